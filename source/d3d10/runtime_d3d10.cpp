@@ -383,31 +383,36 @@ bool reshade::d3d10::runtime_d3d10::capture_screenshot(uint8_t *buffer) const
 	return true;
 }
 
-bool reshade::d3d10::runtime_d3d10::init_effect(size_t index)
+bool reshade::d3d10::runtime_d3d10::compile_effect(size_t index, compiled_effect &compiled)
 {
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_43.dll");
+	// This runs on the worker threads, so make sure only one of them loads the compiler library
+	HMODULE d3d_compiler = nullptr;
+	{	const std::lock_guard<std::mutex> lock(_d3d_compiler_mutex);
 
-	if (_d3d_compiler == nullptr)
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_43.dll");
+
+		d3d_compiler = _d3d_compiler;
+	}
+
+	if (d3d_compiler == nullptr)
 	{
 		LOG(ERROR) << "Unable to load HLSL compiler (\"d3dcompiler_47.dll\")!" << " Make sure you have the DirectX end-user runtime (June 2010) installed or a newer version of the library in the application directory.";
 		return false;
 	}
 
-	effect &effect = _effects[index];
-
-	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(_d3d_compiler, "D3DCompile"));
-	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(_d3d_compiler, "D3DDisassemble"));
+	const effect &effect = _effects[index];
 
-	const std::string hlsl = effect.preamble + effect.module.hlsl;
-	std::unordered_map<std::string, com_ptr<IUnknown>> entry_points;
+	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(d3d_compiler, "D3DCompile"));
+	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(d3d_compiler, "D3DDisassemble"));
 
 	// Compile the generated HLSL source code to DX byte code
 	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
 	{
-		HRESULT hr = E_FAIL;
+		// Prefer the code that only contains what this entry point references, so the compiler has less to parse
+		const std::string hlsl = effect.preamble + (entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl);
 
 		std::string profile;
 		switch (entry_point.type)
@@ -419,9 +424,9 @@ bool reshade::d3d10::runtime_d3d10::init_effect(size_t index)
 			profile = "ps";
 			break;
 		case reshadefx::shader_type::cs:
-			effect.errors += "Compute shaders are not supported in ";
-			effect.errors += "D3D10";
-			effect.errors += '.';
+			compiled.errors += "Compute shaders are not supported in ";
+			compiled.errors += "D3D10";
+			compiled.errors += '.';
 			return false;
 		}
 
@@ -454,12 +459,16 @@ bool reshade::d3d10::runtime_d3d10::init_effect(size_t index)
 		attributes += "profile=" + profile + ';';
 		attributes += "flags=" + std::to_string(compile_flags) + ';';
 
-		const size_t hash = std::hash<std::string_view>()(attributes) ^ std::hash<std::string_view>()(hlsl);
-		std::vector<char> cso;
-		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]))
+		reshadefx::hasher hasher;
+		hasher.update(attributes);
+		hasher.update(hlsl);
+		const reshadefx::hash128 hash = hasher.finalize();
+		std::vector<char> &cso = compiled.entry_points[entry_point.name];
+		std::string &assembly = compiled.assembly[entry_point.name];
+		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly))
 		{
 			com_ptr<ID3DBlob> d3d_compiled, d3d_errors;
-			hr = D3DCompile(
+			const HRESULT hr = D3DCompile(
 				hlsl.data(), hlsl.size(),
 				nullptr, nullptr, nullptr,
 				entry_point.name.c_str(),
@@ -468,7 +477,7 @@ bool reshade::d3d10::runtime_d3d10::init_effect(size_t index)
 				&d3d_compiled, &d3d_errors);
 
 			if (d3d_errors != nullptr) // Append warnings to the output error string as well
-				effect.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
+				compiled.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
 
 			// No need to setup resources if any of the shaders failed to compile
 			if (FAILED(hr))
@@ -478,10 +487,31 @@ bool reshade::d3d10::runtime_d3d10::init_effect(size_t index)
 			std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
 
 			if (com_ptr<ID3DBlob> d3d_disassembled; SUCCEEDED(D3DDisassemble(cso.data(), cso.size(), 0, nullptr, &d3d_disassembled)))
-				effect.assembly[entry_point.name].assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
+				assembly.assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
 
-			save_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]);
+			save_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly);
 		}
+	}
+
+	return true;
+}
+bool reshade::d3d10::runtime_d3d10::init_effect(size_t index, const compiled_effect &compiled)
+{
+	effect &effect = _effects[index];
+
+	std::unordered_map<std::string, com_ptr<IUnknown>> entry_points;
+
+	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
+	{
+		const auto cso_it = compiled.entry_points.find(entry_point.name);
+		if (cso_it == compiled.entry_points.end())
+		{
+			LOG(ERROR) << "Failed to find compiled code for entry point '" << entry_point.name << "'!";
+			return false;
+		}
+
+		HRESULT hr = E_FAIL;
+		const std::vector<char> &cso = cso_it->second;
 
 		// Create runtime shader objects from the compiled DX byte code
 		switch (entry_point.type)
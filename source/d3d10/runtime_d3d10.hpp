@@ -24,7 +24,8 @@ namespace reshade::d3d10
 		bool capture_screenshot(uint8_t *buffer) const override;
 
 	private:
-		bool init_effect(size_t index) override;
+		bool compile_effect(size_t index, compiled_effect &compiled) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
 		void unload_effect(size_t index) override;
 		void unload_effects() override;
 
@@ -51,6 +52,7 @@ namespace reshade::d3d10
 		com_ptr<ID3D10SamplerState>  _copy_sampler_state;
 
 		HMODULE _d3d_compiler = nullptr;
+		std::mutex _d3d_compiler_mutex;
 		com_ptr<ID3D10RasterizerState> _effect_rasterizer;
 		std::unordered_map<size_t, com_ptr<ID3D10SamplerState>> _effect_sampler_states;
 		com_ptr<ID3D10DepthStencilView> _effect_stencil;
@@ -338,7 +338,7 @@ void reshade::d3d11::runtime_d3d11::on_present()
 
 	// For VR use, if the DoubleTex exists, we want to update from that texture now that it has been rendered by the effect.
 	// We are doing this late, to avoid the Reshade copy into backbuffer that breaks the 3D Vision Direct output.
-	const tex_data *tex_impl = _doubletex ? static_cast<tex_data*>(_doubletex->impl) : nullptr;
+	const tex_data *tex_impl = doubletex() ? static_cast<tex_data*>(doubletex()->impl) : nullptr;
 	if (tex_impl)
 	{
 		_vr->CaptureVRFrame(tex_impl->texture.get());
@@ -361,7 +361,7 @@ bool reshade::d3d11::runtime_d3d11::capture_screenshot(uint8_t *buffer) const
 
 	// If we are running in stereo mode, as indicated by the presence of the DoubleTex
 	// texture, let's also generate a stereo screenshot.
-	const tex_data *tex_impl = _doubletex ? static_cast<tex_data*>(_doubletex->impl) : nullptr;
+	const tex_data *tex_impl = doubletex() ? static_cast<tex_data*>(doubletex()->impl) : nullptr;
 	auto tex_width = tex_impl ? _width * 2: _width;
 
 	// Create a texture in system memory, copy back buffer data into it and map it for reading
@@ -436,31 +436,36 @@ bool reshade::d3d11::runtime_d3d11::capture_screenshot(uint8_t *buffer) const
 	return true;
 }
 
-bool reshade::d3d11::runtime_d3d11::init_effect(size_t index)
+bool reshade::d3d11::runtime_d3d11::compile_effect(size_t index, compiled_effect &compiled)
 {
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_43.dll");
+	// This runs on the worker threads, so make sure only one of them loads the compiler library
+	HMODULE d3d_compiler = nullptr;
+	{	const std::lock_guard<std::mutex> lock(_d3d_compiler_mutex);
 
-	if (_d3d_compiler == nullptr)
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_43.dll");
+
+		d3d_compiler = _d3d_compiler;
+	}
+
+	if (d3d_compiler == nullptr)
 	{
 		LOG(ERROR) << "Unable to load HLSL compiler (\"d3dcompiler_47.dll\")!" << " Make sure you have the DirectX end-user runtime (June 2010) installed or a newer version of the library in the application directory.";
 		return false;
 	}
 
-	effect &effect = _effects[index];
-
-	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(_d3d_compiler, "D3DCompile"));
-	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(_d3d_compiler, "D3DDisassemble"));
+	const effect &effect = _effects[index];
 
-	const std::string hlsl = effect.preamble + effect.module.hlsl;
-	std::unordered_map<std::string, com_ptr<IUnknown>> entry_points;
+	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(d3d_compiler, "D3DCompile"));
+	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(d3d_compiler, "D3DDisassemble"));
 
 	// Compile the generated HLSL source code to DX byte code
 	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
 	{
-		HRESULT hr = E_FAIL;
+		// Prefer the code that only contains what this entry point references, so the compiler has less to parse
+		const std::string hlsl = effect.preamble + (entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl);
 
 		std::string profile;
 		switch (entry_point.type)
@@ -477,9 +482,9 @@ bool reshade::d3d11::runtime_d3d11::init_effect(size_t index)
 			// See https://docs.microsoft.com/windows/win32/direct3d11/direct3d-11-advanced-stages-compute-shader
 			if (_renderer_id < D3D_FEATURE_LEVEL_11_0)
 			{
-				effect.errors += "Compute shaders are not supported in ";
-				effect.errors += "D3D10";
-				effect.errors += '.';
+				compiled.errors += "Compute shaders are not supported in ";
+				compiled.errors += "D3D10";
+				compiled.errors += '.';
 				return false;
 			}
 			break;
@@ -517,12 +522,16 @@ bool reshade::d3d11::runtime_d3d11::init_effect(size_t index)
 		attributes += "profile=" + profile + ';';
 		attributes += "flags=" + std::to_string(compile_flags) + ';';
 
-		const size_t hash = std::hash<std::string_view>()(attributes) ^ std::hash<std::string_view>()(hlsl);
-		std::vector<char> cso;
-		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]))
+		reshadefx::hasher hasher;
+		hasher.update(attributes);
+		hasher.update(hlsl);
+		const reshadefx::hash128 hash = hasher.finalize();
+		std::vector<char> &cso = compiled.entry_points[entry_point.name];
+		std::string &assembly = compiled.assembly[entry_point.name];
+		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly))
 		{
 			com_ptr<ID3DBlob> d3d_compiled, d3d_errors;
-			hr = D3DCompile(
+			const HRESULT hr = D3DCompile(
 				hlsl.data(), hlsl.size(),
 				nullptr, nullptr, nullptr,
 				entry_point.name.c_str(),
@@ -531,7 +540,7 @@ bool reshade::d3d11::runtime_d3d11::init_effect(size_t index)
 				&d3d_compiled, &d3d_errors);
 
 			if (d3d_errors != nullptr) // Append warnings to the output error string as well
-				effect.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
+				compiled.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
 
 			// No need to setup resources if any of the shaders failed to compile
 			if (FAILED(hr))
@@ -541,10 +550,31 @@ bool reshade::d3d11::runtime_d3d11::init_effect(size_t index)
 			std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
 
 			if (com_ptr<ID3DBlob> d3d_disassembled; SUCCEEDED(D3DDisassemble(cso.data(), cso.size(), 0, nullptr, &d3d_disassembled)))
-				effect.assembly[entry_point.name].assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
+				assembly.assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
 
-			save_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]);
+			save_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly);
 		}
+	}
+
+	return true;
+}
+bool reshade::d3d11::runtime_d3d11::init_effect(size_t index, const compiled_effect &compiled)
+{
+	effect &effect = _effects[index];
+
+	std::unordered_map<std::string, com_ptr<IUnknown>> entry_points;
+
+	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
+	{
+		const auto cso_it = compiled.entry_points.find(entry_point.name);
+		if (cso_it == compiled.entry_points.end())
+		{
+			LOG(ERROR) << "Failed to find compiled code for entry point '" << entry_point.name << "'!";
+			return false;
+		}
+
+		HRESULT hr = E_FAIL;
+		const std::vector<char> &cso = cso_it->second;
 
 		// Create runtime shader objects from the compiled DX byte code
 		switch (entry_point.type)
@@ -953,7 +983,7 @@ bool reshade::d3d11::runtime_d3d11::init_texture(texture &texture)
 	// calls will fail for some games that use unusual formats.
 	if (texture.unique_name == "V__DoubleTex")
 	{
-		_doubletex = &texture;
+		_doubletex_index = &texture - _textures.data();
 
 		if (const char *format_string = format_to_string(desc.Format); format_string != nullptr)
 			LOG(INFO) << "Original texture format for DoubleTex: " << format_to_string(desc.Format);
@@ -1078,7 +1108,7 @@ void reshade::d3d11::runtime_d3d11::destroy_texture(texture &texture)
 	if (texture.unique_name == "V__DoubleTex")
 	{
 		_vr->DestroySharedTexture();
-		_doubletex = nullptr;
+		_doubletex_index = std::numeric_limits<size_t>::max();
 	}
 
 	delete static_cast<tex_data *>(texture.impl);
@@ -1502,7 +1532,7 @@ void reshade::d3d11::runtime_d3d11::render_imgui_draw_data(ImDrawData *draw_data
 
 	// Repeat the drawing twice more for each eye of the DoubleTex texture, when it's active.
 	// We need to disable the scissor clipping to see the second eye.
-	const tex_data *tex_impl = _doubletex ? static_cast<tex_data*>(_doubletex->impl) : nullptr;
+	const tex_data *tex_impl = doubletex() ? static_cast<tex_data*>(doubletex()->impl) : nullptr;
 	if (tex_impl)
 	{
 		ID3D11RenderTargetView *const doubletex_targets[] = { tex_impl->rtv[0].get() };
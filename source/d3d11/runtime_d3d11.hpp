@@ -26,7 +26,8 @@ namespace reshade::d3d11
 		bool capture_screenshot(uint8_t *buffer) const override;
 
 	private:
-		bool init_effect(size_t index) override;
+		bool compile_effect(size_t index, compiled_effect &compiled) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
 		void unload_effect(size_t index) override;
 		void unload_effects() override;
 
@@ -56,6 +57,7 @@ namespace reshade::d3d11
 		com_ptr<ID3D11SamplerState>  _copy_sampler_state;
 
 		HMODULE _d3d_compiler = nullptr;
+		std::mutex _d3d_compiler_mutex;
 		com_ptr<ID3D11RasterizerState> _effect_rasterizer;
 		std::unordered_map<size_t, com_ptr<ID3D11SamplerState>> _effect_sampler_states;
 		com_ptr<ID3D11DepthStencilView> _effect_stencil;
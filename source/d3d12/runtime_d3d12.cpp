@@ -63,6 +63,45 @@ namespace reshade::d3d12
 		std::vector<pass_data> passes;
 	};
 
+	struct compiled_effect_data
+	{
+		com_ptr<ID3D12RootSignature> signature;
+		std::unordered_map<std::string, std::vector<com_ptr<ID3D12PipelineState>>> pipelines; // Pipeline state of each pass, by technique name
+	};
+
+	static DXGI_FORMAT convert_format(reshadefx::texture_format format)
+	{
+		switch (format)
+		{
+		case reshadefx::texture_format::r8:
+			return DXGI_FORMAT_R8_UNORM;
+		case reshadefx::texture_format::r16f:
+			return DXGI_FORMAT_R16_FLOAT;
+		case reshadefx::texture_format::r32f:
+			return DXGI_FORMAT_R32_FLOAT;
+		case reshadefx::texture_format::rg8:
+			return DXGI_FORMAT_R8G8_UNORM;
+		case reshadefx::texture_format::rg16:
+			return DXGI_FORMAT_R16G16_UNORM;
+		case reshadefx::texture_format::rg16f:
+			return DXGI_FORMAT_R16G16_FLOAT;
+		case reshadefx::texture_format::rg32f:
+			return DXGI_FORMAT_R32G32_FLOAT;
+		case reshadefx::texture_format::rgba8:
+			return DXGI_FORMAT_R8G8B8A8_TYPELESS;
+		case reshadefx::texture_format::rgba16:
+			return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case reshadefx::texture_format::rgba16f:
+			return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case reshadefx::texture_format::rgba32f:
+			return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		case reshadefx::texture_format::rgb10a2:
+			return DXGI_FORMAT_R10G10B10A2_UNORM;
+		default:
+			return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
 	static void transition_state(
 		const com_ptr<ID3D12GraphicsCommandList> &list,
 		const com_ptr<ID3D12Resource> &res,
@@ -422,7 +461,7 @@ void reshade::d3d12::runtime_d3d12::on_present()
 	// For VR use, if the DoubleTex exists, we want to update from that texture now that it has been rendered by the effect.
 	// We are doing this late, to avoid the Reshade copy into backbuffer that breaks the 3D Vision Direct output.
 	// We are just adding our commands to the reshade cmd_list, to copy after it is done.
-	const tex_data *tex_impl = _doubletex ? static_cast<tex_data*>(_doubletex->impl) : nullptr;
+	const tex_data *tex_impl = doubletex() ? static_cast<tex_data*>(doubletex()->impl) : nullptr;
 	if (tex_impl)
 	{
 		_vr->CaptureVRFrame(tex_impl->resource.get(), _cmd_list.get());
@@ -578,29 +617,34 @@ bool reshade::d3d12::runtime_d3d12::capture_screenshot(uint8_t *buffer) const
 	return true;
 }
 
-bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
+bool reshade::d3d12::runtime_d3d12::compile_effect(size_t index, compiled_effect &compiled)
 {
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
+	// This runs on the worker threads, so make sure only one of them loads the compiler library
+	HMODULE d3d_compiler = nullptr;
+	{	const std::lock_guard<std::mutex> lock(_d3d_compiler_mutex);
+
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
+
+		d3d_compiler = _d3d_compiler;
+	}
 
-	if (_d3d_compiler == nullptr)
+	if (d3d_compiler == nullptr)
 	{
 		LOG(ERROR) << "Unable to load HLSL compiler (\"d3dcompiler_47.dll\")!";
 		return false;
 	}
 
-	effect &effect = _effects[index];
-
-	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(_d3d_compiler, "D3DCompile"));
-	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(_d3d_compiler, "D3DDisassemble"));
+	const effect &effect = _effects[index];
 
-	const std::string hlsl = effect.preamble + effect.module.hlsl;
-	std::unordered_map<std::string, std::vector<char>> entry_points;
+	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(d3d_compiler, "D3DCompile"));
+	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(d3d_compiler, "D3DDisassemble"));
 
 	// Compile the generated HLSL source code to DX byte code
 	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
 	{
-		HRESULT hr = E_FAIL;
+		// Prefer the code that only contains what this entry point references, so the compiler has less to parse
+		const std::string hlsl = effect.preamble + (entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl);
 
 		std::string profile;
 		switch (entry_point.type)
@@ -627,12 +671,16 @@ bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
 		attributes += "profile=" + profile + ';';
 		attributes += "flags=" + std::to_string(compile_flags) + ';';
 
-		const size_t hash = std::hash<std::string_view>()(attributes) ^ std::hash<std::string_view>()(hlsl);
-		std::vector<char> &cso = entry_points[entry_point.name];
-		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]))
+		reshadefx::hasher hasher;
+		hasher.update(attributes);
+		hasher.update(hlsl);
+		const reshadefx::hash128 hash = hasher.finalize();
+		std::vector<char> &cso = compiled.entry_points[entry_point.name];
+		std::string &assembly = compiled.assembly[entry_point.name];
+		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly))
 		{
 			com_ptr<ID3DBlob> d3d_compiled, d3d_errors;
-			hr = D3DCompile(
+			const HRESULT hr = D3DCompile(
 				hlsl.data(), hlsl.size(),
 				nullptr, nullptr, nullptr,
 				entry_point.name.c_str(),
@@ -641,7 +689,7 @@ bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
 				&d3d_compiled, &d3d_errors);
 
 			if (d3d_errors != nullptr) // Append warnings to the output error string as well
-				effect.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
+				compiled.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
 
 			// No need to setup resources if any of the shaders failed to compile
 			if (FAILED(hr))
@@ -651,15 +699,15 @@ bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
 			std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
 
 			if (com_ptr<ID3DBlob> d3d_disassembled; SUCCEEDED(D3DDisassemble(cso.data(), cso.size(), 0, nullptr, &d3d_disassembled)))
-				effect.assembly[entry_point.name].assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
+				assembly.assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
 
-			save_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]);
+			save_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly);
 		}
 	}
 
-	if (index >= _effect_data.size())
-		_effect_data.resize(index + 1);
-	effect_data &effect_data = _effect_data[index];
+	// The device is free-threaded, so create the pipeline states here too, which is where the driver compiles the byte code to GPU code
+	const auto impl = std::make_shared<compiled_effect_data>();
+	compiled.impl = impl;
 
 	{   D3D12_DESCRIPTOR_RANGE srv_range = {};
 		srv_range.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
@@ -695,14 +743,214 @@ bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
 		desc.NumParameters = effect.module.num_storage_bindings == 0 ? 3 : 4;
 		desc.pParameters = params;
 
-		effect_data.signature = create_root_signature(desc);
-		if (effect_data.signature == nullptr)
+		impl->signature = create_root_signature(desc);
+		if (impl->signature == nullptr)
 		{
 			LOG(ERROR) << "Failed to create root signature for effect file '" << effect.source_file << "'!";
 			return false;
 		}
 	}
 
+	for (const reshadefx::technique_info &technique_info : effect.module.techniques)
+	{
+		std::vector<com_ptr<ID3D12PipelineState>> &pipelines = impl->pipelines[technique_info.name];
+		pipelines.resize(technique_info.passes.size());
+
+		for (size_t pass_index = 0; pass_index < technique_info.passes.size(); ++pass_index)
+		{
+			const reshadefx::pass_info &pass_info = technique_info.passes[pass_index];
+
+			if (!pass_info.cs_entry_point.empty())
+			{
+				D3D12_COMPUTE_PIPELINE_STATE_DESC pso_desc = {};
+				pso_desc.pRootSignature = impl->signature.get();
+
+				const auto &CS = compiled.entry_points.at(pass_info.cs_entry_point);
+				pso_desc.CS = { CS.data(), CS.size() };
+
+				pso_desc.NodeMask = 1;
+
+				if (HRESULT hr = _device->CreateComputePipelineState(&pso_desc, IID_PPV_ARGS(&pipelines[pass_index])); FAILED(hr))
+				{
+					LOG(ERROR) << "Failed to create compute pipeline for pass " << pass_index << " in technique '" << technique_info.name << "'! HRESULT is " << hr << '.';
+					return false;
+				}
+			}
+			else
+			{
+				D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
+				pso_desc.pRootSignature = impl->signature.get();
+
+				const auto &VS = compiled.entry_points.at(pass_info.vs_entry_point);
+				pso_desc.VS = { VS.data(), VS.size() };
+				const auto &PS = compiled.entry_points.at(pass_info.ps_entry_point);
+				pso_desc.PS = { PS.data(), PS.size() };
+
+				for (UINT k = 0; k < 8 && !pass_info.render_target_names[k].empty(); ++k)
+				{
+					// The render target textures may not have been created yet, so take their format from the description
+					reshadefx::texture_info texture_info;
+					if (!look_up_texture_info_by_name(pass_info.render_target_names[k], texture_info))
+					{
+						LOG(ERROR) << "Failed to find render target '" << pass_info.render_target_names[k] << "' for pass " << pass_index << " in technique '" << technique_info.name << "'!";
+						return false;
+					}
+
+					// Same as in 'init_texture', the stereo texture matches the back buffer format
+					const DXGI_FORMAT format = texture_info.unique_name == "V__DoubleTex" ?
+						make_dxgi_format_typeless(_backbuffer_format) :
+						convert_format(texture_info.format);
+
+					pso_desc.NumRenderTargets = k + 1;
+					pso_desc.RTVFormats[k] = pass_info.srgb_write_enable ?
+						make_dxgi_format_srgb(format) :
+						make_dxgi_format_normal(format);
+				}
+
+				if (pass_info.render_target_names[0].empty())
+				{
+					pso_desc.NumRenderTargets = 1;
+					pso_desc.RTVFormats[0] = pass_info.srgb_write_enable ?
+						make_dxgi_format_srgb(_backbuffer_format) :
+						make_dxgi_format_normal(_backbuffer_format);
+				}
+
+				pso_desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+				pso_desc.SampleMask = UINT_MAX;
+				pso_desc.SampleDesc = { 1, 0 };
+				pso_desc.NodeMask = 1;
+
+				switch (pass_info.topology)
+				{
+				case reshadefx::primitive_topology::point_list:
+					pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
+					break;
+				case reshadefx::primitive_topology::line_list:
+				case reshadefx::primitive_topology::line_strip:
+					pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
+					break;
+				case reshadefx::primitive_topology::triangle_list:
+				case reshadefx::primitive_topology::triangle_strip:
+					pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+					break;
+				}
+
+				{   D3D12_BLEND_DESC &desc = pso_desc.BlendState;
+					desc.AlphaToCoverageEnable = FALSE;
+					desc.IndependentBlendEnable = FALSE;
+					desc.RenderTarget[0].BlendEnable = pass_info.blend_enable;
+
+					const auto convert_blend_op = [](reshadefx::pass_blend_op value) {
+						switch (value)
+						{
+						default:
+						case reshadefx::pass_blend_op::add: return D3D12_BLEND_OP_ADD;
+						case reshadefx::pass_blend_op::subtract: return D3D12_BLEND_OP_SUBTRACT;
+						case reshadefx::pass_blend_op::rev_subtract: return D3D12_BLEND_OP_REV_SUBTRACT;
+						case reshadefx::pass_blend_op::min: return D3D12_BLEND_OP_MIN;
+						case reshadefx::pass_blend_op::max: return D3D12_BLEND_OP_MAX;
+						}
+					};
+					const auto convert_blend_func = [](reshadefx::pass_blend_func value) {
+						switch (value) {
+						case reshadefx::pass_blend_func::zero: return D3D12_BLEND_ZERO;
+						default:
+						case reshadefx::pass_blend_func::one: return D3D12_BLEND_ONE;
+						case reshadefx::pass_blend_func::src_color: return D3D12_BLEND_SRC_COLOR;
+						case reshadefx::pass_blend_func::src_alpha: return D3D12_BLEND_SRC_ALPHA;
+						case reshadefx::pass_blend_func::inv_src_color: return D3D12_BLEND_INV_SRC_COLOR;
+						case reshadefx::pass_blend_func::inv_src_alpha: return D3D12_BLEND_INV_SRC_ALPHA;
+						case reshadefx::pass_blend_func::dst_color: return D3D12_BLEND_DEST_COLOR;
+						case reshadefx::pass_blend_func::dst_alpha: return D3D12_BLEND_DEST_ALPHA;
+						case reshadefx::pass_blend_func::inv_dst_color: return D3D12_BLEND_INV_DEST_COLOR;
+						case reshadefx::pass_blend_func::inv_dst_alpha: return D3D12_BLEND_INV_DEST_ALPHA;
+						}
+					};
+
+					desc.RenderTarget[0].SrcBlend = convert_blend_func(pass_info.src_blend);
+					desc.RenderTarget[0].DestBlend = convert_blend_func(pass_info.dest_blend);
+					desc.RenderTarget[0].BlendOp = convert_blend_op(pass_info.blend_op);
+					desc.RenderTarget[0].SrcBlendAlpha = convert_blend_func(pass_info.src_blend_alpha);
+					desc.RenderTarget[0].DestBlendAlpha = convert_blend_func(pass_info.dest_blend_alpha);
+					desc.RenderTarget[0].BlendOpAlpha = convert_blend_op(pass_info.blend_op_alpha);
+					desc.RenderTarget[0].RenderTargetWriteMask = pass_info.color_write_mask;
+				}
+
+				{   D3D12_RASTERIZER_DESC &desc = pso_desc.RasterizerState;
+					desc.FillMode = D3D12_FILL_MODE_SOLID;
+					desc.CullMode = D3D12_CULL_MODE_NONE;
+					desc.DepthClipEnable = TRUE;
+				}
+
+				{   D3D12_DEPTH_STENCIL_DESC &desc = pso_desc.DepthStencilState;
+					desc.DepthEnable = FALSE;
+					desc.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+					desc.DepthFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+
+					const auto convert_stencil_op = [](reshadefx::pass_stencil_op value) {
+						switch (value) {
+						case reshadefx::pass_stencil_op::zero: return D3D12_STENCIL_OP_ZERO;
+						default:
+						case reshadefx::pass_stencil_op::keep: return D3D12_STENCIL_OP_KEEP;
+						case reshadefx::pass_stencil_op::invert: return D3D12_STENCIL_OP_INVERT;
+						case reshadefx::pass_stencil_op::replace: return D3D12_STENCIL_OP_REPLACE;
+						case reshadefx::pass_stencil_op::incr: return D3D12_STENCIL_OP_INCR;
+						case reshadefx::pass_stencil_op::incr_sat: return D3D12_STENCIL_OP_INCR_SAT;
+						case reshadefx::pass_stencil_op::decr: return D3D12_STENCIL_OP_DECR;
+						case reshadefx::pass_stencil_op::decr_sat: return D3D12_STENCIL_OP_DECR_SAT;
+						}
+					};
+					const auto convert_stencil_func = [](reshadefx::pass_stencil_func value) {
+						switch (value)
+						{
+						case reshadefx::pass_stencil_func::never: return D3D12_COMPARISON_FUNC_NEVER;
+						case reshadefx::pass_stencil_func::equal: return D3D12_COMPARISON_FUNC_EQUAL;
+						case reshadefx::pass_stencil_func::not_equal: return D3D12_COMPARISON_FUNC_NOT_EQUAL;
+						case reshadefx::pass_stencil_func::less: return D3D12_COMPARISON_FUNC_LESS;
+						case reshadefx::pass_stencil_func::less_equal: return D3D12_COMPARISON_FUNC_LESS_EQUAL;
+						case reshadefx::pass_stencil_func::greater: return D3D12_COMPARISON_FUNC_GREATER;
+						case reshadefx::pass_stencil_func::greater_equal: return D3D12_COMPARISON_FUNC_GREATER_EQUAL;
+						default:
+						case reshadefx::pass_stencil_func::always: return D3D12_COMPARISON_FUNC_ALWAYS;
+						}
+					};
+
+					desc.StencilEnable = pass_info.stencil_enable;
+					desc.StencilReadMask = pass_info.stencil_read_mask;
+					desc.StencilWriteMask = pass_info.stencil_write_mask;
+					desc.FrontFace.StencilFailOp = convert_stencil_op(pass_info.stencil_op_fail);
+					desc.FrontFace.StencilDepthFailOp = convert_stencil_op(pass_info.stencil_op_depth_fail);
+					desc.FrontFace.StencilPassOp = convert_stencil_op(pass_info.stencil_op_pass);
+					desc.FrontFace.StencilFunc = convert_stencil_func(pass_info.stencil_comparison_func);
+					desc.BackFace = desc.FrontFace;
+				}
+
+				if (HRESULT hr = _device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&pipelines[pass_index])); FAILED(hr))
+				{
+					LOG(ERROR) << "Failed to create graphics pipeline for pass " << pass_index << " in technique '" << technique_info.name << "'! HRESULT is " << hr << '.';
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+bool reshade::d3d12::runtime_d3d12::init_effect(size_t index, const compiled_effect &compiled)
+{
+	effect &effect = _effects[index];
+
+	// The root signature and pipeline states were already created along with the shaders in 'compile_effect'
+	const auto compiled_data = static_cast<const compiled_effect_data *>(compiled.impl.get());
+	if (compiled_data == nullptr)
+		return false;
+
+	if (index >= _effect_data.size())
+		_effect_data.resize(index + 1);
+	effect_data &effect_data = _effect_data[index];
+
+	effect_data.signature = compiled_data->signature;
+
 	if (!effect.uniform_data_storage.empty())
 	{
 		D3D12_RESOURCE_DESC desc = { D3D12_RESOURCE_DIMENSION_BUFFER };
@@ -817,40 +1065,27 @@ bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
 		auto impl = new technique_data();
 		technique.impl = impl;
 
+		const auto pipelines = compiled_data->pipelines.find(technique.name);
+		if (pipelines == compiled_data->pipelines.end() || pipelines->second.size() != technique.passes.size())
+		{
+			LOG(ERROR) << "Failed to find pipeline states for technique '" << technique.name << "'!";
+			return false;
+		}
+
 		impl->passes.resize(technique.passes.size());
 		for (size_t pass_index = 0; pass_index < technique.passes.size(); ++pass_index)
 		{
 			pass_data &pass_data = impl->passes[pass_index];
 			reshadefx::pass_info &pass_info = technique.passes[pass_index];
 
+			pass_data.pipeline = pipelines->second[pass_index];
+
 			if (!pass_info.cs_entry_point.empty())
 			{
 				impl->has_compute_passes = true;
-
-				D3D12_COMPUTE_PIPELINE_STATE_DESC pso_desc = {};
-				pso_desc.pRootSignature = effect_data.signature.get();
-
-				const auto &CS = entry_points.at(pass_info.cs_entry_point);
-				pso_desc.CS = { CS.data(), CS.size() };
-
-				pso_desc.NodeMask = 1;
-
-				if (HRESULT hr = _device->CreateComputePipelineState(&pso_desc, IID_PPV_ARGS(&pass_data.pipeline)); FAILED(hr))
-				{
-					LOG(ERROR) << "Failed to create compute pipeline for pass " << pass_index << " in technique '" << technique.name << "'! HRESULT is " << hr << '.';
-					return false;
-				}
 			}
 			else
 			{
-				D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
-				pso_desc.pRootSignature = effect_data.signature.get();
-
-				const auto &VS = entry_points.at(pass_info.vs_entry_point);
-				pso_desc.VS = { VS.data(), VS.size() };
-				const auto &PS = entry_points.at(pass_info.ps_entry_point);
-				pso_desc.PS = { PS.data(), PS.size() };
-
 				// Keep track of the base handle, which is followed by a contiguous range of render target descriptors
 				pass_data.render_targets = rtv_cpu_base;
 				rtv_cpu_base.ptr += 8 * _rtv_handle_size;
@@ -875,136 +1110,14 @@ bool reshade::d3d12::runtime_d3d12::init_effect(size_t index)
 
 					_device->CreateRenderTargetView(tex_impl->resource.get(), &rtv_desc, rtv_handle);
 
-					pso_desc.NumRenderTargets = pass_data.num_render_targets = k + 1;
-					pso_desc.RTVFormats[k] = rtv_desc.Format;
+					pass_data.num_render_targets = k + 1;
 				}
 
 				if (pass_info.render_target_names[0].empty())
 				{
-					pso_desc.NumRenderTargets = 1;
-					pso_desc.RTVFormats[0] = pass_info.srgb_write_enable ?
-						make_dxgi_format_srgb(_backbuffer_format) :
-						make_dxgi_format_normal(_backbuffer_format);
-
 					pass_info.viewport_width = _width;
 					pass_info.viewport_height = _height;
 				}
-
-				pso_desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
-				pso_desc.SampleMask = UINT_MAX;
-				pso_desc.SampleDesc = { 1, 0 };
-				pso_desc.NodeMask = 1;
-
-				switch (pass_info.topology)
-				{
-				case reshadefx::primitive_topology::point_list:
-					pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
-					break;
-				case reshadefx::primitive_topology::line_list:
-				case reshadefx::primitive_topology::line_strip:
-					pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
-					break;
-				case reshadefx::primitive_topology::triangle_list:
-				case reshadefx::primitive_topology::triangle_strip:
-					pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-					break;
-				}
-
-				{   D3D12_BLEND_DESC &desc = pso_desc.BlendState;
-					desc.AlphaToCoverageEnable = FALSE;
-					desc.IndependentBlendEnable = FALSE;
-					desc.RenderTarget[0].BlendEnable = pass_info.blend_enable;
-
-					const auto convert_blend_op = [](reshadefx::pass_blend_op value) {
-						switch (value)
-						{
-						default:
-						case reshadefx::pass_blend_op::add: return D3D12_BLEND_OP_ADD;
-						case reshadefx::pass_blend_op::subtract: return D3D12_BLEND_OP_SUBTRACT;
-						case reshadefx::pass_blend_op::rev_subtract: return D3D12_BLEND_OP_REV_SUBTRACT;
-						case reshadefx::pass_blend_op::min: return D3D12_BLEND_OP_MIN;
-						case reshadefx::pass_blend_op::max: return D3D12_BLEND_OP_MAX;
-						}
-					};
-					const auto convert_blend_func = [](reshadefx::pass_blend_func value) {
-						switch (value) {
-						case reshadefx::pass_blend_func::zero: return D3D12_BLEND_ZERO;
-						default:
-						case reshadefx::pass_blend_func::one: return D3D12_BLEND_ONE;
-						case reshadefx::pass_blend_func::src_color: return D3D12_BLEND_SRC_COLOR;
-						case reshadefx::pass_blend_func::src_alpha: return D3D12_BLEND_SRC_ALPHA;
-						case reshadefx::pass_blend_func::inv_src_color: return D3D12_BLEND_INV_SRC_COLOR;
-						case reshadefx::pass_blend_func::inv_src_alpha: return D3D12_BLEND_INV_SRC_ALPHA;
-						case reshadefx::pass_blend_func::dst_color: return D3D12_BLEND_DEST_COLOR;
-						case reshadefx::pass_blend_func::dst_alpha: return D3D12_BLEND_DEST_ALPHA;
-						case reshadefx::pass_blend_func::inv_dst_color: return D3D12_BLEND_INV_DEST_COLOR;
-						case reshadefx::pass_blend_func::inv_dst_alpha: return D3D12_BLEND_INV_DEST_ALPHA;
-						}
-					};
-
-					desc.RenderTarget[0].SrcBlend = convert_blend_func(pass_info.src_blend);
-					desc.RenderTarget[0].DestBlend = convert_blend_func(pass_info.dest_blend);
-					desc.RenderTarget[0].BlendOp = convert_blend_op(pass_info.blend_op);
-					desc.RenderTarget[0].SrcBlendAlpha = convert_blend_func(pass_info.src_blend_alpha);
-					desc.RenderTarget[0].DestBlendAlpha = convert_blend_func(pass_info.dest_blend_alpha);
-					desc.RenderTarget[0].BlendOpAlpha = convert_blend_op(pass_info.blend_op_alpha);
-					desc.RenderTarget[0].RenderTargetWriteMask = pass_info.color_write_mask;
-				}
-
-				{   D3D12_RASTERIZER_DESC &desc = pso_desc.RasterizerState;
-					desc.FillMode = D3D12_FILL_MODE_SOLID;
-					desc.CullMode = D3D12_CULL_MODE_NONE;
-					desc.DepthClipEnable = TRUE;
-				}
-
-				{   D3D12_DEPTH_STENCIL_DESC &desc = pso_desc.DepthStencilState;
-					desc.DepthEnable = FALSE;
-					desc.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-					desc.DepthFunc = D3D12_COMPARISON_FUNC_ALWAYS;
-
-					const auto convert_stencil_op = [](reshadefx::pass_stencil_op value) {
-						switch (value) {
-						case reshadefx::pass_stencil_op::zero: return D3D12_STENCIL_OP_ZERO;
-						default:
-						case reshadefx::pass_stencil_op::keep: return D3D12_STENCIL_OP_KEEP;
-						case reshadefx::pass_stencil_op::invert: return D3D12_STENCIL_OP_INVERT;
-						case reshadefx::pass_stencil_op::replace: return D3D12_STENCIL_OP_REPLACE;
-						case reshadefx::pass_stencil_op::incr: return D3D12_STENCIL_OP_INCR;
-						case reshadefx::pass_stencil_op::incr_sat: return D3D12_STENCIL_OP_INCR_SAT;
-						case reshadefx::pass_stencil_op::decr: return D3D12_STENCIL_OP_DECR;
-						case reshadefx::pass_stencil_op::decr_sat: return D3D12_STENCIL_OP_DECR_SAT;
-						}
-					};
-					const auto convert_stencil_func = [](reshadefx::pass_stencil_func value) {
-						switch (value)
-						{
-						case reshadefx::pass_stencil_func::never: return D3D12_COMPARISON_FUNC_NEVER;
-						case reshadefx::pass_stencil_func::equal: return D3D12_COMPARISON_FUNC_EQUAL;
-						case reshadefx::pass_stencil_func::not_equal: return D3D12_COMPARISON_FUNC_NOT_EQUAL;
-						case reshadefx::pass_stencil_func::less: return D3D12_COMPARISON_FUNC_LESS;
-						case reshadefx::pass_stencil_func::less_equal: return D3D12_COMPARISON_FUNC_LESS_EQUAL;
-						case reshadefx::pass_stencil_func::greater: return D3D12_COMPARISON_FUNC_GREATER;
-						case reshadefx::pass_stencil_func::greater_equal: return D3D12_COMPARISON_FUNC_GREATER_EQUAL;
-						default:
-						case reshadefx::pass_stencil_func::always: return D3D12_COMPARISON_FUNC_ALWAYS;
-						}
-					};
-
-					desc.StencilEnable = pass_info.stencil_enable;
-					desc.StencilReadMask = pass_info.stencil_read_mask;
-					desc.StencilWriteMask = pass_info.stencil_write_mask;
-					desc.FrontFace.StencilFailOp = convert_stencil_op(pass_info.stencil_op_fail);
-					desc.FrontFace.StencilDepthFailOp = convert_stencil_op(pass_info.stencil_op_depth_fail);
-					desc.FrontFace.StencilPassOp = convert_stencil_op(pass_info.stencil_op_pass);
-					desc.FrontFace.StencilFunc = convert_stencil_func(pass_info.stencil_comparison_func);
-					desc.BackFace = desc.FrontFace;
-				}
-
-				if (HRESULT hr = _device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&pass_data.pipeline)); FAILED(hr))
-				{
-					LOG(ERROR) << "Failed to create graphics pipeline for pass " << pass_index << " in technique '" << technique.name << "'! HRESULT is " << hr << '.';
-					return false;
-				}
 			}
 
 			pass_data.srv_handle = srv_gpu_base;
@@ -1153,52 +1266,14 @@ bool reshade::d3d12::runtime_d3d12::init_texture(texture &texture)
 	if (texture.storage_access || texture.levels > 1) // Need UAV for mipmap generation
 		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
-	switch (texture.format)
-	{
-	case reshadefx::texture_format::r8:
-		desc.Format = DXGI_FORMAT_R8_UNORM;
-		break;
-	case reshadefx::texture_format::r16f:
-		desc.Format = DXGI_FORMAT_R16_FLOAT;
-		break;
-	case reshadefx::texture_format::r32f:
-		desc.Format = DXGI_FORMAT_R32_FLOAT;
-		break;
-	case reshadefx::texture_format::rg8:
-		desc.Format = DXGI_FORMAT_R8G8_UNORM;
-		break;
-	case reshadefx::texture_format::rg16:
-		desc.Format = DXGI_FORMAT_R16G16_UNORM;
-		break;
-	case reshadefx::texture_format::rg16f:
-		desc.Format = DXGI_FORMAT_R16G16_FLOAT;
-		break;
-	case reshadefx::texture_format::rg32f:
-		desc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		break;
-	case reshadefx::texture_format::rgba8:
-		desc.Format = DXGI_FORMAT_R8G8B8A8_TYPELESS;
-		break;
-	case reshadefx::texture_format::rgba16:
-		desc.Format = DXGI_FORMAT_R16G16B16A16_UNORM;
-		break;
-	case reshadefx::texture_format::rgba16f:
-		desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-		break;
-	case reshadefx::texture_format::rgba32f:
-		desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		break;
-	case reshadefx::texture_format::rgb10a2:
-		desc.Format = DXGI_FORMAT_R10G10B10A2_UNORM;
-		break;
-	}
+	desc.Format = convert_format(texture.format);
 
 	// If we are creating our stereo texture, we need to ensure that it matches the format
 	// of the backbuffer, instead of the reshade defaults.  Otherwise, our CopySubResourceRegion
 	// calls will fail for some games that use unusual formats.
 	if (texture.unique_name == "V__DoubleTex")
 	{
-		_doubletex = &texture;
+		_doubletex_index = &texture - _textures.data();
 
 		if (const char *format_string = format_to_string(desc.Format); format_string != nullptr)
 			LOG(INFO) << "Original texture format for DoubleTex: " << format_to_string(desc.Format);
@@ -1357,7 +1432,7 @@ void reshade::d3d12::runtime_d3d12::destroy_texture(texture &texture)
 	if (texture.unique_name == "V__DoubleTex")
 	{
 		_vr->DestroySharedTexture();
-		_doubletex = nullptr;
+		_doubletex_index = std::numeric_limits<size_t>::max();
 	}
 
 	// Make sure texture is not still in use before destroying it
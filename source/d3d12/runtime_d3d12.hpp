@@ -30,7 +30,8 @@ namespace reshade::d3d12
 		bool capture_screenshot(uint8_t *buffer) const override;
 
 	private:
-		bool init_effect(size_t index) override;
+		bool compile_effect(size_t index, compiled_effect &compiled) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
 		void unload_effect(size_t index) override;
 		void unload_effects() override;
 
@@ -74,6 +75,7 @@ namespace reshade::d3d12
 		com_ptr<ID3D12RootSignature> _mipmap_signature;
 
 		HMODULE _d3d_compiler = nullptr;
+		std::mutex _d3d_compiler_mutex;
 		com_ptr<ID3D12Resource> _effect_stencil;
 		std::vector<struct effect_data> _effect_data;
 
@@ -340,48 +340,52 @@ bool reshade::d3d9::runtime_d3d9::capture_screenshot(uint8_t *buffer) const
 	return true;
 }
 
-bool reshade::d3d9::runtime_d3d9::init_effect(size_t index)
+bool reshade::d3d9::runtime_d3d9::compile_effect(size_t index, compiled_effect &compiled)
 {
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
-	if (_d3d_compiler == nullptr)
-		_d3d_compiler = LoadLibraryW(L"d3dcompiler_43.dll");
+	// This runs on the worker threads, so make sure only one of them loads the compiler library
+	HMODULE d3d_compiler = nullptr;
+	{	const std::lock_guard<std::mutex> lock(_d3d_compiler_mutex);
 
-	if (_d3d_compiler == nullptr)
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_47.dll");
+		if (_d3d_compiler == nullptr)
+			_d3d_compiler = LoadLibraryW(L"d3dcompiler_43.dll");
+
+		d3d_compiler = _d3d_compiler;
+	}
+
+	if (d3d_compiler == nullptr)
 	{
 		LOG(ERROR) << "Unable to load HLSL compiler (\"d3dcompiler_47.dll\")!" << " Make sure you have the DirectX end-user runtime (June 2010) installed or a newer version of the library in the application directory.";
 		return false;
 	}
 
-	effect &effect = _effects[index];
+	const effect &effect = _effects[index];
 
-	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(_d3d_compiler, "D3DCompile"));
-	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(_d3d_compiler, "D3DDisassemble"));
+	const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(d3d_compiler, "D3DCompile"));
+	const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(d3d_compiler, "D3DDisassemble"));
 
 	// Add specialization constant defines to source code
-	const std::string hlsl =
+	const std::string hlsl_prefix =
 		"#define COLOR_PIXEL_SIZE 1.0 / " + std::to_string(_width) + ", 1.0 / " + std::to_string(_height) + "\n"
 		"#define DEPTH_PIXEL_SIZE COLOR_PIXEL_SIZE\n"
 		"#define SV_DEPTH_PIXEL_SIZE DEPTH_PIXEL_SIZE\n"
 		"#define SV_TARGET_PIXEL_SIZE COLOR_PIXEL_SIZE\n"
 		"#line 1\n" + // Reset line number, so it matches what is shown when viewing the generated code
-		effect.preamble +
-		effect.module.hlsl;
+		effect.preamble;
 
 	// Overwrite position semantic in pixel shaders
 	const D3D_SHADER_MACRO ps_defines[] = {
 		{ "POSITION", "VPOS" }, { nullptr, nullptr }
 	};
 
-	std::unordered_map<std::string, com_ptr<IUnknown>> entry_points;
-
 	// Compile the generated HLSL source code to DX byte code
 	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
 	{
-		HRESULT hr = E_FAIL;
+		// Prefer the code that only contains what this entry point references, so the compiler has less to parse
+		const std::string hlsl = hlsl_prefix + (entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl);
 
 		std::string profile;
-		com_ptr<ID3DBlob> compiled, d3d_errors;
 
 		switch (entry_point.type)
 		{
@@ -392,9 +396,9 @@ bool reshade::d3d9::runtime_d3d9::init_effect(size_t index)
 			profile = "ps_3_0";
 			break;
 		case reshadefx::shader_type::cs:
-			effect.errors += "Compute shaders are not supported in ";
-			effect.errors += "D3D9";
-			effect.errors += '.';
+			compiled.errors += "Compute shaders are not supported in ";
+			compiled.errors += "D3D9";
+			compiled.errors += '.';
 			return false;
 		}
 
@@ -403,34 +407,60 @@ bool reshade::d3d9::runtime_d3d9::init_effect(size_t index)
 		attributes += "profile=" + profile + ';';
 		attributes += "flags=" + std::to_string(_performance_mode ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_OPTIMIZATION_LEVEL1) + ';';
 
-		const size_t hash = std::hash<std::string_view>()(attributes) ^ std::hash<std::string_view>()(hlsl);
-		std::vector<char> cso;
-		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]))
+		reshadefx::hasher hasher;
+		hasher.update(attributes);
+		hasher.update(hlsl);
+		const reshadefx::hash128 hash = hasher.finalize();
+		std::vector<char> &cso = compiled.entry_points[entry_point.name];
+		std::string &assembly = compiled.assembly[entry_point.name];
+		if (!load_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly))
 		{
-			hr = D3DCompile(
+			com_ptr<ID3DBlob> d3d_compiled, d3d_errors;
+			const HRESULT hr = D3DCompile(
 				hlsl.data(), hlsl.size(), nullptr,
 				entry_point.type == reshadefx::shader_type::ps ? ps_defines : nullptr,
 				nullptr,
 				entry_point.name.c_str(),
 				profile.c_str(),
 				_performance_mode ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_OPTIMIZATION_LEVEL1, 0,
-				&compiled, &d3d_errors);
+				&d3d_compiled, &d3d_errors);
 
 			if (d3d_errors != nullptr) // Append warnings to the output error string as well
-				effect.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
+				compiled.errors.append(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
 
 			// No need to setup resources if any of the shaders failed to compile
 			if (FAILED(hr))
 				return false;
 
-			cso.resize(compiled->GetBufferSize());
-			std::memcpy(cso.data(), compiled->GetBufferPointer(), cso.size());
+			cso.resize(d3d_compiled->GetBufferSize());
+			std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
 
 			if (com_ptr<ID3DBlob> disassembled; SUCCEEDED(D3DDisassemble(cso.data(), cso.size(), 0, nullptr, &disassembled)))
-				effect.assembly[entry_point.name].assign(static_cast<const char *>(disassembled->GetBufferPointer()), disassembled->GetBufferSize() - 1);
+				assembly.assign(static_cast<const char *>(disassembled->GetBufferPointer()), disassembled->GetBufferSize() - 1);
 
-			save_effect_cache(effect.source_file, entry_point.name, hash, cso, effect.assembly[entry_point.name]);
+			save_effect_cache(effect.source_file, entry_point.name, hash, cso, assembly);
 		}
+	}
+
+	return true;
+}
+bool reshade::d3d9::runtime_d3d9::init_effect(size_t index, const compiled_effect &compiled)
+{
+	effect &effect = _effects[index];
+
+	std::unordered_map<std::string, com_ptr<IUnknown>> entry_points;
+
+	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
+	{
+		const auto cso_it = compiled.entry_points.find(entry_point.name);
+		if (cso_it == compiled.entry_points.end())
+		{
+			LOG(ERROR) << "Failed to find compiled code for entry point '" << entry_point.name << "'!";
+			return false;
+		}
+
+		HRESULT hr = E_FAIL;
+		const std::vector<char> &cso = cso_it->second;
 
 		// Create runtime shader objects from the compiled DX byte code
 		switch (entry_point.type)
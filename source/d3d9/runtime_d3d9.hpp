@@ -24,7 +24,8 @@ namespace reshade::d3d9
 		bool capture_screenshot(uint8_t *buffer) const override;
 
 	private:
-		bool init_effect(size_t index) override;
+		bool compile_effect(size_t index, compiled_effect &compiled) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
 		void unload_effect(size_t index) override;
 		void unload_effects() override;
 
@@ -52,6 +53,7 @@ namespace reshade::d3d9
 		com_ptr<IDirect3DSurface9> _backbuffer_texture_surface;
 
 		HMODULE _d3d_compiler = nullptr;
+		std::mutex _d3d_compiler_mutex;
 		com_ptr<IDirect3DSurface9> _effect_stencil;
 		com_ptr<IDirect3DVertexBuffer9> _effect_vertex_buffer;
 		com_ptr<IDirect3DVertexDeclaration9> _effect_vertex_layout;
@@ -4,11 +4,13 @@
  */
 
 #include "dll_config.hpp"
+#include "runtime_platform.hpp"
 #include <cassert>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
-static std::unordered_map<std::wstring, reshade::ini_file> g_ini_cache;
+static std::unordered_map<std::filesystem::path::string_type, reshade::ini_file> g_ini_cache;
 
 reshade::ini_file::ini_file(const std::filesystem::path &path) : _path(path)
 {
@@ -26,23 +28,31 @@ void reshade::ini_file::load()
 	if (ec || _modified_at >= modified_at)
 		return; // Skip loading if there was an error (e.g. file does not exist) or there was no modification to the file since it was last loaded
 
-	std::ifstream file;
-	if (file.open(_path); !file)
+	// Read the whole file into memory and parse it from there, instead of reading it line by line through a stream
+	// It is not parsed from a mapping, since that would fault when another application truncates the file meanwhile
+	std::string file_data;
+	if (!platform::read_file(_path, file_data))
 		return;
 
 	_sections.clear();
 	_modified = false;
 	_modified_at = modified_at;
 
-	file.imbue(std::locale("en-us.UTF-8"));
+	std::string_view data = file_data;
 	// Remove BOM (0xefbbbf means 0xfeff)
-	if (file.get() != 0xef || file.get() != 0xbb || file.get() != 0xbf)
-		file.seekg(0, std::ios::beg);
-
-	std::string line, section;
-	while (std::getline(file, line))
+	if (data.size() >= 3 &&
+		static_cast<unsigned char>(data[0]) == 0xef &&
+		static_cast<unsigned char>(data[1]) == 0xbb &&
+		static_cast<unsigned char>(data[2]) == 0xbf)
+		data.remove_prefix(3);
+
+	std::string section;
+	while (!data.empty())
 	{
-		trim(line);
+		std::string_view line = data.substr(0, data.find('\n'));
+		data.remove_prefix(std::min(line.size() + 1, data.size()));
+
+		line = trim(line, " \t\r"); // Also remove carriage return of Windows line endings
 
 		if (line.empty() || line[0] == ';' || line[0] == '/' || line[0] == '#')
 			continue;
@@ -58,8 +68,8 @@ void reshade::ini_file::load()
 		const auto assign_index = line.find('=');
 		if (assign_index != std::string::npos)
 		{
-			const std::string key = trim(line.substr(0, assign_index));
-			const std::string value = trim(line.substr(assign_index + 1));
+			const std::string key(trim(line.substr(0, assign_index)));
+			const std::string_view value = trim(line.substr(assign_index + 1));
 
 			// Append to key if it already exists
 			reshade::ini_file::value &elements = _sections[section][key];
@@ -91,7 +101,7 @@ void reshade::ini_file::load()
 		}
 		else
 		{
-			_sections[section].insert({ line, {} });
+			_sections[section].insert({ std::string(line), {} });
 		}
 	}
 }
@@ -175,7 +185,9 @@ bool reshade::ini_file::save()
 		return false;
 
 	const std::string str = data.str();
-	file.imbue(std::locale("en-us.UTF-8"));
+#ifdef _WIN32
+	file.imbue(std::locale("en-us.UTF-8")); // This locale name only exists on Windows
+#endif
 	file.write(str.data(), str.size());
 
 	// Flush stream to disk before updating last write time
@@ -189,8 +201,9 @@ bool reshade::ini_file::save()
 
 reshade::ini_file &reshade::ini_file::load_cache(const std::filesystem::path &path)
 {
-	const auto it = g_ini_cache.try_emplace(path, path);
-	if (it.second || (std::filesystem::file_time_type::clock::now() - it.first->second._modified_at) < std::chrono::seconds(1))
+	const auto it = g_ini_cache.try_emplace(path.native(), path);
+	// Compare against the current time minus the interval instead of subtracting the last modification time, which may be far enough in the past for that to overflow
+	if (it.second || it.first->second._modified_at > std::filesystem::file_time_type::clock::now() - std::chrono::seconds(1))
 		return it.first->second; // Don't need to reload file when it was just loaded or there are still modifications pending
 	else
 		return it.first->second.load(), it.first->second;
@@ -201,10 +214,10 @@ bool reshade::ini_file::flush_cache()
 	bool success = true;
 
 	// Save all files that were modified in one second intervals
-	for (std::pair<const std::wstring, ini_file> &file : g_ini_cache)
+	for (std::pair<const std::filesystem::path::string_type, ini_file> &file : g_ini_cache)
 	{
 		// Check modified status before requesting file time, since the latter is costly and therefore should be avoided when not necessary
-		if (file.second._modified && (std::filesystem::file_time_type::clock::now() - file.second._modified_at) > std::chrono::seconds(1))
+		if (file.second._modified && file.second._modified_at < std::filesystem::file_time_type::clock::now() - std::chrono::seconds(1))
 			success &= file.second.save();
 	}
 
@@ -212,7 +225,7 @@ bool reshade::ini_file::flush_cache()
 }
 bool reshade::ini_file::flush_cache(const std::filesystem::path &path)
 {
-	const auto it = g_ini_cache.find(path);
+	const auto it = g_ini_cache.find(path.native());
 	return it != g_ini_cache.end() && it->second.save();
 }
 
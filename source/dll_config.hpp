@@ -6,7 +6,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <algorithm> // std::min
 #include <filesystem>
 #include <unordered_map>
 
@@ -25,6 +27,12 @@ inline std::string trim(const std::string &str, const char chars[] = " \t")
 	trim(res, chars);
 	return res;
 }
+inline std::string_view trim(std::string_view str, const char chars[] = " \t")
+{
+	str.remove_prefix(std::min(str.find_first_not_of(chars), str.size()));
+	str.remove_suffix(str.size() - (str.find_last_not_of(chars) + 1));
+	return str;
+}
 
 namespace reshade
 {
@@ -121,19 +129,6 @@ namespace reshade
 		{
 			set(section, key, std::to_string(value));
 		}
-		template <>
-		void set(const std::string &section, const std::string &key, const bool &value)
-		{
-			set<std::string>(section, key, value ? "1" : "0");
-		}
-		template <>
-		void set(const std::string &section, const std::string &key, const std::string &value)
-		{
-			auto &v = _sections[section][key];
-			v.assign(1, value);
-			_modified = true;
-			_modified_at = std::filesystem::file_time_type::clock::now();
-		}
 		void set(const std::string &section, const std::string &key, std::string &&value)
 		{
 			auto &v = _sections[section][key];
@@ -142,11 +137,6 @@ namespace reshade
 			_modified = true;
 			_modified_at = std::filesystem::file_time_type::clock::now();
 		}
-		template <>
-		void set(const std::string &section, const std::string &key, const std::filesystem::path &value)
-		{
-			set(section, key, value.u8string());
-		}
 		template <typename T, size_t SIZE>
 		void set(const std::string &section, const std::string &key, const T(&values)[SIZE], const size_t size = SIZE)
 		{
@@ -157,14 +147,6 @@ namespace reshade
 			_modified = true;
 			_modified_at = std::filesystem::file_time_type::clock::now();
 		}
-		template <>
-		void set(const std::string &section, const std::string &key, const std::vector<std::string> &values)
-		{
-			auto &v = _sections[section][key];
-			v = values;
-			_modified = true;
-			_modified_at = std::filesystem::file_time_type::clock::now();
-		}
 		void set(const std::string &section, const std::string &key, std::vector<std::string> &&values)
 		{
 			auto &v = _sections[section][key];
@@ -172,16 +154,6 @@ namespace reshade
 			_modified = true;
 			_modified_at = std::filesystem::file_time_type::clock::now();
 		}
-		template <>
-		void set(const std::string &section, const std::string &key, const std::vector<std::filesystem::path> &values)
-		{
-			auto &v = _sections[section][key];
-			v.resize(values.size());
-			for (size_t i = 0; i < values.size(); ++i)
-				v[i] = values[i].u8string();
-			_modified = true;
-			_modified_at = std::filesystem::file_time_type::clock::now();
-		}
 
 		/// <summary>
 		/// Removes the specified <paramref name="key"/> from the <paramref name="section"/>.
@@ -212,61 +184,6 @@ namespace reshade
 
 		template <typename T>
 		static const T convert(const std::vector<std::string> &values, size_t i) = delete;
-		template <>
-		static const bool convert(const std::vector<std::string> &values, size_t i)
-		{
-			return convert<int>(values, i) != 0 || i < values.size() && (values[i] == "true" || values[i] == "True" || values[i] == "TRUE");
-		}
-		template <>
-		static const int convert(const std::vector<std::string> &values, size_t i)
-		{
-			return static_cast<int>(convert<long>(values, i));
-		}
-		template <>
-		static const unsigned int convert(const std::vector<std::string> &values, size_t i)
-		{
-			return static_cast<unsigned int>(convert<unsigned long>(values, i));
-		}
-		template <>
-		static const long convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? std::strtol(values[i].c_str(), nullptr, 10) : 0l;
-		}
-		template <>
-		static const unsigned long convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? std::strtoul(values[i].c_str(), nullptr, 10) : 0ul;
-		}
-		template <>
-		static const long long convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? std::strtoll(values[i].c_str(), nullptr, 10) : 0ll;
-		}
-		template <>
-		static const unsigned long long convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? std::strtoull(values[i].c_str(), nullptr, 10) : 0ull;
-		}
-		template <>
-		static const float convert(const std::vector<std::string> &values, size_t i)
-		{
-			return static_cast<float>(convert<double>(values, i));
-		}
-		template <>
-		static const double convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? std::strtod(values[i].c_str(), nullptr) : 0.0;
-		}
-		template <>
-		static const std::string convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? values[i] : std::string();
-		}
-		template <>
-		static const std::filesystem::path convert(const std::vector<std::string> &values, size_t i)
-		{
-			return i < values.size() ? std::filesystem::u8path(values[i]) : std::filesystem::path();
-		}
 
 		/// <summary>
 		/// Describes a single value in an INI file.
@@ -279,10 +196,104 @@ namespace reshade
 
 		bool _modified = false;
 		std::filesystem::path _path;
-		std::filesystem::file_time_type _modified_at;
+		std::filesystem::file_time_type _modified_at = std::filesystem::file_time_type::min(); // The clock epoch is not necessarily before any file time (e.g. it is not with libstdc++)
 		std::unordered_map<std::string, section> _sections;
 	};
 
+	// Explicit specializations have to be declared at namespace scope (and before they are used by another one)
+	template <>
+	inline const long ini_file::convert<long>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? std::strtol(values[i].c_str(), nullptr, 10) : 0l;
+	}
+	template <>
+	inline const unsigned long ini_file::convert<unsigned long>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? std::strtoul(values[i].c_str(), nullptr, 10) : 0ul;
+	}
+	template <>
+	inline const long long ini_file::convert<long long>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? std::strtoll(values[i].c_str(), nullptr, 10) : 0ll;
+	}
+	template <>
+	inline const unsigned long long ini_file::convert<unsigned long long>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? std::strtoull(values[i].c_str(), nullptr, 10) : 0ull;
+	}
+	template <>
+	inline const int ini_file::convert<int>(const std::vector<std::string> &values, size_t i)
+	{
+		return static_cast<int>(convert<long>(values, i));
+	}
+	template <>
+	inline const unsigned int ini_file::convert<unsigned int>(const std::vector<std::string> &values, size_t i)
+	{
+		return static_cast<unsigned int>(convert<unsigned long>(values, i));
+	}
+	template <>
+	inline const bool ini_file::convert<bool>(const std::vector<std::string> &values, size_t i)
+	{
+		return convert<int>(values, i) != 0 || i < values.size() && (values[i] == "true" || values[i] == "True" || values[i] == "TRUE");
+	}
+	template <>
+	inline const double ini_file::convert<double>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? std::strtod(values[i].c_str(), nullptr) : 0.0;
+	}
+	template <>
+	inline const float ini_file::convert<float>(const std::vector<std::string> &values, size_t i)
+	{
+		return static_cast<float>(convert<double>(values, i));
+	}
+	template <>
+	inline const std::string ini_file::convert<std::string>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? values[i] : std::string();
+	}
+	template <>
+	inline const std::filesystem::path ini_file::convert<std::filesystem::path>(const std::vector<std::string> &values, size_t i)
+	{
+		return i < values.size() ? std::filesystem::u8path(values[i]) : std::filesystem::path();
+	}
+
+	template <>
+	inline void ini_file::set<std::string>(const std::string &section, const std::string &key, const std::string &value)
+	{
+		auto &v = _sections[section][key];
+		v.assign(1, value);
+		_modified = true;
+		_modified_at = std::filesystem::file_time_type::clock::now();
+	}
+	template <>
+	inline void ini_file::set<bool>(const std::string &section, const std::string &key, const bool &value)
+	{
+		set<std::string>(section, key, value ? "1" : "0");
+	}
+	template <>
+	inline void ini_file::set<std::filesystem::path>(const std::string &section, const std::string &key, const std::filesystem::path &value)
+	{
+		set(section, key, value.u8string());
+	}
+	template <>
+	inline void ini_file::set<std::vector<std::string>>(const std::string &section, const std::string &key, const std::vector<std::string> &values)
+	{
+		auto &v = _sections[section][key];
+		v = values;
+		_modified = true;
+		_modified_at = std::filesystem::file_time_type::clock::now();
+	}
+	template <>
+	inline void ini_file::set<std::vector<std::filesystem::path>>(const std::string &section, const std::string &key, const std::vector<std::filesystem::path> &values)
+	{
+		auto &v = _sections[section][key];
+		v.resize(values.size());
+		for (size_t i = 0; i < values.size(); ++i)
+			v[i] = values[i].u8string();
+		_modified = true;
+		_modified_at = std::filesystem::file_time_type::clock::now();
+	}
+
 	/// <summary>
 	/// Global configuration that can be used for general settings that are not specific to a runtime instance.
 	/// </summary>
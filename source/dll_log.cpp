@@ -5,21 +5,48 @@
 
 #include "dll_log.hpp"
 #include <mutex>
-#include <Windows.h>
+
+#ifdef _WIN32
+	#include <Windows.h>
+#else
+	#include <chrono>
+	#include <ctime>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 
 struct scoped_file_handle
 {
+#ifdef _WIN32
+	using native_handle = HANDLE;
+	static inline const native_handle invalid_handle = INVALID_HANDLE_VALUE;
+#else
+	using native_handle = int;
+	static constexpr native_handle invalid_handle = -1;
+#endif
+
 	~scoped_file_handle()
 	{
-		if (handle != INVALID_HANDLE_VALUE)
-			CloseHandle(handle);
+		close();
 	}
 
-	inline operator HANDLE() const { return handle; }
-	inline void operator=(HANDLE new_handle) { handle = new_handle; }
+	inline operator native_handle() const { return handle; }
+	inline void operator=(native_handle new_handle) { handle = new_handle; }
+
+	void close()
+	{
+		if (handle == invalid_handle)
+			return;
+#ifdef _WIN32
+		CloseHandle(handle);
+#else
+		::close(handle);
+#endif
+		handle = invalid_handle;
+	}
 
 private:
-	HANDLE handle = INVALID_HANDLE_VALUE;
+	native_handle handle = invalid_handle;
 };
 
 static std::mutex s_message_mutex;
@@ -28,11 +55,25 @@ std::ostringstream reshade::log::line_stream;
 
 reshade::log::message::message(level level)
 {
+#ifdef _WIN32
 	SYSTEMTIME time;
 	GetLocalTime(&time);
+#else
+	const auto now = std::chrono::system_clock::now();
+	const std::time_t now_time = std::chrono::system_clock::to_time_t(now);
+	std::tm local_time = {};
+	localtime_r(&now_time, &local_time);
+
+	// Fill in the same fields as 'GetLocalTime' on Windows
+	const struct {
+		int wYear, wMonth, wDay, wHour, wMinute, wSecond, wMilliseconds;
+	} time = {
+		local_time.tm_year + 1900, local_time.tm_mon + 1, local_time.tm_mday, local_time.tm_hour, local_time.tm_min, local_time.tm_sec,
+		static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000) };
+#endif
 
 	const char level_names[][6] = { "ERROR", "WARN ", "INFO ", "DEBUG" };
-	assert((static_cast<size_t>(level) - 1) < ARRAYSIZE(level_names));
+	assert((static_cast<size_t>(level) - 1) < std::size(level_names));
 
 	// Lock the stream until the message is complete
 	s_message_mutex.lock();
@@ -51,7 +92,11 @@ reshade::log::message::message(level level)
 		<< std::setw(2) << time.wMinute << ':'
 		<< std::setw(2) << time.wSecond << ':'
 		<< std::setw(3) << time.wMilliseconds << ' '
+#ifdef _WIN32
 		<< '[' << std::setw(5) << GetCurrentThreadId() << ']' << std::setfill(' ') << " | "
+#else
+		<< '[' << std::setw(5) << gettid() << ']' << std::setfill(' ') << " | "
+#endif
 		<< level_names[static_cast<unsigned int>(level) - 1] << " | " << std::left;
 }
 reshade::log::message::~message()
@@ -59,19 +104,25 @@ reshade::log::message::~message()
 	std::string line_string = line_stream.str();
 	line_string += '\n'; // Terminate line with line feed
 
+#ifdef _WIN32
 	// Replace all LF with CRLF
 	for (size_t offset = 0; (offset = line_string.find('\n', offset)) != std::string::npos; offset += 2)
 		line_string.replace(offset, 1, "\r\n", 2);
+#endif
 
 	// Write line to the log file
-	if (s_file_handle != INVALID_HANDLE_VALUE)
+	if (s_file_handle != scoped_file_handle::invalid_handle)
 	{
+#ifdef _WIN32
 		DWORD written = 0;
 		WriteFile(s_file_handle, line_string.data(), static_cast<DWORD>(line_string.size()), &written, nullptr);
-		assert(written == line_string.size());
+#else
+		const ssize_t written = write(s_file_handle, line_string.data(), line_string.size());
+#endif
+		assert(static_cast<size_t>(written) == line_string.size());
 	}
 
-#ifndef NDEBUG
+#if !defined(NDEBUG) && defined(_WIN32)
 	// Write line to the debug output
 	OutputDebugStringA(line_string.c_str());
 #endif
@@ -83,13 +134,16 @@ reshade::log::message::~message()
 void reshade::log::open_log_file(const std::filesystem::path &path)
 {
 	// Close the previous file first
-	if (s_file_handle != INVALID_HANDLE_VALUE)
-		CloseHandle(s_file_handle);
+	s_file_handle.close();
 
 	// Set default line stream settings
 	line_stream.setf(std::ios::left);
 	line_stream.setf(std::ios::showbase);
 
 	// Open the log file for writing (and flush on each write) and clear previous contents
+#ifdef _WIN32
 	s_file_handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+#else
+	s_file_handle = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DSYNC, 0644);
+#endif
 }
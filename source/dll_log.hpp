@@ -9,8 +9,10 @@
 #include <iomanip>
 #include <sstream>
 #include <filesystem>
+#ifdef _WIN32
 #include <utf8/unchecked.h>
 #include <combaseapi.h> // REFIID, HRESULT
+#endif
 
 #undef INFO
 #undef ERROR // This is defined in the Windows SDK headers
@@ -59,70 +61,6 @@ namespace reshade::log
 			return *this;
 		}
 
-		template <>
-		message &operator<<(REFIID riid)
-		{
-			OLECHAR riid_string[40];
-			StringFromGUID2(riid, riid_string, ARRAYSIZE(riid_string));
-			return *this << riid_string;
-		}
-
-		template <>
-		message &operator<<(const HRESULT &hresult) // Note: HRESULT is just an alias for long, so this falsely catches all long values too
-		{
-			switch (hresult)
-			{
-			case E_NOTIMPL:
-				return *this << "E_NOTIMPL";
-			case E_OUTOFMEMORY:
-				return *this << "E_OUTOFMEMORY";
-			case E_INVALIDARG:
-				return *this << "E_INVALIDARG";
-			case E_NOINTERFACE:
-				return *this << "E_NOINTERFACE";
-			case E_FAIL:
-				return *this << "E_FAIL";
-			case 0x8876017C:
-				return *this << "D3DERR_OUTOFVIDEOMEMORY";
-			case 0x88760868:
-				return *this << "D3DERR_DEVICELOST";
-			case 0x8876086A:
-				return *this << "D3DERR_NOTAVAILABLE";
-			case 0x8876086C:
-				return *this << "D3DERR_INVALIDCALL";
-			case 0x88760870:
-				return *this << "D3DERR_DEVICEREMOVED";
-			case DXGI_ERROR_INVALID_CALL:
-				return *this << "DXGI_ERROR_INVALID_CALL";
-			case DXGI_ERROR_UNSUPPORTED:
-				return *this << "DXGI_ERROR_UNSUPPORTED";
-			case DXGI_ERROR_DEVICE_REMOVED:
-				return *this << "DXGI_ERROR_DEVICE_REMOVED";
-			case DXGI_ERROR_DEVICE_HUNG:
-				return *this << "DXGI_ERROR_DEVICE_HUNG";
-			case DXGI_ERROR_DEVICE_RESET:
-				return *this << "DXGI_ERROR_DEVICE_RESET";
-			default:
-				return *this << std::hex << static_cast<unsigned long>(hresult) << std::dec;
-			}
-		}
-
-		template <>
-		message &operator<<(const std::wstring &message)
-		{
-			static_assert(sizeof(std::wstring::value_type) == sizeof(uint16_t), "expected 'std::wstring' to use UTF-16 encoding");
-			std::string utf8_message;
-			utf8_message.reserve(message.size());
-			utf8::unchecked::utf16to8(message.begin(), message.end(), std::back_inserter(utf8_message));
-			return operator<<(utf8_message);
-		}
-
-		template <>
-		message &operator<<(const std::filesystem::path &path)
-		{
-			return operator<<('"' + path.u8string() + '"');
-		}
-
 		inline message &operator<<(const char *message)
 		{
 			line_stream << message;
@@ -131,10 +69,85 @@ namespace reshade::log
 
 		inline message &operator<<(const wchar_t *message)
 		{
+#ifdef _WIN32
 			static_assert(sizeof(wchar_t) == sizeof(uint16_t), "expected 'wchar_t' to use UTF-16 encoding");
 			std::string utf8_message;
 			utf8::unchecked::utf16to8(message, message + wcslen(message), std::back_inserter(utf8_message));
 			return operator<<(utf8_message);
+#else
+			return operator<<(std::filesystem::path(message).u8string());
+#endif
 		}
 	};
+
+	// Explicit specializations have to be declared at namespace scope
+#ifdef _WIN32
+	template <>
+	inline message &message::operator<<(REFIID riid)
+	{
+		OLECHAR riid_string[40];
+		StringFromGUID2(riid, riid_string, ARRAYSIZE(riid_string));
+		return *this << riid_string;
+	}
+
+	template <>
+	inline message &message::operator<<(const HRESULT &hresult) // Note: HRESULT is just an alias for long, so this falsely catches all long values too
+	{
+		switch (hresult)
+		{
+		case E_NOTIMPL:
+			return *this << "E_NOTIMPL";
+		case E_OUTOFMEMORY:
+			return *this << "E_OUTOFMEMORY";
+		case E_INVALIDARG:
+			return *this << "E_INVALIDARG";
+		case E_NOINTERFACE:
+			return *this << "E_NOINTERFACE";
+		case E_FAIL:
+			return *this << "E_FAIL";
+		case 0x8876017C:
+			return *this << "D3DERR_OUTOFVIDEOMEMORY";
+		case 0x88760868:
+			return *this << "D3DERR_DEVICELOST";
+		case 0x8876086A:
+			return *this << "D3DERR_NOTAVAILABLE";
+		case 0x8876086C:
+			return *this << "D3DERR_INVALIDCALL";
+		case 0x88760870:
+			return *this << "D3DERR_DEVICEREMOVED";
+		case DXGI_ERROR_INVALID_CALL:
+			return *this << "DXGI_ERROR_INVALID_CALL";
+		case DXGI_ERROR_UNSUPPORTED:
+			return *this << "DXGI_ERROR_UNSUPPORTED";
+		case DXGI_ERROR_DEVICE_REMOVED:
+			return *this << "DXGI_ERROR_DEVICE_REMOVED";
+		case DXGI_ERROR_DEVICE_HUNG:
+			return *this << "DXGI_ERROR_DEVICE_HUNG";
+		case DXGI_ERROR_DEVICE_RESET:
+			return *this << "DXGI_ERROR_DEVICE_RESET";
+		default:
+			return *this << std::hex << static_cast<unsigned long>(hresult) << std::dec;
+		}
+	}
+#endif
+
+	template <>
+	inline message &message::operator<<(const std::wstring &message)
+	{
+#ifdef _WIN32
+		static_assert(sizeof(std::wstring::value_type) == sizeof(uint16_t), "expected 'std::wstring' to use UTF-16 encoding");
+		std::string utf8_message;
+		utf8_message.reserve(message.size());
+		utf8::unchecked::utf16to8(message.begin(), message.end(), std::back_inserter(utf8_message));
+		return operator<<(utf8_message);
+#else
+		return operator<<(std::filesystem::path(message).u8string());
+#endif
+	}
+
+	template <>
+	inline message &message::operator<<(const std::filesystem::path &path)
+	{
+		return operator<<('"' + path.u8string() + '"');
+	}
 }
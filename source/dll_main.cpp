@@ -112,6 +112,7 @@ static inline std::filesystem::path get_module_path(HMODULE module)
 #ifdef RESHADE_TEST_APPLICATION
 
 #  include "com_ptr.hpp"
+#  include "runtime_null.hpp"
 #  include <d3d9.h>
 #  include <d3d11.h>
 #  include <d3d12.h>
@@ -787,6 +788,64 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow
 	}
 	#pragma endregion
 
+	#pragma region Null Implementation
+	if (strstr(lpCmdLine, "-null"))
+	{
+		// Present a fixed number of frames (unless the window is closed before), so that runs are comparable
+		unsigned long num_frames = 1000;
+		if (const char *const frames_arg = strstr(lpCmdLine, "-frames "); frames_arg != nullptr)
+			num_frames = strtoul(frames_arg + 8, nullptr, 10);
+
+		RECT window_rect = {};
+		GetClientRect(window_handle, &window_rect);
+
+		// Effects and preset are taken from the configuration file, same as when running with any other graphics API
+		const auto time_init_started = std::chrono::high_resolution_clock::now();
+		reshade::null::runtime_null runtime;
+		if (!runtime.on_init(window_handle, static_cast<unsigned int>(window_rect.right), static_cast<unsigned int>(window_rect.bottom)))
+			return EXIT_FAILURE;
+		const auto init_duration = std::chrono::high_resolution_clock::now() - time_init_started;
+
+		for (unsigned long frame = 0; frame < num_frames && msg.message != WM_QUIT; ++frame)
+		{
+			while (msg.message != WM_QUIT &&
+				PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+				DispatchMessage(&msg);
+
+			if (s_resize_w != 0)
+			{
+				runtime.on_reset();
+				runtime.on_init(window_handle, s_resize_w, s_resize_h);
+
+				s_resize_w = s_resize_h = 0;
+			}
+
+			runtime.on_present();
+		}
+
+		const auto log_stage = [](const char *name, const reshade::null::runtime_null::stage_statistics &stage) {
+			using namespace std::chrono;
+			LOG(INFO) << "> " << name << ": " << stage.count << " calls, "
+				<< duration_cast<microseconds>(stage.total).count() / 1000.0 << " ms in total, "
+				<< (stage.count != 0 ? duration_cast<microseconds>(stage.total).count() / stage.count : 0) << " us on average, "
+				<< duration_cast<microseconds>(stage.max).count() << " us at most";
+		};
+
+		const reshade::null::runtime_null::statistics &stats = runtime.stats();
+		LOG(INFO) << "Presented " << stats.present.count << " frames with the null runtime, which took " << std::chrono::duration_cast<std::chrono::milliseconds>(init_duration).count() << " ms to initialize:";
+		log_stage("present", stats.present);
+		log_stage("load_effects", stats.load_effects);
+		log_stage("compile_effect", stats.compile_effect);
+		log_stage("init_effect", stats.init_effect);
+		log_stage("init_texture", stats.init_texture);
+		log_stage("upload_texture", stats.upload_texture);
+		log_stage("render_technique", stats.render_technique);
+		LOG(INFO) << "> " << stats.num_passes << " passes rendered, " << runtime.recorded_passes().size() << " of them in the last frame, " << stats.texture_memory / 1024 << " KiB of texture memory in use";
+
+		return EXIT_SUCCESS;
+	}
+	#pragma endregion
+
 	return EXIT_FAILURE;
 }
 
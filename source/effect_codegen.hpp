@@ -7,7 +7,9 @@
 
 #include "effect_module.hpp"
 #include <memory> // std::unique_ptr
-#include <algorithm> // std::find_if
+#include <cassert>
+#include <unordered_map>
+#include <algorithm> // std::find_if, std::remove_if
 
 namespace reshadefx
 {
@@ -100,6 +102,22 @@ namespace reshadefx
 		/// <param name="type">The shader type (vertex, pixel or compute shader).</param>
 		/// <param name="num_threads">The number of local threads it this is a compute entry point.</param>
 		virtual void define_entry_point(function_info &function, shader_type type, int num_threads[3] = nullptr) = 0;
+		/// <summary>
+		/// Mark an entry point function and everything it references as used by a technique.
+		/// If dead code elimination is enabled, only definitions marked this way are written to the result, and every entry point additionally gets its own copy of the code with only the definitions it references.
+		/// </summary>
+		/// <param name="function">The entry point function, after it was passed to <see cref="define_entry_point"/>.</param>
+		void mark_referenced(const function_info &function)
+		{
+			std::unordered_set<id> &references = _entry_point_references[function.unique_name];
+			references.insert(function.definition);
+			references.insert(function.referenced_samplers.begin(), function.referenced_samplers.end());
+			references.insert(function.referenced_storages.begin(), function.referenced_storages.end());
+			references.insert(function.referenced_functions.begin(), function.referenced_functions.end());
+			references.insert(function.referenced_variables.begin(), function.referenced_variables.end());
+
+			_referenced_definitions.insert(references.begin(), references.end());
+		}
 
 		/// <summary>
 		/// Resolve the access chain and add a load operation to the output.
@@ -316,9 +334,73 @@ namespace reshadefx
 				[id](const auto &it) { return it->definition == id; })->get();
 		}
 
+		/// <summary>
+		/// Get all functions that were defined so far.
+		/// </summary>
+		const std::vector<std::unique_ptr<function_info>> &functions() const { return _functions; }
+		/// <summary>
+		/// Check whether a definition is referenced by the specified entry point, which was marked with <see cref="mark_referenced"/> before.
+		/// </summary>
+		/// <param name="entry_point">The name of the entry point.</param>
+		/// <param name="id">The SSA ID of the definition to check.</param>
+		bool is_referenced_by_entry_point(const std::string &entry_point, id id) const
+		{
+			const auto it = _entry_point_references.find(entry_point);
+			return it != _entry_point_references.end() && it->second.find(id) != it->second.end();
+		}
+
 	protected:
 		id make_id() { return _next_id++; }
 
+		/// <summary>
+		/// Check whether a definition can be removed from the result, because dead code elimination is enabled and no technique references it.
+		/// </summary>
+		bool is_unreferenced(id id) const
+		{
+			return _eliminate_dead_code && _referenced_definitions.find(id) == _referenced_definitions.end();
+		}
+
+		/// <summary>
+		/// Mark the textures that referenced samplers, storages and render targets use as referenced too (also for every entry point that samples or writes them), so that their declarations are kept in the code.
+		/// Resources are never removed from the module itself, since that would leave holes in the binding numbers already written to the code, and would drop textures that are only declared to share them with other effects.
+		/// </summary>
+		void mark_referenced_resources()
+		{
+			if (!_eliminate_dead_code)
+				return;
+
+			const auto find_texture_id = [this](const std::string &name) -> uint32_t {
+				const auto it = std::find_if(_module.textures.begin(), _module.textures.end(),
+					[&name](const auto &info) { return info.unique_name == name; });
+				// The parser rejects samplers, storages and render targets without a valid texture, so this should always succeed
+				assert(it != _module.textures.end());
+				return it != _module.textures.end() ? it->id : 0;
+			};
+
+			for (const technique_info &tech : _module.techniques)
+				for (const pass_info &pass : tech.passes)
+					for (const std::string &target : pass.render_target_names)
+						if (!target.empty())
+							_referenced_definitions.insert(find_texture_id(target));
+
+			for (const sampler_info &info : _module.samplers)
+				if (!is_unreferenced(info.id))
+					_referenced_definitions.insert(find_texture_id(info.texture_name));
+			for (const storage_info &info : _module.storages)
+				if (!is_unreferenced(info.id))
+					_referenced_definitions.insert(find_texture_id(info.texture_name));
+
+			for (auto &entry_point : _entry_point_references)
+			{
+				for (const sampler_info &info : _module.samplers)
+					if (entry_point.second.find(info.id) != entry_point.second.end())
+						entry_point.second.insert(find_texture_id(info.texture_name));
+				for (const storage_info &info : _module.storages)
+					if (entry_point.second.find(info.id) != entry_point.second.end())
+						entry_point.second.insert(find_texture_id(info.texture_name));
+			}
+		}
+
 		static uint32_t align_up(uint32_t size, uint32_t alignment)
 		{
 			alignment -= 1;
@@ -335,6 +417,9 @@ namespace reshadefx
 		id _next_id = 1;
 		id _last_block = 0;
 		id _current_block = 0;
+		bool _eliminate_dead_code = false;
+		std::unordered_set<id> _referenced_definitions;
+		std::unordered_map<std::string, std::unordered_set<id>> _entry_point_references;
 	};
 
 	/// <summary>
@@ -344,14 +429,16 @@ namespace reshadefx
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
 	/// <param name="enable_16bit_types">Use real 16-bit types for the minimum precision types "min16int", "min16uint" and "min16float".</param>
 	/// <param name="flip_vert_y">Insert code to flip the Y component of the output position in vertex shaders.</param>
-	codegen *create_codegen_glsl(bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false);
+	/// <param name="eliminate_dead_code">Remove functions, global variables and resources that are not referenced by any technique from the generated code and the module.</param>
+	codegen *create_codegen_glsl(bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false, bool eliminate_dead_code = false);
 	/// <summary>
 	/// Create a back-end implementation for HLSL code generation.
 	/// </summary>
 	/// <param name="shader_model">The HLSL shader model version (e.g. 30, 41, 50, 60, ...)</param>
 	/// <param name="debug_info">Whether to append debug information like line directives to the generated code.</param>
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
-	codegen *create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants);
+	/// <param name="eliminate_dead_code">Remove functions, global variables and resources that are not referenced by any technique from the generated code and the module.</param>
+	codegen *create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, bool eliminate_dead_code = false);
 	/// <summary>
 	/// Create a back-end implementation for SPIR-V code generation.
 	/// </summary>
@@ -360,5 +447,7 @@ namespace reshadefx
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
 	/// <param name="enable_16bit_types">Use real 16-bit types for the minimum precision types "min16int", "min16uint" and "min16float".</param>
 	/// <param name="flip_vert_y">Insert code to flip the Y component of the output position in vertex shaders.</param>
-	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false);
+	/// <param name="eliminate_dead_code">Remove functions, global variables and resources that are not referenced by any technique from the generated code and the module.</param>
+	/// <param name="optimize">Run optimization passes over the generated code (promotion of local variables to SSA values, deduplication of types and constants, removal of dead instructions and functions and merging of trivial blocks).</param>
+	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false, bool eliminate_dead_code = false, bool optimize = false);
 }
@@ -9,6 +9,7 @@
 #include <cstdio> // snprintf
 #include <cassert>
 #include <algorithm> // std::find_if, std::max
+#include <deque>
 #include <unordered_set>
 
 using namespace reshadefx;
@@ -16,11 +17,13 @@ using namespace reshadefx;
 class codegen_glsl final : public codegen
 {
 public:
-	codegen_glsl(bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
+	codegen_glsl(bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool eliminate_dead_code)
 		: _debug_info(debug_info), _uniforms_to_spec_constants(uniforms_to_spec_constants), _enable_16bit_types(enable_16bit_types), _flip_vert_y(flip_vert_y)
 	{
+		_eliminate_dead_code = eliminate_dead_code;
+
 		// Create default block and reserve a memory block to avoid frequent reallocations
-		std::string &block = _blocks.emplace(0, std::string()).first->second;
+		std::string &block = _blocks.emplace(0, code_block()).first->second.code;
 		block.reserve(8192);
 	}
 
@@ -37,10 +40,50 @@ private:
 		expression,
 	};
 
+	// Range of code in the default block that belongs to a single function, global variable or resource definition
+	struct definition_range
+	{
+		id definition;
+		size_t begin, end;
+	};
+
+	// Code of a basic block, which refers to the blocks that were appended to it instead of copying their code
+	// The code of a function is only put together once the function is finished, so that nested control flow does not copy the same code again at every level
+	struct code_block
+	{
+		struct reference
+		{
+			// Offset into the code at which the referenced block is inserted
+			size_t offset;
+			// Block to insert, or zero to insert the continue block of the loop that is the target of a "continue" statement
+			id block;
+			// Indentation level of the referenced block at the time it was appended
+			unsigned int indentation_level;
+			// Continue block of the loop this is the body of, or the continue block to insert in case of a "continue" statement
+			id continue_block;
+		};
+
+		std::string code;
+		std::vector<reference> references;
+		unsigned int indentation_level = 0;
+	};
+
+	// Marks that the code written last did not end with a line break
+	static constexpr unsigned int no_line_level = ~0u;
+
 	std::string _ubo_block;
 	std::string _compute_block;
-	std::unordered_map<id, std::string> _names;
-	std::unordered_map<id, std::string> _blocks;
+	// Names indexed by their ID, which includes the automatically generated ones once they were used, so that they can be returned by reference
+	// This is a deque, so that references to names stay valid when it grows
+	mutable std::deque<std::string> _names;
+	// Set of all names given to definitions so far, to detect clashes without having to search through all of them
+	std::unordered_set<std::string> _used_names;
+	std::unordered_map<id, code_block> _blocks;
+	// Blocks of finished functions, which can be reused, so that their memory does not have to be allocated again
+	std::vector<code_block> _free_blocks;
+	// Code that is inserted in front of "continue" statements of a loop, indexed by the continue block of that loop
+	std::unordered_map<id, std::string> _continue_code;
+	std::vector<definition_range> _definition_ranges;
 	bool _debug_info = false;
 	bool _uniforms_to_spec_constants = false;
 	bool _enable_16bit_types = false;
@@ -56,6 +99,8 @@ private:
 
 	void write_result(module &module) override
 	{
+		mark_referenced_resources();
+
 		module = std::move(_module);
 
 		if (_enable_16bit_types)
@@ -95,7 +140,38 @@ private:
 			// Read matrices in column major layout, even though they are actually row major, to avoid transposing them on every access (since GLSL uses column matrices)
 			// TODO: This technically only works with square matrices
 			module.hlsl += "layout(std140, column_major, binding = 0) uniform _Globals {\n" + _ubo_block + "};\n";
-		module.hlsl += _blocks.at(0);
+
+		const std::string &code = _blocks.at(0).code;
+
+		if (!_eliminate_dead_code)
+		{
+			module.hlsl += code;
+			return;
+		}
+
+		// Skip over all definitions that are not in the specified set of references
+		const auto append_referenced_code = [this, &code](std::string &out, const std::unordered_set<id> &references) {
+			size_t offset = 0;
+			for (const definition_range &range : _definition_ranges)
+			{
+				if (references.find(range.definition) != references.end())
+					continue;
+
+				out.append(code, offset, range.begin - offset);
+				offset = range.end;
+			}
+
+			out.append(code, offset, std::string::npos);
+		};
+
+		// Every entry point gets the same declarations written above, followed by only the definitions it references
+		for (entry_point &entry_point : module.entry_points)
+		{
+			entry_point.hlsl = module.hlsl;
+			append_referenced_code(entry_point.hlsl, _entry_point_references.at(entry_point.name));
+		}
+
+		append_referenced_code(module.hlsl, _referenced_definitions);
 	}
 
 	template <bool is_param = false, bool is_decl = true, bool is_interface = false>
@@ -291,20 +367,23 @@ private:
 	}
 	void write_location(std::string &s, const location &loc) const
 	{
-		if (loc.source.empty() || !_debug_info)
+		if (loc.source == 0 || !_debug_info)
 			return;
 
 		s += "#line " + std::to_string(loc.line) + '\n';
 	}
 
-	std::string id_to_name(id id) const
+	const std::string &id_to_name(id id) const
 	{
 		if (const auto it = _remapped_sampler_variables.find(id); it != _remapped_sampler_variables.end())
 			id = it->second;
 		assert(id != 0);
-		if (const auto it = _names.find(id); it != _names.end())
-			return it->second;
-		return '_' + std::to_string(id);
+		if (id >= _names.size())
+			_names.resize(id + 1);
+		std::string &name = _names[id];
+		if (name.empty())
+			name = '_' + std::to_string(id);
+		return name;
 	}
 
 	template <naming naming_type = naming::general>
@@ -317,8 +396,12 @@ private:
 		if constexpr (naming_type != naming::reserved)
 			name = escape_name(std::move(name));
 		if constexpr (naming_type == naming::general)
-			if (std::find_if(_names.begin(), _names.end(), [&name](const auto &it) { return it.second == name; }) != _names.end())
+			if (_used_names.find(name) != _used_names.end())
 				name += '_' + std::to_string(id); // Append a numbered suffix if the name already exists
+		if constexpr (naming_type != naming::expression)
+			_used_names.insert(name); // Expressions are made up of names that were defined before, so do not need to be tracked
+		if (id >= _names.size())
+			_names.resize(id + 1);
 		_names[id] = std::move(name);
 	}
 
@@ -418,10 +501,128 @@ private:
 		if (block.empty())
 			return;
 
-		for (size_t pos = 0; (pos = block.find("\n\t", pos)) != std::string::npos; pos += 3)
-			block.replace(pos, 2, "\n\t\t");
+		// Build the indented code in a single pass, rather than inserting into the block for every line (which moves all the code after it each time)
+		std::string indented_block;
+		indented_block.reserve(block.size() + block.size() / 8);
+		indented_block += '\t';
 
-		block.insert(block.begin(), '\t');
+		for (size_t offset = 0, pos; offset < block.size(); offset = pos + 2)
+		{
+			if ((pos = block.find("\n\t", offset)) == std::string::npos)
+			{
+				indented_block.append(block, offset, std::string::npos);
+				break;
+			}
+
+			indented_block.append(block, offset, pos - offset);
+			indented_block += "\n\t\t";
+		}
+
+		block = std::move(indented_block);
+	}
+
+	static void increase_indentation_level(code_block &block)
+	{
+		// Only count the level here, it is applied to the code when the block is written out in 'write_block'
+		block.indentation_level++;
+	}
+
+	void append_block(id target_block, id block_id, id continue_block = 0)
+	{
+		code_block &target = _blocks.at(target_block);
+		const code_block &block = _blocks.at(block_id);
+
+		if (block.code.empty() && block.references.empty())
+			return;
+
+		if (target_block == 0)
+		{
+			// Ranges of the default block are tracked for every definition, so its code has to be written out right away
+			unsigned int line_level = no_line_level;
+			std::unordered_map<id, unsigned int> continue_levels;
+			write_block(target.code, block_id, block.indentation_level, 0, line_level, continue_levels);
+			return;
+		}
+
+		target.references.push_back({ target.code.size(), block_id, block.indentation_level, continue_block });
+	}
+
+	// Returns the code of a block with all the blocks it references put in, for code that still has to be modified
+	std::string block_code(id block_id) const
+	{
+		std::string code;
+		unsigned int line_level = no_line_level;
+		std::unordered_map<id, unsigned int> continue_levels;
+		write_block(code, block_id, _blocks.at(block_id).indentation_level, 0, line_level, continue_levels);
+		return code;
+	}
+
+	// Writes the code of a block and of all the blocks it references to the output, with the same result as if every block had been indented and copied into the next one right away
+	// The level of a line is the total indentation level of the innermost block that contained both the line break and the tab that follows it, which is the lower one of the two levels
+	void write_block(std::string &out, id block_id, unsigned int indentation_level, unsigned int level, unsigned int &line_level, std::unordered_map<id, unsigned int> &continue_levels) const
+	{
+		const code_block &block = _blocks.at(block_id);
+		if (block.code.empty() && block.references.empty())
+			return;
+
+		// Every indentation level adds a tab in front of the first line of the block
+		if (indentation_level != 0)
+		{
+			write_indented(out, std::string(indentation_level, '\t'), level, line_level);
+			level += indentation_level;
+		}
+
+		size_t offset = 0;
+		for (const code_block::reference &reference : block.references)
+		{
+			write_indented(out, std::string_view(block.code).substr(offset, reference.offset - offset), level, line_level);
+			offset = reference.offset;
+
+			if (reference.block != 0)
+			{
+				if (reference.continue_block != 0)
+					continue_levels[reference.continue_block] = level;
+
+				write_block(out, reference.block, reference.indentation_level, level, line_level, continue_levels);
+			}
+			else
+			{
+				// The continue block was added to the loop body after it was indented, so it is at the level of the loop, rather than at the level of the "continue" statement
+				const unsigned int continue_level = continue_levels.at(reference.continue_block);
+				if (line_level != no_line_level)
+					line_level = std::min(line_level, continue_level);
+
+				write_indented(out, _continue_code.at(reference.continue_block), continue_level, line_level);
+			}
+		}
+
+		write_indented(out, std::string_view(block.code).substr(offset), level, line_level);
+	}
+	static void write_indented(std::string &out, std::string_view code, unsigned int level, unsigned int &line_level)
+	{
+		if (code.empty())
+			return;
+
+		// Indent a line that started in code that was written before
+		if (line_level != no_line_level && code[0] == '\t')
+			out.append(std::min(line_level, level), '\t');
+		line_level = no_line_level;
+
+		for (size_t offset = 0, pos; offset < code.size(); offset = pos + 1)
+		{
+			if ((pos = code.find('\n', offset)) == std::string_view::npos)
+			{
+				out.append(code.data() + offset, code.size() - offset);
+				break;
+			}
+
+			out.append(code.data() + offset, pos + 1 - offset);
+
+			if (pos + 1 == code.size())
+				line_level = level;
+			else if (code[pos + 1] == '\t')
+				out.append(level, '\t');
+		}
 	}
 
 	id   define_struct(const location &loc, struct_info &info) override
@@ -431,7 +632,7 @@ private:
 
 		_structs.push_back(info);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -472,12 +673,16 @@ private:
 
 		define_name<naming::unique>(info.id, info.unique_name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
+
+		const size_t begin = code.size();
 
 		write_location(code, loc);
 
 		code += "layout(binding = " + std::to_string(info.binding) + ") uniform sampler2D " + id_to_name(info.id) + ";\n";
 
+		_definition_ranges.push_back({ info.id, begin, code.size() });
+
 		_module.samplers.push_back(info);
 
 		return info.id;
@@ -489,12 +694,16 @@ private:
 
 		define_name<naming::unique>(info.id, info.unique_name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
+
+		const size_t begin = code.size();
 
 		write_location(code, loc);
 
 		code += "layout(binding = " + std::to_string(info.binding) + ") uniform writeonly image2D " + id_to_name(info.id) + ";\n";
 
+		_definition_ranges.push_back({ info.id, begin, code.size() });
+
 		_module.storages.push_back(info);
 
 		return info.id;
@@ -511,7 +720,7 @@ private:
 			if (info.type.is_array())
 				info.size *= info.type.array_length;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			write_location(code, loc);
 
@@ -581,7 +790,9 @@ private:
 		if (!name.empty())
 			define_name<naming::general>(res, name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
+
+		const size_t begin = code.size();
 
 		write_location(code, loc);
 
@@ -599,6 +810,9 @@ private:
 
 		code += ";\n";
 
+		if (global && _current_block == 0)
+			_definition_ranges.push_back({ res, begin, code.size() });
+
 		return res;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -618,7 +832,11 @@ private:
 		else
 			define_name<naming::reserved>(info.definition, "main");
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
+
+		// The end of the range is filled in by 'leave_function' (entry points add their range in 'define_entry_point' instead, so that it covers the surrounding preprocessor block)
+		if (!is_entry_point)
+			_definition_ranges.push_back({ info.definition, code.size(), std::string::npos });
 
 		write_location(code, loc);
 
@@ -669,9 +887,11 @@ private:
 
 		_module.entry_points.push_back({ func.unique_name, stype });
 
-		_blocks.at(0) += "#ifdef ENTRY_POINT_" + func.unique_name + '\n';
+		const size_t begin = _blocks.at(0).code.size();
+
+		_blocks.at(0).code += "#ifdef ENTRY_POINT_" + func.unique_name + '\n';
 		if (stype == shader_type::cs)
-			_blocks.at(0) += "layout(local_size_x = " + std::to_string(num_threads[0]) +
+			_blocks.at(0).code += "layout(local_size_x = " + std::to_string(num_threads[0]) +
 			                      ", local_size_y = " + std::to_string(num_threads[1]) +
 			                      ", local_size_z = " + std::to_string(num_threads[2]) + ") in;\n";
 
@@ -696,7 +916,7 @@ private:
 			if (type.base == type::t_bool)
 				type.base  = type::t_float;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			const int array_length = std::max(1, type.array_length);
 			const uint32_t location = semantic_to_location(semantic, array_length);
@@ -771,7 +991,7 @@ private:
 		define_function({}, entry_point, true);
 		enter_block(create_block());
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		// Handle input parameters
 		for (size_t i = 0; i < num_params; ++i)
@@ -1012,7 +1232,12 @@ private:
 		leave_block_and_return(0);
 		leave_function();
 
-		_blocks.at(0) += "#endif\n";
+		_blocks.at(0).code += "#endif\n";
+
+		// The generated function is not known to the parser, so add it to the references of the entry point here
+		func.referenced_functions.insert(entry_point.definition);
+
+		_definition_ranges.push_back({ entry_point.definition, begin, _blocks.at(0).code.size() });
 	}
 
 	id   emit_load(const expression &exp, bool force_new_id) override
@@ -1042,7 +1267,9 @@ private:
 			case expression::operation::op_dynamic_index:
 				// For matrices this will extract a column, but that is fine, since they are initialized column-wise too
 				// Also cast to an integer, since it could be a boolean too, but GLSL does not allow those in index expressions
-				expr_code += "[int(" + id_to_name(op.index) + ")]";
+				expr_code += "[int(";
+				expr_code += id_to_name(op.index);
+				expr_code += ")]";
 				break;
 			case expression::operation::op_constant_index:
 				if (op.from.is_vector() && !op.from.is_array())
@@ -1089,11 +1316,15 @@ private:
 		if (force_new_id)
 		{
 			// Need to store value in a new variable to comply with request for a new ID
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			code += '\t';
 			write_type(code, exp.type);
-			code += ' ' + id_to_name(res) + " = " + expr_code + ";\n";
+			code += ' ';
+			code += id_to_name(res);
+			code += " = ";
+			code += expr_code;
+			code += ";\n";
 		}
 		else
 		{
@@ -1113,11 +1344,12 @@ private:
 			return;
 		}
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, exp.location);
 
-		code += '\t' + id_to_name(exp.base);
+		code += '\t';
+		code += id_to_name(exp.base);
 
 		for (const auto &op : exp.chain)
 		{
@@ -1128,7 +1360,9 @@ private:
 				code += escape_name(find_struct(op.from.definition).member_list[op.index].name);
 				break;
 			case expression::operation::op_dynamic_index:
-				code += "[int(" + id_to_name(op.index) + ")]";
+				code += "[int(";
+				code += id_to_name(op.index);
+				code += ")]";
 				break;
 			case expression::operation::op_constant_index:
 				code += '[' + std::to_string(op.index) + ']';
@@ -1164,10 +1398,17 @@ private:
 
 		// GLSL matrices are always floating point, so need to cast type
 		if (!exp.chain.empty() && exp.chain[0].from.is_matrix() && !exp.chain[0].from.is_floating_point())
+		{
 			// Only supporting scalar assignments to matrices currently, so can assume to always cast to float
-			code += "float(" + id_to_name(value) + ");\n";
+			code += "float(";
+			code += id_to_name(value);
+			code += ");\n";
+		}
 		else
-			code += id_to_name(value) + ";\n";
+		{
+			code += id_to_name(value);
+			code += ";\n";
+		}
 	}
 
 	id   emit_constant(const type &type, const constant &data) override
@@ -1176,7 +1417,7 @@ private:
 
 		if (type.is_array() || type.is_struct())
 		{
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			code += '\t';
 
@@ -1185,7 +1426,8 @@ private:
 				code += "const ";
 
 			write_type(code, type);
-			code += ' ' + id_to_name(res);
+			code += ' ';
+			code += id_to_name(res);
 
 			// Array constants need to be stored in a constant variable as they cannot be used in-place
 			if (type.is_array())
@@ -1212,13 +1454,15 @@ private:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, res_type);
-		code += ' ' + id_to_name(res) + " = ";
+		code += ' ';
+		code += id_to_name(res);
+		code += " = ";
 
 		switch (op)
 		{
@@ -1238,7 +1482,9 @@ private:
 			assert(false);
 		}
 
-		code += '(' + id_to_name(val) + ");\n";
+		code += '(';
+		code += id_to_name(val);
+		code += ");\n";
 
 		return res;
 	}
@@ -1246,13 +1492,15 @@ private:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, res_type);
-		code += ' ' + id_to_name(res) + " = ";
+		code += ' ';
+		code += id_to_name(res);
+		code += " = ";
 
 		std::string intrinsic, operator_code;
 
@@ -1362,9 +1610,22 @@ private:
 		}
 
 		if (!intrinsic.empty())
-			code += intrinsic + '(' + id_to_name(lhs) + ", " + id_to_name(rhs) + ')';
+		{
+			code += intrinsic;
+			code += '(';
+			code += id_to_name(lhs);
+			code += ", ";
+			code += id_to_name(rhs);
+			code += ')';
+		}
 		else
-			code += id_to_name(lhs) + ' ' + operator_code + ' ' + id_to_name(rhs);
+		{
+			code += id_to_name(lhs);
+			code += ' ';
+			code += operator_code;
+			code += ' ';
+			code += id_to_name(rhs);
+		}
 
 		code += ";\n";
 
@@ -1377,13 +1638,14 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, res_type);
-		code += ' ' + id_to_name(res);
+		code += ' ';
+		code += id_to_name(res);
 
 		if (res_type.is_array())
 			code += '[' + std::to_string(res_type.array_length) + ']';
@@ -1394,7 +1656,14 @@ private:
 			code += "compCond(" + id_to_name(condition) + ", " + id_to_name(true_value) + ", " + id_to_name(false_value) + ");\n",
 			_uses_componentwise_cond = true;
 		else // GLSL requires the conditional expression to be a scalar boolean
-			code += id_to_name(condition) + " ? " + id_to_name(true_value) + " : " + id_to_name(false_value) + ";\n";
+		{
+			code += id_to_name(condition);
+			code += " ? ";
+			code += id_to_name(true_value);
+			code += " : ";
+			code += id_to_name(false_value);
+			code += ";\n";
+		}
 
 		return res;
 	}
@@ -1407,7 +1676,7 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1416,7 +1685,8 @@ private:
 		if (!res_type.is_void())
 		{
 			write_type(code, res_type);
-			code += ' ' + id_to_name(res);
+			code += ' ';
+			code += id_to_name(res);
 
 			if (res_type.is_array())
 				code += '[' + std::to_string(res_type.array_length) + ']';
@@ -1424,7 +1694,8 @@ private:
 			code += " = ";
 		}
 
-		code += id_to_name(function) + '(';
+		code += id_to_name(function);
+		code += '(';
 
 		for (size_t i = 0, num_args = args.size(); i < num_args; ++i)
 		{
@@ -1447,7 +1718,7 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1456,7 +1727,9 @@ private:
 		if (!res_type.is_void())
 		{
 			write_type(code, res_type);
-			code += ' ' + id_to_name(res) + " = ";
+			code += ' ';
+			code += id_to_name(res);
+			code += " = ";
 		}
 
 		enum
@@ -1486,13 +1759,14 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, type);
-		code += ' ' + id_to_name(res);
+		code += ' ';
+		code += id_to_name(res);
 
 		if (type.is_array())
 			code += '[' + std::to_string(type.array_length) + ']';
@@ -1523,49 +1797,39 @@ private:
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_statement_block != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
-
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
+		increase_indentation_level(_blocks.at(true_statement_block));
+		increase_indentation_level(_blocks.at(false_statement_block));
 
-		code += _blocks.at(condition_block);
+		append_block(_current_block, condition_block);
 
 		write_location(code, loc);
 
 		code += "\tif (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += true_statement_data;
+		append_block(_current_block, true_statement_block);
 		code += "\t}\n";
 
-		if (!false_statement_data.empty())
+		if (const code_block &false_statement_data = _blocks.at(false_statement_block);
+			!false_statement_data.code.empty() || !false_statement_data.references.empty())
 		{
 			code += "\telse\n\t{\n";
-			code += false_statement_data;
+			append_block(_current_block, false_statement_block);
 			code += "\t}\n";
 		}
-
-		// Remove consumed blocks to save memory
-		_blocks.erase(condition_block);
-		_blocks.erase(true_statement_block);
-		_blocks.erase(false_statement_block);
 	}
 	id   emit_phi(const location &loc, id condition_value, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &type) override
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_value != 0 && true_statement_block != 0 && false_value != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
-
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
+		increase_indentation_level(_blocks.at(true_statement_block));
+		increase_indentation_level(_blocks.at(false_statement_block));
 
 		const id res = make_id();
 
-		code += _blocks.at(condition_block);
+		append_block(_current_block, condition_block);
 
 		code += '\t';
 		write_type(code, type);
@@ -1574,34 +1838,31 @@ private:
 		write_location(code, loc);
 
 		code += "\tif (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += (true_statement_block != condition_block ? true_statement_data : std::string());
+		if (true_statement_block != condition_block)
+			append_block(_current_block, true_statement_block);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(true_value) + ";\n";
 		code += "\t}\n\telse\n\t{\n";
-		code += (false_statement_block != condition_block ? false_statement_data : std::string());
+		if (false_statement_block != condition_block)
+			append_block(_current_block, false_statement_block);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(false_value) + ";\n";
 		code += "\t}\n";
 
-		// Remove consumed blocks to save memory
-		_blocks.erase(condition_block);
-		_blocks.erase(true_statement_block);
-		_blocks.erase(false_statement_block);
-
 		return res;
 	}
 	void emit_loop(const location &loc, id condition_value, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int) override
 	{
 		assert(prev_block != 0 && header_block != 0 && loop_block != 0 && continue_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		std::string &loop_data = _blocks.at(loop_block);
-		std::string &continue_data = _blocks.at(continue_block);
+		increase_indentation_level(_blocks.at(loop_block));
+		increase_indentation_level(_blocks.at(loop_block));
+		increase_indentation_level(_blocks.at(continue_block));
 
-		increase_indentation_level(loop_data);
-		increase_indentation_level(loop_data);
-		increase_indentation_level(continue_data);
+		append_block(_current_block, prev_block);
 
-		code += _blocks.at(prev_block);
+		// The continue and condition blocks are modified below, so need their code right away
+		std::string continue_data = block_code(continue_block);
 
 		// Condition value can be missing in infinite loop constructs like "for (;;)"
 		std::string condition_name = condition_value != 0 ? id_to_name(condition_value) : "true";
@@ -1614,9 +1875,7 @@ private:
 			continue_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 
 			// We need to add the continue block to all "continue" statements as well
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data);
+			_continue_code[continue_block] = continue_data;
 
 			code += "\tbool " + condition_name + ";\n";
 
@@ -1624,14 +1883,14 @@ private:
 
 			code += '\t';
 			code += "do\n\t{\n\t\t{\n";
-			code += loop_data; // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
+			append_block(_current_block, loop_block, continue_block); // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
 			code += "\t\t}\n";
 			code += continue_data;
 			code += "\t}\n\twhile (" + condition_name + ");\n";
 		}
 		else
 		{
-			std::string &condition_data = _blocks.at(condition_block);
+			std::string condition_data = block_code(condition_block);
 
 			// If the condition data is just a single line, then it is a simple expression, which we can just put into the loop condition as-is
 			if (std::count(condition_data.begin(), condition_data.end(), '\n') == 1)
@@ -1657,35 +1916,25 @@ private:
 				condition_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 			}
 
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data + condition_data);
+			_continue_code[continue_block] = continue_data + condition_data;
 
 			code += '\t';
 			code += "while (" + condition_name + ")\n\t{\n\t\t{\n";
-			code += loop_data;
+			append_block(_current_block, loop_block, continue_block);
 			code += "\t\t}\n";
 			code += continue_data;
 			code += condition_data;
 			code += "\t}\n";
-
-			_blocks.erase(condition_block);
 		}
-
-		// Remove consumed blocks to save memory
-		_blocks.erase(prev_block);
-		_blocks.erase(header_block);
-		_blocks.erase(loop_block);
-		_blocks.erase(continue_block);
 	}
 	void emit_switch(const location &loc, id selector_value, id selector_block, id default_label, id default_block, const std::vector<id> &case_literal_and_labels, const std::vector<id> &case_blocks, unsigned int) override
 	{
 		assert(selector_value != 0 && selector_block != 0 && default_label != 0 && default_block != 0);
 		assert(case_blocks.size() == case_literal_and_labels.size() / 2);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		code += _blocks.at(selector_block);
+		append_block(_current_block, selector_block);
 
 		write_location(code, loc);
 
@@ -1717,44 +1966,43 @@ private:
 			}
 
 			assert(case_blocks[i / 2] != 0);
-			std::string &case_data = _blocks.at(case_blocks[i / 2]);
-
-			increase_indentation_level(case_data);
+			increase_indentation_level(_blocks.at(case_blocks[i / 2]));
 
 			code += "{\n";
-			code += case_data;
+			append_block(_current_block, case_blocks[i / 2]);
 			code += "\t}\n";
 		}
 
 
 		if (default_label != 0 && default_block != _current_block)
 		{
-			std::string &default_data = _blocks.at(default_block);
-
-			increase_indentation_level(default_data);
+			increase_indentation_level(_blocks.at(default_block));
 
 			code += "\tdefault: {\n";
-			code += default_data;
+			append_block(_current_block, default_block);
 			code += "\t}\n";
-
-			_blocks.erase(default_block);
 		}
 
 		code += "\t}\n";
-
-		// Remove consumed blocks to save memory
-		_blocks.erase(selector_block);
-		for (const id case_block : case_blocks)
-			_blocks.erase(case_block);
 	}
 
 	id   create_block() override
 	{
 		const id res = make_id();
 
-		std::string &block = _blocks.emplace(res, std::string()).first->second;
-		// Reserve a decently big enough memory block to avoid frequent reallocations
-		block.reserve(4096);
+		code_block &block = _blocks.emplace(res, code_block()).first->second;
+
+		if (!_free_blocks.empty())
+		{
+			// Reuse the memory of a block of a function that was already finished
+			block = std::move(_free_blocks.back());
+			_free_blocks.pop_back();
+		}
+		else
+		{
+			// Reserve a decently big enough memory block to avoid frequent reallocations
+			block.code.reserve(4096);
+		}
 
 		return res;
 	}
@@ -1774,7 +2022,7 @@ private:
 		if (!is_in_block())
 			return 0;
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\tdiscard;\n";
 
@@ -1798,7 +2046,7 @@ private:
 		if (!_functions.back()->return_type.is_void() && value == 0)
 			return set_block(0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\treturn";
 
@@ -1821,15 +2069,16 @@ private:
 		if (!is_in_block())
 			return _last_block;
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
 
 		switch (loop_flow)
 		{
 		case 1:
-			code += "\tbreak;\n";
+			block.code += "\tbreak;\n";
 			break;
 		case 2: // Keep track of continue target block, so we can insert its code here later
-			code += "__CONTINUE__" + std::to_string(target) + "\tcontinue;\n";
+			block.references.push_back({ block.code.size(), 0, 0, target });
+			block.code += "\tcontinue;\n";
 			break;
 		}
 
@@ -1846,11 +2095,37 @@ private:
 	{
 		assert(_last_block != 0);
 
-		_blocks.at(0) += "{\n" + _blocks.at(_last_block) + "}\n";
+		std::string &code = _blocks.at(0).code;
+
+		code += "{\n";
+		append_block(0, _last_block);
+		code += "}\n";
+
+		if (!_definition_ranges.empty() && _definition_ranges.back().end == std::string::npos)
+			_definition_ranges.back().end = code.size();
+
+		// All blocks of the function were written out now, so can reuse their memory
+		for (auto it = _blocks.begin(); it != _blocks.end();)
+		{
+			if (it->first == 0)
+			{
+				++it;
+				continue;
+			}
+
+			code_block &block = it->second;
+			block.code.clear();
+			block.references.clear();
+			block.indentation_level = 0;
+			_free_blocks.push_back(std::move(block));
+			it = _blocks.erase(it);
+		}
+
+		_continue_code.clear();
 	}
 };
 
-codegen *reshadefx::create_codegen_glsl(bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
+codegen *reshadefx::create_codegen_glsl(bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool eliminate_dead_code)
 {
-	return new codegen_glsl(debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y);
+	return new codegen_glsl(debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y, eliminate_dead_code);
 }
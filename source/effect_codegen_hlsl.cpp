@@ -10,17 +10,20 @@
 #include <cassert>
 #include <cstring> // stricmp
 #include <algorithm> // std::find_if, std::max
+#include <deque>
 
 using namespace reshadefx;
 
 class codegen_hlsl final : public codegen
 {
 public:
-	codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants)
+	codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, bool eliminate_dead_code)
 		: _shader_model(shader_model), _debug_info(debug_info), _uniforms_to_spec_constants(uniforms_to_spec_constants)
 	{
+		_eliminate_dead_code = eliminate_dead_code;
+
 		// Create default block and reserve a memory block to avoid frequent reallocations
-		std::string &block = _blocks.emplace(0, std::string()).first->second;
+		std::string &block = _blocks.emplace(0, code_block()).first->second.code;
 		block.reserve(8192);
 	}
 
@@ -35,10 +38,50 @@ private:
 		expression,
 	};
 
+	// Range of code in the default block that belongs to a single function, global variable or resource definition
+	struct definition_range
+	{
+		id definition;
+		size_t begin, end;
+	};
+
+	// Code of a basic block, which refers to the blocks that were appended to it instead of copying their code
+	// The code of a function is only put together once the function is finished, so that nested control flow does not copy the same code again at every level
+	struct code_block
+	{
+		struct reference
+		{
+			// Offset into the code at which the referenced block is inserted
+			size_t offset;
+			// Block to insert, or zero to insert the continue block of the loop that is the target of a "continue" statement
+			id block;
+			// Indentation level of the referenced block at the time it was appended
+			unsigned int indentation_level;
+			// Continue block of the loop this is the body of, or the continue block to insert in case of a "continue" statement
+			id continue_block;
+		};
+
+		std::string code;
+		std::vector<reference> references;
+		unsigned int indentation_level = 0;
+	};
+
+	// Marks that the code written last did not end with a line break
+	static constexpr unsigned int no_line_level = ~0u;
+
 	std::string _cbuffer_block;
-	std::string _current_location;
-	std::unordered_map<id, std::string> _names;
-	std::unordered_map<id, std::string> _blocks;
+	uint32_t _current_location = 0;
+	// Names indexed by their ID, which includes the automatically generated ones once they were used, so that they can be returned by reference
+	// This is a deque, so that references to names stay valid when it grows
+	mutable std::deque<std::string> _names;
+	// Set of all names given to definitions so far, to detect clashes without having to search through all of them
+	std::unordered_set<std::string> _used_names;
+	std::unordered_map<id, code_block> _blocks;
+	// Blocks of finished functions, which can be reused, so that their memory does not have to be allocated again
+	std::vector<code_block> _free_blocks;
+	// Code that is inserted in front of "continue" statements of a loop, indexed by the continue block of that loop
+	std::unordered_map<id, std::string> _continue_code;
+	std::vector<definition_range> _definition_ranges;
 	bool _debug_info = false;
 	bool _uniforms_to_spec_constants = false;
 	unsigned int _shader_model = 0;
@@ -48,6 +91,8 @@ private:
 
 	void write_result(module &module) override
 	{
+		mark_referenced_resources();
+
 		module = std::move(_module);
 
 		if (_shader_model >= 40)
@@ -101,7 +146,37 @@ private:
 			module.total_uniform_size *= 4;
 		}
 
-		module.hlsl += _blocks.at(0);
+		const std::string &code = _blocks.at(0).code;
+
+		if (!_eliminate_dead_code)
+		{
+			module.hlsl += code;
+			return;
+		}
+
+		// Skip over all definitions that are not in the specified set of references
+		const auto append_referenced_code = [this, &code](std::string &out, const std::unordered_set<id> &references) {
+			size_t offset = 0;
+			for (const definition_range &range : _definition_ranges)
+			{
+				if (references.find(range.definition) != references.end())
+					continue;
+
+				out.append(code, offset, range.begin - offset);
+				offset = range.end;
+			}
+
+			out.append(code, offset, std::string::npos);
+		};
+
+		// Every entry point gets the same declarations written above, followed by only the definitions it references
+		for (entry_point &entry_point : module.entry_points)
+		{
+			entry_point.hlsl = module.hlsl;
+			append_referenced_code(entry_point.hlsl, _entry_point_references.at(entry_point.name));
+		}
+
+		append_referenced_code(module.hlsl, _referenced_definitions);
 	}
 
 	template <bool is_param = false, bool is_decl = true>
@@ -262,7 +337,7 @@ private:
 	template <bool force_source = false>
 	void write_location(std::string &s, const location &loc)
 	{
-		if (loc.source.empty() || !_debug_info)
+		if (loc.source == 0 || !_debug_info)
 			return;
 
 		s += "#line " + std::to_string(loc.line);
@@ -270,13 +345,14 @@ private:
 		size_t offset = s.size();
 
 		// Avoid writing the file name every time to reduce output text size
-		if constexpr (force_source)
+		// This does not work when unreferenced definitions are removed afterwards, since that could remove the line that switched files
+		if (force_source || _eliminate_dead_code)
 		{
-			s += " \"" + loc.source + '\"';
+			s += " \"" + loc.source_name() + '\"';
 		}
 		else if (loc.source != _current_location)
 		{
-			s += " \"" + loc.source + '\"';
+			s += " \"" + loc.source_name() + '\"';
 
 			_current_location = loc.source;
 		}
@@ -291,11 +367,14 @@ private:
 		s += '\n';
 	}
 
-	std::string id_to_name(id id) const
+	const std::string &id_to_name(id id) const
 	{
-		if (const auto it = _names.find(id); it != _names.end())
-			return it->second;
-		return '_' + std::to_string(id);
+		if (id >= _names.size())
+			_names.resize(id + 1);
+		std::string &name = _names[id];
+		if (name.empty())
+			name = '_' + std::to_string(id);
+		return name;
 	}
 
 	template <naming naming_type = naming::general>
@@ -307,8 +386,12 @@ private:
 				return; // Filter out names that may clash with automatic ones
 		name = escape_name(std::move(name));
 		if constexpr (naming_type == naming::general)
-			if (std::find_if(_names.begin(), _names.end(), [&name](const auto &it) { return it.second == name; }) != _names.end())
+			if (_used_names.find(name) != _used_names.end())
 				name += '_' + std::to_string(id); // Append a numbered suffix if the name already exists
+		if constexpr (naming_type != naming::expression)
+			_used_names.insert(name); // Expressions are made up of names that were defined before, so do not need to be tracked
+		if (id >= _names.size())
+			_names.resize(id + 1);
 		_names[id] = std::move(name);
 	}
 
@@ -362,10 +445,128 @@ private:
 		if (block.empty())
 			return;
 
-		for (size_t pos = 0; (pos = block.find("\n\t", pos)) != std::string::npos; pos += 3)
-			block.replace(pos, 2, "\n\t\t");
+		// Build the indented code in a single pass, rather than inserting into the block for every line (which moves all the code after it each time)
+		std::string indented_block;
+		indented_block.reserve(block.size() + block.size() / 8);
+		indented_block += '\t';
+
+		for (size_t offset = 0, pos; offset < block.size(); offset = pos + 2)
+		{
+			if ((pos = block.find("\n\t", offset)) == std::string::npos)
+			{
+				indented_block.append(block, offset, std::string::npos);
+				break;
+			}
+
+			indented_block.append(block, offset, pos - offset);
+			indented_block += "\n\t\t";
+		}
+
+		block = std::move(indented_block);
+	}
+
+	static void increase_indentation_level(code_block &block)
+	{
+		// Only count the level here, it is applied to the code when the block is written out in 'write_block'
+		block.indentation_level++;
+	}
+
+	void append_block(id target_block, id block_id, id continue_block = 0)
+	{
+		code_block &target = _blocks.at(target_block);
+		const code_block &block = _blocks.at(block_id);
+
+		if (block.code.empty() && block.references.empty())
+			return;
+
+		if (target_block == 0)
+		{
+			// Ranges of the default block are tracked for every definition, so its code has to be written out right away
+			unsigned int line_level = no_line_level;
+			std::unordered_map<id, unsigned int> continue_levels;
+			write_block(target.code, block_id, block.indentation_level, 0, line_level, continue_levels);
+			return;
+		}
+
+		target.references.push_back({ target.code.size(), block_id, block.indentation_level, continue_block });
+	}
+
+	// Returns the code of a block with all the blocks it references put in, for code that still has to be modified
+	std::string block_code(id block_id) const
+	{
+		std::string code;
+		unsigned int line_level = no_line_level;
+		std::unordered_map<id, unsigned int> continue_levels;
+		write_block(code, block_id, _blocks.at(block_id).indentation_level, 0, line_level, continue_levels);
+		return code;
+	}
+
+	// Writes the code of a block and of all the blocks it references to the output, with the same result as if every block had been indented and copied into the next one right away
+	// The level of a line is the total indentation level of the innermost block that contained both the line break and the tab that follows it, which is the lower one of the two levels
+	void write_block(std::string &out, id block_id, unsigned int indentation_level, unsigned int level, unsigned int &line_level, std::unordered_map<id, unsigned int> &continue_levels) const
+	{
+		const code_block &block = _blocks.at(block_id);
+		if (block.code.empty() && block.references.empty())
+			return;
+
+		// Every indentation level adds a tab in front of the first line of the block
+		if (indentation_level != 0)
+		{
+			write_indented(out, std::string(indentation_level, '\t'), level, line_level);
+			level += indentation_level;
+		}
+
+		size_t offset = 0;
+		for (const code_block::reference &reference : block.references)
+		{
+			write_indented(out, std::string_view(block.code).substr(offset, reference.offset - offset), level, line_level);
+			offset = reference.offset;
+
+			if (reference.block != 0)
+			{
+				if (reference.continue_block != 0)
+					continue_levels[reference.continue_block] = level;
+
+				write_block(out, reference.block, reference.indentation_level, level, line_level, continue_levels);
+			}
+			else
+			{
+				// The continue block was added to the loop body after it was indented, so it is at the level of the loop, rather than at the level of the "continue" statement
+				const unsigned int continue_level = continue_levels.at(reference.continue_block);
+				if (line_level != no_line_level)
+					line_level = std::min(line_level, continue_level);
+
+				write_indented(out, _continue_code.at(reference.continue_block), continue_level, line_level);
+			}
+		}
+
+		write_indented(out, std::string_view(block.code).substr(offset), level, line_level);
+	}
+	static void write_indented(std::string &out, std::string_view code, unsigned int level, unsigned int &line_level)
+	{
+		if (code.empty())
+			return;
+
+		// Indent a line that started in code that was written before
+		if (line_level != no_line_level && code[0] == '\t')
+			out.append(std::min(line_level, level), '\t');
+		line_level = no_line_level;
+
+		for (size_t offset = 0, pos; offset < code.size(); offset = pos + 1)
+		{
+			if ((pos = code.find('\n', offset)) == std::string_view::npos)
+			{
+				out.append(code.data() + offset, code.size() - offset);
+				break;
+			}
+
+			out.append(code.data() + offset, pos + 1 - offset);
 
-		block.insert(block.begin(), '\t');
+			if (pos + 1 == code.size())
+				line_level = level;
+			else if (code[pos + 1] == '\t')
+				out.append(level, '\t');
+		}
 	}
 
 	id   define_struct(const location &loc, struct_info &info) override
@@ -375,7 +576,7 @@ private:
 
 		_structs.push_back(info);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -409,12 +610,16 @@ private:
 			info.binding = _module.num_texture_bindings;
 			_module.num_texture_bindings += 2;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
+
+			const size_t begin = code.size();
 
 			write_location(code, loc);
 
 			code += "Texture2D __"     + info.unique_name + " : register(t" + std::to_string(info.binding + 0) + ");\n";
 			code += "Texture2D __srgb" + info.unique_name + " : register(t" + std::to_string(info.binding + 1) + ");\n";
+
+			_definition_ranges.push_back({ info.id, begin, code.size() });
 		}
 
 		_module.textures.push_back(info);
@@ -431,7 +636,7 @@ private:
 			[&info](const auto &it) { return it.unique_name == info.texture_name; });
 		assert(texture != _module.textures.end());
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		if (_shader_model >= 40)
 		{
@@ -453,15 +658,22 @@ private:
 			assert(info.srgb == 0 || info.srgb == 1);
 			info.texture_binding = texture->binding + info.srgb; // Offset binding by one to choose the SRGB variant
 
+			// Sampler state declarations may be shared with other samplers, so only the sampler definition itself can be removed
+			const size_t begin = code.size();
+
 			write_location(code, loc);
 
 			code += "static const __sampler2D " + id_to_name(info.id) + " = { " + (info.srgb ? "__srgb" : "__") + info.texture_name + ", __s" + std::to_string(info.binding) + " };\n";
+
+			_definition_ranges.push_back({ info.id, begin, code.size() });
 		}
 		else
 		{
 			info.binding = _module.num_sampler_bindings++;
 			info.texture_binding = ~0u; // Unset texture binding
 
+			const size_t begin = code.size();
+
 			code += "sampler2D __" + info.unique_name + "_s : register(s" + std::to_string(info.binding) + ");\n";
 
 			write_location(code, loc);
@@ -474,6 +686,8 @@ private:
 				code += texture->semantic + "_PIXEL_SIZE"; // Expect application to set inverse texture size via a define if it is not known here
 
 			code += ") }; \n";
+
+			_definition_ranges.push_back({ info.id, begin, code.size() });
 		}
 
 		_module.samplers.push_back(info);
@@ -491,11 +705,15 @@ private:
 		{
 			info.binding = _module.num_storage_bindings++;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
+
+			const size_t begin = code.size();
 
 			write_location(code, loc);
 
 			code += "RWTexture2D<float4> " + info.unique_name + " : register(u" + std::to_string(info.binding) + ");\n";
+
+			_definition_ranges.push_back({ info.id, begin, code.size() });
 		}
 
 		_module.storages.push_back(info);
@@ -514,7 +732,7 @@ private:
 			if (info.type.is_array())
 				info.size *= info.type.array_length;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			write_location(code, loc);
 
@@ -591,7 +809,9 @@ private:
 		if (!name.empty())
 			define_name<naming::general>(res, name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
+
+		const size_t begin = code.size();
 
 		write_location(code, loc);
 
@@ -609,6 +829,9 @@ private:
 
 		code += ";\n";
 
+		if (global && _current_block == 0)
+			_definition_ranges.push_back({ res, begin, code.size() });
+
 		return res;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -617,7 +840,10 @@ private:
 
 		define_name<naming::unique>(info.definition, info.unique_name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
+
+		// The end of the range is filled in by 'leave_function'
+		_definition_ranges.push_back({ info.definition, code.size(), std::string::npos });
 
 		write_location(code, loc);
 
@@ -736,8 +962,10 @@ private:
 			}
 		}
 
+		const size_t begin = _blocks.at(_current_block).code.size();
+
 		if (stype == shader_type::cs)
-			_blocks.at(_current_block) += "[numthreads(" +
+			_blocks.at(_current_block).code += "[numthreads(" +
 				std::to_string(num_threads[0]) + ", " +
 				std::to_string(num_threads[1]) + ", " +
 				std::to_string(num_threads[2]) + ")]\n";
@@ -745,7 +973,13 @@ private:
 		define_function({}, entry_point);
 		enter_block(create_block());
 
-		std::string &code = _blocks.at(_current_block);
+		// Make the attribute part of the generated function, so that it is removed together with it
+		_definition_ranges.back().begin = begin;
+
+		// The generated function is not known to the parser, so add it to the references of the entry point here
+		func.referenced_functions.insert(entry_point.definition);
+
+		std::string &code = _blocks.at(_current_block).code;
 
 		// Clear all color output parameters so no component is left uninitialized
 		for (struct_member_info &param : entry_point.parameter_list)
@@ -836,7 +1070,9 @@ private:
 				expr_code += find_struct(op.from.definition).member_list[op.index].name;
 				break;
 			case expression::operation::op_dynamic_index:
-				expr_code += '[' + id_to_name(op.index) + ']';
+				expr_code += '[';
+				expr_code += id_to_name(op.index);
+				expr_code += ']';
 				break;
 			case expression::operation::op_constant_index:
 				if (op.from.is_vector() && !op.from.is_array())
@@ -859,11 +1095,15 @@ private:
 		if (force_new_id)
 		{
 			// Need to store value in a new variable to comply with request for a new ID
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			code += '\t';
 			write_type(code, exp.type);
-			code += ' ' + id_to_name(res) + " = " + expr_code + ";\n";
+			code += ' ';
+			code += id_to_name(res);
+			code += " = ";
+			code += expr_code;
+			code += ";\n";
 		}
 		else
 		{
@@ -875,11 +1115,12 @@ private:
 	}
 	void emit_store(const expression &exp, id value) override
 	{
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, exp.location);
 
-		code += '\t' + id_to_name(exp.base);
+		code += '\t';
+		code += id_to_name(exp.base);
 
 		static const char s_matrix_swizzles[16][5] = {
 			"_m00", "_m01", "_m02", "_m03",
@@ -897,7 +1138,9 @@ private:
 				code += find_struct(op.from.definition).member_list[op.index].name;
 				break;
 			case expression::operation::op_dynamic_index:
-				code += '[' + id_to_name(op.index) + ']';
+				code += '[';
+				code += id_to_name(op.index);
+				code += ']';
 				break;
 			case expression::operation::op_constant_index:
 				code += '[' + std::to_string(op.index) + ']';
@@ -913,7 +1156,9 @@ private:
 			}
 		}
 
-		code += " = " + id_to_name(value) + ";\n";
+		code += " = ";
+		code += id_to_name(value);
+		code += ";\n";
 	}
 
 	id   emit_constant(const type &type, const constant &data) override
@@ -922,12 +1167,13 @@ private:
 
 		if (type.is_array())
 		{
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			// Array constants need to be stored in a constant variable as they cannot be used in-place
 			code += "\tconst ";
 			write_type(code, type);
-			code += ' ' + id_to_name(res);
+			code += ' ';
+			code += id_to_name(res);
 			code += '[' + std::to_string(type.array_length) + ']';
 			code += " = ";
 			write_constant(code, type, data);
@@ -946,20 +1192,23 @@ private:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, res_type);
-		code += ' ' + id_to_name(res) + " = ";
+		code += ' ';
+		code += id_to_name(res);
+		code += " = ";
 
 		if (_shader_model < 40 && op == tokenid::tilde)
 			code += "0xFFFFFFFF - "; // Emulate bitwise not operator on shader model 3
 		else
 			code += char(op);
 
-		code += id_to_name(val) + ";\n";
+		code += id_to_name(val);
+		code += ";\n";
 
 		return res;
 	}
@@ -967,13 +1216,15 @@ private:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, res_type);
-		code += ' ' + id_to_name(res) + " = ";
+		code += ' ';
+		code += id_to_name(res);
+		code += " = ";
 
 		if (_shader_model < 40)
 		{
@@ -984,7 +1235,8 @@ private:
 				code += "floor(";
 		}
 
-		code += id_to_name(lhs) + ' ';
+		code += id_to_name(lhs);
+		code += ' ';
 
 		switch (op)
 		{
@@ -1058,7 +1310,8 @@ private:
 			assert(false);
 		}
 
-		code += ' ' + id_to_name(rhs);
+		code += ' ';
+		code += id_to_name(rhs);
 
 		if (_shader_model < 40)
 		{
@@ -1079,18 +1332,25 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, res_type);
-		code += ' ' + id_to_name(res);
+		code += ' ';
+		code += id_to_name(res);
 
 		if (res_type.is_array())
 			code += '[' + std::to_string(res_type.array_length) + ']';
 
-		code += " = " + id_to_name(condition) + " ? " + id_to_name(true_value) + " : " + id_to_name(false_value) + ";\n";
+		code += " = ";
+		code += id_to_name(condition);
+		code += " ? ";
+		code += id_to_name(true_value);
+		code += " : ";
+		code += id_to_name(false_value);
+		code += ";\n";
 
 		return res;
 	}
@@ -1103,7 +1363,7 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1112,7 +1372,8 @@ private:
 		if (!res_type.is_void())
 		{
 			write_type(code, res_type);
-			code += ' ' + id_to_name(res);
+			code += ' ';
+			code += id_to_name(res);
 
 			if (res_type.is_array())
 				code += '[' + std::to_string(res_type.array_length) + ']';
@@ -1120,7 +1381,8 @@ private:
 			code += " = ";
 		}
 
-		code += id_to_name(function) + '(';
+		code += id_to_name(function);
+		code += '(';
 
 		for (size_t i = 0, num_args = args.size(); i < num_args; ++i)
 		{
@@ -1143,7 +1405,7 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1164,12 +1426,16 @@ private:
 			// Implementation of the 'tex2Dsize' intrinsic passes the result variable into 'GetDimensions' as output argument
 			// Same with the atomic intrinsics, which use the last parameter to return the previous value of the target
 			write_type(code, res_type);
-			code += ' ' + id_to_name(res) + "; ";
+			code += ' ';
+			code += id_to_name(res);
+			code += "; ";
 		}
 		else if (!res_type.is_void())
 		{
 			write_type(code, res_type);
-			code += ' ' + id_to_name(res) + " = ";
+			code += ' ';
+			code += id_to_name(res);
+			code += " = ";
 		}
 
 		switch (intrinsic)
@@ -1193,13 +1459,14 @@ private:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
 		code += '\t';
 		write_type(code, type);
-		code += ' ' + id_to_name(res);
+		code += ' ';
+		code += id_to_name(res);
 
 		if (type.is_array())
 			code += '[' + std::to_string(type.array_length) + ']';
@@ -1233,15 +1500,12 @@ private:
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_statement_block != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
+		increase_indentation_level(_blocks.at(true_statement_block));
+		increase_indentation_level(_blocks.at(false_statement_block));
 
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
-
-		code += _blocks.at(condition_block);
+		append_block(_current_block, condition_block);
 
 		write_location(code, loc);
 
@@ -1251,36 +1515,29 @@ private:
 		if (flags & 0x2) code +=  "[branch] ";
 
 		code += "if (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += true_statement_data;
+		append_block(_current_block, true_statement_block);
 		code += "\t}\n";
 
-		if (!false_statement_data.empty())
+		if (const code_block &false_statement_data = _blocks.at(false_statement_block);
+			!false_statement_data.code.empty() || !false_statement_data.references.empty())
 		{
 			code += "\telse\n\t{\n";
-			code += false_statement_data;
+			append_block(_current_block, false_statement_block);
 			code += "\t}\n";
 		}
-
-		// Remove consumed blocks to save memory
-		_blocks.erase(condition_block);
-		_blocks.erase(true_statement_block);
-		_blocks.erase(false_statement_block);
 	}
 	id   emit_phi(const location &loc, id condition_value, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &type) override
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_value != 0 && true_statement_block != 0 && false_value != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
-
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
+		increase_indentation_level(_blocks.at(true_statement_block));
+		increase_indentation_level(_blocks.at(false_statement_block));
 
 		const id res = make_id();
 
-		code += _blocks.at(condition_block);
+		append_block(_current_block, condition_block);
 
 		code += '\t';
 		write_type(code, type);
@@ -1289,34 +1546,31 @@ private:
 		write_location(code, loc);
 
 		code += "\tif (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += (true_statement_block != condition_block ? true_statement_data : std::string());
+		if (true_statement_block != condition_block)
+			append_block(_current_block, true_statement_block);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(true_value) + ";\n";
 		code += "\t}\n\telse\n\t{\n";
-		code += (false_statement_block != condition_block ? false_statement_data : std::string());
+		if (false_statement_block != condition_block)
+			append_block(_current_block, false_statement_block);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(false_value) + ";\n";
 		code += "\t}\n";
 
-		// Remove consumed blocks to save memory
-		_blocks.erase(condition_block);
-		_blocks.erase(true_statement_block);
-		_blocks.erase(false_statement_block);
-
 		return res;
 	}
 	void emit_loop(const location &loc, id condition_value, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int flags) override
 	{
 		assert(prev_block != 0 && header_block != 0 && loop_block != 0 && continue_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		std::string &loop_data = _blocks.at(loop_block);
-		std::string &continue_data = _blocks.at(continue_block);
+		increase_indentation_level(_blocks.at(loop_block));
+		increase_indentation_level(_blocks.at(loop_block));
+		increase_indentation_level(_blocks.at(continue_block));
 
-		increase_indentation_level(loop_data);
-		increase_indentation_level(loop_data);
-		increase_indentation_level(continue_data);
+		append_block(_current_block, prev_block);
 
-		code += _blocks.at(prev_block);
+		// The continue and condition blocks are modified below, so need their code right away
+		std::string continue_data = block_code(continue_block);
 
 		std::string attributes;
 		if (flags & 0x1)
@@ -1335,9 +1589,7 @@ private:
 			continue_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 
 			// We need to add the continue block to all "continue" statements as well
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data);
+			_continue_code[continue_block] = continue_data;
 
 			code += "\tbool " + condition_name + ";\n";
 
@@ -1345,14 +1597,14 @@ private:
 
 			code += '\t' + attributes;
 			code += "do\n\t{\n\t\t{\n";
-			code += loop_data; // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
+			append_block(_current_block, loop_block, continue_block); // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
 			code += "\t\t}\n";
 			code += continue_data;
 			code += "\t}\n\twhile (" + condition_name + ");\n";
 		}
 		else
 		{
-			std::string &condition_data = _blocks.at(condition_block);
+			std::string condition_data = block_code(condition_block);
 
 			// Work around D3DCompiler putting uniform variables that are used as the loop count register into integer registers (only in SM3)
 			// Only applies to dynamic loops with uniform variables in the condition, where it generates a loop instruction like "rep i0", but then expects the "i0" register to be set externally
@@ -1386,9 +1638,7 @@ private:
 				condition_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 			}
 
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data + condition_data);
+			_continue_code[continue_block] = continue_data + condition_data;
 
 			write_location(code, loc);
 
@@ -1397,31 +1647,23 @@ private:
 				code += "while (true)\n\t{\n\t\tif (" + condition_name + ")\n\t\t{\n";
 			else
 				code += "while (" + condition_name + ")\n\t{\n\t\t{\n";
-			code += loop_data;
+			append_block(_current_block, loop_block, continue_block);
 			code += "\t\t}\n";
 			if (use_break_statement_for_condition)
 				code += "\t\telse break;\n";
 			code += continue_data;
 			code += condition_data;
 			code += "\t}\n";
-
-			_blocks.erase(condition_block);
 		}
-
-		// Remove consumed blocks to save memory
-		_blocks.erase(prev_block);
-		_blocks.erase(header_block);
-		_blocks.erase(loop_block);
-		_blocks.erase(continue_block);
 	}
 	void emit_switch(const location &loc, id selector_value, id selector_block, id default_label, id default_block, const std::vector<id> &case_literal_and_labels, const std::vector<id> &case_blocks, unsigned int flags) override
 	{
 		assert(selector_value != 0 && selector_block != 0 && default_label != 0 && default_block != 0);
 		assert(case_blocks.size() == case_literal_and_labels.size() / 2);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
-		code += _blocks.at(selector_block);
+		append_block(_current_block, selector_block);
 
 		if (_shader_model >= 40)
 		{
@@ -1460,26 +1702,20 @@ private:
 				}
 
 				assert(case_blocks[i / 2] != 0);
-				std::string &case_data = _blocks.at(case_blocks[i / 2]);
-
-				increase_indentation_level(case_data);
+				increase_indentation_level(_blocks.at(case_blocks[i / 2]));
 
 				code += "{\n";
-				code += case_data;
+				append_block(_current_block, case_blocks[i / 2]);
 				code += "\t}\n";
 			}
 
 			if (default_label != 0 && default_block != _current_block)
 			{
-				std::string &default_data = _blocks.at(default_block);
-
-				increase_indentation_level(default_data);
+				increase_indentation_level(_blocks.at(default_block));
 
 				code += "\tdefault: {\n";
-				code += default_data;
+				append_block(_current_block, default_block);
 				code += "\t}\n";
-
-				_blocks.erase(default_block);
 			}
 
 			code += "\t}\n";
@@ -1511,12 +1747,10 @@ private:
 				}
 
 				assert(case_blocks[i / 2] != 0);
-				std::string &case_data = _blocks.at(case_blocks[i / 2]);
-
-				increase_indentation_level(case_data);
+				increase_indentation_level(_blocks.at(case_blocks[i / 2]));
 
 				code += ")\n\t{\n";
-				code += case_data;
+				append_block(_current_block, case_blocks[i / 2]);
 				code += "\t}\n\telse\n\t";
 			}
 
@@ -1524,31 +1758,32 @@ private:
 
 			if (default_block != _current_block)
 			{
-				std::string &default_data = _blocks.at(default_block);
-
-				increase_indentation_level(default_data);
+				increase_indentation_level(_blocks.at(default_block));
 
-				code += default_data;
-
-				_blocks.erase(default_block);
+				append_block(_current_block, default_block);
 			}
 
 			code += "\t} } while (false);\n";
 		}
-
-		// Remove consumed blocks to save memory
-		_blocks.erase(selector_block);
-		for (const id case_block : case_blocks)
-			_blocks.erase(case_block);
 	}
 
 	id   create_block() override
 	{
 		const id res = make_id();
 
-		std::string &block = _blocks.emplace(res, std::string()).first->second;
-		// Reserve a decently big enough memory block to avoid frequent reallocations
-		block.reserve(4096);
+		code_block &block = _blocks.emplace(res, code_block()).first->second;
+
+		if (!_free_blocks.empty())
+		{
+			// Reuse the memory of a block of a function that was already finished
+			block = std::move(_free_blocks.back());
+			_free_blocks.pop_back();
+		}
+		else
+		{
+			// Reserve a decently big enough memory block to avoid frequent reallocations
+			block.code.reserve(4096);
+		}
 
 		return res;
 	}
@@ -1568,7 +1803,7 @@ private:
 		if (!is_in_block())
 			return 0;
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\tdiscard;\n";
 
@@ -1594,7 +1829,7 @@ private:
 		if (!_functions.back()->return_type.is_void() && value == 0)
 			return set_block(0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\treturn";
 
@@ -1617,15 +1852,16 @@ private:
 		if (!is_in_block())
 			return _last_block;
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
 
 		switch (loop_flow)
 		{
 		case 1:
-			code += "\tbreak;\n";
+			block.code += "\tbreak;\n";
 			break;
 		case 2: // Keep track of continue target block, so we can insert its code here later
-			code += "__CONTINUE__" + std::to_string(target) + "\tcontinue;\n";
+			block.references.push_back({ block.code.size(), 0, 0, target });
+			block.code += "\tcontinue;\n";
 			break;
 		}
 
@@ -1642,11 +1878,37 @@ private:
 	{
 		assert(_last_block != 0);
 
-		_blocks.at(0) += "{\n" + _blocks.at(_last_block) + "}\n";
+		std::string &code = _blocks.at(0).code;
+
+		code += "{\n";
+		append_block(0, _last_block);
+		code += "}\n";
+
+		if (!_definition_ranges.empty() && _definition_ranges.back().end == std::string::npos)
+			_definition_ranges.back().end = code.size();
+
+		// All blocks of the function were written out now, so can reuse their memory
+		for (auto it = _blocks.begin(); it != _blocks.end();)
+		{
+			if (it->first == 0)
+			{
+				++it;
+				continue;
+			}
+
+			code_block &block = it->second;
+			block.code.clear();
+			block.references.clear();
+			block.indentation_level = 0;
+			_free_blocks.push_back(std::move(block));
+			it = _blocks.erase(it);
+		}
+
+		_continue_code.clear();
 	}
 };
 
-codegen *reshadefx::create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants)
+codegen *reshadefx::create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, bool eliminate_dead_code)
 {
-	return new codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants);
+	return new codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants, eliminate_dead_code);
 }
@@ -6,8 +6,10 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include <cassert>
-#include <cstring> // memcmp
+#include <cstring> // std::memcmp, std::strlen
+#include <limits> // std::numeric_limits
 #include <algorithm> // std::find_if, std::max
+#include <functional>
 #include <unordered_set>
 
 // Use the C++ variant of the SPIR-V headers
@@ -19,25 +21,133 @@ namespace spv {
 using namespace reshadefx;
 
 /// <summary>
-/// A single instruction in a SPIR-V module
+/// A single instruction in a SPIR-V module. The words it is encoded in are stored in the basic block it belongs to.
 /// </summary>
 struct spirv_instruction
 {
 	spv::Op op;
 	spv::Id type;
 	spv::Id result;
-	std::vector<spv::Id> operands;
+	uint32_t offset; // Index of the first word of this instruction in the words of its basic block
 
-	explicit spirv_instruction(spv::Op op = spv::OpNop) : op(op), type(0), result(0) {}
-	spirv_instruction(spv::Op op, spv::Id result) : op(op), type(result), result(0) {}
-	spirv_instruction(spv::Op op, spv::Id type, spv::Id result) : op(op), type(type), result(result) {}
+	/// <summary>
+	/// Get the index of the first operand word of this instruction in the words of its basic block.
+	/// </summary>
+	uint32_t operands_offset() const { return offset + 1 + (type != 0) + (result != 0); }
+};
+
+struct spirv_instruction_ref;
+
+/// <summary>
+/// A list of instructions forming a basic block in the SPIR-V module.
+/// All instructions are encoded into a single stream of words in their final binary layout, so that blocks can be appended to each other and written to the module without per-instruction copies.
+/// </summary>
+struct spirv_basic_block
+{
+	std::vector<uint32_t> words;
+	std::vector<spirv_instruction> instructions;
+
+	/// <summary>
+	/// Add a new instruction to the end of this block.
+	/// </summary>
+	/// <param name="op">The opcode of the instruction.</param>
+	/// <param name="type">The optional result type ID of the instruction.</param>
+	/// <param name="result">The optional result ID of the instruction.</param>
+	/// <returns>A reference to the new instruction that operands can be added to.</returns>
+	spirv_instruction_ref add_instruction(spv::Op op, spv::Id type, spv::Id result);
+
+	/// <summary>
+	/// Append another basic block the end of this one.
+	/// </summary>
+	void append(const spirv_basic_block &block)
+	{
+		append(block, 0, block.instructions.size());
+	}
+	/// <summary>
+	/// Append a range of instructions from another basic block to the end of this one.
+	/// </summary>
+	void append(const spirv_basic_block &block, size_t first, size_t count)
+	{
+		if (count == 0)
+			return;
+
+		const uint32_t begin = block.instructions[first].offset;
+		const uint32_t end = first + count < block.instructions.size() ? block.instructions[first + count].offset : static_cast<uint32_t>(block.words.size());
+		const uint32_t base = static_cast<uint32_t>(words.size());
+
+		words.insert(words.end(), block.words.begin() + begin, block.words.begin() + end);
+
+		instructions.reserve(instructions.size() + count);
+		for (size_t i = first; i < first + count; ++i)
+		{
+			spirv_instruction &inst = instructions.emplace_back(block.instructions[i]);
+			inst.offset = inst.offset - begin + base;
+		}
+	}
+
+	/// <summary>
+	/// Remove the last instruction from this block.
+	/// </summary>
+	/// <returns>A block containing only the removed instruction.</returns>
+	spirv_basic_block pop_back()
+	{
+		assert(!instructions.empty());
+
+		spirv_basic_block last;
+		last.append(*this, instructions.size() - 1, 1);
+
+		words.resize(instructions.back().offset);
+		instructions.pop_back();
+
+		return last;
+	}
+
+	/// <summary>
+	/// Get the operands of the specified instruction in this block.
+	/// </summary>
+	const spv::Id *operands(const spirv_instruction &inst) const { return words.data() + inst.operands_offset(); }
+	/// <summary>
+	/// Get the number of operands of the specified instruction in this block.
+	/// </summary>
+	uint32_t num_operands(const spirv_instruction &inst) const { return (words[inst.offset] >> spv::WordCountShift) - (inst.operands_offset() - inst.offset); }
+
+	/// <summary>
+	/// Write instructions of this block to a SPIR-V module.
+	/// </summary>
+	/// <param name="output">The output stream to append the instructions to.</param>
+	/// <param name="first">The index of the first instruction to write.</param>
+	/// <param name="count">The number of instructions to write, or all remaining ones if this exceeds the number of instructions.</param>
+	void write(std::vector<uint32_t> &output, size_t first = 0, size_t count = std::numeric_limits<size_t>::max()) const
+	{
+		if (first >= instructions.size())
+			return;
+
+		const uint32_t begin = instructions[first].offset;
+		const uint32_t end = count < instructions.size() - first ? instructions[first + count].offset : static_cast<uint32_t>(words.size());
+
+		output.insert(output.end(), words.begin() + begin, words.begin() + end);
+	}
+};
+
+/// <summary>
+/// A reference to the last instruction of a basic block, which is used to add operands to it while it is being built.
+/// </summary>
+struct spirv_instruction_ref
+{
+	spirv_basic_block *block = nullptr;
+	size_t index = 0;
+	spv::Id result = 0;
 
 	/// <summary>
 	/// Add a single operand to the instruction.
 	/// </summary>
-	spirv_instruction &add(spv::Id operand)
+	spirv_instruction_ref &add(spv::Id operand)
 	{
-		operands.push_back(operand);
+		// Operands are appended to the word stream, so no other instruction may have been added to the block after this one
+		assert(block != nullptr && index + 1 == block->instructions.size());
+
+		block->words[block->instructions[index].offset] += 1 << spv::WordCountShift;
+		block->words.push_back(operand);
 		return *this;
 	}
 
@@ -45,16 +155,20 @@ struct spirv_instruction
 	/// Add a range of operands to the instruction.
 	/// </summary>
 	template <typename It>
-	spirv_instruction &add(It begin, It end)
+	spirv_instruction_ref &add(It begin, It end)
 	{
-		operands.insert(operands.end(), begin, end);
+		assert(block != nullptr && index + 1 == block->instructions.size());
+
+		const size_t num_operands = static_cast<size_t>(std::distance(begin, end));
+		block->words[block->instructions[index].offset] += static_cast<uint32_t>(num_operands) << spv::WordCountShift;
+		block->words.insert(block->words.end(), begin, end);
 		return *this;
 	}
 
 	/// <summary>
 	/// Add a null-terminated literal UTF-8 string to the instruction.
 	/// </summary>
-	spirv_instruction &add_string(const char *string)
+	spirv_instruction_ref &add_string(const char *string)
 	{
 		uint32_t word;
 		do {
@@ -67,62 +181,84 @@ struct spirv_instruction
 	}
 
 	/// <summary>
-	/// Write this instruction to a SPIR-V module.
+	/// Set the result type of the instruction, for when it is only known after the operands were added.
 	/// </summary>
-	/// <param name="output">The output stream to append this instruction to.</param>
-	void write(std::vector<uint32_t> &output) const
+	spirv_instruction_ref &set_type(spv::Id type)
 	{
-		// See https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html
-		// 0             | Opcode: The 16 high-order bits are the WordCount of the instruction. The 16 low-order bits are the opcode enumerant.
-		// 1             | Optional instruction type <id>
-		// .             | Optional instruction Result <id>
-		// .             | Operand 1 (if needed)
-		// .             | Operand 2 (if needed)
-		// ...           | ...
-		// WordCount - 1 | Operand N (N is determined by WordCount minus the 1 to 3 words used for the opcode, instruction type <id>, and instruction Result <id>).
+		assert(block != nullptr && index + 1 == block->instructions.size() && type != 0);
 
-		const uint32_t num_words = 1 + (type != 0) + (result != 0) + static_cast<uint32_t>(operands.size());
-		output.push_back((num_words << spv::WordCountShift) | op);
-
-		// Optional instruction type ID
-		if (type != 0)
-			output.push_back(type);
-
-		// Optional instruction result ID
-		if (result != 0)
-			output.push_back(result);
+		spirv_instruction &inst = block->instructions[index];
+		if (inst.type == 0)
+		{
+			// The type is the first word after the opcode, so make room for it by moving the remaining words of this instruction back
+			block->words.insert(block->words.begin() + inst.offset + 1, type);
+			block->words[inst.offset] += 1 << spv::WordCountShift;
+		}
+		else
+		{
+			block->words[inst.offset + 1] = type;
+		}
 
-		// Write out the operands
-		output.insert(output.end(), operands.begin(), operands.end());
+		inst.type = type;
+		return *this;
 	}
 };
 
-/// <summary>
-/// A list of instructions forming a basic block in the SPIR-V module
-/// </summary>
-struct spirv_basic_block
+inline spirv_instruction_ref spirv_basic_block::add_instruction(spv::Op op, spv::Id type, spv::Id result)
 {
-	std::vector<spirv_instruction> instructions;
-
-	/// <summary>
-	/// Append another basic block the end of this one.
-	/// </summary>
-	void append(const spirv_basic_block &block)
-	{
-		instructions.insert(instructions.end(), block.instructions.begin(), block.instructions.end());
-	}
-};
+	// See https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html
+	// 0             | Opcode: The 16 high-order bits are the WordCount of the instruction. The 16 low-order bits are the opcode enumerant.
+	// 1             | Optional instruction type <id>
+	// .             | Optional instruction Result <id>
+	// .             | Operand 1 (if needed)
+	// .             | Operand 2 (if needed)
+	// ...           | ...
+	// WordCount - 1 | Operand N (N is determined by WordCount minus the 1 to 3 words used for the opcode, instruction type <id>, and instruction Result <id>).
+
+	const uint32_t offset = static_cast<uint32_t>(words.size());
+	const uint32_t num_words = 1 + (type != 0) + (result != 0);
+	words.push_back((num_words << spv::WordCountShift) | op);
+
+	// Optional instruction type ID
+	if (type != 0)
+		words.push_back(type);
+
+	// Optional instruction result ID
+	if (result != 0)
+		words.push_back(result);
+
+	instructions.push_back({ op, type, result, offset });
+
+	return { this, instructions.size() - 1, result };
+}
 
 class codegen_spirv final : public codegen
 {
 public:
-	codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
-		: _debug_info(debug_info), _vulkan_semantics(vulkan_semantics), _uniforms_to_spec_constants(uniforms_to_spec_constants), _enable_16bit_types(enable_16bit_types), _flip_vert_y(flip_vert_y)
+	codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool eliminate_dead_code, bool optimize)
+		: _debug_info(debug_info), _vulkan_semantics(vulkan_semantics), _uniforms_to_spec_constants(uniforms_to_spec_constants), _enable_16bit_types(enable_16bit_types), _flip_vert_y(flip_vert_y), _optimize(optimize)
 	{
+		_eliminate_dead_code = eliminate_dead_code;
+
 		_glsl_ext = make_id();
 	}
 
 private:
+	static size_t hash_combine(size_t seed, size_t value)
+	{
+		return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+	static size_t hash_type(const type &info)
+	{
+		// Only hash the fields that are compared by the equality operator of the type, so that equal types end up with the same hash
+		size_t hash = info.base;
+		hash = hash_combine(hash, info.rows);
+		hash = hash_combine(hash, info.cols);
+		hash = hash_combine(hash, static_cast<size_t>(info.array_length));
+		hash = hash_combine(hash, info.definition);
+		return hash;
+	}
+
 	struct type_lookup
 	{
 		reshadefx::type type;
@@ -134,16 +270,54 @@ private:
 		{
 			return lhs.type == rhs.type && lhs.is_ptr == rhs.is_ptr && lhs.array_stride == rhs.array_stride && lhs.storage == rhs.storage;
 		}
+
+		struct hash
+		{
+			size_t operator()(const type_lookup &lookup) const
+			{
+				size_t hash = hash_type(lookup.type);
+				hash = hash_combine(hash, lookup.is_ptr);
+				hash = hash_combine(hash, lookup.array_stride);
+				hash = hash_combine(hash, lookup.storage);
+				return hash;
+			}
+		};
 	};
-	struct function_blocks
+	struct constant_lookup
+	{
+		reshadefx::type type;
+		reshadefx::constant data;
+
+		friend bool operator==(const constant_lookup &lhs, const constant_lookup &rhs)
+		{
+			if (!(lhs.type == rhs.type && std::memcmp(lhs.data.as_uint, rhs.data.as_uint, sizeof(lhs.data.as_uint)) == 0 && lhs.data.array_data.size() == rhs.data.array_data.size()))
+				return false;
+			for (size_t i = 0; i < lhs.data.array_data.size(); ++i)
+				if (std::memcmp(lhs.data.array_data[i].as_uint, rhs.data.array_data[i].as_uint, sizeof(lhs.data.as_uint)) != 0)
+					return false;
+			return true;
+		}
+
+		struct hash
+		{
+			size_t operator()(const constant_lookup &lookup) const
+			{
+				size_t hash = hash_type(lookup.type);
+				for (const uint32_t value : lookup.data.as_uint)
+					hash = hash_combine(hash, value);
+				for (const constant &element : lookup.data.array_data)
+					for (const uint32_t value : element.as_uint)
+						hash = hash_combine(hash, value);
+				return hash;
+			}
+		};
+	};
+	struct function_type_lookup
 	{
-		spirv_basic_block declaration;
-		spirv_basic_block variables;
-		spirv_basic_block definition;
 		type return_type;
 		std::vector<type> param_types;
 
-		friend bool operator==(const function_blocks &lhs, const function_blocks &rhs)
+		friend bool operator==(const function_type_lookup &lhs, const function_type_lookup &rhs)
 		{
 			if (lhs.param_types.size() != rhs.param_types.size())
 				return false;
@@ -152,6 +326,26 @@ private:
 					return false;
 			return lhs.return_type == rhs.return_type;
 		}
+
+		struct hash
+		{
+			size_t operator()(const function_type_lookup &lookup) const
+			{
+				size_t hash = hash_type(lookup.return_type);
+				for (const type &param_type : lookup.param_types)
+					hash = hash_combine(hash, hash_type(param_type));
+				return hash;
+			}
+		};
+	};
+	struct function_blocks
+	{
+		spirv_basic_block declaration;
+		spirv_basic_block variables;
+		spirv_basic_block definition;
+		type return_type;
+		std::vector<type> param_types;
+		spv::Id result = 0;
 	};
 
 	spirv_basic_block _entries;
@@ -164,12 +358,14 @@ private:
 
 	std::unordered_set<spv::Id> _spec_constants;
 	std::unordered_set<spv::Capability> _capabilities;
-	std::vector<std::pair<type_lookup, spv::Id>> _type_lookup;
-	std::vector<std::tuple<type, constant, spv::Id>> _constant_lookup;
-	std::vector<std::pair<function_blocks, spv::Id>> _function_type_lookup;
-	std::unordered_map<std::string, spv::Id> _string_lookup;
+	std::unordered_map<type_lookup, spv::Id, type_lookup::hash> _type_lookup;
+	std::unordered_map<constant_lookup, spv::Id, constant_lookup::hash> _constant_lookup;
+	std::unordered_map<function_type_lookup, spv::Id, function_type_lookup::hash> _function_type_lookup;
+	std::unordered_map<spv::Id, size_t> _constant_instructions; // Index of the instruction defining each constant in the type and constant section
+	std::unordered_map<uint32_t, spv::Id> _string_lookup;
 	std::unordered_map<spv::Id, spv::StorageClass> _storage_lookup;
 	std::unordered_map<std::string, uint32_t> _semantic_to_location;
+	std::unordered_map<spv::Id, spv::Id> _undefined_values;
 
 	std::vector<function_blocks> _functions_blocks;
 	std::unordered_map<id, spirv_basic_block> _block_data;
@@ -180,6 +376,7 @@ private:
 	bool _uniforms_to_spec_constants = false;
 	bool _enable_16bit_types = false;
 	bool _flip_vert_y = false;
+	bool _optimize = false;
 	id _glsl_ext = 0;
 	id _global_ubo_type = 0;
 	id _global_ubo_variable = 0;
@@ -188,7 +385,7 @@ private:
 
 	inline void add_location(const location &loc, spirv_basic_block &block)
 	{
-		if (loc.source.empty() || !_debug_info)
+		if (loc.source == 0 || !_debug_info)
 			return;
 
 		spv::Id file;
@@ -200,7 +397,7 @@ private:
 		else
 		{
 			add_instruction(spv::OpString, 0, _debug_a, file)
-				.add_string(loc.source.c_str());
+				.add_string(loc.source_name().c_str());
 			_string_lookup.emplace(loc.source, file);
 		}
 
@@ -210,33 +407,27 @@ private:
 			.add(loc.line)
 			.add(loc.column);
 	}
-	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type = 0)
+	inline spirv_instruction_ref add_instruction(spv::Op op, spv::Id type = 0)
 	{
 		assert(is_in_function() && is_in_block());
 		return add_instruction(op, type, *_current_block_data);
 	}
-	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block)
+	inline spirv_instruction_ref add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block)
 	{
-		spirv_instruction &instruction = add_instruction_without_result(op, block);
-		instruction.type = type;
-		instruction.result = make_id();
-		return instruction;
+		return block.add_instruction(op, type, make_id());
 	}
-	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block, spv::Id &result)
+	inline spirv_instruction_ref add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block, spv::Id &result)
 	{
-		spirv_instruction &instruction = add_instruction_without_result(op, block);
-		instruction.type = type;
-		instruction.result = result = make_id();
-		return instruction;
+		return block.add_instruction(op, type, result = make_id());
 	}
-	inline spirv_instruction &add_instruction_without_result(spv::Op op)
+	inline spirv_instruction_ref add_instruction_without_result(spv::Op op)
 	{
 		assert(is_in_function() && is_in_block());
 		return add_instruction_without_result(op, *_current_block_data);
 	}
-	inline spirv_instruction &add_instruction_without_result(spv::Op op, spirv_basic_block &block)
+	inline spirv_instruction_ref add_instruction_without_result(spv::Op op, spirv_basic_block &block)
 	{
-		return block.instructions.emplace_back(op);
+		return block.add_instruction(op, 0, 0);
 	}
 
 	void write_result(module &module) override
@@ -244,100 +435,929 @@ private:
 		// First initialize the UBO type now that all member types are known
 		if (_global_ubo_type != 0)
 		{
-			spirv_instruction &type_inst = add_instruction_without_result(spv::OpTypeStruct, _types_and_constants);
-			type_inst.add(_global_ubo_types.begin(), _global_ubo_types.end());
-			type_inst.result = _global_ubo_type;
+			_types_and_constants.add_instruction(spv::OpTypeStruct, 0, _global_ubo_type)
+				.add(_global_ubo_types.begin(), _global_ubo_types.end());
 
-			spirv_instruction &variable_inst = add_instruction_without_result(spv::OpVariable, _variables);
-			variable_inst.add(spv::StorageClassUniform);
-			variable_inst.type = convert_type({ type::t_struct, 0, 0, type::q_uniform, 0, _global_ubo_type }, true, spv::StorageClassUniform);
-			variable_inst.result = _global_ubo_variable;
+			const spv::Id variable_type = convert_type({ type::t_struct, 0, 0, type::q_uniform, 0, _global_ubo_type }, true, spv::StorageClassUniform);
+			_variables.add_instruction(spv::OpVariable, variable_type, _global_ubo_variable)
+				.add(spv::StorageClassUniform);
 
-			add_name(variable_inst.result, "$Globals");
+			add_name(_global_ubo_variable, "$Globals");
 		}
 
+		mark_referenced_resources();
+
+		if (_optimize)
+			optimize();
+
 		module = std::move(_module);
 
-		// Write SPIRV header info
-		module.spirv.push_back(spv::MagicNumber);
-		module.spirv.push_back(0x10300); // Force SPIR-V 1.3
-		module.spirv.push_back(0u); // Generator magic number, see https://www.khronos.org/registry/spir-v/api/spir-v.xml
-		module.spirv.push_back(_next_id); // Maximum ID
-		module.spirv.push_back(0u); // Reserved for instruction schema
+		if (!_eliminate_dead_code)
+		{
+			write_module(module.spirv, nullptr);
+			return;
+		}
+
+		// Every entry point gets its own module with only the definitions it references
+		for (entry_point &entry_point : module.entry_points)
+			write_module(entry_point.spirv, &_entry_point_references.at(entry_point.name));
+
+		write_module(module.spirv, &_referenced_definitions);
+	}
+	void write_module(std::vector<uint32_t> &spirv, const std::unordered_set<id> *references) const
+	{
+		// Collect the IDs of all functions and global variables that are not in the specified set of references, as well as anything defined inside those functions
+		std::unordered_set<spv::Id> removed_ids;
+		if (references != nullptr)
+		{
+			for (const auto &function : _functions_blocks)
+			{
+				if (references->find(function.result) != references->end())
+					continue;
+
+				for (const spirv_basic_block *block : { &function.declaration, &function.variables, &function.definition })
+					for (const auto &node : block->instructions)
+						if (node.result != 0)
+							removed_ids.insert(node.result);
+			}
+
+			for (const auto &node : _variables.instructions)
+			{
+				if (node.op != spv::OpVariable || references->find(node.result) != references->end())
+					continue;
+
+				// Only global variables, samplers and storages are known to the parser, everything else (like the uniform buffer or inputs and outputs) is kept
+				if (const spv::StorageClass storage = static_cast<spv::StorageClass>(_variables.operands(node)[0]);
+					storage == spv::StorageClassPrivate || storage == spv::StorageClassWorkgroup || storage == spv::StorageClassUniformConstant)
+					removed_ids.insert(node.result);
+			}
+
+			// Entry points whose function was removed are dropped, together with their input and output variables
+			for (const auto &node : _entries.instructions)
+			{
+				const spv::Id *const operands = _entries.operands(node);
+				if (removed_ids.find(operands[1]) == removed_ids.end())
+					continue;
+
+				// The interface variables follow after the entry point name string
+				const size_t name_length = std::strlen(reinterpret_cast<const char *>(&operands[2]));
+				removed_ids.insert(operands + 2 + (name_length + 4) / 4, operands + _entries.num_operands(node));
+			}
+		}
+
+		// Names, decorations and execution modes are targeting the ID in their first operand, entry points the ID in their second operand
+		const auto is_removed = [&removed_ids](const spirv_basic_block &block, const spirv_instruction &node) {
+			if (removed_ids.find(node.result) != removed_ids.end())
+				return true;
+			switch (node.op)
+			{
+			case spv::OpName:
+			case spv::OpDecorate:
+			case spv::OpExecutionMode:
+				return removed_ids.find(block.operands(node)[0]) != removed_ids.end();
+			case spv::OpEntryPoint:
+				return removed_ids.find(block.operands(node)[1]) != removed_ids.end();
+			default:
+				return false;
+			}
+		};
+		// Sections that nothing was removed from are copied as a whole
+		const auto write_block = [&](const spirv_basic_block &block) {
+			if (removed_ids.empty())
+				return block.write(spirv);
+			for (size_t i = 0; i < block.instructions.size(); ++i)
+				if (!is_removed(block, block.instructions[i]))
+					block.write(spirv, i, 1);
+		};
+
+		spirv_basic_block header;
 
 		// All capabilities
-		spirv_instruction(spv::OpCapability)
-			.add(spv::CapabilityShader) // Implicitly declares the Matrix capability too
-			.write(module.spirv);
+		header.add_instruction(spv::OpCapability, 0, 0)
+			.add(spv::CapabilityShader); // Implicitly declares the Matrix capability too
 
 		for (spv::Capability capability : _capabilities)
-			spirv_instruction(spv::OpCapability)
-				.add(capability)
-				.write(module.spirv);
+			header.add_instruction(spv::OpCapability, 0, 0)
+				.add(capability);
 
 		// Optional extension instructions
-		spirv_instruction(spv::OpExtInstImport, _glsl_ext)
-			.add_string("GLSL.std.450") // Import GLSL extension
-			.write(module.spirv);
+		header.add_instruction(spv::OpExtInstImport, 0, _glsl_ext)
+			.add_string("GLSL.std.450"); // Import GLSL extension
 
 		// Single required memory model instruction
-		spirv_instruction(spv::OpMemoryModel)
+		header.add_instruction(spv::OpMemoryModel, 0, 0)
 			.add(spv::AddressingModelLogical)
-			.add(spv::MemoryModelGLSL450)
-			.write(module.spirv);
+			.add(spv::MemoryModelGLSL450);
+
+		spirv_basic_block source;
+		source.add_instruction(spv::OpSource, 0, 0)
+			.add(spv::SourceLanguageUnknown) // ReShade FX is not a reserved token at the moment
+			.add(0); // Language version, TODO: Maybe fill in ReShade version here?
+
+		// Reserve space for the whole module up front, so that it is not reallocated while the sections are appended
+		size_t num_words = 5 + header.words.size() + source.words.size();
+		for (const spirv_basic_block *block : { &_entries, &_execution_modes, &_debug_a, &_debug_b, &_annotations, &_types_and_constants, &_variables })
+			num_words += block->words.size();
+		for (const auto &function : _functions_blocks)
+			num_words += function.declaration.words.size() + function.variables.words.size() + function.definition.words.size();
+		spirv.reserve(spirv.size() + num_words);
+
+		// Write SPIRV header info
+		spirv.push_back(spv::MagicNumber);
+		spirv.push_back(0x10300); // Force SPIR-V 1.3
+		spirv.push_back(0u); // Generator magic number, see https://www.khronos.org/registry/spir-v/api/spir-v.xml
+		spirv.push_back(_next_id); // Maximum ID
+		spirv.push_back(0u); // Reserved for instruction schema
+
+		header.write(spirv);
 
 		// All entry point declarations
-		for (const auto &node : _entries.instructions)
-			node.write(module.spirv);
+		write_block(_entries);
 
 		// All execution mode declarations
-		for (const auto &node : _execution_modes.instructions)
-			node.write(module.spirv);
+		write_block(_execution_modes);
 
-		spirv_instruction(spv::OpSource)
-			.add(spv::SourceLanguageUnknown) // ReShade FX is not a reserved token at the moment
-			.add(0) // Language version, TODO: Maybe fill in ReShade version here?
-			.write(module.spirv);
+		source.write(spirv);
 
 		if (_debug_info)
 		{
 			// All debug instructions
-			for (const auto &node : _debug_a.instructions)
-				node.write(module.spirv);
-			for (const auto &node : _debug_b.instructions)
-				node.write(module.spirv);
+			_debug_a.write(spirv);
+			write_block(_debug_b);
 		}
 
 		// All annotation instructions
-		for (const auto &node : _annotations.instructions)
-			node.write(module.spirv);
+		write_block(_annotations);
 
 		// All type declarations
-		for (const auto &node : _types_and_constants.instructions)
-			node.write(module.spirv);
-		for (const auto &node : _variables.instructions)
-			node.write(module.spirv);
+		_types_and_constants.write(spirv);
+		write_block(_variables);
 
 		// All function definitions
 		for (const auto &function : _functions_blocks)
 		{
-			if (function.definition.instructions.empty())
+			if (function.definition.instructions.empty() || removed_ids.find(function.result) != removed_ids.end())
 				continue;
 
-			for (const auto &node : function.declaration.instructions)
-				node.write(module.spirv);
+			function.declaration.write(spirv);
 
 			// Grab first label and move it in front of variable declarations
-			function.definition.instructions.front().write(module.spirv);
+			function.definition.write(spirv, 0, 1);
 			assert(function.definition.instructions.front().op == spv::OpLabel);
 
-			for (const auto &node : function.variables.instructions)
-				node.write(module.spirv);
-			for (auto it = function.definition.instructions.begin() + 1; it != function.definition.instructions.end(); ++it)
-				it->write(module.spirv);
+			function.variables.write(spirv);
+			function.definition.write(spirv, 1);
 		}
 	}
 
+	/// <summary>
+	/// Call the specified function for every word of an instruction that holds an ID (including the result type, but not the result itself).
+	/// Most instructions only take IDs as operands, so only the ones that mix in literal numbers or strings need to be special-cased.
+	/// </summary>
+	template <typename B, typename F>
+	static void for_each_id(B &block, const spirv_instruction &inst, F callback)
+	{
+		if (inst.type != 0)
+			callback(block.words[inst.offset + 1]);
+
+		auto *const operands = block.words.data() + inst.operands_offset();
+		const uint32_t num_operands = block.num_operands(inst);
+
+		// IDs are in the range ['begin', 'end') and then again from 'rest' to the last operand
+		uint32_t begin = 0, end = num_operands, rest = num_operands;
+
+		switch (inst.op)
+		{
+		case spv::OpCapability:
+		case spv::OpExtInstImport:
+		case spv::OpMemoryModel:
+		case spv::OpSource:
+		case spv::OpString:
+		case spv::OpTypeVoid:
+		case spv::OpTypeBool:
+		case spv::OpTypeInt:
+		case spv::OpTypeFloat:
+		case spv::OpConstant:
+		case spv::OpConstantTrue:
+		case spv::OpConstantFalse:
+		case spv::OpSpecConstant:
+		case spv::OpSpecConstantTrue:
+		case spv::OpSpecConstantFalse:
+			end = 0;
+			break;
+		case spv::OpName:
+		case spv::OpMemberName:
+		case spv::OpDecorate:
+		case spv::OpMemberDecorate:
+		case spv::OpExecutionMode:
+		case spv::OpLine:
+		case spv::OpTypeVector:
+		case spv::OpTypeMatrix:
+		case spv::OpTypeImage:
+		case spv::OpLoad:
+		case spv::OpCompositeExtract:
+		case spv::OpSelectionMerge:
+			end = 1;
+			break;
+		case spv::OpStore:
+		case spv::OpCompositeInsert:
+		case spv::OpVectorShuffle:
+		case spv::OpLoopMerge:
+			end = 2;
+			break;
+		case spv::OpBranchConditional:
+			end = 3;
+			break;
+		case spv::OpTypePointer:
+		case spv::OpVariable:
+		case spv::OpFunction:
+			begin = 1;
+			break;
+		case spv::OpExtInst:
+			end = 1, rest = 2; // Skip the instruction number in the extended instruction set
+			break;
+		case spv::OpImageSampleImplicitLod:
+		case spv::OpImageSampleExplicitLod:
+		case spv::OpImageFetch:
+		case spv::OpImageRead:
+			end = 2, rest = 3; // Skip the image operands mask
+			break;
+		case spv::OpImageGather:
+		case spv::OpImageWrite:
+			end = 3, rest = 4;
+			break;
+		case spv::OpEntryPoint:
+			// The interface variables follow after the entry point name string
+			begin = 1, end = 2, rest = 2 + static_cast<uint32_t>(std::strlen(reinterpret_cast<const char *>(&operands[2])) + 4) / 4;
+			break;
+		case spv::OpSwitch:
+			// The selector and default label are followed by pairs of a literal and a label
+			end = 2;
+			for (uint32_t i = 3; i < num_operands; i += 2)
+				callback(operands[i]);
+			break;
+		default:
+			break;
+		}
+
+		for (uint32_t i = begin; i < std::min(end, num_operands); ++i)
+			callback(operands[i]);
+		for (uint32_t i = rest; i < num_operands; ++i)
+			callback(operands[i]);
+	}
+
+	/// <summary>
+	/// Follow the chain of replacements for the specified ID to the ID that is used in its place now.
+	/// </summary>
+	static spv::Id resolve_id(const std::unordered_map<spv::Id, spv::Id> &replacements, spv::Id value)
+	{
+		for (auto it = replacements.find(value); it != replacements.end(); it = replacements.find(value))
+			value = it->second;
+		return value;
+	}
+	static void apply_replacements(spirv_basic_block &block, const std::unordered_map<spv::Id, spv::Id> &replacements)
+	{
+		if (replacements.empty())
+			return;
+
+		for (const spirv_instruction &inst : block.instructions)
+			for_each_id(block, inst, [&replacements](spv::Id &operand) { operand = resolve_id(replacements, operand); });
+	}
+
+	void optimize()
+	{
+		// IDs that were replaced by another ID during optimization
+		std::unordered_map<spv::Id, spv::Id> replacements;
+		// IDs of all definitions that were removed, so that names and decorations targeting them can be removed as well
+		std::unordered_set<spv::Id> removed_ids;
+
+		remove_unreachable_functions(removed_ids);
+		deduplicate_types_and_constants(replacements, removed_ids);
+
+		std::unordered_map<spv::Id, spv::Id> pointee_types;
+		for (const spirv_instruction &inst : _types_and_constants.instructions)
+			if (inst.op == spv::OpTypePointer)
+				pointee_types.emplace(inst.result, _types_and_constants.operands(inst)[1]);
+
+		for (function_blocks &function : _functions_blocks)
+		{
+			if (function.definition.instructions.empty())
+				continue;
+
+			promote_local_variables(function, pointee_types, replacements, removed_ids);
+		}
+
+		apply_replacements(_variables, replacements);
+		for (function_blocks &function : _functions_blocks)
+			apply_replacements(function.declaration, replacements);
+
+		remove_dead_instructions(removed_ids);
+
+		// Finally drop names and decorations of everything that was removed
+		const auto filter_targets = [&removed_ids, &replacements](const spirv_basic_block &block) {
+			spirv_basic_block filtered;
+			for (size_t i = 0; i < block.instructions.size(); ++i)
+				if (const spv::Id target = block.operands(block.instructions[i])[0];
+					removed_ids.find(target) == removed_ids.end() && replacements.find(target) == replacements.end())
+					filtered.append(block, i, 1);
+			return filtered;
+		};
+
+		_debug_b = filter_targets(_debug_b);
+		_annotations = filter_targets(_annotations);
+	}
+
+	void remove_unreachable_functions(std::unordered_set<spv::Id> &removed_ids)
+	{
+		std::unordered_map<spv::Id, function_blocks *> functions;
+		for (function_blocks &function : _functions_blocks)
+			functions.emplace(function.result, &function);
+
+		// Walk the call graph starting at the entry points
+		std::vector<spv::Id> worklist;
+		for (const spirv_instruction &inst : _entries.instructions)
+			worklist.push_back(_entries.operands(inst)[1]);
+
+		std::unordered_set<spv::Id> reachable;
+		while (!worklist.empty())
+		{
+			const spv::Id function = worklist.back();
+			worklist.pop_back();
+
+			if (!reachable.insert(function).second)
+				continue;
+
+			const spirv_basic_block &definition = functions.at(function)->definition;
+			for (const spirv_instruction &inst : definition.instructions)
+				if (inst.op == spv::OpFunctionCall)
+					worklist.push_back(definition.operands(inst)[0]);
+		}
+
+		for (function_blocks &function : _functions_blocks)
+		{
+			if (reachable.find(function.result) != reachable.end())
+				continue;
+
+			for (spirv_basic_block *block : { &function.declaration, &function.variables, &function.definition })
+			{
+				for (const spirv_instruction &inst : block->instructions)
+					if (inst.result != 0)
+						removed_ids.insert(inst.result);
+
+				*block = spirv_basic_block();
+			}
+		}
+	}
+
+	void deduplicate_types_and_constants(std::unordered_map<spv::Id, spv::Id> &replacements, std::unordered_set<spv::Id> &removed_ids)
+	{
+		// Decorated definitions are distinct even if their instructions are identical (e.g. arrays with and without a stride)
+		std::unordered_set<spv::Id> decorated;
+		for (const spirv_instruction &inst : _annotations.instructions)
+			decorated.insert(_annotations.operands(inst)[0]);
+
+		std::unordered_map<std::string, spv::Id> definitions;
+		spirv_basic_block deduplicated;
+
+		for (size_t i = 0; i < _types_and_constants.instructions.size(); ++i)
+		{
+			const spirv_instruction &inst = _types_and_constants.instructions[i];
+
+			// Definitions always come before their uses in this section, so any replaced operand was already seen
+			for_each_id(_types_and_constants, inst, [&replacements](spv::Id &operand) { operand = resolve_id(replacements, operand); });
+
+			switch (inst.op)
+			{
+			case spv::OpTypeStruct: // Structures may be decorated through their members
+			case spv::OpSpecConstant:
+			case spv::OpSpecConstantTrue:
+			case spv::OpSpecConstantFalse:
+			case spv::OpSpecConstantComposite:
+				deduplicated.append(_types_and_constants, i, 1);
+				continue;
+			default:
+				break;
+			}
+
+			if (inst.result == 0 || decorated.find(inst.result) != decorated.end())
+			{
+				deduplicated.append(_types_and_constants, i, 1);
+				continue;
+			}
+
+			// The key is the whole instruction without its result ID
+			const uint32_t *const words = _types_and_constants.words.data() + inst.offset;
+			const uint32_t result_index = 1 + (inst.type != 0);
+			std::string key(reinterpret_cast<const char *>(words), result_index * sizeof(uint32_t));
+			key.append(reinterpret_cast<const char *>(words + result_index + 1), ((words[0] >> spv::WordCountShift) - result_index - 1) * sizeof(uint32_t));
+
+			if (const auto insert = definitions.emplace(std::move(key), inst.result); !insert.second)
+			{
+				replacements[inst.result] = insert.first->second;
+				removed_ids.insert(inst.result);
+				continue;
+			}
+
+			deduplicated.append(_types_and_constants, i, 1);
+		}
+
+		_types_and_constants = std::move(deduplicated);
+	}
+
+	void promote_local_variables(function_blocks &function, const std::unordered_map<spv::Id, spv::Id> &pointee_types, std::unordered_map<spv::Id, spv::Id> &replacements, std::unordered_set<spv::Id> &removed_ids)
+	{
+		spirv_basic_block &definition = function.definition;
+
+		// Split the function definition into its basic blocks
+		struct cfg_block
+		{
+			size_t begin = 0, end = 0; // Range of instructions, starting with the label and ending with the terminator
+			std::vector<size_t> predecessors, successors;
+			size_t unfilled_predecessors = 0;
+			bool sealed = false;
+			std::unordered_map<spv::Id, spv::Id> current_values;
+			std::vector<size_t> incomplete_phis;
+		};
+
+		std::vector<cfg_block> blocks;
+		std::unordered_map<spv::Id, size_t> block_lookup;
+
+		for (size_t i = 0; i < definition.instructions.size(); ++i)
+		{
+			const spirv_instruction &inst = definition.instructions[i];
+
+			switch (inst.op)
+			{
+			case spv::OpLabel:
+				block_lookup.emplace(inst.result, blocks.size());
+				blocks.emplace_back().begin = i;
+				break;
+			case spv::OpBranch:
+			case spv::OpBranchConditional:
+			case spv::OpSwitch:
+			case spv::OpReturn:
+			case spv::OpReturnValue:
+			case spv::OpKill:
+			case spv::OpUnreachable:
+				blocks.back().end = i + 1;
+				break;
+			default:
+				break;
+			}
+		}
+
+		for (size_t b = 0; b < blocks.size(); ++b)
+		{
+			const spirv_instruction &terminator = definition.instructions[blocks[b].end - 1];
+			const spv::Id *const operands = definition.operands(terminator);
+
+			std::vector<spv::Id> targets;
+			if (terminator.op == spv::OpBranch)
+				targets.push_back(operands[0]);
+			else if (terminator.op == spv::OpBranchConditional)
+				targets.insert(targets.end(), { operands[1], operands[2] });
+			else if (terminator.op == spv::OpSwitch)
+				for (uint32_t i = 1; i < definition.num_operands(terminator); i += 2)
+					targets.push_back(operands[i]);
+
+			for (const spv::Id target : targets)
+			{
+				const size_t s = block_lookup.at(target);
+				// Phi instructions take one value per predecessor block, even if that block branches to the same target multiple times
+				if (std::find(blocks[b].successors.begin(), blocks[b].successors.end(), s) != blocks[b].successors.end())
+					continue;
+				blocks[b].successors.push_back(s);
+				blocks[s].predecessors.push_back(b);
+			}
+		}
+
+		// Only variables that are solely loaded from and stored to as a whole can be promoted, any other use (like access chains or function arguments) needs the pointer
+		std::unordered_map<spv::Id, spv::Id> variables; // Variable ID -> Initial value
+		for (const spirv_instruction &inst : function.variables.instructions)
+			if (inst.op == spv::OpVariable)
+				variables.emplace(inst.result, function.variables.num_operands(inst) > 1 ? function.variables.operands(inst)[1] : 0);
+
+		for (const spirv_instruction &inst : definition.instructions)
+		{
+			const spv::Id *const pointer = (inst.op == spv::OpLoad || inst.op == spv::OpStore) ? definition.operands(inst) : nullptr;
+			for_each_id(definition, inst, [&variables, pointer](const spv::Id &operand) {
+				if (&operand != pointer)
+					variables.erase(operand);
+			});
+		}
+
+		if (variables.empty())
+			return;
+
+		std::unordered_map<spv::Id, spv::Id> variable_types;
+		for (const spirv_instruction &inst : function.variables.instructions)
+			if (variables.find(inst.result) != variables.end())
+				variable_types.emplace(inst.result, pointee_types.at(inst.type));
+
+		// Construct SSA form directly from the loads and stores, see "Simple and Efficient Construction of Static Single Assignment Form" by Braun et al.
+		struct phi_info
+		{
+			spv::Id result;
+			spv::Id variable;
+			size_t block;
+			std::vector<spv::Id> operands = {};
+			std::vector<size_t> users = {};
+			bool removed = false;
+		};
+
+		std::vector<phi_info> phis;
+		std::unordered_map<spv::Id, size_t> phi_lookup;
+
+		const auto add_phi = [&](spv::Id variable, size_t block) {
+			const spv::Id result = make_id();
+			phi_lookup.emplace(result, phis.size());
+			phis.push_back({ result, variable, block });
+			return phis.size() - 1;
+		};
+
+		std::function<spv::Id(spv::Id, size_t)> read_variable;
+
+		const std::function<spv::Id(size_t)> try_remove_trivial_phi = [&](size_t phi) -> spv::Id {
+			spv::Id same = 0;
+			for (spv::Id value : phis[phi].operands)
+			{
+				value = resolve_id(replacements, value);
+				if (value == same || value == phis[phi].result)
+					continue; // Unique value or self-reference
+				if (same != 0)
+					return phis[phi].result; // The phi merges at least two values, so it is not trivial
+				same = value;
+			}
+
+			if (same == 0) // The phi is unreachable or in the start block
+				same = undefined_value(variable_types.at(phis[phi].variable));
+
+			phis[phi].removed = true;
+			replacements[phis[phi].result] = same;
+
+			// Removing this phi may have made other phis that use it trivial too
+			const std::vector<size_t> users = phis[phi].users;
+			if (const auto it = phi_lookup.find(same); it != phi_lookup.end())
+				phis[it->second].users.insert(phis[it->second].users.end(), users.begin(), users.end());
+			for (const size_t user : users)
+				if (user != phi && !phis[user].removed)
+					try_remove_trivial_phi(user);
+
+			return same;
+		};
+		const auto add_phi_operands = [&](size_t phi) {
+			for (const size_t predecessor : blocks[phis[phi].block].predecessors)
+			{
+				const spv::Id value = resolve_id(replacements, read_variable(phis[phi].variable, predecessor));
+				phis[phi].operands.push_back(value);
+
+				if (const auto it = phi_lookup.find(value); it != phi_lookup.end())
+					phis[it->second].users.push_back(phi);
+			}
+			return try_remove_trivial_phi(phi);
+		};
+
+		read_variable = [&](spv::Id variable, size_t b) -> spv::Id {
+			// Walk up chains of single predecessors iteratively, since those can be very long
+			std::vector<size_t> visited;
+			spv::Id value = 0;
+			while (true)
+			{
+				if (const auto it = blocks[b].current_values.find(variable); it != blocks[b].current_values.end())
+				{
+					value = resolve_id(replacements, it->second);
+					break;
+				}
+
+				if (!blocks[b].sealed)
+				{
+					// Not all predecessors are known yet, so add an operandless phi that is completed when the block is sealed
+					const size_t phi = add_phi(variable, b);
+					blocks[b].incomplete_phis.push_back(phi);
+					value = phis[phi].result;
+					break;
+				}
+				if (blocks[b].predecessors.empty())
+				{
+					// Variables are initialized at the start of the function, so anything else is unreachable code
+					value = undefined_value(variable_types.at(variable));
+					break;
+				}
+				if (blocks[b].predecessors.size() == 1)
+				{
+					visited.push_back(b);
+					b = blocks[b].predecessors[0];
+					continue;
+				}
+
+				// Break potential cycles with an operandless phi first
+				const size_t phi = add_phi(variable, b);
+				blocks[b].current_values[variable] = phis[phi].result;
+				value = add_phi_operands(phi);
+				break;
+			}
+
+			blocks[b].current_values[variable] = value;
+			for (const size_t v : visited)
+				blocks[v].current_values[variable] = value;
+			return value;
+		};
+
+		// Blocks without predecessors (the start block and unreachable ones) are sealed right away, all others once all their predecessors were filled
+		for (cfg_block &block : blocks)
+		{
+			block.unfilled_predecessors = block.predecessors.size();
+			block.sealed = block.predecessors.empty();
+		}
+		for (const auto &[variable, initializer] : variables)
+			blocks[0].current_values[variable] = initializer != 0 ? initializer : undefined_value(variable_types.at(variable));
+
+		std::vector<bool> removed_instructions(definition.instructions.size());
+
+		for (size_t b = 0; b < blocks.size(); ++b)
+		{
+			for (size_t i = blocks[b].begin; i < blocks[b].end; ++i)
+			{
+				const spirv_instruction &inst = definition.instructions[i];
+				if (inst.op != spv::OpLoad && inst.op != spv::OpStore)
+					continue;
+
+				const spv::Id *const operands = definition.operands(inst);
+				if (variables.find(operands[0]) == variables.end())
+					continue;
+
+				if (inst.op == spv::OpStore)
+					blocks[b].current_values[operands[0]] = operands[1];
+				else
+					replacements[inst.result] = read_variable(operands[0], b);
+
+				removed_instructions[i] = true;
+			}
+
+			// Seal all successors whose predecessors are all filled now
+			for (const size_t s : blocks[b].successors)
+			{
+				if (--blocks[s].unfilled_predecessors != 0 || blocks[s].sealed)
+					continue;
+
+				for (const size_t phi : blocks[s].incomplete_phis)
+					add_phi_operands(phi);
+				blocks[s].sealed = true;
+			}
+		}
+
+		// Merge blocks into their only predecessor if it unconditionally branches to them and they are not the target of a structured control flow instruction
+		std::unordered_set<spv::Id> merge_targets;
+		for (const spirv_instruction &inst : definition.instructions)
+			if (inst.op == spv::OpSelectionMerge)
+				merge_targets.insert(definition.operands(inst)[0]);
+			else if (inst.op == spv::OpLoopMerge)
+				merge_targets.insert({ definition.operands(inst)[0], definition.operands(inst)[1] });
+
+		std::vector<std::vector<size_t>> block_phis(blocks.size());
+		for (size_t phi = 0; phi < phis.size(); ++phi)
+			if (!phis[phi].removed)
+				block_phis[phis[phi].block].push_back(phi);
+
+		std::vector<bool> has_phis(blocks.size()), is_header(blocks.size()), is_loop_header(blocks.size());
+		for (size_t b = 0; b < blocks.size(); ++b)
+		{
+			has_phis[b] = !block_phis[b].empty();
+			for (size_t i = blocks[b].begin; i < blocks[b].end; ++i)
+				if (definition.instructions[i].op == spv::OpPhi)
+					has_phis[b] = true;
+				else if (definition.instructions[i].op == spv::OpSelectionMerge)
+					is_header[b] = true;
+				else if (definition.instructions[i].op == spv::OpLoopMerge)
+					is_header[b] = is_loop_header[b] = true;
+		}
+
+		std::vector<size_t> merged_into_next(blocks.size(), 0); // Index of the block that was merged into this one (zero if none)
+		std::vector<bool> merged(blocks.size());
+		for (size_t b = 0; b < blocks.size(); ++b)
+		{
+			const spirv_instruction &terminator = definition.instructions[blocks[b].end - 1];
+			if (terminator.op != spv::OpBranch)
+				continue;
+
+			const size_t s = blocks[b].successors[0];
+			if (s <= b || blocks[s].predecessors.size() != 1 || has_phis[s] ||
+				merge_targets.find(definition.instructions[blocks[s].begin].result) != merge_targets.end())
+				continue;
+
+			// A loop header can absorb the block evaluating the loop condition, in which case the loop merge instruction is moved in front of its conditional branch
+			if (is_loop_header[b] && (is_header[s] || definition.instructions[blocks[s].end - 1].op != spv::OpBranchConditional))
+				continue;
+
+			merged_into_next[b] = s;
+			merged[s] = true;
+			// Phis in successors of the merged block now reference this block as their predecessor
+			replacements[definition.instructions[blocks[s].begin].result] = definition.instructions[blocks[b].begin].result;
+		}
+
+		// Rebuild the function definition without the promoted loads and stores and with the new phis at the start of their blocks
+		spirv_basic_block optimized;
+		optimized.words.reserve(definition.words.size());
+		optimized.instructions.reserve(definition.instructions.size());
+
+		for (size_t head = 0; head < blocks.size(); ++head)
+		{
+			if (merged[head])
+				continue;
+
+			size_t loop_merge = 0; // Index of the loop merge instruction of the previous block in the chain, if it was a loop header
+
+			for (size_t b = head; true; b = merged_into_next[b])
+			{
+				size_t begin = blocks[b].begin;
+				size_t end = blocks[b].end;
+
+				if (b == head)
+				{
+					optimized.append(definition, begin++, 1);
+
+					for (const size_t phi_index : block_phis[b])
+					{
+						const phi_info &phi = phis[phi_index];
+
+						spirv_instruction_ref inst = optimized.add_instruction(spv::OpPhi, variable_types.at(phi.variable), phi.result);
+						for (size_t k = 0; k < phi.operands.size(); ++k)
+							inst.add(phi.operands[k]).add(definition.instructions[blocks[blocks[b].predecessors[k]].begin].result);
+					}
+				}
+				else
+				{
+					begin++; // Skip label of merged block
+				}
+
+				if (merged_into_next[b] != 0)
+					end--; // Skip branch into merged block
+
+				const size_t prev_loop_merge = loop_merge;
+				loop_merge = 0;
+				if (merged_into_next[b] != 0 && is_loop_header[b])
+				{
+					loop_merge = --end;
+					assert(definition.instructions[loop_merge].op == spv::OpLoopMerge);
+				}
+
+				for (size_t i = begin; i < end; ++i)
+				{
+					if (removed_instructions[i])
+						continue;
+					if (prev_loop_merge != 0 && i == end - 1)
+						optimized.append(definition, prev_loop_merge, 1);
+					optimized.append(definition, i, 1);
+				}
+
+				if (merged_into_next[b] == 0)
+					break;
+			}
+		}
+
+		// Add function end instruction
+		optimized.append(definition, definition.instructions.size() - 1, 1);
+		assert(definition.instructions.back().op == spv::OpFunctionEnd);
+
+		apply_replacements(optimized, replacements);
+		definition = std::move(optimized);
+
+		spirv_basic_block variables_block;
+		for (size_t i = 0; i < function.variables.instructions.size(); ++i)
+			if (const spv::Id result = function.variables.instructions[i].result;
+				variables.find(result) == variables.end())
+				variables_block.append(function.variables, i, 1);
+			else
+				removed_ids.insert(result);
+		apply_replacements(variables_block, replacements);
+		function.variables = std::move(variables_block);
+	}
+
+	void remove_dead_instructions(std::unordered_set<spv::Id> &removed_ids)
+	{
+		struct definition_info
+		{
+			const spirv_basic_block *block;
+			size_t index;
+			bool removable;
+			uint32_t uses;
+		};
+
+		std::unordered_map<spv::Id, definition_info> definitions;
+
+		const auto add_definitions = [&definitions](const spirv_basic_block &block) {
+			for (size_t i = 0; i < block.instructions.size(); ++i)
+			{
+				const spirv_instruction &inst = block.instructions[i];
+				if (inst.result == 0)
+					continue;
+
+				bool removable = false;
+				switch (inst.op)
+				{
+				case spv::OpVariable:
+					if (const spv::StorageClass storage = static_cast<spv::StorageClass>(block.operands(inst)[0]);
+						storage == spv::StorageClassFunction || storage == spv::StorageClassPrivate || storage == spv::StorageClassWorkgroup || storage == spv::StorageClassUniformConstant)
+						removable = true;
+					break;
+				case spv::OpLabel:
+				case spv::OpFunction:
+				case spv::OpFunctionParameter:
+				case spv::OpFunctionCall:
+				case spv::OpAtomicAnd:
+				case spv::OpAtomicCompareExchange:
+				case spv::OpAtomicExchange:
+				case spv::OpAtomicIAdd:
+				case spv::OpAtomicOr:
+				case spv::OpAtomicSMax:
+				case spv::OpAtomicSMin:
+				case spv::OpAtomicUMax:
+				case spv::OpAtomicUMin:
+				case spv::OpAtomicXor:
+				case spv::OpSpecConstant: // Specialization constants are kept for the application to set, even if not used by the code
+				case spv::OpSpecConstantTrue:
+				case spv::OpSpecConstantFalse:
+				case spv::OpSpecConstantComposite:
+					break;
+				case spv::OpExtInst:
+					// These write to the pointer passed in as last argument
+					removable = block.operands(inst)[1] != spv::GLSLstd450Modf && block.operands(inst)[1] != spv::GLSLstd450Frexp;
+					break;
+				default:
+					removable = true;
+					break;
+				}
+
+				definitions.emplace(inst.result, definition_info { &block, i, removable, 0 });
+			}
+		};
+
+		std::vector<spirv_basic_block *> blocks = { &_types_and_constants, &_variables, &_entries };
+		for (function_blocks &function : _functions_blocks)
+			blocks.insert(blocks.end(), { &function.declaration, &function.variables, &function.definition });
+
+		add_definitions(_types_and_constants);
+		add_definitions(_variables);
+		for (function_blocks &function : _functions_blocks)
+		{
+			add_definitions(function.variables);
+			add_definitions(function.definition);
+		}
+
+		for (const spirv_basic_block *block : blocks)
+			for (const spirv_instruction &inst : block->instructions)
+				for_each_id(*block, inst, [&definitions](const spv::Id &operand) {
+					if (const auto it = definitions.find(operand); it != definitions.end())
+						it->second.uses++;
+				});
+
+		// Removing an instruction may make the definitions of its operands unused too
+		std::vector<spv::Id> worklist;
+		for (const auto &[result, info] : definitions)
+			if (info.removable && info.uses == 0)
+				worklist.push_back(result);
+
+		std::unordered_set<spv::Id> dead_ids;
+		while (!worklist.empty())
+		{
+			const spv::Id result = worklist.back();
+			worklist.pop_back();
+
+			const definition_info &info = definitions.at(result);
+			dead_ids.insert(result);
+
+			for_each_id(*info.block, info.block->instructions[info.index], [&definitions, &worklist](const spv::Id &operand) {
+				if (const auto it = definitions.find(operand); it != definitions.end() && --it->second.uses == 0 && it->second.removable)
+					worklist.push_back(operand);
+			});
+		}
+
+		if (dead_ids.empty())
+			return;
+
+		for (spirv_basic_block *block : blocks)
+		{
+			spirv_basic_block filtered;
+			for (size_t i = 0; i < block->instructions.size(); ++i)
+				if (dead_ids.find(block->instructions[i].result) == dead_ids.end())
+					filtered.append(*block, i, 1);
+			*block = std::move(filtered);
+		}
+
+		removed_ids.insert(dead_ids.begin(), dead_ids.end());
+	}
+
+	spv::Id undefined_value(spv::Id type)
+	{
+		if (const auto it = _undefined_values.find(type);
+			it != _undefined_values.end())
+			return it->second;
+
+		const spv::Id result = add_instruction(spv::OpUndef, type, _types_and_constants).result;
+		_undefined_values.emplace(type, result);
+		return result;
+	}
+
 	spv::Id convert_type(type info, bool is_ptr = false, spv::StorageClass storage = spv::StorageClassFunction, uint32_t array_stride = 0)
 	{
 		assert(array_stride == 0 || info.is_array());
@@ -354,8 +1374,8 @@ private:
 			info.base = static_cast<type::datatype>(info.base + 1); // min16int -> int, min16uint -> uint, min16float -> float
 
 		const type_lookup lookup = { info, is_ptr, array_stride, storage };
-		if (const auto it = std::find_if(_type_lookup.begin(), _type_lookup.end(),
-			[&lookup](const auto &lookup_it) { return lookup_it.first == lookup; }); it != _type_lookup.end())
+		if (const auto it = _type_lookup.find(lookup);
+			it != _type_lookup.end())
 			return it->second;
 
 		spv::Id type, elem_type;
@@ -499,14 +1519,15 @@ private:
 			}
 		}
 
-		_type_lookup.push_back({ lookup, type });
+		_type_lookup.emplace(lookup, type);
 
 		return type;
 	}
 	spv::Id convert_type(const function_blocks &info)
 	{
-		if (auto it = std::find_if(_function_type_lookup.begin(), _function_type_lookup.end(),
-			[&info](const auto &lookup) { return lookup.first == info; }); it != _function_type_lookup.end())
+		function_type_lookup lookup = { info.return_type, info.param_types };
+		if (const auto it = _function_type_lookup.find(lookup);
+			it != _function_type_lookup.end())
 			return it->second;
 
 		auto return_type = convert_type(info.return_type);
@@ -517,11 +1538,11 @@ private:
 		for (const type &param_type : info.param_types)
 			param_type_ids.push_back(convert_type(param_type, true));
 
-		spirv_instruction &inst = add_instruction(spv::OpTypeFunction, 0, _types_and_constants);
+		spirv_instruction_ref inst = add_instruction(spv::OpTypeFunction, 0, _types_and_constants);
 		inst.add(return_type);
 		inst.add(param_type_ids.begin(), param_type_ids.end());
 
-		_function_type_lookup.push_back({ info, inst.result });;
+		_function_type_lookup.emplace(std::move(lookup), inst.result);
 
 		return inst.result;
 	}
@@ -727,7 +1748,8 @@ private:
 				_module.spec_constants.push_back(scalar_info);
 			};
 
-			const spirv_instruction &base_inst = _types_and_constants.instructions.back();
+			const spirv_basic_block &block = _types_and_constants;
+			const spirv_instruction &base_inst = block.instructions.back();
 			assert(base_inst.result == res);
 
 			// External specialization constants need to be scalars
@@ -740,24 +1762,22 @@ private:
 				assert(base_inst.op == spv::OpSpecConstantComposite);
 
 				// Add each individual scalar component of the constant as a separate external specialization constant
-				for (size_t i = 0; i < (info.type.is_array() ? base_inst.operands.size() : 1); ++i)
+				for (size_t i = 0; i < (info.type.is_array() ? block.num_operands(base_inst) : 1); ++i)
 				{
 					constant initializer_value = info.initializer_value;
 					spirv_instruction elem_inst = base_inst;
 
 					if (info.type.is_array())
 					{
-						elem_inst = *std::find_if(_types_and_constants.instructions.rbegin(), _types_and_constants.instructions.rend(),
-							[elem = base_inst.operands[i]](const auto &it) { return it.result == elem; });
+						elem_inst = block.instructions[_constant_instructions.at(block.operands(base_inst)[i])];
 
-						assert(initializer_value.array_data.size() == base_inst.operands.size());
+						assert(initializer_value.array_data.size() == block.num_operands(base_inst));
 						initializer_value = initializer_value.array_data[i];
 					}
 
-					for (size_t row = 0; row < elem_inst.operands.size(); ++row)
+					for (size_t row = 0; row < block.num_operands(elem_inst); ++row)
 					{
-						const spirv_instruction &row_inst = *std::find_if(_types_and_constants.instructions.rbegin(), _types_and_constants.instructions.rend(),
-							[elem = elem_inst.operands[row]](const auto &it) { return it.result == elem; });
+						const spirv_instruction &row_inst = block.instructions[_constant_instructions.at(block.operands(elem_inst)[row])];
 
 						if (row_inst.op != spv::OpSpecConstantComposite)
 						{
@@ -765,10 +1785,9 @@ private:
 							continue;
 						}
 
-						for (size_t col = 0; col < row_inst.operands.size(); ++col)
+						for (size_t col = 0; col < block.num_operands(row_inst); ++col)
 						{
-							const spirv_instruction &col_inst = *std::find_if(_types_and_constants.instructions.rbegin(), _types_and_constants.instructions.rend(),
-								[elem = row_inst.operands[col]](const auto &it) { return it.result == elem; });
+							const spirv_instruction &col_inst = block.instructions[_constant_instructions.at(block.operands(row_inst)[col])];
 
 							add_spec_constant(col_inst, info, initializer_value, row * info.type.cols + col);
 						}
@@ -867,7 +1886,7 @@ private:
 
 		spv::Id res;
 		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpVariable
-		spirv_instruction &inst = add_instruction(spv::OpVariable, convert_type(type, true, storage), block, res)
+		spirv_instruction_ref inst = add_instruction(spv::OpVariable, convert_type(type, true, storage), block, res)
 			.add(storage);
 
 		if (initializer_value != 0)
@@ -915,6 +1934,8 @@ private:
 			.add(spv::FunctionControlMaskNone)
 			.add(convert_type(function));
 
+		function.result = info.definition;
+
 		if (!info.name.empty())
 			add_name(info.definition, info.name.c_str());
 
@@ -958,6 +1979,9 @@ private:
 		define_function({}, entry_point);
 		enter_block(create_block());
 
+		// The generated function is not known to the parser, so add it to the references of the entry point here
+		func.referenced_functions.insert(entry_point.definition);
+
 		const auto create_varying_param = [this, &call_params](const struct_member_info &param) {
 			const spv::Id variable = define_variable({}, param.type, nullptr, spv::StorageClassFunction);
 
@@ -1268,7 +2292,7 @@ private:
 				it != _storage_lookup.end())
 				storage = it->second;
 
-			spirv_instruction *access_chain = nullptr;
+			spirv_instruction_ref access_chain;
 
 			// Check if this is a uniform variable (see 'define_uniform' function above) and dereference it
 			if (result & 0xF0000000)
@@ -1281,7 +2305,7 @@ private:
 				if (is_uniform_bool)
 					base_type.base = type::t_uint;
 
-				access_chain = &add_instruction(spv::OpAccessChain)
+				access_chain = add_instruction(spv::OpAccessChain)
 					.add(_global_ubo_variable)
 					.add(emit_constant(member_index));
 			}
@@ -1296,8 +2320,8 @@ private:
 				assert(_current_block_data != &_types_and_constants);
 
 				// Use access chain from uniform if possible, otherwise create new one
-				if (access_chain == nullptr) access_chain =
-					&add_instruction(spv::OpAccessChain).add(result); // Base
+				if (access_chain.block == nullptr) access_chain =
+					add_instruction(spv::OpAccessChain).add(result); // Base
 
 				// Ignore first index into 1xN matrices, since they were translated to a vector type in SPIR-V
 				if (exp.chain[0].from.rows == 1 && exp.chain[0].from.cols > 1)
@@ -1307,18 +2331,18 @@ private:
 					exp.chain[i].op == expression::operation::op_member ||
 					exp.chain[i].op == expression::operation::op_dynamic_index ||
 					exp.chain[i].op == expression::operation::op_constant_index); ++i)
-					access_chain->add(exp.chain[i].op == expression::operation::op_dynamic_index ?
+					access_chain.add(exp.chain[i].op == expression::operation::op_dynamic_index ?
 						exp.chain[i].index :
 						emit_constant(exp.chain[i].index)); // Indexes
 
 				base_type = exp.chain[i - 1].to;
-				access_chain->type = convert_type(base_type, true, storage); // Last type is the result
-				result = access_chain->result;
+				access_chain.set_type(convert_type(base_type, true, storage)); // Last type is the result
+				result = access_chain.result;
 			}
-			else if (access_chain != nullptr)
+			else if (access_chain.block != nullptr)
 			{
-				access_chain->type = convert_type(base_type, true, storage, base_type.is_array() ? 16u : 0u);
-				result = access_chain->result;
+				access_chain.set_type(convert_type(base_type, true, storage, base_type.is_array() ? 16u : 0u));
+				result = access_chain.result;
 			}
 
 			result = add_instruction(spv::OpLoad, convert_type(base_type))
@@ -1445,7 +2469,7 @@ private:
 							scalar_type.rows = 1;
 							scalar_type.cols = 1;
 
-							spirv_instruction &node = add_instruction(spv::OpCompositeExtract, convert_type(scalar_type))
+							spirv_instruction_ref node = add_instruction(spv::OpCompositeExtract, convert_type(scalar_type))
 								.add(result);
 
 							if (op.from.rows > 1) // Matrix types with a single row are actually vectors, so they don't need the extra index
@@ -1456,7 +2480,7 @@ private:
 							components[c] = node.result;
 						}
 
-						spirv_instruction &node = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
+						spirv_instruction_ref node = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
 						for (unsigned int c = 0; c < 4 && op.swizzle[c] >= 0; ++c)
 							node.add(components[c]);
 						result = node.result;
@@ -1464,7 +2488,7 @@ private:
 					}
 					else if (op.from.is_vector())
 					{
-						spirv_instruction &node = add_instruction(spv::OpVectorShuffle, convert_type(op.to))
+						spirv_instruction_ref node = add_instruction(spv::OpVectorShuffle, convert_type(op.to))
 							.add(result) // Vector 1
 							.add(result); // Vector 2
 						for (unsigned int c = 0; c < 4 && op.swizzle[c] >= 0; ++c)
@@ -1474,7 +2498,7 @@ private:
 					}
 					else
 					{
-						spirv_instruction &node = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
+						spirv_instruction_ref node = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
 						for (unsigned int c = 0; c < op.to.rows; ++c)
 							node.add(result);
 						result = node.result;
@@ -1485,7 +2509,7 @@ private:
 				{
 					assert(op.swizzle[1] < 0);
 
-					spirv_instruction &node = add_instruction(spv::OpCompositeExtract, convert_type(op.to))
+					spirv_instruction_ref node = add_instruction(spv::OpCompositeExtract, convert_type(op.to))
 						.add(result); // Composite
 					if (op.from.rows > 1)
 					{
@@ -1542,7 +2566,7 @@ private:
 
 					if (base_type.is_vector())
 					{
-						spirv_instruction &node = add_instruction(spv::OpVectorShuffle, convert_type(base_type))
+						spirv_instruction_ref node = add_instruction(spv::OpVectorShuffle, convert_type(base_type))
 							.add(result) // Vector 1
 							.add(value); // Vector 2
 
@@ -1559,7 +2583,7 @@ private:
 					{
 						assert(op.swizzle[1] < 0);
 
-						spirv_instruction &node = add_instruction(spv::OpCompositeInsert, convert_type(base_type))
+						spirv_instruction_ref node = add_instruction(spv::OpCompositeInsert, convert_type(base_type))
 							.add(value) // Object
 							.add(result); // Composite
 
@@ -1611,8 +2635,8 @@ private:
 		// Ensure that 'access_chain' cannot get invalidated by calls to 'emit_constant' or 'convert_type'
 		assert(_current_block_data != &_types_and_constants);
 
-		spirv_instruction *access_chain =
-			&add_instruction(spv::OpAccessChain).add(exp.base); // Base
+		spirv_instruction_ref access_chain =
+			add_instruction(spv::OpAccessChain).add(exp.base); // Base
 
 		// Ignore first index into 1xN matrices, since they were translated to a vector type in SPIR-V
 		if (exp.chain[0].from.rows == 1 && exp.chain[0].from.cols > 1)
@@ -1622,12 +2646,12 @@ private:
 			exp.chain[i].op == expression::operation::op_member ||
 			exp.chain[i].op == expression::operation::op_dynamic_index ||
 			exp.chain[i].op == expression::operation::op_constant_index); ++i)
-			access_chain->add(exp.chain[i].op == expression::operation::op_dynamic_index ?
+			access_chain.add(exp.chain[i].op == expression::operation::op_dynamic_index ?
 				exp.chain[i].index :
 				emit_constant(exp.chain[i].index)); // Indexes
 
-		access_chain->type = convert_type(exp.chain[i - 1].to, true, storage); // Last type is the result
-		return access_chain->result;
+		access_chain.set_type(convert_type(exp.chain[i - 1].to, true, storage)); // Last type is the result
+		return access_chain.result;
 	}
 
 	id   emit_constant(uint32_t value)
@@ -1653,15 +2677,9 @@ private:
 	id   emit_constant(const type &type, const constant &data, bool spec_constant)
 	{
 		if (!spec_constant) // Specialization constants cannot reuse other constants
-			if (auto it = std::find_if(_constant_lookup.begin(), _constant_lookup.end(), [&type, &data](auto &x) {
-				if (!(std::get<0>(x) == type && std::memcmp(&std::get<1>(x).as_uint[0], &data.as_uint[0], sizeof(uint32_t) * 16) == 0 && std::get<1>(x).array_data.size() == data.array_data.size()))
-					return false;
-				for (size_t i = 0; i < data.array_data.size(); ++i)
-					if (std::memcmp(&std::get<1>(x).array_data[i].as_uint[0], &data.array_data[i].as_uint[0], sizeof(uint32_t) * 16) != 0)
-						return false;
-				return true;
-			}); it != _constant_lookup.end())
-				return std::get<2>(*it); // Re-use existing constant instead of duplicating the definition
+			if (const auto it = _constant_lookup.find({ type, data });
+				it != _constant_lookup.end())
+				return it->second; // Re-use existing constant instead of duplicating the definition
 
 		spv::Id result;
 		if (type.is_array())
@@ -1717,7 +2735,7 @@ private:
 			}
 			else
 			{
-				spirv_instruction &node = add_instruction(spec_constant ? spv::OpSpecConstantComposite : spv::OpConstantComposite, convert_type(type), _types_and_constants);
+				spirv_instruction_ref node = add_instruction(spec_constant ? spv::OpSpecConstantComposite : spv::OpConstantComposite, convert_type(type), _types_and_constants);
 				for (unsigned int i = 0; i < type.rows; ++i)
 					node.add(rows[i]);
 
@@ -1740,10 +2758,13 @@ private:
 				.result;
 		}
 
+		// The defining instruction is the last one added, unless this is a single row matrix, which reuses the row vector constant that was already indexed
+		_constant_instructions.emplace(result, _types_and_constants.instructions.size() - 1);
+
 		if (spec_constant) // Keep track of all specialization constants
 			_spec_constants.insert(result);
 		else
-			_constant_lookup.push_back({ type, data, result });
+			_constant_lookup.emplace(constant_lookup { type, data }, result);
 
 		return result;
 	}
@@ -1769,7 +2790,7 @@ private:
 
 		add_location(loc, *_current_block_data);
 
-		spirv_instruction &inst = add_instruction(spv_op, convert_type(type));
+		spirv_instruction_ref inst = add_instruction(spv_op, convert_type(type));
 		inst.add(val); // Operand
 
 		return inst.result;
@@ -1879,7 +2900,7 @@ private:
 					.add(row)
 					.result;
 
-				spirv_instruction &inst = add_instruction(spv_op, convert_type(vector_type));
+				spirv_instruction_ref inst = add_instruction(spv_op, convert_type(vector_type));
 				inst.add(lhs_elem); // Operand 1
 				inst.add(rhs_elem); // Operand 2
 
@@ -1891,14 +2912,14 @@ private:
 				ids.push_back(inst.result);
 			}
 
-			spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(res_type));
+			spirv_instruction_ref inst = add_instruction(spv::OpCompositeConstruct, convert_type(res_type));
 			inst.add(ids.begin(), ids.end());
 
 			return inst.result;
 		}
 		else
 		{
-			spirv_instruction &inst = add_instruction(spv_op, convert_type(res_type));
+			spirv_instruction_ref inst = add_instruction(spv_op, convert_type(res_type));
 			inst.add(lhs); // Operand 1
 			inst.add(rhs); // Operand 2
 
@@ -1917,7 +2938,7 @@ private:
 
 		add_location(loc, *_current_block_data);
 
-		spirv_instruction &inst = add_instruction(spv::OpSelect, convert_type(type));
+		spirv_instruction_ref inst = add_instruction(spv::OpSelect, convert_type(type));
 		inst.add(condition); // Condition
 		inst.add(true_value); // Object 1
 		inst.add(false_value); // Object 2
@@ -1933,7 +2954,7 @@ private:
 		add_location(loc, *_current_block_data);
 
 		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpFunctionCall
-		spirv_instruction &inst = add_instruction(spv::OpFunctionCall, convert_type(res_type));
+		spirv_instruction_ref inst = add_instruction(spv::OpFunctionCall, convert_type(res_type));
 		inst.add(function); // Function
 		for (const expression &arg : args)
 			inst.add(arg.base); // Arguments
@@ -1983,7 +3004,7 @@ private:
 			// Turn the list of scalar arguments into a list of column vectors
 			for (size_t arg = 0; arg < args.size(); arg += vector_type.rows)
 			{
-				spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(vector_type));
+				spirv_instruction_ref inst = add_instruction(spv::OpCompositeConstruct, convert_type(vector_type));
 				for (unsigned row = 0; row < vector_type.rows; ++row)
 					inst.add(args[arg + row].base);
 
@@ -1999,7 +3020,7 @@ private:
 				ids.push_back(arg.base);
 		}
 
-		spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(type));
+		spirv_instruction_ref inst = add_instruction(spv::OpCompositeConstruct, convert_type(type));
 		inst.add(ids.begin(), ids.end());
 
 		return inst.result;
@@ -2007,35 +3028,32 @@ private:
 
 	void emit_if(const location &loc, id, id condition_block, id true_statement_block, id false_statement_block, unsigned int selection_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const spirv_basic_block merge_label = _current_block_data->pop_back();
+		assert(merge_label.instructions[0].op == spv::OpLabel);
 
 		// Add previous block containing the condition value first
 		_current_block_data->append(_block_data[condition_block]);
 
-		spirv_instruction branch_inst = _current_block_data->instructions.back();
-		assert(branch_inst.op == spv::OpBranchConditional);
-		_current_block_data->instructions.pop_back();
+		const spirv_basic_block branch_inst = _current_block_data->pop_back();
+		assert(branch_inst.instructions[0].op == spv::OpBranchConditional);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
 		add_instruction_without_result(spv::OpSelectionMerge)
-			.add(merge_label.result)
+			.add(merge_label.instructions[0].result)
 			.add(selection_control); // 'SelectionControl' happens to match the flags produced by the parser
 
 		// Append all blocks belonging to the branch
-		_current_block_data->instructions.push_back(branch_inst);
+		_current_block_data->append(branch_inst);
 		_current_block_data->append(_block_data[true_statement_block]);
 		_current_block_data->append(_block_data[false_statement_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->append(merge_label);
 	}
 	id   emit_phi(const location &loc, id, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &type) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const spirv_basic_block merge_label = _current_block_data->pop_back();
+		assert(merge_label.instructions[0].op == spv::OpLabel);
 
 		// Add previous block containing the condition value first
 		_current_block_data->append(_block_data[condition_block]);
@@ -2045,12 +3063,12 @@ private:
 		if (false_statement_block != condition_block)
 			_current_block_data->append(_block_data[false_statement_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->append(merge_label);
 
 		add_location(loc, *_current_block_data);
 
 		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpPhi
-		spirv_instruction &inst = add_instruction(spv::OpPhi, convert_type(type))
+		spirv_instruction_ref inst = add_instruction(spv::OpPhi, convert_type(type))
 			.add(true_value) // Variable 0
 			.add(true_statement_block) // Parent 0
 			.add(false_value) // Variable 1
@@ -2060,26 +3078,25 @@ private:
 	}
 	void emit_loop(const location &loc, id, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int loop_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const spirv_basic_block merge_label = _current_block_data->pop_back();
+		assert(merge_label.instructions[0].op == spv::OpLabel);
 
 		// Add previous block first
 		_current_block_data->append(_block_data[prev_block]);
 
 		// Fill header block
 		assert(_block_data[header_block].instructions.size() == 2);
-		_current_block_data->instructions.push_back(_block_data[header_block].instructions[0]);
+		_current_block_data->append(_block_data[header_block], 0, 1);
 		assert(_current_block_data->instructions.back().op == spv::OpLabel);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
 		add_instruction_without_result(spv::OpLoopMerge)
-			.add(merge_label.result)
+			.add(merge_label.instructions[0].result)
 			.add(continue_block)
 			.add(loop_control); // 'LoopControl' happens to match the flags produced by the parser
 
-		_current_block_data->instructions.push_back(_block_data[header_block].instructions[1]);
+		_current_block_data->append(_block_data[header_block], 1, 1);
 		assert(_current_block_data->instructions.back().op == spv::OpBranch);
 
 		// Add condition block if it exists
@@ -2090,38 +3107,37 @@ private:
 		_current_block_data->append(_block_data[loop_block]);
 		_current_block_data->append(_block_data[continue_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->append(merge_label);
 	}
 	void emit_switch(const location &loc, id, id selector_block, id default_label, id default_block, const std::vector<id> &case_literal_and_labels, const std::vector<id> &case_blocks, unsigned int selection_control) override
 	{
 		assert(case_blocks.size() == case_literal_and_labels.size() / 2);
 
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const spirv_basic_block merge_label = _current_block_data->pop_back();
+		assert(merge_label.instructions[0].op == spv::OpLabel);
 
 		// Add previous block containing the selector value first
 		_current_block_data->append(_block_data[selector_block]);
 
-		spirv_instruction switch_inst = _current_block_data->instructions.back();
-		assert(switch_inst.op == spv::OpSwitch);
-		_current_block_data->instructions.pop_back();
+		spirv_basic_block switch_inst = _current_block_data->pop_back();
+		assert(switch_inst.instructions[0].op == spv::OpSwitch);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
 		add_instruction_without_result(spv::OpSelectionMerge)
-			.add(merge_label.result)
+			.add(merge_label.instructions[0].result)
 			.add(selection_control); // 'SelectionControl' happens to match the flags produced by the parser
 
 		// Update switch instruction to contain all case labels
-		switch_inst.operands[1] = default_label;
-		switch_inst.add(case_literal_and_labels.begin(), case_literal_and_labels.end());
+		switch_inst.words[switch_inst.instructions[0].operands_offset() + 1] = default_label;
+		spirv_instruction_ref { &switch_inst, 0 }
+			.add(case_literal_and_labels.begin(), case_literal_and_labels.end());
 
 		// Append all blocks belonging to the switch
-		_current_block_data->instructions.push_back(switch_inst);
+		_current_block_data->append(switch_inst);
 
 		std::vector<id> blocks = case_blocks;
-		if (default_label != merge_label.result)
+		if (default_label != merge_label.instructions[0].result)
 			blocks.push_back(default_block);
 		// Eliminate duplicates (because of multiple case labels pointing to the same block)
 		std::sort(blocks.begin(), blocks.end());
@@ -2129,7 +3145,7 @@ private:
 		for (const id case_block : blocks)
 			_current_block_data->append(_block_data[case_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->append(merge_label);
 	}
 
 	bool is_in_function() const override { return _current_function != nullptr; }
@@ -2150,8 +3166,7 @@ private:
 
 		set_block(id);
 
-		add_instruction_without_result(spv::OpLabel)
-			.result = id;
+		_current_block_data->add_instruction(spv::OpLabel, 0, id);
 	}
 	id   leave_block_and_kill() override
 	{
@@ -2232,7 +3247,8 @@ private:
 	{
 		assert(is_in_function()); // Can only leave if there was a function to begin with
 
-		_current_function->definition = _block_data[_last_block];
+		// The last block contains all other blocks of the function at this point and is not used again afterwards
+		_current_function->definition = std::move(_block_data[_last_block]);
 
 		// Append function end instruction
 		add_instruction_without_result(spv::OpFunctionEnd, _current_function->definition);
@@ -2241,7 +3257,7 @@ private:
 	}
 };
 
-codegen *reshadefx::create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
+codegen *reshadefx::create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool eliminate_dead_code, bool optimize)
 {
-	return new codegen_spirv(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y);
+	return new codegen_spirv(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y, eliminate_dead_code, optimize);
 }
@@ -564,3 +564,175 @@ bool reshadefx::expression::evaluate_constant_expression(reshadefx::tokenid op,
 
 	return true;
 }
+bool reshadefx::expression::evaluate_constant_intrinsic(const reshadefx::location &loc, const std::string &name, const std::vector<expression> &arguments, const reshadefx::type &res_type)
+{
+	if (arguments.empty() || arguments.size() > 3 || res_type.is_array() || !res_type.is_numeric() || res_type.is_matrix())
+		return false;
+	for (const expression &arg : arguments)
+		if (!arg.is_constant || arg.type.is_array() || !arg.type.is_numeric() || arg.type.is_matrix())
+			return false;
+
+	const reshadefx::type &arg_type = arguments[0].type;
+	const auto a = [&arguments](size_t arg, unsigned int i) { return arguments[arg].constant.as_float[i]; };
+
+	reshadefx::constant result = {};
+
+	if (!arg_type.is_floating_point())
+	{
+		// Only a few intrinsics have integer overloads
+		const bool is_signed = arg_type.is_signed();
+		const auto i32 = [&arguments](size_t arg, unsigned int i) { return arguments[arg].constant.as_int[i]; };
+		const auto u32 = [&arguments](size_t arg, unsigned int i) { return arguments[arg].constant.as_uint[i]; };
+
+		for (unsigned int i = 0; i < res_type.components(); ++i)
+		{
+			if (name == "abs" && is_signed)
+				result.as_uint[i] = i32(0, i) < 0 ? 0u - u32(0, i) : u32(0, i);
+			else if (name == "sign" && is_signed)
+				result.as_int[i] = (i32(0, i) > 0) - (i32(0, i) < 0);
+			else if (name == "min" && arguments.size() == 2)
+				result.as_uint[i] = is_signed ? static_cast<uint32_t>(std::min(i32(0, i), i32(1, i))) : std::min(u32(0, i), u32(1, i));
+			else if (name == "max" && arguments.size() == 2)
+				result.as_uint[i] = is_signed ? static_cast<uint32_t>(std::max(i32(0, i), i32(1, i))) : std::max(u32(0, i), u32(1, i));
+			else if (name == "clamp" && arguments.size() == 3)
+				result.as_uint[i] = is_signed ? static_cast<uint32_t>(std::min(std::max(i32(0, i), i32(1, i)), i32(2, i))) : std::min(std::max(u32(0, i), u32(1, i)), u32(2, i));
+			else
+				return false;
+		}
+	}
+	else if (name == "dot" || name == "length" || name == "distance")
+	{
+		float sum = 0.0f;
+		for (unsigned int i = 0; i < arg_type.components(); ++i)
+		{
+			const float x = name == "distance" ? a(0, i) - a(1, i) : a(0, i);
+			sum += x * (name == "dot" ? a(1, i) : x);
+		}
+		result.as_float[0] = name == "dot" ? sum : std::sqrt(sum);
+	}
+	else if (name == "normalize")
+	{
+		float sum = 0.0f;
+		for (unsigned int i = 0; i < arg_type.components(); ++i)
+			sum += a(0, i) * a(0, i);
+		for (unsigned int i = 0; i < arg_type.components(); ++i)
+			result.as_float[i] = a(0, i) / std::sqrt(sum);
+	}
+	else if (name == "cross")
+	{
+		result.as_float[0] = a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1);
+		result.as_float[1] = a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2);
+		result.as_float[2] = a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0);
+	}
+	else
+	{
+		// All other intrinsics operate on each component separately
+		for (unsigned int i = 0; i < res_type.components(); ++i)
+		{
+			const float x = a(0, i);
+			float &r = result.as_float[i];
+
+			if (arguments.size() == 1)
+			{
+				if (name == "abs")
+					r = std::abs(x);
+				else if (name == "sign")
+					r = static_cast<float>((x > 0.0f) - (x < 0.0f));
+				else if (name == "saturate")
+					r = std::min(std::max(x, 0.0f), 1.0f);
+				else if (name == "rcp")
+					r = 1.0f / x;
+				else if (name == "sqrt")
+					r = std::sqrt(x);
+				else if (name == "rsqrt")
+					r = 1.0f / std::sqrt(x);
+				else if (name == "exp")
+					r = std::exp(x);
+				else if (name == "exp2")
+					r = std::exp2(x);
+				else if (name == "log")
+					r = std::log(x);
+				else if (name == "log2")
+					r = std::log2(x);
+				else if (name == "log10")
+					r = std::log10(x);
+				else if (name == "sin")
+					r = std::sin(x);
+				else if (name == "cos")
+					r = std::cos(x);
+				else if (name == "tan")
+					r = std::tan(x);
+				else if (name == "asin")
+					r = std::asin(x);
+				else if (name == "acos")
+					r = std::acos(x);
+				else if (name == "atan")
+					r = std::atan(x);
+				else if (name == "sinh")
+					r = std::sinh(x);
+				else if (name == "cosh")
+					r = std::cosh(x);
+				else if (name == "tanh")
+					r = std::tanh(x);
+				else if (name == "floor")
+					r = std::floor(x);
+				else if (name == "ceil")
+					r = std::ceil(x);
+				else if (name == "trunc")
+					r = std::trunc(x);
+				else if (name == "frac")
+					r = x - std::floor(x);
+				else if (name == "degrees")
+					r = x * 57.29577951308232f;
+				else if (name == "radians")
+					r = x * 0.017453292519943295f;
+				else
+					return false;
+			}
+			else if (arguments.size() == 2)
+			{
+				const float y = a(1, i);
+
+				if (name == "min")
+					r = std::min(x, y);
+				else if (name == "max")
+					r = std::max(x, y);
+				else if (name == "pow" && x >= 0.0f) // Power of a negative base is undefined on the GPU
+					r = std::pow(x, y);
+				else if (name == "atan2")
+					r = std::atan2(x, y);
+				else if (name == "step")
+					r = x <= y ? 1.0f : 0.0f;
+				else
+					return false;
+			}
+			else
+			{
+				const float y = a(1, i), z = a(2, i);
+
+				if (name == "clamp")
+					r = std::min(std::max(x, y), z);
+				else if (name == "lerp")
+					r = x + (y - x) * z;
+				else if (name == "mad")
+					r = x * y + z;
+				else if (name == "smoothstep")
+				{
+					const float t = std::min(std::max((z - x) / (y - x), 0.0f), 1.0f);
+					r = t * t * (3.0f - 2.0f * t);
+				}
+				else
+					return false;
+			}
+		}
+	}
+
+	// Leave any results that are not representable as literals (e.g. square root of a negative number or division by zero) to the GPU
+	if (res_type.is_floating_point())
+		for (unsigned int i = 0; i < res_type.components(); ++i)
+			if (!std::isfinite(result.as_float[i]))
+				return false;
+
+	reset_to_rvalue_constant(loc, std::move(result), res_type);
+	return true;
+}
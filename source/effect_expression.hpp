@@ -215,5 +215,14 @@ namespace reshadefx
 		/// <param name="op">The binary operator to apply.</param>
 		/// <param name="rhs">The constant to use as right-hand side of the binary operation.</param>
 		bool evaluate_constant_expression(reshadefx::tokenid op, const reshadefx::constant &rhs);
+		/// <summary>
+		/// Replace this expression with the result of calling an intrinsic function, if that can be evaluated at compile time.
+		/// </summary>
+		/// <param name="loc">The code location of the call.</param>
+		/// <param name="name">The name of the intrinsic function to call.</param>
+		/// <param name="arguments">The constant arguments, already cast to the parameter types of the intrinsic overload.</param>
+		/// <param name="res_type">The return type of the intrinsic overload.</param>
+		/// <returns><c>true</c> if the call was evaluated, <c>false</c> if it has to be left for code generation.</returns>
+		bool evaluate_constant_intrinsic(const reshadefx::location &loc, const std::string &name, const std::vector<expression> &arguments, const reshadefx::type &res_type);
 	};
 }
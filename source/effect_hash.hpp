@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring> // std::memcpy
+#include <algorithm> // std::min
+
+namespace reshadefx
+{
+	/// <summary>
+	/// A 128-bit hash value, which is stable across builds and platforms (unlike 'std::hash'), so it can be used to identify files persisted to disk.
+	/// </summary>
+	struct hash128
+	{
+		uint64_t low = 0, high = 0;
+
+		bool operator==(const hash128 &other) const { return low == other.low && high == other.high; }
+		bool operator!=(const hash128 &other) const { return low != other.low || high != other.high; }
+
+		/// <summary>
+		/// Format this hash as a string of 32 hexadecimal digits.
+		/// </summary>
+		std::string to_string() const
+		{
+			static const char digits[] = "0123456789abcdef";
+			std::string result(32, '0');
+			for (size_t i = 0; i < 16; ++i)
+			{
+				result[15 - i] = digits[(high >> (i * 4)) & 0xF];
+				result[31 - i] = digits[(low >> (i * 4)) & 0xF];
+			}
+			return result;
+		}
+	};
+
+	/// <summary>
+	/// Computes a 128-bit hash incrementally. This runs two XXH64 streams with different seeds side by side, the low half matches plain XXH64 with the specified seed.
+	/// </summary>
+	class hasher
+	{
+		static constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+		static constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+		static constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+		static constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+		static constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+	public:
+		explicit hasher(uint64_t seed = 0)
+		{
+			_lanes[0].reset(seed);
+			_lanes[1].reset(seed ^ prime5);
+		}
+
+		/// <summary>
+		/// Append the specified data to the hash.
+		/// </summary>
+		void update(const void *data, size_t size)
+		{
+			auto *input = static_cast<const uint8_t *>(data);
+			_total_size += size;
+
+			// Fill up partially filled stripe from a previous update first
+			if (_buffer_size != 0)
+			{
+				const size_t fill = std::min(size, sizeof(_buffer) - _buffer_size);
+				std::memcpy(_buffer + _buffer_size, input, fill);
+				_buffer_size += fill;
+				input += fill;
+				size -= fill;
+
+				if (_buffer_size < sizeof(_buffer))
+					return;
+
+				consume_stripe(_buffer);
+				_buffer_size = 0;
+			}
+
+			for (; size >= sizeof(_buffer); input += sizeof(_buffer), size -= sizeof(_buffer))
+				consume_stripe(input);
+
+			std::memcpy(_buffer, input, size);
+			_buffer_size = size;
+		}
+		void update(std::string_view data)
+		{
+			update(data.data(), data.size());
+		}
+		template <typename T>
+		void update_value(const T &value)
+		{
+			update(&value, sizeof(value));
+		}
+
+		/// <summary>
+		/// Get the hash of all data appended so far.
+		/// </summary>
+		hash128 finalize() const
+		{
+			return { _lanes[0].finalize(_buffer, _buffer_size, _total_size), _lanes[1].finalize(_buffer, _buffer_size, _total_size) };
+		}
+
+	private:
+		static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+		static uint64_t read64(const uint8_t *p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+		static uint32_t read32(const uint8_t *p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+
+		static uint64_t round(uint64_t acc, uint64_t input)
+		{
+			acc += input * prime2;
+			acc = rotl(acc, 31);
+			return acc * prime1;
+		}
+		static uint64_t merge_round(uint64_t acc, uint64_t value)
+		{
+			acc ^= round(0, value);
+			return acc * prime1 + prime4;
+		}
+
+		struct lane
+		{
+			uint64_t v[4];
+
+			void reset(uint64_t seed)
+			{
+				v[0] = seed + prime1 + prime2;
+				v[1] = seed + prime2;
+				v[2] = seed;
+				v[3] = seed - prime1;
+			}
+
+			uint64_t finalize(const uint8_t *tail, size_t tail_size, uint64_t total_size) const
+			{
+				uint64_t h;
+				if (total_size >= 32)
+				{
+					h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+					for (size_t i = 0; i < 4; ++i)
+						h = merge_round(h, v[i]);
+				}
+				else
+				{
+					h = v[2] /* seed */ + prime5;
+				}
+
+				h += total_size;
+
+				for (; tail_size >= 8; tail += 8, tail_size -= 8)
+				{
+					h ^= round(0, read64(tail));
+					h = rotl(h, 27) * prime1 + prime4;
+				}
+				if (tail_size >= 4)
+				{
+					h ^= read32(tail) * prime1;
+					h = rotl(h, 23) * prime2 + prime3;
+					tail += 4;
+					tail_size -= 4;
+				}
+				for (; tail_size > 0; tail++, tail_size--)
+				{
+					h ^= *tail * prime5;
+					h = rotl(h, 11) * prime1;
+				}
+
+				h ^= h >> 33;
+				h *= prime2;
+				h ^= h >> 29;
+				h *= prime3;
+				h ^= h >> 32;
+				return h;
+			}
+		};
+
+		void consume_stripe(const uint8_t *stripe)
+		{
+			for (lane &state : _lanes)
+				for (size_t i = 0; i < 4; ++i)
+					state.v[i] = round(state.v[i], read64(stripe + i * 8));
+		}
+
+		lane _lanes[2];
+		uint8_t _buffer[32];
+		size_t _buffer_size = 0;
+		uint64_t _total_size = 0;
+	};
+
+	/// <summary>
+	/// Compute the 128-bit hash of the specified data.
+	/// </summary>
+	inline hash128 hash(std::string_view data, uint64_t seed = 0)
+	{
+		hasher h(seed);
+		h.update(data);
+		return h.finalize();
+	}
+}
@@ -5,8 +5,23 @@
 
 #include "effect_lexer.hpp"
 #include <cassert>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map> // Used for static lookup tables
 
+// Vectorized scanning is used for long runs of whitespace, comments and identifiers, with a scalar fallback for the remaining characters
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define RESHADEFX_LEXER_SSE2 1
+	#include <emmintrin.h>
+#elif defined(_M_ARM64) || (defined(__ARM_NEON) && defined(__aarch64__))
+	#define RESHADEFX_LEXER_NEON 1
+	#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER) && (RESHADEFX_LEXER_SSE2 || RESHADEFX_LEXER_NEON)
+	#include <intrin.h> // _BitScanForward
+#endif
+
 using namespace reshadefx;
 
 enum token_type
@@ -198,7 +213,68 @@ static const std::unordered_map<tokenid, std::string> token_lookup = {
 	{ tokenid::sampler, "sampler" },
 	{ tokenid::storage, "storage" },
 };
-static const std::unordered_map<std::string, tokenid> keyword_lookup = {
+
+// Hash tables which translate a given identifier to a keyword or preprocessor directive token
+// These are generated at compile time, so that a lookup only has to hash the identifier once and compare against very few entries, without any memory allocation
+struct lookup_entry
+{
+	std::string_view name;
+	tokenid id = tokenid::unknown;
+};
+
+static constexpr uint32_t hash_name(std::string_view name)
+{
+	// FNV-1a hash, with a final shift to mix the high bits into the low bits used for indexing
+	uint32_t hash = 2166136261u;
+	for (const char c : name)
+		hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+	return hash ^ (hash >> 15);
+}
+
+template <size_t table_size>
+struct lookup_table
+{
+	static_assert((table_size & (table_size - 1)) == 0, "table size has to be a power of two");
+
+	template <size_t num_entries>
+	constexpr lookup_table(const lookup_entry (&list)[num_entries]) : entries(list), slots(), max_probe_length(0)
+	{
+		static_assert(num_entries < 0xFF && num_entries < table_size / 2, "table size is too small for the number of entries");
+
+		// Insert all entries with linear probing and keep track of the longest probe sequence, so that lookups know when to stop
+		for (size_t i = 0; i < num_entries; ++i)
+		{
+			size_t index = hash_name(list[i].name) & (table_size - 1), probe_length = 1;
+			while (slots[index] != 0)
+				index = (index + 1) & (table_size - 1), probe_length++;
+
+			slots[index] = static_cast<uint8_t>(i + 1);
+
+			if (probe_length > max_probe_length)
+				max_probe_length = probe_length;
+		}
+	}
+
+	bool find(std::string_view name, tokenid &id) const
+	{
+		for (size_t index = hash_name(name) & (table_size - 1), probe_length = 0; probe_length < max_probe_length && slots[index] != 0; index = (index + 1) & (table_size - 1), probe_length++)
+		{
+			if (const lookup_entry &entry = entries[slots[index] - 1]; entry.name == name)
+			{
+				id = entry.id;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	const lookup_entry *entries;
+	uint8_t slots[table_size]; // Index into the entry list plus one, or zero for an empty slot
+	size_t max_probe_length;
+};
+
+static constexpr lookup_entry keyword_list[] = {
 	{ "asm", tokenid::reserved },
 	{ "asm_fragment", tokenid::reserved },
 	{ "auto", tokenid::reserved },
@@ -432,7 +508,7 @@ static const std::unordered_map<std::string, tokenid> keyword_lookup = {
 	{ "volatile", tokenid::volatile_ },
 	{ "while", tokenid::while_ }
 };
-static const std::unordered_map<std::string, tokenid> pp_directive_lookup = {
+static constexpr lookup_entry pp_directive_list[] = {
 	{ "define", tokenid::hash_def },
 	{ "undef", tokenid::hash_undef },
 	{ "if", tokenid::hash_if },
@@ -447,6 +523,115 @@ static const std::unordered_map<std::string, tokenid> pp_directive_lookup = {
 	{ "include", tokenid::hash_include },
 };
 
+static constexpr lookup_table<1024> keyword_lookup(keyword_list);
+static constexpr lookup_table<64> pp_directive_lookup(pp_directive_list);
+
+// Make sure the hash function spreads the names well enough, so that a lookup never needs to compare against more than a few entries
+static_assert(keyword_lookup.max_probe_length <= 3, "too many hash collisions in keyword lookup table");
+static_assert(pp_directive_lookup.max_probe_length <= 2, "too many hash collisions in preprocessor directive lookup table");
+
+#if RESHADEFX_LEXER_SSE2 || RESHADEFX_LEXER_NEON
+// Number of characters processed per vectorized step
+static constexpr size_t block_size = 16;
+
+static inline unsigned int first_set_bit(uint32_t mask)
+{
+	assert(mask != 0);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+#if RESHADEFX_LEXER_SSE2
+typedef __m128i block_type;
+
+static inline block_type load_block(const char *p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+static inline block_type match_char(block_type block, char c)
+{
+	return _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+}
+static inline block_type match_range(block_type block, char lo, char hi)
+{
+	// There is no unsigned byte comparison in SSE2, so bias the values to make a signed comparison work instead
+	return _mm_cmplt_epi8(
+		_mm_add_epi8(block, _mm_set1_epi8(static_cast<char>(0x80 - lo))),
+		_mm_set1_epi8(static_cast<char>(hi - lo - 0x7F)));
+}
+static inline block_type combine(block_type a, block_type b)
+{
+	return _mm_or_si128(a, b);
+}
+static inline block_type to_lower(block_type block)
+{
+	return _mm_or_si128(block, _mm_set1_epi8(0x20));
+}
+static inline uint32_t to_mask(block_type block)
+{
+	return static_cast<uint32_t>(_mm_movemask_epi8(block));
+}
+#else
+typedef uint8x16_t block_type;
+
+static inline block_type load_block(const char *p)
+{
+	return vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+}
+static inline block_type match_char(block_type block, char c)
+{
+	return vceqq_u8(block, vdupq_n_u8(static_cast<uint8_t>(c)));
+}
+static inline block_type match_range(block_type block, char lo, char hi)
+{
+	return vcleq_u8(vsubq_u8(block, vdupq_n_u8(static_cast<uint8_t>(lo))), vdupq_n_u8(static_cast<uint8_t>(hi - lo)));
+}
+static inline block_type combine(block_type a, block_type b)
+{
+	return vorrq_u8(a, b);
+}
+static inline block_type to_lower(block_type block)
+{
+	return vorrq_u8(block, vdupq_n_u8(0x20));
+}
+static inline uint32_t to_mask(block_type block)
+{
+	// NEON has no equivalent to 'movemask', so weight each lane with its bit and add them up horizontally
+	static const uint8_t lane_bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	const uint8x16_t bits = vandq_u8(block, vld1q_u8(lane_bits));
+	return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits))) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+}
+#endif
+
+// Each of these returns a mask with one bit set for every character in the block that belongs to the class
+static inline uint32_t space_mask(const char *p)
+{
+	const block_type block = load_block(p);
+	// Matches the 'SPACE' entries in the type lookup table (' ', '\t', '\v', '\f' and '\r')
+	return to_mask(combine(combine(match_char(block, ' '), match_char(block, '\t')), match_range(block, '\v', '\r')));
+}
+static inline uint32_t identifier_mask(const char *p)
+{
+	const block_type block = load_block(p);
+	// Matches the 'IDENT' and 'DIGIT' entries in the type lookup table
+	return to_mask(combine(combine(match_range(to_lower(block), 'a', 'z'), match_range(block, '0', '9')), match_char(block, '_')));
+}
+static inline uint32_t line_feed_mask(const char *p)
+{
+	return to_mask(match_char(load_block(p), '\n'));
+}
+static inline uint32_t comment_end_mask(const char *p)
+{
+	const block_type block = load_block(p);
+	return to_mask(combine(match_char(block, '*'), match_char(block, '\n')));
+}
+#endif
+
 static inline bool is_octal_digit(char c)
 {
 	return static_cast<unsigned>(c - '0') < 8;
@@ -495,6 +680,45 @@ static long long octal_to_decimal(long long n)
 	return n;
 }
 
+// List of source file names referenced by locations, which is shared between all lexers so that identifiers stay unique across threads
+static std::shared_mutex s_source_names_mutex;
+static std::deque<std::string> s_source_names;
+static std::unordered_map<std::string_view, uint32_t> s_source_name_lookup;
+
+uint32_t reshadefx::location::source_id(std::string_view name)
+{
+	if (name.empty())
+		return 0;
+
+	{ const std::shared_lock<std::shared_mutex> lock(s_source_names_mutex);
+		if (const auto it = s_source_name_lookup.find(name);
+			it != s_source_name_lookup.end())
+			return it->second;
+	}
+
+	const std::unique_lock<std::shared_mutex> lock(s_source_names_mutex);
+
+	// Another thread may have added the name in the meantime, so check again
+	if (const auto it = s_source_name_lookup.find(name);
+		it != s_source_name_lookup.end())
+		return it->second;
+
+	// The lookup key has to point to the stored copy of the name, since the passed in one may not outlive this call
+	const uint32_t id = static_cast<uint32_t>(s_source_names.size() + 1);
+	s_source_name_lookup.emplace(s_source_names.emplace_back(name), id);
+	return id;
+}
+const std::string &reshadefx::location::source_name() const
+{
+	static const std::string empty;
+	if (source == 0)
+		return empty;
+
+	// Elements in a deque are never moved when new ones are appended, so the returned reference stays valid after the lock is released
+	const std::shared_lock<std::shared_mutex> lock(s_source_names_mutex);
+	return s_source_names[source - 1];
+}
+
 std::string reshadefx::token::id_to_name(tokenid id)
 {
 	const auto it = token_lookup.find(id);
@@ -503,6 +727,13 @@ std::string reshadefx::token::id_to_name(tokenid id)
 	return "unknown";
 }
 
+reshadefx::tokenid reshadefx::lexer::keyword_id(std::string_view identifier)
+{
+	tokenid id = tokenid::identifier;
+	keyword_lookup.find(identifier, id);
+	return id;
+}
+
 reshadefx::token reshadefx::lexer::lex()
 {
 	bool is_at_line_begin = _cur_location.column <= 1;
@@ -514,7 +745,7 @@ next_token:
 	tok.offset = input_offset();
 	tok.length = 1;
 	tok.literal_as_double = 0;
-	tok.literal_as_string.clear();
+	tok.literal_as_string = {};
 
 	// Do a character type lookup for the current character
 	switch (type_lookup[uint8_t(*_cur)])
@@ -648,6 +879,21 @@ next_token:
 		{
 			while (_cur < _end)
 			{
+#if RESHADEFX_LEXER_SSE2 || RESHADEFX_LEXER_NEON
+				// Skip ahead to the next character that can end the comment or start a new line
+				if (_cur + block_size <= _end)
+				{
+					if (const uint32_t mask = comment_end_mask(_cur); mask == 0)
+					{
+						skip(block_size);
+						continue;
+					}
+					else
+					{
+						skip(first_set_bit(mask));
+					}
+				}
+#endif
 				if (*_cur == '\n')
 				{
 					_cur_location.line++;
@@ -775,12 +1021,26 @@ void reshadefx::lexer::skip(size_t length)
 }
 void reshadefx::lexer::skip_space()
 {
+#if RESHADEFX_LEXER_SSE2 || RESHADEFX_LEXER_NEON
+	// Most runs of whitespace are a single character between two tokens, so only switch to vectorized scanning when there is more
+	if (_cur + 1 < _end && type_lookup[uint8_t(_cur[1])] == SPACE)
+	{
+		for (; _cur + block_size <= _end; skip(block_size))
+			if (const uint32_t mask = ~space_mask(_cur) & 0xFFFF; mask != 0)
+				return skip(first_set_bit(mask));
+	}
+#endif
 	// Skip each character until a space is found
 	while (type_lookup[uint8_t(*_cur)] == SPACE && _cur < _end)
 		skip(1);
 }
 void reshadefx::lexer::skip_to_next_line()
 {
+#if RESHADEFX_LEXER_SSE2 || RESHADEFX_LEXER_NEON
+	for (; _cur + block_size <= _end; skip(block_size))
+		if (const uint32_t mask = line_feed_mask(_cur); mask != 0)
+			return skip(first_set_bit(mask));
+#endif
 	// Skip each character until a new line feed is found
 	while (*_cur != '\n' && _cur < _end)
 		skip(1);
@@ -797,19 +1057,27 @@ void reshadefx::lexer::parse_identifier(token &tok) const
 	auto *const begin = _cur, *end = begin;
 
 	// Skip to the end of the identifier sequence
-	do end++; while (type_lookup[uint8_t(*end)] == IDENT || type_lookup[uint8_t(*end)] == DIGIT);
+	end++;
+#if RESHADEFX_LEXER_SSE2 || RESHADEFX_LEXER_NEON
+	for (; end + block_size <= _end; end += block_size)
+		if (const uint32_t mask = ~identifier_mask(end) & 0xFFFF; mask != 0)
+		{
+			end += first_set_bit(mask);
+			break;
+		}
+#endif
+	while (type_lookup[uint8_t(*end)] == IDENT || type_lookup[uint8_t(*end)] == DIGIT)
+		end++;
 
 	tok.id = tokenid::identifier;
 	tok.offset = input_offset();
 	tok.length = end - begin;
-	tok.literal_as_string.assign(begin, end);
+	tok.literal_as_string = std::string_view(begin, end - begin);
 
 	if (_ignore_keywords)
 		return;
 
-	if (const auto it = keyword_lookup.find(tok.literal_as_string);
-		it != keyword_lookup.end())
-		tok.id = it->second;
+	keyword_lookup.find(tok.literal_as_string, tok.id);
 }
 bool reshadefx::lexer::parse_pp_directive(token &tok)
 {
@@ -817,10 +1085,8 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 	skip_space(); // Skip any space between the '#' and directive
 	parse_identifier(tok);
 
-	if (const auto it = pp_directive_lookup.find(tok.literal_as_string);
-		it != pp_directive_lookup.end())
+	if (pp_directive_lookup.find(tok.literal_as_string, tok.id))
 	{
-		tok.id = it->second;
 		return true;
 	}
 	else if (!_ignore_line_directives && tok.literal_as_string == "line") // The #line directive needs special handling
@@ -844,7 +1110,7 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 			token temptok;
 			parse_string_literal(temptok, false);
 
-			_cur_location.source = std::move(temptok.literal_as_string);
+			_cur_location.source = location::source_id(temptok.literal_as_string);
 		}
 
 		// Do not return the #line directive as token to the caller
@@ -859,6 +1125,33 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 {
 	auto *const begin = _cur, *end = begin + 1; // Skip first quote character right away
 
+	tok.id = tokenid::string_literal;
+
+	// Most string literals do not contain any special characters, so they can simply point into the input string
+	for (auto c = *end; c != '"'; c = *++end)
+	{
+		if (c == '\n' || end >= _end)
+		{
+			tok.literal_as_string = std::string_view(begin + 1, end - (begin + 1));
+			tok.length = end - begin;
+			return;
+		}
+
+		if (c == '\\' || c == '\r')
+			break;
+	}
+
+	if (*end == '"')
+	{
+		tok.literal_as_string = std::string_view(begin + 1, end - (begin + 1));
+		tok.length = end - begin + 1;
+		return;
+	}
+
+	// Otherwise build the literal in separate storage owned by this lexer
+	std::string literal;
+	end = begin + 1;
+
 	for (auto c = *end; c != '"'; c = *++end)
 	{
 		if (c == '\n' || end >= _end)
@@ -949,10 +1242,11 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 			}
 		}
 
-		tok.literal_as_string += c;
+		literal += c;
 	}
 
-	tok.id = tokenid::string_literal;
+	// Keep a single copy per literal in the input, so that lexing the same part again (after 'reset_to_offset') does not grow the storage
+	tok.literal_as_string = _literal_storage.try_emplace(static_cast<size_t>(begin - _input.data()) * 2 + (escape ? 1 : 0), std::move(literal)).first->second;
 	tok.length = end - begin + 1;
 }
 void reshadefx::lexer::parse_numeric_literal(token &tok) const
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_token.hpp"
+#include <unordered_map>
 
 namespace reshadefx
 {
@@ -15,6 +16,9 @@ namespace reshadefx
 	class lexer
 	{
 	public:
+		/// <summary>
+		/// Construct a lexical analyzer that takes ownership of the specified <paramref name="input"/> string.
+		/// </summary>
 		explicit lexer(
 			std::string input,
 			bool ignore_comments = true,
@@ -24,7 +28,33 @@ namespace reshadefx
 			bool ignore_keywords = false,
 			bool escape_string_literals = true,
 			const location &start_location = location()) :
-			_input(std::move(input)),
+			_input_storage(std::move(input)),
+			_cur_location(start_location),
+			_ignore_comments(ignore_comments),
+			_ignore_whitespace(ignore_whitespace),
+			_ignore_pp_directives(ignore_pp_directives),
+			_ignore_line_directives(ignore_line_directives),
+			_ignore_keywords(ignore_keywords),
+			_escape_string_literals(escape_string_literals)
+		{
+			_input = _input_storage;
+			_cur = _input.data();
+			_end = _cur + _input.size();
+		}
+		/// <summary>
+		/// Construct a lexical analyzer that works directly on the specified <paramref name="input"/> string without copying it.
+		/// The string has to be null-terminated and has to outlive this lexical analyzer and all tokens it returns.
+		/// </summary>
+		explicit lexer(
+			std::string_view input,
+			bool ignore_comments = true,
+			bool ignore_whitespace = true,
+			bool ignore_pp_directives = true,
+			bool ignore_line_directives = false,
+			bool ignore_keywords = false,
+			bool escape_string_literals = true,
+			const location &start_location = location()) :
+			_input(input),
 			_cur_location(start_location),
 			_ignore_comments(ignore_comments),
 			_ignore_whitespace(ignore_whitespace),
@@ -40,7 +70,11 @@ namespace reshadefx
 		lexer(const lexer &lexer) { operator=(lexer); }
 		lexer &operator=(const lexer &lexer)
 		{
-			_input = lexer._input;
+			// Only copy the input string if it is owned by the other lexer, otherwise keep referencing the same external string
+			_input_storage = lexer._input_storage;
+			_input = lexer._input.data() == lexer._input_storage.data() ? std::string_view(_input_storage) : lexer._input;
+			// Copy the literals too, so that tokens lexed by the copy do not point into storage of the other lexer, which may be destroyed first
+			_literal_storage = lexer._literal_storage;
 			_cur_location = lexer._cur_location;
 			reset_to_offset(lexer._cur - lexer._input.data());
 			_end = _input.data() + _input.size();
@@ -62,8 +96,15 @@ namespace reshadefx
 		/// <summary>
 		/// Get the input string this lexical analyzer works on.
 		/// </summary>
-		/// <returns>A constant reference to the input string.</returns>
-		const std::string &input_string() const { return _input; }
+		/// <returns>A view of the input string.</returns>
+		std::string_view input_string() const { return _input; }
+
+		/// <summary>
+		/// Look up the keyword token for the specified identifier (as done during lexical analysis when keywords are not ignored).
+		/// </summary>
+		/// <param name="identifier">The identifier to look up.</param>
+		/// <returns>The keyword token, or <see cref="tokenid::identifier"/> if this is not a keyword.</returns>
+		static tokenid keyword_id(std::string_view identifier);
 
 		/// <summary>
 		/// Perform lexical analysis on the input string and return the next token in sequence.
@@ -98,7 +139,9 @@ namespace reshadefx
 		void parse_string_literal(token &tok, bool escape);
 		void parse_numeric_literal(token &tok) const;
 
-		std::string _input;
+		std::string _input_storage;
+		std::string_view _input;
+		std::unordered_map<size_t, std::string> _literal_storage; // String literals that differ from their representation in the input (because of escape sequences), which tokens can point into, keyed by their offset in the input
 		location _cur_location;
 		const std::string::value_type *_cur, *_end;
 		bool _ignore_comments;
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "effect_module.hpp"
+#include <cstring> // std::memcpy
+
+// Increase this whenever the layout of the module structures or the serialized format changes, so that old cached modules are no longer read
+// "fxc --check-serialization" verifies this against a list of known formats, which needs an entry for the new value too
+static const char s_module_magic[8] = { 'R', 'F', 'X', 'M', 'O', 'D', '0', '1' };
+
+template <typename T>
+static void write(std::string &data, const std::vector<T> &value);
+
+static void write(std::string &data, uint32_t value)
+{
+	data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+static void write(std::string &data, float value)
+{
+	data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+static void write(std::string &data, const std::string &value)
+{
+	write(data, static_cast<uint32_t>(value.size()));
+	data.append(value);
+}
+static void write(std::string &data, const std::vector<uint32_t> &value)
+{
+	write(data, static_cast<uint32_t>(value.size()));
+	data.append(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(uint32_t));
+}
+static void write(std::string &data, const reshadefx::type &value)
+{
+	write(data, static_cast<uint32_t>(value.base));
+	write(data, value.rows);
+	write(data, value.cols);
+	write(data, value.qualifiers);
+	write(data, static_cast<uint32_t>(value.array_length));
+	write(data, value.definition);
+}
+static void write(std::string &data, const reshadefx::constant &value)
+{
+	data.append(reinterpret_cast<const char *>(value.as_uint), sizeof(value.as_uint));
+	write(data, value.string_data);
+	write(data, static_cast<uint32_t>(value.array_data.size()));
+	for (const reshadefx::constant &element : value.array_data)
+		write(data, element);
+}
+static void write(std::string &data, const reshadefx::annotation &value)
+{
+	write(data, value.type);
+	write(data, value.name);
+	write(data, value.value);
+}
+static void write(std::string &data, const reshadefx::entry_point &value)
+{
+	write(data, value.name);
+	write(data, static_cast<uint32_t>(value.type));
+	write(data, value.hlsl);
+	write(data, value.spirv);
+}
+static void write(std::string &data, const reshadefx::texture_info &value)
+{
+	write(data, value.id);
+	write(data, value.binding);
+	write(data, value.semantic);
+	write(data, value.unique_name);
+	write(data, value.annotations);
+	write(data, value.width);
+	write(data, value.height);
+	write(data, value.levels);
+	write(data, static_cast<uint32_t>(value.format));
+	write(data, static_cast<uint32_t>(value.render_target) | (static_cast<uint32_t>(value.storage_access) << 1));
+}
+static void write(std::string &data, const reshadefx::sampler_info &value)
+{
+	write(data, value.id);
+	write(data, value.binding);
+	write(data, value.texture_binding);
+	write(data, value.unique_name);
+	write(data, value.texture_name);
+	write(data, value.annotations);
+	write(data, static_cast<uint32_t>(value.filter));
+	write(data, static_cast<uint32_t>(value.address_u));
+	write(data, static_cast<uint32_t>(value.address_v));
+	write(data, static_cast<uint32_t>(value.address_w));
+	write(data, value.min_lod);
+	write(data, value.max_lod);
+	write(data, value.lod_bias);
+	write(data, static_cast<uint32_t>(value.srgb));
+}
+static void write(std::string &data, const reshadefx::storage_info &value)
+{
+	write(data, value.id);
+	write(data, value.binding);
+	write(data, value.unique_name);
+	write(data, value.texture_name);
+}
+static void write(std::string &data, const reshadefx::uniform_info &value)
+{
+	write(data, value.name);
+	write(data, value.type);
+	write(data, value.size);
+	write(data, value.offset);
+	write(data, value.annotations);
+	write(data, static_cast<uint32_t>(value.has_initializer_value));
+	write(data, value.initializer_value);
+}
+static void write(std::string &data, const reshadefx::pass_info &value)
+{
+	write(data, value.name);
+	for (const std::string &render_target_name : value.render_target_names)
+		write(data, render_target_name);
+	write(data, value.vs_entry_point);
+	write(data, value.ps_entry_point);
+	write(data, value.cs_entry_point);
+
+	// All the remaining render state fits into a byte each
+	const uint8_t states[] = {
+		value.clear_render_targets, value.srgb_write_enable, value.blend_enable, value.stencil_enable,
+		value.color_write_mask, value.stencil_read_mask, value.stencil_write_mask,
+		static_cast<uint8_t>(value.blend_op), static_cast<uint8_t>(value.blend_op_alpha),
+		static_cast<uint8_t>(value.src_blend), static_cast<uint8_t>(value.dest_blend), static_cast<uint8_t>(value.src_blend_alpha), static_cast<uint8_t>(value.dest_blend_alpha),
+		static_cast<uint8_t>(value.stencil_comparison_func), static_cast<uint8_t>(value.stencil_op_pass), static_cast<uint8_t>(value.stencil_op_fail), static_cast<uint8_t>(value.stencil_op_depth_fail),
+		static_cast<uint8_t>(value.topology),
+	};
+	data.append(reinterpret_cast<const char *>(states), sizeof(states));
+
+	write(data, value.stencil_reference_value);
+	write(data, value.num_vertices);
+	write(data, value.viewport_width);
+	write(data, value.viewport_height);
+	write(data, value.viewport_dispatch_z);
+	write(data, value.samplers);
+	write(data, value.storages);
+}
+static void write(std::string &data, const reshadefx::technique_info &value)
+{
+	write(data, value.name);
+	write(data, value.passes);
+	write(data, value.annotations);
+}
+template <typename T>
+static void write(std::string &data, const std::vector<T> &value)
+{
+	write(data, static_cast<uint32_t>(value.size()));
+	for (const T &element : value)
+		write(data, element);
+}
+
+namespace
+{
+	struct module_reader
+	{
+		std::string_view data;
+		size_t offset = 0;
+
+		bool read_bytes(void *value, size_t size)
+		{
+			if (size > data.size() - offset)
+				return false;
+			if (size == 0)
+				return true; // Empty vectors have no storage to copy into ('memcpy' must not be passed a null pointer)
+			std::memcpy(value, data.data() + offset, size);
+			offset += size;
+			return true;
+		}
+
+		bool read(uint32_t &value)
+		{
+			return read_bytes(&value, sizeof(value));
+		}
+		bool read(float &value)
+		{
+			return read_bytes(&value, sizeof(value));
+		}
+		bool read(std::string &value)
+		{
+			uint32_t size = 0;
+			if (!read(size) || size > data.size() - offset)
+				return false;
+			value.assign(data.data() + offset, size);
+			offset += size;
+			return true;
+		}
+		bool read(std::vector<uint32_t> &value)
+		{
+			uint32_t size = 0;
+			if (!read(size) || size > (data.size() - offset) / sizeof(uint32_t))
+				return false;
+			value.resize(size);
+			return read_bytes(value.data(), size * sizeof(uint32_t));
+		}
+		template <typename T>
+		bool read(std::vector<T> &value)
+		{
+			uint32_t size = 0;
+			if (!read(size) || size > data.size() - offset) // Every element takes up at least one byte, so this catches corrupted sizes before allocating
+				return false;
+			value.resize(size);
+			for (T &element : value)
+				if (!read(element))
+					return false;
+			return true;
+		}
+		template <typename T>
+		bool read_enum(T &value)
+		{
+			uint32_t raw_value = 0;
+			if (!read(raw_value))
+				return false;
+			value = static_cast<T>(raw_value);
+			return true;
+		}
+
+		bool read(reshadefx::type &value)
+		{
+			uint32_t array_length = 0;
+			if (!read_enum(value.base) || !read(value.rows) || !read(value.cols) || !read(value.qualifiers) || !read(array_length) || !read(value.definition))
+				return false;
+			value.array_length = static_cast<int>(array_length);
+			return true;
+		}
+		bool read(reshadefx::constant &value)
+		{
+			return read_bytes(value.as_uint, sizeof(value.as_uint)) && read(value.string_data) && read(value.array_data);
+		}
+		bool read(reshadefx::annotation &value)
+		{
+			return read(value.type) && read(value.name) && read(value.value);
+		}
+		bool read(reshadefx::entry_point &value)
+		{
+			return read(value.name) && read_enum(value.type) && read(value.hlsl) && read(value.spirv);
+		}
+		bool read(reshadefx::texture_info &value)
+		{
+			uint32_t flags = 0;
+			if (!read(value.id) || !read(value.binding) || !read(value.semantic) || !read(value.unique_name) || !read(value.annotations) ||
+				!read(value.width) || !read(value.height) || !read(value.levels) || !read_enum(value.format) || !read(flags))
+				return false;
+			value.render_target = (flags & 1) != 0;
+			value.storage_access = (flags & 2) != 0;
+			return true;
+		}
+		bool read(reshadefx::sampler_info &value)
+		{
+			uint32_t srgb = 0;
+			if (!read(value.id) || !read(value.binding) || !read(value.texture_binding) || !read(value.unique_name) || !read(value.texture_name) || !read(value.annotations) ||
+				!read_enum(value.filter) || !read_enum(value.address_u) || !read_enum(value.address_v) || !read_enum(value.address_w) ||
+				!read(value.min_lod) || !read(value.max_lod) || !read(value.lod_bias) || !read(srgb))
+				return false;
+			value.srgb = static_cast<uint8_t>(srgb);
+			return true;
+		}
+		bool read(reshadefx::storage_info &value)
+		{
+			return read(value.id) && read(value.binding) && read(value.unique_name) && read(value.texture_name);
+		}
+		bool read(reshadefx::uniform_info &value)
+		{
+			uint32_t has_initializer_value = 0;
+			if (!read(value.name) || !read(value.type) || !read(value.size) || !read(value.offset) || !read(value.annotations) ||
+				!read(has_initializer_value) || !read(value.initializer_value))
+				return false;
+			value.has_initializer_value = has_initializer_value != 0;
+			return true;
+		}
+		bool read(reshadefx::pass_info &value)
+		{
+			if (!read(value.name))
+				return false;
+			for (std::string &render_target_name : value.render_target_names)
+				if (!read(render_target_name))
+					return false;
+			if (!read(value.vs_entry_point) || !read(value.ps_entry_point) || !read(value.cs_entry_point))
+				return false;
+
+			uint8_t states[18];
+			if (!read_bytes(states, sizeof(states)))
+				return false;
+			value.clear_render_targets = states[0];
+			value.srgb_write_enable = states[1];
+			value.blend_enable = states[2];
+			value.stencil_enable = states[3];
+			value.color_write_mask = states[4];
+			value.stencil_read_mask = states[5];
+			value.stencil_write_mask = states[6];
+			value.blend_op = static_cast<reshadefx::pass_blend_op>(states[7]);
+			value.blend_op_alpha = static_cast<reshadefx::pass_blend_op>(states[8]);
+			value.src_blend = static_cast<reshadefx::pass_blend_func>(states[9]);
+			value.dest_blend = static_cast<reshadefx::pass_blend_func>(states[10]);
+			value.src_blend_alpha = static_cast<reshadefx::pass_blend_func>(states[11]);
+			value.dest_blend_alpha = static_cast<reshadefx::pass_blend_func>(states[12]);
+			value.stencil_comparison_func = static_cast<reshadefx::pass_stencil_func>(states[13]);
+			value.stencil_op_pass = static_cast<reshadefx::pass_stencil_op>(states[14]);
+			value.stencil_op_fail = static_cast<reshadefx::pass_stencil_op>(states[15]);
+			value.stencil_op_depth_fail = static_cast<reshadefx::pass_stencil_op>(states[16]);
+			value.topology = static_cast<reshadefx::primitive_topology>(states[17]);
+
+			return read(value.stencil_reference_value) && read(value.num_vertices) &&
+				read(value.viewport_width) && read(value.viewport_height) && read(value.viewport_dispatch_z) &&
+				read(value.samplers) && read(value.storages);
+		}
+		bool read(reshadefx::technique_info &value)
+		{
+			return read(value.name) && read(value.passes) && read(value.annotations);
+		}
+	};
+}
+
+void reshadefx::serialize_module(const module &module, std::string &data)
+{
+	data.append(s_module_magic, sizeof(s_module_magic));
+
+	write(data, module.hlsl);
+	write(data, module.spirv);
+	write(data, module.entry_points);
+	write(data, module.textures);
+	write(data, module.samplers);
+	write(data, module.storages);
+	write(data, module.uniforms);
+	write(data, module.spec_constants);
+	write(data, module.techniques);
+	write(data, module.total_uniform_size);
+	write(data, module.num_texture_bindings);
+	write(data, module.num_sampler_bindings);
+	write(data, module.num_storage_bindings);
+}
+
+bool reshadefx::deserialize_module(std::string_view data, module &module)
+{
+	if (data.size() < sizeof(s_module_magic) || std::memcmp(data.data(), s_module_magic, sizeof(s_module_magic)) != 0)
+		return false;
+
+	module_reader reader { data, sizeof(s_module_magic) };
+
+	reshadefx::module result;
+	if (!reader.read(result.hlsl) ||
+		!reader.read(result.spirv) ||
+		!reader.read(result.entry_points) ||
+		!reader.read(result.textures) ||
+		!reader.read(result.samplers) ||
+		!reader.read(result.storages) ||
+		!reader.read(result.uniforms) ||
+		!reader.read(result.spec_constants) ||
+		!reader.read(result.techniques) ||
+		!reader.read(result.total_uniform_size) ||
+		!reader.read(result.num_texture_bindings) ||
+		!reader.read(result.num_sampler_bindings) ||
+		!reader.read(result.num_storage_bindings) ||
+		reader.offset != data.size())
+		return false;
+
+	module = std::move(result);
+	return true;
+}
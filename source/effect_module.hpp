@@ -242,6 +242,9 @@ namespace reshadefx
 	{
 		std::string name;
 		shader_type type;
+		// Self-contained code with only the definitions this entry point references (empty unless the code generator was asked to eliminate dead code)
+		std::string hlsl = {};
+		std::vector<uint32_t> spirv = {};
 	};
 
 	/// <summary>
@@ -257,6 +260,8 @@ namespace reshadefx
 		std::vector<struct_member_info> parameter_list;
 		std::unordered_set<uint32_t> referenced_samplers;
 		std::unordered_set<uint32_t> referenced_storages;
+		std::unordered_set<uint32_t> referenced_functions;
+		std::unordered_set<uint32_t> referenced_variables;
 	};
 
 	/// <summary>
@@ -326,4 +331,18 @@ namespace reshadefx
 		uint32_t num_sampler_bindings = 0;
 		uint32_t num_storage_bindings = 0;
 	};
+
+	/// <summary>
+	/// Append a compact binary representation of the specified module to a buffer, so that it can be cached and restored later without parsing the effect code again.
+	/// </summary>
+	/// <param name="module">The module to serialize.</param>
+	/// <param name="data">The buffer to append the serialized module to.</param>
+	void serialize_module(const module &module, std::string &data);
+	/// <summary>
+	/// Restore a module from the binary representation created by <see cref="serialize_module"/>.
+	/// </summary>
+	/// <param name="data">The serialized module.</param>
+	/// <param name="module">The module to overwrite with the restored one.</param>
+	/// <returns>A boolean value indicating whether the data was valid and written by a compatible version (the module is left unchanged if not).</returns>
+	bool deserialize_module(std::string_view data, module &module);
 }
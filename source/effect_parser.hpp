@@ -20,6 +20,17 @@ namespace reshadefx
 		parser();
 		~parser();
 
+		/// <summary>
+		/// Add an identifier whose value is only known at runtime (e.g. left in the output by <see cref="preprocessor::add_runtime_constant"/>).
+		/// Where a constant is required (outside of functions, in array sizes and in case labels) it evaluates to the specified value,
+		/// everywhere else it is read from an implicit uniform variable with the specified 'source' annotation, so that the generated code does not change with the value.
+		/// The same applies to global constants initialized from it, whose initializer is parsed again wherever they are used in code.
+		/// </summary>
+		/// <param name="name">The name of the identifier.</param>
+		/// <param name="value">The current value of the identifier.</param>
+		/// <param name="source">The value of the 'source' annotation of the uniform variable, which tells the runtime how to fill it.</param>
+		void add_runtime_constant(const std::string &name, int value, const std::string &source);
+
 		/// <summary>
 		/// Parse the provided input string.
 		/// </summary>
@@ -27,6 +38,18 @@ namespace reshadefx
 		/// <param name="backend">The code generation implementation to use.</param>
 		/// <returns>A boolean value indicating whether parsing was successful or not.</returns>
 		bool parse(std::string source, class codegen *backend);
+		/// <summary>
+		/// Parse the provided list of tokens (e.g. as produced by the preprocessor), which avoids lexing the input string again.
+		/// </summary>
+		/// <param name="tokens">The tokens to analyze. The list is terminated by an end of file token.</param>
+		/// <param name="backend">The code generation implementation to use.</param>
+		/// <returns>A boolean value indicating whether parsing was successful or not.</returns>
+		bool parse(std::vector<token> tokens, class codegen *backend);
+
+		/// <summary>
+		/// Check whether the current value of a runtime constant was baked in anywhere (e.g. in an array size or texture dimension), which makes the result only valid for that value.
+		/// </summary>
+		bool runtime_constants_evaluated() const { return _baked_runtime_constants != 0; }
 
 		/// <summary>
 		/// Get the list of error messages.
@@ -35,9 +58,23 @@ namespace reshadefx
 		const std::string &errors() const { return _errors; }
 
 	private:
+		struct runtime_constant
+		{
+			int value;
+			std::string source;
+			uint32_t uniform = 0; // Only defined once the identifier is first used outside a constant expression
+		};
+		struct runtime_dependent_constant
+		{
+			std::vector<token> initializer; // Tokens of the initializer expression, terminated by an end of file token
+			struct scope scope; // Scope the constant was declared in
+		};
+
 		void error(const location &location, unsigned int code, const std::string &message);
 		void warning(const location &location, unsigned int code, const std::string &message);
 
+		bool parse_input();
+
 		void backup();
 		void restore();
 
@@ -71,6 +108,7 @@ namespace reshadefx
 		bool parse_expression_unary(expression &expression);
 		bool parse_expression_multary(expression &expression, unsigned int precedence = 0);
 		bool parse_expression_assignment(expression &expression);
+		bool parse_runtime_dependent_initializer(const runtime_dependent_constant &constant_info, expression &expression);
 		bool parse_annotations(std::vector<annotation> &annotations);
 		bool parse_statement(bool scoped);
 		bool parse_statement_block(bool scoped);
@@ -80,8 +118,16 @@ namespace reshadefx
 		token _token, _token_next, _token_backup;
 		std::unique_ptr<class lexer> _lexer;
 		size_t _lexer_backup_offset = 0;
+		std::vector<token> _input_tokens;
+		size_t _input_token_index = 0;
 		std::vector<uint32_t> _loop_break_target_stack;
 		std::vector<uint32_t> _loop_continue_target_stack;
 		reshadefx::function_info *_current_function = nullptr;
+		std::unordered_map<std::string, runtime_constant> _runtime_constants;
+		unsigned int _constant_expression_level = 0; // Non-zero while parsing an expression inside a function that has to be constant
+		unsigned int _baked_runtime_constants = 0; // Number of times a runtime constant was replaced with its current value
+		unsigned int _runtime_constant_reads = 0; // Number of times a runtime constant was read from its uniform variable instead
+		unsigned int _variable_references = 0; // Number of references to variables and calls to functions, which are all that can give an expression side effects
+		std::vector<runtime_dependent_constant> _runtime_dependent_constants; // Indexed by the identifier of a constant symbol minus one
 	};
 }
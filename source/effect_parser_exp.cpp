@@ -7,6 +7,8 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include <cassert>
+#include <utility> // std::exchange
+#include <algorithm> // std::min, std::all_of
 
 reshadefx::parser::parser()
 {
@@ -15,9 +17,15 @@ reshadefx::parser::~parser()
 {
 }
 
+void reshadefx::parser::add_runtime_constant(const std::string &name, int value, const std::string &source)
+{
+	assert(!name.empty());
+	_runtime_constants[name] = { value, source };
+}
+
 void reshadefx::parser::error(const location &location, unsigned int code, const std::string &message)
 {
-	_errors += location.source;
+	_errors += location.source_name();
 	_errors += '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": error";
 	_errors += (code == 0) ? ": " : " X" + std::to_string(code) + ": ";
 	_errors += message;
@@ -25,7 +33,7 @@ void reshadefx::parser::error(const location &location, unsigned int code, const
 }
 void reshadefx::parser::warning(const location &location, unsigned int code, const std::string &message)
 {
-	_errors += location.source;
+	_errors += location.source_name();
 	_errors += '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": warning";
 	_errors += (code == 0) ? ": " : " X" + std::to_string(code) + ": ";
 	_errors += message;
@@ -35,18 +43,24 @@ void reshadefx::parser::warning(const location &location, unsigned int code, con
 void reshadefx::parser::backup()
 {
 	_token_backup = _token_next;
-	_lexer_backup_offset = _lexer->input_offset();
+	_lexer_backup_offset = _lexer != nullptr ? _lexer->input_offset() : _input_token_index;
 }
 void reshadefx::parser::restore()
 {
-	_lexer->reset_to_offset(_lexer_backup_offset);
+	if (_lexer != nullptr)
+		_lexer->reset_to_offset(_lexer_backup_offset);
+	else
+		_input_token_index = _lexer_backup_offset;
 	_token_next = _token_backup; // Copy instead of move here, since restore may be called twice (from 'accept_type_class' and then again from 'parse_expression_unary')
 }
 
 void reshadefx::parser::consume()
 {
 	_token = std::move(_token_next);
-	_token_next = _lexer->lex();
+	if (_lexer != nullptr)
+		_token_next = _lexer->lex();
+	else // Keep returning the end of file token once the end of the token list was reached
+		_token_next = _input_tokens[std::min(_input_token_index++, _input_tokens.size() - 1)];
 }
 void reshadefx::parser::consume_until(tokenid tokid)
 {
@@ -90,14 +104,15 @@ bool reshadefx::parser::accept_symbol(std::string &identifier, scoped_symbol &sy
 		return false;
 	}
 
-	identifier = std::move(_token.literal_as_string);
+	identifier = _token.literal_as_string;
 
 	// Can concatenate multiple '::' to force symbol search for a specific namespace level
 	while (accept(tokenid::colon_colon))
 	{
 		if (!expect(tokenid::identifier))
 			return false;
-		identifier += "::" + std::move(_token.literal_as_string);
+		identifier += "::";
+		identifier += _token.literal_as_string;
 	}
 
 	// Figure out which scope to start searching in
@@ -670,7 +685,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 	}
 	else if (accept(tokenid::string_literal))
 	{
-		std::string value = std::move(_token.literal_as_string);
+		std::string value(_token.literal_as_string);
 
 		// Multiple string literals in sequence are concatenated into a single string literal
 		while (accept(tokenid::string_literal))
@@ -834,91 +849,156 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 
 			assert(symbol.function != nullptr);
 
-			std::vector<expression> parameters(arguments.size());
-
-			// We need to allocate some temporary variables to pass in and load results from pointer parameters
-			for (size_t i = 0; i < arguments.size(); ++i)
+			// Evaluate calls to intrinsics with only constant arguments at compile time, so that all code generators can just emit the result as a literal
+			bool folded = false;
+			if (symbol.op == symbol_type::intrinsic &&
+				std::all_of(arguments.begin(), arguments.end(), [](const expression &arg) { return arg.is_constant; }))
 			{
-				const auto &param_type = symbol.function->parameter_list[i].type;
+				std::vector<expression> constant_arguments = arguments;
+				for (size_t i = 0; i < constant_arguments.size(); ++i)
+					constant_arguments[i].add_cast_operation(symbol.function->parameter_list[i].type);
+
+				folded = exp.evaluate_constant_intrinsic(location, symbol.function->name, constant_arguments, symbol.type);
 
-				if (param_type.has(type::q_out) && (arguments[i].type.has(type::q_const) || !arguments[i].is_lvalue))
-					return error(arguments[i].location, 3025, "l-value specifies const object for an 'out' parameter"), false;
+				if (folded)
+					for (size_t i = 0; i < arguments.size(); ++i)
+						if (arguments[i].type.components() > symbol.function->parameter_list[i].type.components())
+							warning(arguments[i].location, 3206, "implicit truncation of vector type");
+			}
 
-				if (arguments[i].type.components() > param_type.components())
-					warning(arguments[i].location, 3206, "implicit truncation of vector type");
+			if (!folded)
+			{
+				std::vector<expression> parameters(arguments.size());
 
-				if (symbol.op == symbol_type::function || param_type.has(type::q_out))
+				// We need to allocate some temporary variables to pass in and load results from pointer parameters
+				for (size_t i = 0; i < arguments.size(); ++i)
 				{
-					if (param_type.is_sampler() || param_type.is_storage() || param_type.has(type::q_groupshared) /* Special case for atomic intrinsics */)
+					const auto &param_type = symbol.function->parameter_list[i].type;
+
+					if (param_type.has(type::q_out) && (arguments[i].type.has(type::q_const) || !arguments[i].is_lvalue))
+						return error(arguments[i].location, 3025, "l-value specifies const object for an 'out' parameter"), false;
+
+					if (arguments[i].type.components() > param_type.components())
+						warning(arguments[i].location, 3206, "implicit truncation of vector type");
+
+					if (symbol.op == symbol_type::function || param_type.has(type::q_out))
 					{
-						if (arguments[i].type != param_type)
-							return error(location, 3004, "no matching intrinsic overload for '" + identifier + '\''), false;
+						if (param_type.is_sampler() || param_type.is_storage() || param_type.has(type::q_groupshared) /* Special case for atomic intrinsics */)
+						{
+							if (arguments[i].type != param_type)
+								return error(location, 3004, "no matching intrinsic overload for '" + identifier + '\''), false;
 
-						assert(arguments[i].is_lvalue);
+							assert(arguments[i].is_lvalue);
 
-						// Do not shadow object or pointer parameters to function calls
-						size_t chain_index = 0;
-						const auto access_chain = _codegen->emit_access_chain(arguments[i], chain_index);
-						parameters[i].reset_to_lvalue(arguments[i].location, access_chain, param_type);
-						assert(chain_index == arguments[i].chain.size());
+							// Do not shadow object or pointer parameters to function calls
+							size_t chain_index = 0;
+							const auto access_chain = _codegen->emit_access_chain(arguments[i], chain_index);
+							parameters[i].reset_to_lvalue(arguments[i].location, access_chain, param_type);
+							assert(chain_index == arguments[i].chain.size());
 
-						// This is referencing a l-value, but want to avoid copying below
-						parameters[i].is_lvalue = false;
+							// This is referencing a l-value, but want to avoid copying below
+							parameters[i].is_lvalue = false;
+						}
+						else
+						{
+							// All user-defined functions actually accept pointers as arguments, same applies to intrinsics with 'out' parameters
+							const auto temp_variable = _codegen->define_variable(arguments[i].location, param_type);
+							parameters[i].reset_to_lvalue(arguments[i].location, temp_variable, param_type);
+						}
 					}
 					else
 					{
-						// All user-defined functions actually accept pointers as arguments, same applies to intrinsics with 'out' parameters
-						const auto temp_variable = _codegen->define_variable(arguments[i].location, param_type);
-						parameters[i].reset_to_lvalue(arguments[i].location, temp_variable, param_type);
+						expression arg = arguments[i];
+						arg.add_cast_operation(param_type);
+						parameters[i].reset_to_rvalue(arg.location, _codegen->emit_load(arg), param_type);
+
+						// Keep track of whether the parameter is a constant for code generation (this makes the expression invalid for all other uses)
+						parameters[i].is_constant = arg.is_constant;
 					}
 				}
-				else
+
+				// Copy in parameters from the argument access chains to parameter variables
+				for (size_t i = 0; i < arguments.size(); ++i)
 				{
-					expression arg = arguments[i];
-					arg.add_cast_operation(param_type);
-					parameters[i].reset_to_rvalue(arg.location, _codegen->emit_load(arg), param_type);
+					// Only do this for pointer parameters as discovered above
+					if (parameters[i].is_lvalue && parameters[i].type.has(type::q_in) && !parameters[i].type.is_sampler() && !parameters[i].type.is_storage())
+					{
+						expression arg = arguments[i];
+						arg.add_cast_operation(parameters[i].type);
+						_codegen->emit_store(parameters[i], _codegen->emit_load(arg));
+					}
+				}
+
+				// Check if the call resolving found an intrinsic or function and invoke the corresponding code
+				const auto result = symbol.op == symbol_type::function ?
+					_codegen->emit_call(location, symbol.id, symbol.type, parameters) :
+					_codegen->emit_call_intrinsic(location, symbol.id, symbol.type, parameters);
 
-					// Keep track of whether the parameter is a constant for code generation (this makes the expression invalid for all other uses)
-					parameters[i].is_constant = arg.is_constant;
+				exp.reset_to_rvalue(location, result, symbol.type);
+
+				if (symbol.op == symbol_type::function)
+					_variable_references++; // Functions can have side effects just like references to variables
+
+				// Copy out parameters from parameter variables back to the argument access chains
+				for (size_t i = 0; i < arguments.size(); ++i)
+				{
+					// Only do this for pointer parameters as discovered above
+					if (parameters[i].is_lvalue && parameters[i].type.has(type::q_out) && !parameters[i].type.is_sampler() && !parameters[i].type.is_storage())
+					{
+						expression arg = parameters[i];
+						arg.add_cast_operation(arguments[i].type);
+						_codegen->emit_store(arguments[i], _codegen->emit_load(arg));
+					}
 				}
-			}
 
-			// Copy in parameters from the argument access chains to parameter variables
-			for (size_t i = 0; i < arguments.size(); ++i)
-			{
-				// Only do this for pointer parameters as discovered above
-				if (parameters[i].is_lvalue && parameters[i].type.has(type::q_in) && !parameters[i].type.is_sampler() && !parameters[i].type.is_storage())
+				if (_current_function != nullptr && symbol.op == symbol_type::function)
 				{
-					expression arg = arguments[i];
-					arg.add_cast_operation(parameters[i].type);
-					_codegen->emit_store(parameters[i], _codegen->emit_load(arg));
+					// Calling a function makes the caller inherit all references from the callee, so that the references of an entry point cover everything it can reach
+					_current_function->referenced_samplers.insert(symbol.function->referenced_samplers.begin(), symbol.function->referenced_samplers.end());
+					_current_function->referenced_storages.insert(symbol.function->referenced_storages.begin(), symbol.function->referenced_storages.end());
+					_current_function->referenced_functions.insert(symbol.function->referenced_functions.begin(), symbol.function->referenced_functions.end());
+					_current_function->referenced_variables.insert(symbol.function->referenced_variables.begin(), symbol.function->referenced_variables.end());
+					_current_function->referenced_functions.insert(symbol.id);
 				}
 			}
+		}
+		else if (const auto it = _runtime_constants.find(identifier);
+			symbol.op == symbol_type::invalid && it != _runtime_constants.end())
+		{
+			runtime_constant &runtime_constant_info = it->second;
 
-			// Check if the call resolving found an intrinsic or function and invoke the corresponding code
-			const auto result = symbol.op == symbol_type::function ?
-				_codegen->emit_call(location, symbol.id, symbol.type, parameters) :
-				_codegen->emit_call_intrinsic(location, symbol.id, symbol.type, parameters);
-
-			exp.reset_to_rvalue(location, result, symbol.type);
+			if (_current_function == nullptr || _constant_expression_level != 0)
+			{
+				// The value is baked in where a constant is required, which makes the result depend on it
+				exp.reset_to_rvalue_constant(location, runtime_constant_info.value);
 
-			// Copy out parameters from parameter variables back to the argument access chains
-			for (size_t i = 0; i < arguments.size(); ++i)
+				_baked_runtime_constants++;
+			}
+			else
 			{
-				// Only do this for pointer parameters as discovered above
-				if (parameters[i].is_lvalue && parameters[i].type.has(type::q_out) && !parameters[i].type.is_sampler() && !parameters[i].type.is_storage())
+				const reshadefx::type uniform_type = { type::t_int, 1, 1, type::q_extern | type::q_uniform };
+
+				// Everywhere else the value is read from a uniform variable the runtime keeps updated
+				if (runtime_constant_info.uniform == 0)
 				{
-					expression arg = parameters[i];
-					arg.add_cast_operation(arguments[i].type);
-					_codegen->emit_store(arguments[i], _codegen->emit_load(arg));
+					uniform_info uniform_info;
+					uniform_info.name = identifier;
+					uniform_info.type = uniform_type;
+
+					annotation &source = uniform_info.annotations.emplace_back();
+					source.type = { type::t_string, 0, 0, type::q_const };
+					source.name = "source";
+					source.value.string_data = runtime_constant_info.source;
+
+					runtime_constant_info.uniform = _codegen->define_uniform(location, uniform_info);
 				}
-			}
 
-			if (_current_function != nullptr)
-			{
-				// Calling a function makes the caller inherit all sampler and storage object references from the callee
-				_current_function->referenced_samplers.insert(symbol.function->referenced_samplers.begin(), symbol.function->referenced_samplers.end());
-				_current_function->referenced_storages.insert(symbol.function->referenced_storages.begin(), symbol.function->referenced_storages.end());
+				exp.reset_to_lvalue(location, runtime_constant_info.uniform, uniform_type);
+				exp.type.qualifiers |= type::q_const; // Cannot be assigned to, same as the literal it replaces
+
+				_current_function->referenced_variables.insert(runtime_constant_info.uniform);
+
+				_runtime_constant_reads++;
 			}
 		}
 		else if (symbol.op == symbol_type::invalid)
@@ -932,20 +1012,41 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 			// Simply return the pointer to the variable, dereferencing is done on site where necessary
 			exp.reset_to_lvalue(location, symbol.id, symbol.type);
 
+			_variable_references++;
+
 			if (_current_function != nullptr &&
 				symbol.scope.level == symbol.scope.namespace_level && symbol.id != 0xFFFFFFFF) // Ignore invalid symbols that were added during error recovery
 			{
-				// Keep track of any global sampler or storage objects referenced in the current function
+				// Keep track of any global sampler, storage objects or variables referenced in the current function
 				if (symbol.type.is_sampler())
 					_current_function->referenced_samplers.insert(symbol.id);
-				if (symbol.type.is_storage())
+				else if (symbol.type.is_storage())
 					_current_function->referenced_storages.insert(symbol.id);
+				else
+					_current_function->referenced_variables.insert(symbol.id);
 			}
 		}
 		else if (symbol.op == symbol_type::constant)
 		{
-			// Constants are loaded into the access chain
-			exp.reset_to_rvalue_constant(location, symbol.constant, symbol.type);
+			// Constants whose value depends on a runtime constant have their initializer parsed again where code is generated, so that it reads the uniform variables instead
+			if (symbol.id != 0 && _current_function != nullptr && _constant_expression_level == 0)
+			{
+				assert(symbol.id <= _runtime_dependent_constants.size());
+
+				if (!parse_runtime_dependent_initializer(_runtime_dependent_constants[symbol.id - 1], exp))
+					return false;
+
+				exp.add_cast_operation(symbol.type);
+				exp.type.qualifiers |= type::q_const; // Cannot be assigned to, same as the constant it replaces
+			}
+			else
+			{
+				if (symbol.id != 0)
+					_baked_runtime_constants++;
+
+				// Constants are loaded into the access chain
+				exp.reset_to_rvalue_constant(location, symbol.constant, symbol.type);
+			}
 		}
 		else
 		{
@@ -989,7 +1090,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 				return false;
 
 			location = std::move(_token.location);
-			const auto subscript = std::move(_token.literal_as_string);
+			const std::string subscript(_token.literal_as_string);
 
 			if (accept('(')) // Methods (function calls on types) are not supported right now
 			{
@@ -1473,3 +1574,33 @@ bool reshadefx::parser::parse_expression_assignment(expression &lhs)
 
 	return true;
 }
+
+bool reshadefx::parser::parse_runtime_dependent_initializer(const runtime_dependent_constant &constant_info, expression &exp)
+{
+	// Switch input over to the tokens of the initializer, which are terminated by an end of file token
+	std::unique_ptr<lexer> input_lexer = std::move(_lexer);
+	std::vector<token> input_tokens = std::exchange(_input_tokens, constant_info.initializer);
+	const size_t input_token_index = std::exchange(_input_token_index, 0);
+	const size_t lexer_backup_offset = _lexer_backup_offset;
+	token current_token = std::move(_token), next_token = std::move(_token_next), backup_token = std::move(_token_backup);
+
+	// Resolve symbols in the scope the constant was declared in, so that the result matches the constant value
+	const scope previous_scope = exchange_scope(constant_info.scope);
+
+	consume();
+
+	const bool parse_success = parse_expression_assignment(exp);
+	assert(!parse_success || peek(tokenid::end_of_file));
+
+	exchange_scope(previous_scope);
+
+	_lexer = std::move(input_lexer);
+	_input_tokens = std::move(input_tokens);
+	_input_token_index = input_token_index;
+	_lexer_backup_offset = lexer_backup_offset;
+	_token = std::move(current_token);
+	_token_next = std::move(next_token);
+	_token_backup = std::move(backup_token);
+
+	return parse_success;
+}
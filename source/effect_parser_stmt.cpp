@@ -20,10 +20,33 @@ struct on_scope_exit
 bool reshadefx::parser::parse(std::string input, codegen *backend)
 {
 	_lexer.reset(new lexer(std::move(input)));
+	_input_tokens.clear();
 
 	// Set backend for subsequent code-generation
 	_codegen = backend;
 
+	return parse_input();
+}
+bool reshadefx::parser::parse(std::vector<token> tokens, codegen *backend)
+{
+	_lexer.reset();
+	_input_tokens = std::move(tokens);
+	_input_token_index = 0;
+
+	if (_input_tokens.empty() || _input_tokens.back() != tokenid::end_of_file)
+	{
+		token &eof_token = _input_tokens.emplace_back();
+		eof_token.id = tokenid::end_of_file;
+		eof_token.offset = eof_token.length = 0;
+	}
+
+	// Set backend for subsequent code-generation
+	_codegen = backend;
+
+	return parse_input();
+}
+bool reshadefx::parser::parse_input()
+{
 	consume();
 
 	bool parse_success = true;
@@ -46,7 +69,7 @@ void reshadefx::parser::parse_top(bool &parse_success)
 			return;
 		}
 
-		const auto name = std::move(_token.literal_as_string);
+		const std::string name(_token.literal_as_string);
 
 		if (!expect('{'))
 		{
@@ -87,7 +110,7 @@ void reshadefx::parser::parse_top(bool &parse_success)
 
 			if (peek('('))
 			{
-				const auto name = std::move(_token.literal_as_string);
+				const std::string name(_token.literal_as_string);
 				// This is definitely a function declaration, so parse it
 				if (!parse_function(type, name))
 				{
@@ -107,7 +130,7 @@ void reshadefx::parser::parse_top(bool &parse_success)
 						parse_success = false;
 						return;
 					}
-					const auto name = std::move(_token.literal_as_string);
+					const std::string name(_token.literal_as_string);
 					if (!parse_variable(type, name, true))
 					{
 						// Insert dummy variable into symbol table, so later references can be resolved despite the error
@@ -159,7 +182,7 @@ bool reshadefx::parser::parse_statement(bool scoped)
 			dont_flatten = 0x8,
 		};
 
-		const auto attribute = std::move(_token_next.literal_as_string);
+		const auto attribute = _token_next.literal_as_string;
 
 		if (!expect(tokenid::identifier) || !expect(']'))
 			return false;
@@ -281,7 +304,10 @@ bool reshadefx::parser::parse_statement(bool scoped)
 					if (_token.id == tokenid::case_)
 					{
 						expression case_label;
-						if (!parse_expression(case_label))
+						_constant_expression_level++;
+						const bool case_label_success = parse_expression(case_label);
+						_constant_expression_level--;
+						if (!case_label_success)
 							return consume_until('}'), false;
 						else if (!case_label.type.is_scalar() || !case_label.type.is_integral() || !case_label.is_constant)
 							return error(case_label.location, 3020, "invalid type for case expression - value must be an integer scalar"), consume_until('}'), false;
@@ -379,7 +405,7 @@ bool reshadefx::parser::parse_statement(bool scoped)
 				do { // There may be multiple declarations behind a type, so loop through them
 					if (count++ > 0 && !expect(','))
 						return false;
-					if (!expect(tokenid::identifier) || !parse_variable(type, std::move(_token.literal_as_string)))
+					if (!expect(tokenid::identifier) || !parse_variable(type, std::string(_token.literal_as_string)))
 						return false;
 				} while (!peek(';'));
 			}
@@ -701,7 +727,7 @@ bool reshadefx::parser::parse_statement(bool scoped)
 			if (count++ > 0 && !expect(','))
 				// Try to consume the rest of the declaration so that parsing may continue despite the error
 				return consume_until(';'), false;
-			if (!expect(tokenid::identifier) || !parse_variable(type, std::move(_token.literal_as_string)))
+			if (!expect(tokenid::identifier) || !parse_variable(type, std::string(_token.literal_as_string)))
 				return consume_until(';'), false;
 		} while (!peek(';'));
 
@@ -792,8 +818,15 @@ bool reshadefx::parser::parse_array_size(type &type)
 			// No length expression, so this is an unsized array
 			type.array_length = -1;
 		}
-		else if (expression expression; parse_expression(expression) && expect(']'))
+		else
 		{
+			expression expression;
+			_constant_expression_level++;
+			const bool expression_success = parse_expression(expression);
+			_constant_expression_level--;
+			if (!expression_success || !expect(']'))
+				return false;
+
 			if (!expression.is_constant || !(expression.type.is_scalar() && expression.type.is_integral()))
 				return error(expression.location, 3058, "array dimensions must be literal scalar expressions"), false;
 
@@ -802,10 +835,6 @@ bool reshadefx::parser::parse_array_size(type &type)
 			if (type.array_length < 1 || type.array_length > 65536)
 				return error(expression.location, 3059, "array dimension must be between 1 and 65536"), false;
 		}
-		else
-		{
-			return false;
-		}
 	}
 
 	// Multi-dimensional arrays are not supported
@@ -831,7 +860,7 @@ bool reshadefx::parser::parse_annotations(std::vector<annotation> &annotations)
 		if (!expect(tokenid::identifier))
 			return consume_until('>'), false;
 
-		auto name = std::move(_token.literal_as_string);
+		std::string name(_token.literal_as_string);
 
 		if (expression expression; !expect('=') || !parse_expression_multary(expression) || !expect(';'))
 			return consume_until('>'), false;
@@ -852,7 +881,7 @@ bool reshadefx::parser::parse_struct()
 	struct_info info;
 	// The structure name is optional
 	if (accept(tokenid::identifier))
-		info.name = std::move(_token.literal_as_string);
+		info.name = _token.literal_as_string;
 	else
 		info.name = "_anonymous_struct_" + std::to_string(location.line) + '_' + std::to_string(location.column);
 
@@ -879,7 +908,7 @@ bool reshadefx::parser::parse_struct()
 			if (!expect(tokenid::identifier))
 				return consume_until('}'), accept(';'), false;
 
-			member.name = std::move(_token.literal_as_string);
+			member.name = _token.literal_as_string;
 			member.location = std::move(_token.location);
 
 			if (member.type.is_void())
@@ -921,7 +950,7 @@ bool reshadefx::parser::parse_struct()
 				if (!expect(tokenid::identifier))
 					return consume_until('}'), accept(';'), false;
 
-				member.semantic = std::move(_token.literal_as_string);
+				member.semantic = _token.literal_as_string;
 				// Make semantic upper case to simplify comparison later on
 				std::transform(member.semantic.begin(), member.semantic.end(), member.semantic.begin(), [](char c) { return static_cast<char>(toupper(c)); });
 
@@ -1020,7 +1049,7 @@ bool reshadefx::parser::parse_function(type type, std::string name)
 			break;
 		}
 
-		param.name = std::move(_token.literal_as_string);
+		param.name = _token.literal_as_string;
 		param.location = std::move(_token.location);
 
 		if (param.type.is_void())
@@ -1070,7 +1099,7 @@ bool reshadefx::parser::parse_function(type type, std::string name)
 				break;
 			}
 
-			param.semantic = std::move(_token.literal_as_string);
+			param.semantic = _token.literal_as_string;
 			// Make semantic upper case to simplify comparison later on
 			std::transform(param.semantic.begin(), param.semantic.end(), param.semantic.begin(), [](char c) { return static_cast<char>(toupper(c)); });
 
@@ -1102,7 +1131,7 @@ bool reshadefx::parser::parse_function(type type, std::string name)
 		if (type.is_void())
 			return error(_token.location, 3076, '\'' + name + "': void function cannot have a semantic"), false;
 
-		info.return_semantic = std::move(_token.literal_as_string);
+		info.return_semantic = _token.literal_as_string;
 		// Make semantic upper case to simplify comparison later on
 		std::transform(info.return_semantic.begin(), info.return_semantic.end(), info.return_semantic.begin(), [](char c) { return static_cast<char>(toupper(c)); });
 	}
@@ -1200,6 +1229,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 	texture_info texture_info;
 	sampler_info sampler_info;
 	storage_info storage_info;
+	std::vector<token> runtime_dependent_initializer;
 
 	if (accept(':'))
 	{
@@ -1209,7 +1239,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 			return error(_token.location, 3043, '\'' + name + "': local variables cannot have semantics"), false;
 
 		std::string &semantic = texture_info.semantic;
-		semantic = std::move(_token.literal_as_string);
+		semantic = _token.literal_as_string;
 
 		// Make semantic upper case to simplify comparison later on
 		std::transform(semantic.begin(), semantic.end(), semantic.begin(), [](char c) { return static_cast<char>(toupper(c)); });
@@ -1223,9 +1253,59 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 		// Variables without a semantic may have an optional initializer
 		if (accept('='))
 		{
+			const token initializer_token = _token_next;
+			const size_t initializer_offset = _lexer != nullptr ? _lexer->input_offset() : _input_token_index;
+			const unsigned int baked_runtime_constants = _baked_runtime_constants;
+			const unsigned int runtime_constant_reads = _runtime_constant_reads;
+			const unsigned int variable_references = _variable_references;
+
 			if (!parse_expression_assignment(initializer))
 				return false;
 
+			// Keep the initializer tokens of constants that depend on a runtime constant, so that they can be parsed again where the constant is used in code
+			// Global constants have the runtime constant baked in, local ones read it from its uniform variable instead, which makes the initializer not constant
+			if (type.has(type::q_const) && (global ?
+				baked_runtime_constants != _baked_runtime_constants :
+				!initializer.is_constant && runtime_constant_reads != _runtime_constant_reads && variable_references == _variable_references))
+			{
+				const size_t end_offset = _lexer != nullptr ? _lexer->input_offset() : _input_token_index;
+
+				// Rewind to the start of the initializer and consume it again to collect its tokens
+				if (_lexer != nullptr)
+					_lexer->reset_to_offset(initializer_offset);
+				else
+					_input_token_index = initializer_offset;
+				_token_next = initializer_token;
+
+				while ((_lexer != nullptr ? _lexer->input_offset() : _input_token_index) != end_offset)
+				{
+					runtime_dependent_initializer.push_back(_token_next);
+					consume();
+				}
+
+				token &eof_token = runtime_dependent_initializer.emplace_back();
+				eof_token.id = tokenid::end_of_file;
+				eof_token.offset = eof_token.length = 0;
+
+				// Evaluate the initializer of local constants again with the runtime constants baked in, to get the value used where a constant is required
+				// This has no side effects, since the initializer does not reference any variables or call any functions
+				if (!global)
+				{
+					expression constant_initializer;
+					_constant_expression_level++;
+					const bool constant_success = parse_runtime_dependent_initializer({ runtime_dependent_initializer, current_scope() }, constant_initializer);
+					_constant_expression_level--;
+
+					if (constant_success && constant_initializer.is_constant)
+						initializer = std::move(constant_initializer);
+					else // Not constant even with the values baked in (e.g. because of an intrinsic that cannot be evaluated at compile time), so this stays a variable
+						runtime_dependent_initializer.clear();
+				}
+
+				// The values baked in above only end up in the result where the constant is used in a constant expression, which counts them again there
+				_baked_runtime_constants = baked_runtime_constants;
+			}
+
 			if (type.has(type::q_groupshared))
 				return error(initializer.location, 3009, '\'' + name + "': variables declared 'groupshared' cannot have an initializer"), false;
 			// TODO: This could be resolved by initializing these at the beginning of the entry point
@@ -1266,7 +1346,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 				if (!expect(tokenid::identifier))
 					return consume_until('}'), false;
 
-				const auto property_name = std::move(_token.literal_as_string);
+				const std::string property_name(_token.literal_as_string);
 				const auto property_location = std::move(_token.location);
 
 				if (!expect('='))
@@ -1279,7 +1359,8 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 				if (accept(tokenid::identifier)) // Handle special enumeration names for property values
 				{
 					// Transform identifier to uppercase to do case-insensitive comparison
-					std::transform(_token.literal_as_string.begin(), _token.literal_as_string.end(), _token.literal_as_string.begin(), [](char c) { return static_cast<char>(toupper(c)); });
+					std::string value(_token.literal_as_string);
+					std::transform(value.begin(), value.end(), value.begin(), [](char c) { return static_cast<char>(toupper(c)); });
 
 					static const std::unordered_map<std::string, uint32_t> s_values = {
 						{ "NONE", 0 }, { "POINT", 0 },
@@ -1303,7 +1384,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 					};
 
 					// Look up identifier in list of possible enumeration names
-					if (const auto it = s_values.find(_token.literal_as_string);
+					if (const auto it = s_values.find(value);
 						it != s_values.end())
 						expression.reset_to_rvalue_constant(_token.location, it->second);
 					else // No match found, so rewind to parser state before the identifier was consumed and try parsing it as a normal expression
@@ -1396,6 +1477,13 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 	{
 		// Named constants are special symbols
 		symbol = { symbol_type::constant, 0, type, initializer.constant };
+
+		// Identify constants depending on a runtime constant, so that they can be parsed again from their initializer (see 'parse_runtime_dependent_initializer')
+		if (!runtime_dependent_initializer.empty())
+		{
+			_runtime_dependent_constants.push_back({ std::move(runtime_dependent_initializer), current_scope() });
+			symbol.id = static_cast<uint32_t>(_runtime_dependent_constants.size());
+		}
 	}
 	else if (type.is_texture())
 	{
@@ -1484,7 +1572,7 @@ bool reshadefx::parser::parse_technique()
 		return false;
 
 	technique_info info;
-	info.name = std::move(_token.literal_as_string);
+	info.name = _token.literal_as_string;
 
 	bool parse_success = parse_annotations(info.annotations);
 
@@ -1515,7 +1603,7 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 
 	// Passes can have an optional name
 	if (accept(tokenid::identifier))
-		info.name = std::move(_token.literal_as_string);
+		info.name = _token.literal_as_string;
 
 	bool parse_success = true;
 	bool targets_support_srgb = true;
@@ -1531,7 +1619,7 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 			return consume_until('}'), false;
 
 		auto location = std::move(_token.location);
-		const auto state = std::move(_token.literal_as_string);
+		const std::string state(_token.literal_as_string);
 
 		if (!expect('='))
 			return consume_until('}'), false;
@@ -1600,16 +1688,19 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 							vs_info = function_info;
 							_codegen->define_entry_point(vs_info, shader_type::vs);
 							info.vs_entry_point = vs_info.unique_name;
+							_codegen->mark_referenced(vs_info);
 							break;
 						case 'P':
 							ps_info = function_info;
 							_codegen->define_entry_point(ps_info, shader_type::ps);
 							info.ps_entry_point = ps_info.unique_name;
+							_codegen->mark_referenced(ps_info);
 							break;
 						case 'C':
 							cs_info = function_info;
 							_codegen->define_entry_point(cs_info, shader_type::cs, num_threads);
 							info.cs_entry_point = cs_info.unique_name;
+							_codegen->mark_referenced(cs_info);
 							break;
 						}
 					}
@@ -1660,7 +1751,8 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 			if (accept(tokenid::identifier)) // Handle special enumeration names for pass states
 			{
 				// Transform identifier to uppercase to do case-insensitive comparison
-				std::transform(_token.literal_as_string.begin(), _token.literal_as_string.end(), _token.literal_as_string.begin(), [](char c) { return static_cast<char>(toupper(c)); });
+				std::string value(_token.literal_as_string);
+				std::transform(value.begin(), value.end(), value.begin(), [](char c) { return static_cast<char>(toupper(c)); });
 
 				static const std::unordered_map<std::string, uint32_t> s_enum_values = {
 					{ "NONE", 0 }, { "ZERO", 0 }, { "ONE", 1 },
@@ -1703,7 +1795,7 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 				};
 
 				// Look up identifier in list of possible enumeration names
-				if (const auto it = s_enum_values.find(_token.literal_as_string);
+				if (const auto it = s_enum_values.find(value);
 					it != s_enum_values.end())
 					expression.reset_to_rvalue_constant(_token.location, it->second);
 				else // No match found, so rewind to parser state before the identifier was consumed and try parsing it as a normal expression
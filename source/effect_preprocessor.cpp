@@ -6,7 +6,12 @@
 #include "effect_lexer.hpp"
 #include "effect_preprocessor.hpp"
 #include <cassert>
-#include <algorithm> // std::find_if
+#include <algorithm> // std::count, std::find_if
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread> // std::this_thread::get_id
+#include <cstring> // std::memcmp, std::memcpy
 
 #ifndef _WIN32
 	// On Linux systems the native path encoding is UTF-8 already, so no conversion necessary
@@ -75,29 +80,320 @@ static bool read_file(const std::filesystem::path &path, std::string &data)
 		return false;
 #endif
 
-	// Read file contents into memory
-	std::vector<char> file_mem(static_cast<size_t>(std::filesystem::file_size(path) + 1));
-	const size_t eof = fread(file_mem.data(), 1, file_mem.size() - 1, file);
+	// Read file contents straight into the input string, instead of copying them over from a temporary buffer
+	// Mapping the file would not save anything here, since the lexer needs the input to end with a new line and a null character, so it has to be copied either way
+	std::error_code ec;
+	const uintmax_t file_size = std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		fclose(file);
+		return false;
+	}
+
+	data.resize(static_cast<size_t>(file_size) + 1);
+	data.resize(fread(data.data(), 1, data.size() - 1, file) + 1);
 
 	// Append a new line feed to the end of the input string to avoid issues with parsing
-	file_mem[eof] = '\n';
+	data.back() = '\n';
 
 	// No longer need to have a handle open to the file, since all data was read, so can safely close it
 	fclose(file);
 
-	std::string_view file_data(file_mem.data(), file_mem.size());
-
 	// Remove BOM (0xefbbbf means 0xfeff)
-	if (file_data.size() >= 3 &&
-		static_cast<unsigned char>(file_data[0]) == 0xef &&
-		static_cast<unsigned char>(file_data[1]) == 0xbb &&
-		static_cast<unsigned char>(file_data[2]) == 0xbf)
-		file_data = std::string_view(file_data.data() + 3, file_data.size() - 3);
+	if (data.size() >= 3 &&
+		static_cast<unsigned char>(data[0]) == 0xef &&
+		static_cast<unsigned char>(data[1]) == 0xbb &&
+		static_cast<unsigned char>(data[2]) == 0xbf)
+		data.erase(0, 3);
 
-	data = file_data;
 	return true;
 }
 
+// Include cache that is shared between all preprocessor instances, so that common header files are only read once even when many effects are compiled in parallel
+struct include_cache_entry
+{
+	std::filesystem::file_time_type modified_time;
+	uintmax_t size;
+	std::shared_ptr<const std::string> data;
+};
+
+static std::shared_mutex s_include_cache_mutex;
+static std::unordered_map<std::string, include_cache_entry> s_include_cache;
+static std::atomic<size_t> s_include_cache_hits = 0;
+static std::atomic<size_t> s_include_cache_misses = 0;
+
+static std::shared_ptr<const std::string> read_include_file(const std::filesystem::path &path)
+{
+	std::error_code ec;
+	// Use the canonical path as key, so that different relative paths to the same file share an entry
+	const std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, ec);
+	const std::string key = (ec ? path : canonical_path).u8string();
+	// Compare modification time and size, so that changes to a file are picked up even if the cache was not cleared
+	const std::filesystem::file_time_type modified_time = std::filesystem::last_write_time(path, ec);
+	const uintmax_t size = std::filesystem::file_size(path, ec);
+
+	{ const std::shared_lock<std::shared_mutex> lock(s_include_cache_mutex);
+		if (const auto it = s_include_cache.find(key);
+			it != s_include_cache.end() && it->second.modified_time == modified_time && it->second.size == size)
+		{
+			s_include_cache_hits++;
+			return it->second.data;
+		}
+	}
+
+	// Read file outside the lock, so that other threads are not blocked by the disk access
+	std::string data;
+	if (!read_file(path, data))
+		return nullptr;
+
+	s_include_cache_misses++;
+
+	auto shared_data = std::make_shared<const std::string>(std::move(data));
+
+	const std::unique_lock<std::shared_mutex> lock(s_include_cache_mutex);
+	s_include_cache[key] = { modified_time, size, shared_data };
+
+	return shared_data;
+}
+
+// Precompiled header snapshot, which holds all state changes of a preprocessor instance caused by including a header file
+struct include_snapshot
+{
+	struct file_entry
+	{
+		std::string path;
+		bool pragma_once;
+		int64_t modified_time;
+		uint64_t size;
+	};
+
+	std::unordered_map<std::string, reshadefx::preprocessor::macro> macros;
+	std::string output;
+	std::string output_source;
+	unsigned int output_line;
+	unsigned int output_token_line;
+	size_t skipped_includes;
+	std::vector<file_entry> files;
+	std::vector<std::pair<std::string, std::string>> include_guards;
+	std::vector<std::string> used_macros;
+};
+
+static const char s_snapshot_magic[8] = { 'R', 'F', 'X', 'P', 'C', 'H', '0', '1' };
+
+// Snapshots are kept in memory after they were first read or written, so that other preprocessor instances do not have to read them from disk again
+static std::shared_mutex s_snapshot_cache_mutex;
+static std::unordered_map<std::string, std::shared_ptr<const include_snapshot>> s_snapshot_cache;
+
+static int64_t file_modified_time(const std::filesystem::path &path)
+{
+	std::error_code ec;
+	return static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+}
+
+static void write_value(FILE *file, uint64_t value)
+{
+	fwrite(&value, sizeof(value), 1, file);
+}
+static void write_string(FILE *file, std::string_view value)
+{
+	write_value(file, value.size());
+	fwrite(value.data(), 1, value.size(), file);
+}
+static bool read_value(FILE *file, uint64_t &value)
+{
+	return fread(&value, sizeof(value), 1, file) == 1;
+}
+// Reads the number of elements that follow and checks that the rest of the file can hold them, so that corrupted counts are caught before allocating
+static bool read_count(FILE *file, uint64_t file_size, uint64_t min_element_size, uint64_t &count)
+{
+	if (!read_value(file, count))
+		return false;
+	const long offset = ftell(file);
+	return offset >= 0 && static_cast<uint64_t>(offset) <= file_size && count <= (file_size - static_cast<uint64_t>(offset)) / min_element_size;
+}
+static bool read_string(FILE *file, uint64_t file_size, std::string &value)
+{
+	uint64_t size = 0;
+	if (!read_count(file, file_size, 1, size))
+		return false;
+	value.resize(static_cast<size_t>(size));
+	return fread(value.data(), 1, value.size(), file) == value.size();
+}
+
+static bool write_snapshot(const std::filesystem::path &path, const include_snapshot &snapshot)
+{
+	// Write to a temporary file first and then move it in place, so that other instances never read a partially written snapshot
+	std::filesystem::path temp_path = path;
+	temp_path += '.' + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+#ifdef _WIN32
+	FILE *file = nullptr;
+	if (_wfopen_s(&file, temp_path.c_str(), L"wb") != 0)
+		return false;
+#else
+	FILE *const file = fopen(temp_path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+#endif
+
+	fwrite(s_snapshot_magic, 1, sizeof(s_snapshot_magic), file);
+
+	write_value(file, snapshot.macros.size());
+	for (const auto &[name, macro] : snapshot.macros)
+	{
+		write_string(file, name);
+		write_string(file, macro.replacement_list);
+		write_value(file, macro.parameters.size());
+		for (const std::string &parameter : macro.parameters)
+			write_string(file, parameter);
+		write_value(file, (macro.is_variadic ? 1 : 0) | (macro.is_function_like ? 2 : 0));
+	}
+
+	write_string(file, snapshot.output);
+	write_string(file, snapshot.output_source);
+	write_value(file, snapshot.output_line);
+	write_value(file, snapshot.output_token_line);
+	write_value(file, snapshot.skipped_includes);
+
+	write_value(file, snapshot.files.size());
+	for (const auto &entry : snapshot.files)
+	{
+		write_string(file, entry.path);
+		write_value(file, entry.pragma_once ? 1 : 0);
+		write_value(file, static_cast<uint64_t>(entry.modified_time));
+		write_value(file, entry.size);
+	}
+
+	write_value(file, snapshot.include_guards.size());
+	for (const auto &[file_path, macro_name] : snapshot.include_guards)
+	{
+		write_string(file, file_path);
+		write_string(file, macro_name);
+	}
+
+	write_value(file, snapshot.used_macros.size());
+	for (const std::string &name : snapshot.used_macros)
+		write_string(file, name);
+
+	const bool success = ferror(file) == 0;
+	fclose(file);
+
+	std::error_code ec;
+	if (success)
+		std::filesystem::rename(temp_path, path, ec);
+	if (!success || ec)
+		std::filesystem::remove(temp_path, ec);
+	return success && !ec;
+}
+static std::shared_ptr<const include_snapshot> read_snapshot(const std::filesystem::path &path)
+{
+	const std::string key = path.u8string();
+
+	{ const std::shared_lock<std::shared_mutex> lock(s_snapshot_cache_mutex);
+		if (const auto it = s_snapshot_cache.find(key); it != s_snapshot_cache.end())
+			return it->second;
+	}
+
+#ifdef _WIN32
+	FILE *file = nullptr;
+	if (_wfopen_s(&file, path.c_str(), L"rb") != 0)
+		return nullptr;
+#else
+	FILE *const file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return nullptr;
+#endif
+
+	std::error_code ec;
+	const uint64_t file_size = std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		fclose(file);
+		return nullptr;
+	}
+
+	const auto snapshot = std::make_shared<include_snapshot>();
+
+	const auto read_snapshot_data = [file, file_size, &data = *snapshot]() {
+		char magic[sizeof(s_snapshot_magic)] = {};
+		if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, s_snapshot_magic, sizeof(magic)) != 0)
+			return false;
+
+		uint64_t count = 0, value = 0;
+		// Counts are checked against the smallest size an element can take up in the file (one value per field)
+		if (!read_count(file, file_size, 4 * sizeof(uint64_t), count))
+			return false;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			std::string name;
+			reshadefx::preprocessor::macro macro;
+			if (!read_string(file, file_size, name) || !read_string(file, file_size, macro.replacement_list) || !read_count(file, file_size, sizeof(uint64_t), value))
+				return false;
+			macro.parameters.resize(static_cast<size_t>(value));
+			for (std::string &parameter : macro.parameters)
+				if (!read_string(file, file_size, parameter))
+					return false;
+			if (!read_value(file, value))
+				return false;
+			macro.is_variadic = (value & 1) != 0;
+			macro.is_function_like = (value & 2) != 0;
+			data.macros.emplace(std::move(name), std::move(macro));
+		}
+
+		if (!read_string(file, file_size, data.output) || !read_string(file, file_size, data.output_source))
+			return false;
+		if (!read_value(file, value))
+			return false;
+		data.output_line = static_cast<unsigned int>(value);
+		if (!read_value(file, value))
+			return false;
+		data.output_token_line = static_cast<unsigned int>(value);
+		if (!read_value(file, value))
+			return false;
+		data.skipped_includes = static_cast<size_t>(value);
+
+		if (!read_count(file, file_size, 4 * sizeof(uint64_t), count))
+			return false;
+		data.files.resize(static_cast<size_t>(count));
+		for (auto &entry : data.files)
+		{
+			if (!read_string(file, file_size, entry.path) || !read_value(file, value))
+				return false;
+			entry.pragma_once = value != 0;
+			if (!read_value(file, value))
+				return false;
+			entry.modified_time = static_cast<int64_t>(value);
+			if (!read_value(file, entry.size))
+				return false;
+		}
+
+		if (!read_count(file, file_size, 2 * sizeof(uint64_t), count))
+			return false;
+		data.include_guards.resize(static_cast<size_t>(count));
+		for (auto &[file_path, macro_name] : data.include_guards)
+			if (!read_string(file, file_size, file_path) || !read_string(file, file_size, macro_name))
+				return false;
+
+		if (!read_count(file, file_size, sizeof(uint64_t), count))
+			return false;
+		data.used_macros.resize(static_cast<size_t>(count));
+		for (std::string &name : data.used_macros)
+			if (!read_string(file, file_size, name))
+				return false;
+
+		return true;
+	};
+
+	const bool success = read_snapshot_data();
+	fclose(file);
+
+	if (!success)
+		return nullptr;
+
+	const std::unique_lock<std::shared_mutex> lock(s_snapshot_cache_mutex);
+	return s_snapshot_cache.emplace(key, snapshot).first->second;
+}
+
 static std::string escape_string(std::string s)
 {
 	for (size_t offset = 0; (offset = s.find('\\', offset)) != std::string::npos; offset += 2)
@@ -105,6 +401,49 @@ static std::string escape_string(std::string s)
 	return '\"' + s + '\"';
 }
 
+static reshadefx::lexer create_expansion_lexer(std::string_view text)
+{
+	// Text that is lexed during macro expansion never starts a new line, so start past the first column (otherwise leading whitespace would be skipped and a '#' would become a directive)
+	return reshadefx::lexer(text,
+		true  /* ignore_comments */,
+		false /* ignore_whitespace */,
+		false /* ignore_pp_directives */,
+		false /* ignore_line_directives */,
+		true  /* ignore_keywords */,
+		false /* escape_string_literals */,
+		reshadefx::location(1, 2));
+}
+
+static void lex_replacement_list(reshadefx::preprocessor::macro &macro)
+{
+	reshadefx::lexer lexer = create_expansion_lexer(macro.replacement_list);
+
+	for (size_t offset = 0; offset < macro.replacement_list.size();)
+	{
+		// Special replacement sequences become a token without any text, which no lexer produces, so that 'expand_macro' can find them by their offset
+		if (macro.replacement_list[offset] == macro_replacement_start)
+		{
+			reshadefx::token &tok = macro.replacement_tokens.emplace_back();
+			tok.id = reshadefx::tokenid::unknown;
+			tok.offset = offset;
+			tok.length = 0;
+
+			offset += macro.replacement_list[offset + 1] == macro_replacement_concat ? 2 : 3;
+			continue;
+		}
+
+		// The lexer stops at the null character that starts a special replacement sequence, so skip over those and continue after them
+		lexer.reset_to_offset(offset);
+		reshadefx::token tok = lexer.lex();
+		offset = tok.offset + tok.length;
+		if (tok == reshadefx::tokenid::end_of_file)
+			continue;
+
+		tok.literal_as_string = {};
+		macro.replacement_tokens.push_back(std::move(tok));
+	}
+}
+
 reshadefx::preprocessor::preprocessor()
 {
 }
@@ -112,6 +451,12 @@ reshadefx::preprocessor::~preprocessor()
 {
 }
 
+void reshadefx::preprocessor::add_precompiled_header(const std::string &name, const std::filesystem::path &snapshot_directory)
+{
+	assert(!name.empty());
+	_precompiled_headers[name] = snapshot_directory;
+}
+
 void reshadefx::preprocessor::add_include_path(const std::filesystem::path &path)
 {
 	assert(!path.empty());
@@ -122,6 +467,11 @@ bool reshadefx::preprocessor::add_macro_definition(const std::string &name, cons
 	assert(!name.empty());
 	return _macros.emplace(name, macro).second;
 }
+void reshadefx::preprocessor::add_runtime_constant(const std::string &name, int value)
+{
+	assert(!name.empty());
+	_runtime_constants[name] = value;
+}
 
 bool reshadefx::preprocessor::append_file(const std::filesystem::path &path)
 {
@@ -131,7 +481,7 @@ bool reshadefx::preprocessor::append_file(const std::filesystem::path &path)
 
 	_success = true; // Clear success flag before parsing a new file
 
-	push(std::move(data), path.u8string());
+	push(std::make_shared<const std::string>(std::move(data)), path.u8string());
 	parse();
 
 	return _success;
@@ -152,6 +502,22 @@ bool reshadefx::preprocessor::append_string(const std::string &source_code)
 	return _success;
 }
 
+void reshadefx::preprocessor::clear_include_cache()
+{
+	{ const std::unique_lock<std::shared_mutex> lock(s_include_cache_mutex);
+		s_include_cache.clear();
+		s_include_cache_hits = 0;
+		s_include_cache_misses = 0;
+	}
+
+	const std::unique_lock<std::shared_mutex> lock(s_snapshot_cache_mutex);
+	s_snapshot_cache.clear();
+}
+reshadefx::preprocessor::include_cache_statistics reshadefx::preprocessor::include_cache_stats()
+{
+	return { s_include_cache_hits.load(), s_include_cache_misses.load() };
+}
+
 std::vector<std::filesystem::path> reshadefx::preprocessor::included_files() const
 {
 	std::vector<std::filesystem::path> files;
@@ -171,26 +537,87 @@ std::vector<std::pair<std::string, std::string>> reshadefx::preprocessor::used_m
 			defines.push_back({ name, it->second.replacement_list });
 	return defines;
 }
+bool reshadefx::preprocessor::runtime_constants_evaluated() const
+{
+	// Evaluated runtime constants are tracked with the used macros, so that this is restored along with them from precompiled header snapshots
+	for (const auto &it : _runtime_constants)
+		if (_used_macros.find(it.first) != _used_macros.end())
+			return true;
+	return false;
+}
 
 void reshadefx::preprocessor::error(const location &location, const std::string &message)
 {
-	_errors += location.source + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor error: " + message + '\n';
+	_errors += location.source_name() + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor error: " + message + '\n';
 	_success = false; // Unset success flag
 }
 void reshadefx::preprocessor::warning(const location &location, const std::string &message)
 {
-	_errors += location.source + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor warning: " + message + '\n';
+	_errors += location.source_name() + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor warning: " + message + '\n';
 }
 
-void reshadefx::preprocessor::push(std::string input, const std::string &name)
+void reshadefx::preprocessor::token_list::append(const token &tok, std::string_view raw, bool adjacent)
+{
+	entry e;
+	e.id = tok.id;
+	std::memcpy(&e.literal_as_double, &tok.literal_as_double, sizeof(e.literal_as_double));
+
+	append(e, raw, adjacent);
+}
+void reshadefx::preprocessor::token_list::append(const entry &tok, std::string_view raw, bool adjacent)
+{
+	// Leave a gap between tokens that did not follow each other in their input, so that 'add_output_token' sees that they may merge into one token in the output string
+	// Whitespace never merges with anything, so it is added without a gap, which lets 'lex_token_list' merge consecutive whitespace instead
+	if (!adjacent && tok != tokenid::space && !tokens.empty())
+		data += '\0';
+
+	entry &e = tokens.emplace_back(tok);
+	e.offset = static_cast<uint32_t>(data.size());
+	e.length = static_cast<uint32_t>(raw.size());
+	data += raw;
+}
+void reshadefx::preprocessor::token_list::append(const token_list &list, size_t first, size_t last, bool adjacent)
+{
+	if (first >= last)
+		return;
+
+	if (!adjacent && list.tokens[first] != tokenid::space && !tokens.empty())
+		data += '\0';
+
+	// Copy the text of all tokens at once, including the gaps between them, and move their offsets to where it was copied to
+	const uint32_t data_offset = static_cast<uint32_t>(data.size()) - list.tokens[first].offset;
+	data.append(list.data, list.tokens[first].offset, list.tokens[last - 1].offset + list.tokens[last - 1].length - list.tokens[first].offset);
+	const size_t token_offset = tokens.size();
+	tokens.insert(tokens.end(), list.tokens.begin() + first, list.tokens.begin() + last);
+	for (auto it = tokens.begin() + token_offset; it != tokens.end(); ++it)
+		it->offset += data_offset;
+}
+void reshadefx::preprocessor::token_list::pop_back()
 {
-	location start_location = !name.empty() ?
+	tokens.pop_back();
+	data.resize(tokens.empty() ? 0 : tokens.back().offset + tokens.back().length);
+}
+
+std::string_view reshadefx::preprocessor::input_level::input_string() const
+{
+	return lexer != nullptr ? lexer->input_string() : std::string_view(tokens->data);
+}
+
+reshadefx::location reshadefx::preprocessor::push_location(const std::string &name) const
+{
+	return !name.empty() ?
 		// Start at the beginning of the file when pushing a new file
 		location(name, 1) :
 		// Start with last known token location when pushing an unnamed string
 		_token.location;
+}
+
+void reshadefx::preprocessor::push(std::string input, const std::string &name)
+{
+	const location start_location = push_location(name);
 
-	input_level level = { name };
+	input_level level = {};
+	level.name = name;
 	level.lexer.reset(new lexer(
 		std::move(input),
 		true  /* ignore_comments */,
@@ -200,10 +627,53 @@ void reshadefx::preprocessor::push(std::string input, const std::string &name)
 		true  /* ignore_keywords */,
 		false /* escape_string_literals */,
 		start_location));
+
+	push(std::move(level), start_location);
+}
+void reshadefx::preprocessor::push(std::shared_ptr<const std::string> input, const std::string &name)
+{
+	const location start_location = push_location(name);
+
+	// Let the lexer work directly on the shared string instead of copying it
+	input_level level = {};
+	level.name = name;
+	level.lexer.reset(new lexer(
+		std::string_view(*input),
+		true  /* ignore_comments */,
+		false /* ignore_whitespace */,
+		false /* ignore_pp_directives */,
+		false /* ignore_line_directives */,
+		true  /* ignore_keywords */,
+		false /* escape_string_literals */,
+		start_location));
+	if (_token_output)
+		_output_files.push_back(input);
+	level.file_data = std::move(input);
+
+	push(std::move(level), start_location);
+}
+void reshadefx::preprocessor::push(std::shared_ptr<const token_list> tokens, size_t first, size_t last)
+{
+	const location start_location = push_location(std::string());
+
+	// Read the tokens directly instead of lexing their text again
+	input_level level = {};
+	level.tokens = std::move(tokens);
+	level.token_index = first;
+	level.token_end = last;
+	level.token_location = start_location;
+
+	push(std::move(level), start_location);
+}
+void reshadefx::preprocessor::push(input_level &&level, const location &start_location)
+{
+	if (!level.name.empty())
+		level.source = start_location.source;
+	level.serial = ++_input_serial;
 	level.next_token.id = tokenid::unknown;
 	level.next_token.location = start_location; // This is used in 'consume' to initialize the output location
 
-	// Inherit hidden macros from parent
+	// Inherit hidden macros from parent (this only copies the pointer to the head of the list)
 	if (!_input_stack.empty())
 		level.hidden_macros = _input_stack.back().hidden_macros;
 
@@ -214,6 +684,71 @@ void reshadefx::preprocessor::push(std::string input, const std::string &name)
 	consume();
 }
 
+void reshadefx::preprocessor::lex_token_list(input_level &input)
+{
+	const token_list &list = *input.tokens;
+
+	// Write directly into the next token of the input level, rather than copying a temporary into it
+	token &tok = input.next_token;
+	while (input.token_index < input.token_end)
+	{
+		const token_list::entry &e = list.tokens[input.token_index++];
+		tok.id = e.id;
+		tok.offset = e.offset;
+		tok.length = e.length;
+		std::memcpy(&tok.literal_as_double, &e.literal_as_double, sizeof(tok.literal_as_double));
+		tok.literal_as_string = {};
+
+		// Consecutive whitespace is added without a gap in between, so it can be merged into a single token like the lexer does
+		if (tok == tokenid::space)
+			while (input.token_index < input.token_end && list.tokens[input.token_index] == tokenid::space)
+				tok.length += list.tokens[input.token_index++].length;
+
+		const std::string_view raw = std::string_view(list.data).substr(tok.offset, tok.length);
+
+		// Assign locations as if the text of the tokens was lexed again starting at the location they were pushed at, since line breaks in macro arguments affect the #line directives in the output
+		tok.location = input.token_location;
+		if (tok == tokenid::end_of_line)
+		{
+			input.token_location.line++;
+			input.token_location.column = 1;
+		}
+		else
+		{
+			input.token_location.column += static_cast<unsigned int>(tok.length);
+			if (tok == tokenid::string_literal) // String literals can continue on the next line
+				input.token_location.line += static_cast<unsigned int>(std::count(raw.begin(), raw.end(), '\n'));
+		}
+
+		switch (tok)
+		{
+		case tokenid::space:
+			// The lexer does not report whitespace at the beginning of a line or right before a line break either
+			if (tok.location.column <= 1 || (input.token_index < input.token_end && list.tokens[input.token_index] == tokenid::end_of_line))
+				continue;
+			break;
+		case tokenid::identifier:
+			tok.literal_as_string = raw;
+			break;
+		case tokenid::string_literal:
+			// Remove quotes (there is no closing one if the string literal is unterminated)
+			tok.literal_as_string = raw.substr(1, raw.size() - (raw.back() == '"' && raw.size() > 1 ? 2 : 1));
+			break;
+		default:
+			break;
+		}
+
+		return;
+	}
+
+	tok.id = tokenid::end_of_file;
+	tok.location = input.token_location;
+	tok.offset = list.data.size();
+	tok.length = 0;
+	tok.literal_as_double = 0;
+	tok.literal_as_string = {};
+}
+
 bool reshadefx::preprocessor::peek(tokenid token) const
 {
 	return _input_stack[_next_input_index].next_token == token;
@@ -229,25 +764,33 @@ bool reshadefx::preprocessor::consume()
 		return false;
 	}
 
+	// Save snapshot of a precompiled header as soon as the input returns to the file that included it
+	if (_pending_snapshot != nullptr && _current_input_index < _pending_snapshot->input_index)
+		save_snapshot();
+
 	// Clear out input stack, now that the current token is overwritten
 	while (_input_stack.size() > (_current_input_index + 1))
 		_input_stack.pop_back();
 
 	// Update location information after switching input levels
 	input_level &input = _input_stack[_current_input_index];
-	if (!input.name.empty() && input.name != _output_location.source)
+	if (input.source != 0 && input.source != _output_location.source)
 	{
 		_output += "#line " + std::to_string(input.next_token.location.line) + " \"" + input.name + "\"\n";
 		_output_location.line = input.next_token.location.line;
-		_output_location.source = input.name;
+		_output_location.source = input.source;
+		_output_token_line = _output_location.line - 1;
 	}
 
 	// Set current token
 	_token = std::move(input.next_token);
-	_current_token_raw_data = input.lexer->input_string().substr(_token.offset, _token.length);
+	_current_token_raw_data = input.input_string().substr(_token.offset, _token.length);
 
 	// Get the next token
-	input.next_token = input.lexer->lex();
+	if (input.lexer != nullptr)
+		input.next_token = input.lexer->lex();
+	else
+		lex_token_list(input);
 
 	// Verify string literals (since the lexer cannot throw errors itself)
 	if (_token == tokenid::string_literal && _current_token_raw_data.back() != '\"')
@@ -265,6 +808,8 @@ bool reshadefx::preprocessor::consume()
 		{
 			// End of input has been reached, so cannot pop further and this is the last token
 			_input_stack.pop_back();
+			// The raw data pointed into the input of the level that was just removed
+			_current_token_raw_data = {};
 			return false;
 		}
 		else
@@ -306,7 +851,7 @@ bool reshadefx::preprocessor::expect(tokenid token)
 		actual_token.location.source = _output_location.source;
 
 		error(actual_token.location, "syntax error: unexpected token '" +
-			_input_stack[_next_input_index].lexer->input_string().substr(actual_token.offset, actual_token.length) + '\'');
+			std::string(_input_stack[_next_input_index].input_string().substr(actual_token.offset, actual_token.length)) + '\'');
 
 		return false;
 	}
@@ -318,6 +863,11 @@ void reshadefx::preprocessor::parse()
 {
 	std::string line;
 
+	// Remove end of file token from a previous call, so that the token list continues after it
+	if (!_output_tokens.empty() && _output_tokens.back() == tokenid::end_of_file)
+		_output_tokens.pop_back();
+	_output_line_first_token = _output_tokens.size();
+
 	while (consume())
 	{
 		_recursion_count = 0;
@@ -395,7 +945,7 @@ void reshadefx::preprocessor::parse()
 			parse_include();
 			continue;
 		case tokenid::hash_unknown:
-			error(_token.location, "unrecognized preprocessing directive '" + _token.literal_as_string + '\'');
+			error(_token.location, "unrecognized preprocessing directive '" + std::string(_token.literal_as_string) + '\'');
 			consume_until(tokenid::end_of_line);
 			continue;
 		case tokenid::end_of_line:
@@ -406,7 +956,10 @@ void reshadefx::preprocessor::parse()
 			{
 				_output += "#line " + std::to_string(_token.location.line) + '\n';
 				_output_location.line  = _token.location.line;
+				_output_token_line = _output_location.line - 1;
 			}
+			if (_token_output)
+				finish_output_line(line, ++_output_token_line);
 			_output += line;
 			_output += '\n';
 			line.clear();
@@ -416,14 +969,33 @@ void reshadefx::preprocessor::parse()
 				continue;
 			// fall through
 		default:
+			if (_token_output)
+				add_output_token(line.size());
 			line += _current_token_raw_data;
 			break;
 		}
 	}
 
+	// Input may end right after a precompiled header, in which case the snapshot was not saved yet
+	if (_pending_snapshot != nullptr)
+		save_snapshot();
+
 	// Append the last line after the EOF was reached to the output
+	if (_token_output)
+	{
+		finish_output_line(line, ++_output_token_line);
+
+		token &eof_token = _output_tokens.emplace_back();
+		eof_token.id = tokenid::end_of_file;
+		eof_token.location = location(_output_token_line + 1);
+		eof_token.location.source = _output_location.source;
+		eof_token.offset = eof_token.length = 0;
+	}
 	_output += line;
 	_output += '\n';
+
+	// All input levels were popped, so nothing references the hidden macros anymore
+	_hidden_macros.clear();
 }
 
 void reshadefx::preprocessor::parse_def()
@@ -435,11 +1007,11 @@ void reshadefx::preprocessor::parse_def()
 
 	macro m;
 	const auto location = std::move(_token.location);
-	const auto macro_name = std::move(_token.literal_as_string);
+	const std::string macro_name(_token.literal_as_string);
 	const auto macro_name_end_offset = _token.offset + _token.length;
 
 	// Check input string here directly to ensure the parenthesis follows the macro name without any whitespace between
-	if (_input_stack[_current_input_index].lexer->input_string()[macro_name_end_offset] == '(')
+	if (_input_stack[_current_input_index].input_string()[macro_name_end_offset] == '(')
 	{
 		accept(tokenid::parenthesis_open);
 
@@ -447,7 +1019,7 @@ void reshadefx::preprocessor::parse_def()
 
 		while (accept(tokenid::identifier))
 		{
-			m.parameters.push_back(_token.literal_as_string);
+			m.parameters.emplace_back(_token.literal_as_string);
 
 			if (!accept(tokenid::comma))
 				break;
@@ -479,7 +1051,8 @@ void reshadefx::preprocessor::parse_undef()
 	else if (_token.literal_as_string == "defined")
 		return warning(_token.location, "macro name 'defined' is reserved");
 
-	_macros.erase(_token.literal_as_string);
+	if (const auto it = find_macro(_token.literal_as_string); it != _macros.end())
+		_macros.erase(it);
 }
 
 void reshadefx::preprocessor::parse_if()
@@ -505,7 +1078,7 @@ void reshadefx::preprocessor::parse_ifdef()
 	if (!expect(tokenid::identifier))
 		return;
 
-	level.value = _macros.find(_token.literal_as_string) != _macros.end() ||
+	level.value = find_macro(_token.literal_as_string) != _macros.end() ||
 		// Check built-in macros as well
 		_token.literal_as_string == "__LINE__" ||
 		_token.literal_as_string == "__FILE__" ||
@@ -528,7 +1101,19 @@ void reshadefx::preprocessor::parse_ifndef()
 	if (!expect(tokenid::identifier))
 		return;
 
-	level.value = _macros.find(_token.literal_as_string) == _macros.end() &&
+	// An '#ifndef' that is the first thing in an included file may be an include guard (this is confirmed once the matching '#endif' is reached)
+	if (input_level &input = _input_stack[level.input_index];
+		input.file_data != nullptr)
+	{
+		if (const token first_token = lexer(input.lexer->input_string(), true, true, false).lex();
+			first_token == tokenid::hash_ifndef && first_token.offset == level.pp_token.offset)
+		{
+			level.is_include_guard = true;
+			input.include_guard = _token.literal_as_string;
+		}
+	}
+
+	level.value = find_macro(_token.literal_as_string) == _macros.end() &&
 		_token.literal_as_string != "__LINE__" &&
 		_token.literal_as_string != "__FILE__" &&
 		_token.literal_as_string != "__FILE_NAME__" &&
@@ -580,9 +1165,25 @@ void reshadefx::preprocessor::parse_else()
 void reshadefx::preprocessor::parse_endif()
 {
 	if (_if_stack.empty())
-		error(_token.location, "missing #if for #endif");
-	else
-		_if_stack.pop_back();
+		return error(_token.location, "missing #if for #endif");
+
+	// Remember the include guard of a file if nothing but whitespace and comments follow the '#endif', so that the file does not have to be read again while the guard macro is defined
+	if (const if_level &level = _if_stack.back();
+		level.is_include_guard && level.pp_token == tokenid::hash_ifndef && level.input_index == _current_input_index)
+	{
+		const input_level &input = _input_stack[level.input_index];
+		// Directives have to be lexed as tokens here too, so that a file with any directive after the '#endif' (including '#line') is still read every time
+		lexer tail_lexer(
+			input.lexer->input_string().substr(_token.offset + _token.length),
+			true  /* ignore_comments */,
+			true  /* ignore_whitespace */,
+			false /* ignore_pp_directives */,
+			true  /* ignore_line_directives */);
+		if (tail_lexer.lex() == tokenid::end_of_file)
+			_include_guards.emplace(input.name, input.include_guard);
+	}
+
+	_if_stack.pop_back();
 }
 
 void reshadefx::preprocessor::parse_error()
@@ -590,14 +1191,14 @@ void reshadefx::preprocessor::parse_error()
 	const auto keyword_location = std::move(_token.location);
 	if (!expect(tokenid::string_literal))
 		return;
-	error(keyword_location, _token.literal_as_string);
+	error(keyword_location, std::string(_token.literal_as_string));
 }
 void reshadefx::preprocessor::parse_warning()
 {
 	const auto keyword_location = std::move(_token.location);
 	if (!expect(tokenid::string_literal))
 		return;
-	warning(keyword_location, _token.literal_as_string);
+	warning(keyword_location, std::string(_token.literal_as_string));
 }
 
 void reshadefx::preprocessor::parse_pragma()
@@ -606,7 +1207,7 @@ void reshadefx::preprocessor::parse_pragma()
 	if (!expect(tokenid::identifier))
 		return;
 
-	std::string pragma = std::move(_token.literal_as_string);
+	std::string pragma(_token.literal_as_string);
 
 	while (!peek(tokenid::end_of_line) && !peek(tokenid::end_of_file))
 	{
@@ -620,8 +1221,8 @@ void reshadefx::preprocessor::parse_pragma()
 
 	if (pragma == "once")
 	{
-		if (const auto it = _file_cache.find(_output_location.source); it != _file_cache.end())
-			it->second.clear();
+		if (const auto it = _file_cache.find(_output_location.source_name()); it != _file_cache.end())
+			it->second.reset();
 		return;
 	}
 
@@ -649,7 +1250,7 @@ void reshadefx::preprocessor::parse_include()
 	}
 
 	std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
-	std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
+	std::filesystem::path file_path = std::filesystem::u8path(_output_location.source_name());
 	file_path.replace_filename(file_name);
 
 	if (std::error_code ec; !std::filesystem::exists(file_path, ec))
@@ -667,7 +1268,15 @@ void reshadefx::preprocessor::parse_include()
 		return;
 	}
 
-	std::string data;
+	// The entire content of a file with an include guard would be skipped while its macro is defined, so do not even push it
+	if (const auto it = _include_guards.find(file_path_string);
+		it != _include_guards.end() && _macros.find(it->second) != _macros.end())
+	{
+		_skipped_includes++;
+		return;
+	}
+
+	std::shared_ptr<const std::string> data;
 	if (auto it = _file_cache.find(file_path_string);
 		it != _file_cache.end())
 	{
@@ -675,7 +1284,25 @@ void reshadefx::preprocessor::parse_include()
 	}
 	else
 	{
-		if (!read_file(file_path, data))
+		// Restore the state after a precompiled header from its snapshot instead of preprocessing it again
+		if (const auto pch_it = _precompiled_headers.find(file_path.filename().u8string());
+			pch_it != _precompiled_headers.end() && _pending_snapshot == nullptr)
+		{
+			std::filesystem::path snapshot_path = pch_it->second / std::filesystem::u8path(pch_it->first + '-' + snapshot_key(file_path_string).to_string() + ".pch");
+
+			if (restore_snapshot(snapshot_path))
+			{
+				_restored_snapshots++;
+				return;
+			}
+
+			// Otherwise save a new snapshot once the header was processed (the input level of the header is pushed right after the last one currently in use)
+			_pending_snapshot.reset(new pending_snapshot {
+				_next_input_index + 1, std::move(snapshot_path), _output.size(), _errors.size(), _skipped_includes, _file_cache, _include_guards, _used_macros });
+		}
+
+		data = read_include_file(file_path);
+		if (data == nullptr)
 		{
 			error(keyword_location, "could not open included file '" + file_path_string + '\'');
 			consume_until(tokenid::end_of_line);
@@ -688,7 +1315,12 @@ void reshadefx::preprocessor::parse_include()
 	// Clear out input stack before pushing include so that hidden macros do not bleed into the include
 	while (_input_stack.size() > (_next_input_index + 1))
 		_input_stack.pop_back();
-	push(std::move(data), file_path_string);
+
+	// A file that was marked with '#pragma once' has no data anymore, so push an empty string instead
+	if (data != nullptr)
+		push(std::move(data), file_path_string);
+	else
+		push(std::string(), file_path_string);
 }
 
 bool reshadefx::preprocessor::evaluate_expression()
@@ -855,7 +1487,7 @@ bool reshadefx::preprocessor::evaluate_expression()
 				std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
 				if (has_parentheses && !expect(tokenid::parenthesis_close))
 					return false;
-				std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
+				std::filesystem::path file_path = std::filesystem::u8path(_output_location.source_name());
 				file_path.replace_filename(file_name);
 
 				std::error_code ec;
@@ -872,7 +1504,7 @@ bool reshadefx::preprocessor::evaluate_expression()
 				const bool has_parentheses = accept(tokenid::parenthesis_open);
 				if (!expect(tokenid::identifier))
 					return false;
-				const std::string macro_name = std::move(_token.literal_as_string);
+				const std::string macro_name(_token.literal_as_string);
 				if (has_parentheses && !expect(tokenid::parenthesis_close))
 					return false;
 
@@ -880,6 +1512,15 @@ bool reshadefx::preprocessor::evaluate_expression()
 				continue;
 			}
 
+			// A runtime constant cannot be left to the parser here, so use its current value instead
+			if (const auto it = _runtime_constants.find(std::string(_token.literal_as_string));
+				it != _runtime_constants.end())
+			{
+				_used_macros.emplace(it->first);
+				rpn[rpn_index++] = { it->second, false };
+				break;
+			}
+
 			// An identifier that cannot be replaced with a number becomes zero
 			rpn[rpn_index++] = { 0, false };
 			break;
@@ -1039,29 +1680,29 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 	}
 	if (_token.literal_as_string == "__FILE__")
 	{
-		push(escape_string(_token.location.source));
+		push(escape_string(_token.location.source_name()));
 		return true;
 	}
 	if (_token.literal_as_string == "__FILE_STEM__")
 	{
-		const std::filesystem::path file_stem = std::filesystem::u8path(_token.location.source).stem();
+		const std::filesystem::path file_stem = std::filesystem::u8path(_token.location.source_name()).stem();
 		push(escape_string(file_stem.u8string()));
 		return true;
 	}
 	if (_token.literal_as_string == "__FILE_NAME__")
 	{
-		const std::filesystem::path file_name = std::filesystem::u8path(_token.location.source).filename();
+		const std::filesystem::path file_name = std::filesystem::u8path(_token.location.source_name()).filename();
 		push(escape_string(file_name.u8string()));
 		return true;
 	}
 
-	const auto it = _macros.find(_token.literal_as_string);
+	const auto it = find_macro(_token.literal_as_string);
 	if (it == _macros.end())
 		return false;
 
-	const std::unordered_set<std::string> &hidden_macros = _input_stack[_current_input_index].hidden_macros;
-	if (hidden_macros.find(_token.literal_as_string) != hidden_macros.end())
-		return false;
+	for (const hidden_macro *hidden = _input_stack[_current_input_index].hidden_macros; hidden != nullptr; hidden = hidden->next)
+		if (hidden->name == &it->first)
+			return false;
 
 	const auto macro_location = _token.location;
 	if (_recursion_count++ >= 256)
@@ -1070,16 +1711,22 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 		return false;
 	}
 
-	std::vector<std::string> arguments;
+	// All arguments are stored in a single list, each followed by a token without any text that marks its end (which no lexer produces)
+	std::shared_ptr<token_list> arguments;
+	std::vector<size_t> argument_offsets;
 	if (it->second.is_function_like)
 	{
 		if (!accept(tokenid::parenthesis_open))
 			return false;
 
+		arguments = std::make_shared<token_list>();
+
 		while (true)
 		{
 			int parentheses_level = 0;
-			std::string argument;
+			uint32_t last_input = 0;
+			size_t last_offset = 0;
+			argument_offsets.push_back(arguments->tokens.size());
 
 			while (true)
 			{
@@ -1097,104 +1744,434 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 				if (_token == tokenid::parenthesis_close && --parentheses_level < 0)
 					break;
 
-				// Collapse all whitespace down to a single space
+				// Collapse all whitespace down to a single space and trim it from the beginning of the argument
 				if (_token == tokenid::space)
-					argument += ' ';
-				else
-					argument += _current_token_raw_data;
-			}
+				{
+					if (arguments->tokens.size() != argument_offsets.back())
+						arguments->append(_token, " ", false);
+					continue;
+				}
 
-			// Trim whitespace from argument
-			const size_t first = argument.find_first_not_of(" \t");
-			if (first == std::string::npos)
-			{
-				argument.clear();
+				const input_level &input = _input_stack[_current_input_index];
+				arguments->append(_token, _current_token_raw_data, input.serial == last_input && _token.offset == last_offset);
+				last_input = input.serial;
+				last_offset = _token.offset + _token.length;
 			}
-			else
-			{
-				const size_t last = argument.find_last_not_of(" \t");
-				argument = argument.substr(first, last - first + 1);
-			}
-			arguments.push_back(std::move(argument));
+
+			// Trim whitespace from the end of the argument
+			while (arguments->tokens.size() != argument_offsets.back() && arguments->tokens.back() == tokenid::space)
+				arguments->pop_back();
+
+			token_list::entry &end_token = arguments->tokens.emplace_back();
+			end_token.id = tokenid::unknown;
+			end_token.offset = static_cast<uint32_t>(arguments->data.size());
+			end_token.length = 0;
 
 			if (parentheses_level < 0)
 				break;
 		}
 	}
 
-	std::string input;
-	expand_macro(it->first, it->second, arguments, input);
+	// The replacement list is only split into tokens once, the first time the macro is expanded
+	if (it->second.replacement_tokens.empty() && !it->second.replacement_list.empty())
+		lex_replacement_list(it->second);
+
+	const auto expansion = std::make_shared<token_list>();
+	expand_macro(it->first, it->second, arguments, argument_offsets, *expansion);
+
+	if (!expansion->tokens.empty())
+	{
+		push(expansion, 0, expansion->tokens.size());
+
+		input_level &level = _input_stack[_current_input_index];
+		level.hidden_macros = &_hidden_macros.emplace_back(hidden_macro { &it->first, level.hidden_macros });
+	}
+
+	return true;
+}
+
+void reshadefx::preprocessor::add_output_token(size_t column)
+{
+	if (_token == tokenid::space)
+	{
+		_output_last_input = 0; // Whitespace separates tokens, so the next one cannot merge with the previous one
+		return;
+	}
+
+	const input_level &input = _input_stack[_current_input_index];
+
+	const auto is_separator = [](tokenid id) {
+		return id == tokenid::parenthesis_open || id == tokenid::parenthesis_close || id == tokenid::bracket_open || id == tokenid::bracket_close ||
+			id == tokenid::brace_open || id == tokenid::brace_close || id == tokenid::comma || id == tokenid::semicolon;
+	};
+
+	// The parser lexes the output string, which can produce different tokens than the ones here in some cases, so lex the line again at the end to get the same result:
+	// - When this token directly follows one from a different input (e.g. a macro expansion), since they may merge into one token in the output string (unless one of them is a separator that cannot merge with anything)
+	// - When a line starts with a '#', since the parser skips those lines
+	// - When a string literal contains escape sequences or continues on the next line, since those are not handled by the preprocessor
+	if ((_output_last_input != 0 && (_output_last_input != input.serial || _output_last_offset != _token.offset) && !is_separator(_output_last_id) && !is_separator(_token.id)) ||
+		(_output_tokens.size() == _output_line_first_token && (_token == tokenid::hash || _token == tokenid::hash_unknown)) ||
+		(_token == tokenid::string_literal && _current_token_raw_data.find_first_of("\\\r\n") != std::string_view::npos))
+		_output_line_relex = true;
+
+	_output_last_id = _token.id;
+	_output_last_input = input.serial;
+	_output_last_offset = _token.offset + _token.length;
+
+	if (_output_line_relex)
+		return;
+
+	token &tok = _output_tokens.emplace_back(_token);
+	tok.location.column = static_cast<unsigned int>(column + 1);
+
+	// Convert token to what the parser lexer would produce (which does not ignore keywords and escapes string literals)
+	switch (tok.id)
+	{
+	case tokenid::identifier:
+		tok.id = lexer::keyword_id(tok.literal_as_string);
+		break;
+	case tokenid::string_literal:
+		// Remove quotes (there is no closing one if the string literal is unterminated)
+		tok.literal_as_string = _current_token_raw_data.substr(1,
+			_current_token_raw_data.size() - (_current_token_raw_data.back() == '"' && _current_token_raw_data.size() > 1 ? 2 : 1));
+		break;
+	default:
+		return;
+	}
+
+	// Files are kept alive until the preprocessor is destroyed, so can reference them directly, but other input (e.g. macro expansions) is freed once it was processed
+	if (input.file_data == nullptr)
+		tok.literal_as_string = store_output_literal(tok.literal_as_string);
+}
+void reshadefx::preprocessor::finish_output_line(const std::string &line, unsigned int line_number)
+{
+	if (_output_line_relex)
+	{
+		_output_tokens.resize(_output_line_first_token);
+
+		lexer line_lexer(std::string_view(line), true, true, true, false, false, true, location(line_number));
+		for (token tok; (tok = line_lexer.lex()) != tokenid::end_of_file;)
+		{
+			tok.literal_as_string = store_output_literal(tok.literal_as_string);
+			_output_tokens.push_back(std::move(tok));
+		}
+	}
+
+	for (size_t i = _output_line_first_token; i < _output_tokens.size(); ++i)
+	{
+		_output_tokens[i].location.source = _output_location.source;
+		_output_tokens[i].location.line = line_number;
+	}
+
+	_output_line_relex = false;
+	_output_last_input = 0;
+	_output_line_first_token = _output_tokens.size();
+}
+std::string_view reshadefx::preprocessor::store_output_literal(std::string_view literal)
+{
+	if (literal.empty())
+		return {};
+
+	// Copy literals into large blocks that are never reallocated, so that the views into them stay valid
+	if (_output_literals.empty() || _output_literals.back().capacity() - _output_literals.back().size() < literal.size())
+		_output_literals.emplace_back().reserve(std::max<size_t>(literal.size(), 64 * 1024));
+
+	std::string &block = _output_literals.back();
+	const size_t offset = block.size();
+	block += literal;
+	return std::string_view(block.data() + offset, literal.size());
+}
+
+std::unordered_map<std::string, reshadefx::preprocessor::macro>::iterator reshadefx::preprocessor::find_macro(std::string_view name)
+{
+	// Reuse the same key string for every lookup, to avoid allocating a new one for each identifier token
+	_macro_lookup_key.assign(name.data(), name.size());
+	return _macros.find(_macro_lookup_key);
+}
 
-	if (!input.empty())
+reshadefx::hash128 reshadefx::preprocessor::snapshot_key(const std::string &file_path) const
+{
+	// The result of including a file depends on the macro definitions, include paths and which files are skipped when included again, so combine all of them into the key
+	std::string key = file_path;
+	for (const std::filesystem::path &include_path : _include_paths)
+		key += "\n#include_path " + include_path.u8string();
+
+	std::vector<const std::pair<const std::string, macro> *> macros;
+	macros.reserve(_macros.size());
+	for (const auto &it : _macros)
+		macros.push_back(&it);
+	std::sort(macros.begin(), macros.end(),
+		[](const auto *lhs, const auto *rhs) { return lhs->first < rhs->first; });
+
+	for (const auto *it : macros)
+	{
+		key += "\n#define " + it->first;
+		if (it->second.is_function_like)
+		{
+			key += '(';
+			for (const std::string &parameter : it->second.parameters)
+				key += parameter + ',';
+			key += it->second.is_variadic ? "...)" : ")";
+		}
+		key += ' ' + it->second.replacement_list;
+	}
+
+	// Runtime constants may be evaluated in the header, in which case its output depends on their values too
+	std::vector<std::string> runtime_constants;
+	for (const auto &[name, value] : _runtime_constants)
+		runtime_constants.push_back("\n#runtime_constant " + name + ' ' + std::to_string(value));
+	std::sort(runtime_constants.begin(), runtime_constants.end());
+
+	for (const std::string &runtime_constant : runtime_constants)
+		key += runtime_constant;
+
+	std::vector<std::string> skipped_files;
+	for (const auto &[path, data] : _file_cache)
+		if (data == nullptr)
+			skipped_files.push_back("\n#pragma once " + path);
+	for (const auto &[path, macro_name] : _include_guards)
+		skipped_files.push_back("\n#ifndef " + macro_name + ' ' + path);
+	std::sort(skipped_files.begin(), skipped_files.end());
+
+	for (const std::string &skipped_file : skipped_files)
+		key += skipped_file;
+
+	return reshadefx::hash(key);
+}
+bool reshadefx::preprocessor::restore_snapshot(const std::filesystem::path &path)
+{
+	const std::shared_ptr<const include_snapshot> snapshot = read_snapshot(path);
+	if (snapshot == nullptr)
+		return false;
+
+	// Verify that none of the included files changed since the snapshot was taken
+	std::vector<std::shared_ptr<const std::string>> file_data(snapshot->files.size());
+	for (size_t i = 0; i < snapshot->files.size(); ++i)
 	{
-		push(std::move(input));
+		const auto &entry = snapshot->files[i];
+		const std::filesystem::path file_path = std::filesystem::u8path(entry.path);
+
+		std::error_code ec;
+		if (file_modified_time(file_path) != entry.modified_time || std::filesystem::file_size(file_path, ec) != entry.size || ec)
+			return false;
+
+		// Files that are not marked with '#pragma once' may be included again later, so need their data
+		if (!entry.pragma_once && (file_data[i] = read_include_file(file_path)) == nullptr)
+			return false;
+	}
+
+	_macros = snapshot->macros;
 
-		_input_stack[_current_input_index].hidden_macros.insert(it->first);
+	if (_token_output)
+	{
+		// The output of the snapshot starts with a #line directive, so lexing it produces the correct locations
+		lexer output_lexer(std::string_view(snapshot->output));
+		for (token tok; (tok = output_lexer.lex()) != tokenid::end_of_file;)
+		{
+			tok.literal_as_string = store_output_literal(tok.literal_as_string);
+			_output_tokens.push_back(std::move(tok));
+		}
+		_output_line_first_token = _output_tokens.size();
 	}
 
+	_output += snapshot->output;
+	_output_location.line = snapshot->output_line;
+	_output_location.source = location::source_id(snapshot->output_source);
+	_output_token_line = snapshot->output_token_line;
+
+	for (size_t i = 0; i < snapshot->files.size(); ++i)
+		_file_cache.insert_or_assign(snapshot->files[i].path, std::move(file_data[i]));
+	for (const auto &[file_path, macro_name] : snapshot->include_guards)
+		_include_guards.insert_or_assign(file_path, macro_name);
+	for (const std::string &name : snapshot->used_macros)
+		_used_macros.insert(name);
+	_skipped_includes += snapshot->skipped_includes;
+
 	return true;
 }
+void reshadefx::preprocessor::save_snapshot()
+{
+	const std::unique_ptr<pending_snapshot> pending = std::move(_pending_snapshot);
+
+	// Parser and symbol table state is not part of the snapshot, since the code generators build their module while parsing and cannot be copied or restored
+	// So a snapshot only saves the preprocessing of the header, its output is parsed again by every compilation that includes it
+
+	// Errors and warnings would not be reported again when restoring the snapshot, so do not save one in that case
+	if (_errors.size() != pending->errors_offset)
+		return;
+
+	auto snapshot = std::make_shared<include_snapshot>();
+	snapshot->macros = _macros;
+	snapshot->output = _output.substr(pending->output_offset);
+	snapshot->output_source = _output_location.source_name();
+	snapshot->output_line = _output_location.line;
+	snapshot->output_token_line = _output_token_line;
+	snapshot->skipped_includes = _skipped_includes - pending->skipped_includes;
+
+	// Only store the changes made while including the header
+	for (const auto &[file_path, data] : _file_cache)
+	{
+		if (const auto it = pending->file_cache.find(file_path);
+			it != pending->file_cache.end() && it->second == data)
+			continue;
+
+		const std::filesystem::path path = std::filesystem::u8path(file_path);
+
+		std::error_code ec;
+		snapshot->files.push_back({ file_path, data == nullptr, file_modified_time(path), std::filesystem::file_size(path, ec) });
+	}
+	for (const auto &[file_path, macro_name] : _include_guards)
+		if (pending->include_guards.find(file_path) == pending->include_guards.end())
+			snapshot->include_guards.emplace_back(file_path, macro_name);
+	for (const std::string &name : _used_macros)
+		if (pending->used_macros.find(name) == pending->used_macros.end())
+			snapshot->used_macros.push_back(name);
 
-void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &macro, const std::vector<std::string> &arguments, std::string &out)
+	if (!write_snapshot(pending->path, *snapshot))
+		return;
+
+	const std::unique_lock<std::shared_mutex> lock(s_snapshot_cache_mutex);
+	s_snapshot_cache[pending->path.u8string()] = std::move(snapshot);
+}
+
+void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &macro, const std::shared_ptr<const token_list> &arguments, const std::vector<size_t> &argument_offsets, token_list &out)
 {
-	for (size_t offset = 0; offset < macro.replacement_list.size(); ++offset)
+	// Arguments that are referenced multiple times in the replacement list expand to the same tokens every time, so only expand them once
+	std::vector<std::pair<bool, token_list>> expanded_arguments;
+
+	// Reserve enough space for the replacement list with unexpanded arguments, which avoids most of the reallocations while appending to it
+	out.data.reserve(macro.replacement_list.size() + (arguments != nullptr ? arguments->data.size() : 0));
+	out.tokens.reserve(macro.replacement_tokens.size() + (arguments != nullptr ? arguments->tokens.size() : 0));
+
+	bool concat = false;
+	const auto append = [&out, &concat](const auto &tok, std::string_view raw, bool adjacent) {
+		if (concat && tok != tokenid::space && !out.tokens.empty())
+		{
+			// Lex the text of the last token and this one again, since together they form a new token (so "a ## b" becomes "ab")
+			const token_list::entry &last = out.tokens.back();
+			adjacent = out.tokens.size() > 1 && out.tokens[out.tokens.size() - 2].offset + out.tokens[out.tokens.size() - 2].length == last.offset;
+			const std::string text = out.data.substr(last.offset, last.length) + std::string(raw);
+			out.pop_back();
+
+			lexer concat_lexer = create_expansion_lexer(text);
+			for (token concat_tok; (concat_tok = concat_lexer.lex()) != tokenid::end_of_file; adjacent = true)
+				out.append(concat_tok, std::string_view(text).substr(concat_tok.offset, concat_tok.length), adjacent);
+		}
+		else
+		{
+			out.append(tok, raw, adjacent);
+		}
+
+		concat = false;
+	};
+
+	for (size_t i = 0; i < macro.replacement_tokens.size(); ++i)
 	{
-		if (macro.replacement_list[offset] != macro_replacement_start)
+		const token &tok = macro.replacement_tokens[i];
+		if (tok != tokenid::unknown || tok.length != 0)
 		{
-			out += macro.replacement_list[offset];
+			append(tok, std::string_view(macro.replacement_list).substr(tok.offset, tok.length),
+				i != 0 && macro.replacement_tokens[i - 1].offset + macro.replacement_tokens[i - 1].length == tok.offset);
 			continue;
 		}
 
 		// This is a special replacement sequence
-		const auto type = macro.replacement_list[++offset];
+		const auto type = macro.replacement_list[tok.offset + 1];
 		if (type == macro_replacement_concat)
 		{
-			// Remove any whitespace preceeding or following the concatenation operator (so "a ## b" becomes "ab")
-			if (const size_t last = out.find_last_not_of(" \t");
-				last != std::string::npos && last + 1 < out.size())
-				out.erase(last + 1);
-			while (offset + 1 != macro.replacement_list.size() &&
-				(macro.replacement_list[offset + 1] == ' ' || macro.replacement_list[offset + 1] == '\t'))
-				++offset;
+			// Remove any whitespace preceeding or following the concatenation operator (unless there is nothing but whitespace before it)
+			size_t last = out.tokens.size();
+			while (last != 0 && out.tokens[last - 1] == tokenid::space)
+				--last;
+			while (last != 0 && out.tokens.size() > last)
+				out.pop_back();
+			while (i + 1 < macro.replacement_tokens.size() && macro.replacement_tokens[i + 1] == tokenid::space)
+				++i;
+			concat = true;
 			continue;
 		}
 
-		const auto index = macro.replacement_list[++offset];
-		if (static_cast<size_t>(index) >= arguments.size())
+		const size_t index = static_cast<unsigned char>(macro.replacement_list[tok.offset + 2]);
+		if (index >= argument_offsets.size())
 		{
 			warning(_token.location, "not enough arguments for function-like macro invocation '" + name + "'");
 			continue;
 		}
 
+		// The last token of each argument is the one that marks its end
+		const size_t argument_first = argument_offsets[index];
+		const size_t argument_last = (index + 1 < argument_offsets.size() ? argument_offsets[index + 1] : arguments->tokens.size()) - 1;
+
 		switch (type)
 		{
 		case macro_replacement_stringize:
-			out.reserve(out.size() + 2 + arguments[index].size());
-			out += '"';
-			for (const char c : arguments[index])
+		{
+			std::string text(1, '"');
+			for (size_t k = argument_first; k < argument_last; ++k)
 			{
-				// Adds backslashes to escape quotes
-				if (c == '"')
-					out += '\\';
-				out += c;
+				for (const char c : std::string_view(arguments->data).substr(arguments->tokens[k].offset, arguments->tokens[k].length))
+				{
+					// Adds backslashes to escape quotes
+					if (c == '"')
+						text += '\\';
+					text += c;
+				}
 			}
-			out += '"';
+			text += '"';
+
+			lexer stringize_lexer = create_expansion_lexer(text);
+			bool adjacent = false;
+			for (token stringize_tok; (stringize_tok = stringize_lexer.lex()) != tokenid::end_of_file; adjacent = true)
+				append(stringize_tok, std::string_view(text).substr(stringize_tok.offset, stringize_tok.length), adjacent);
 			break;
+		}
 		case macro_replacement_argument:
-			push(arguments[index] + static_cast<char>(macro_replacement_argument));
-			while (true)
+		{
+			if (expanded_arguments.empty())
+				expanded_arguments.resize(argument_offsets.size());
+
+			auto &[expanded_valid, expanded] = expanded_arguments[index];
+			if (!expanded_valid)
 			{
-				// Consume all tokens here, so spaces are added to the output too
-				consume();
-				if (_token == tokenid::unknown) // 'macro_replacement_argument' is 'tokenid::unknown'
-					break;
-				if (_token == tokenid::identifier && evaluate_identifier_as_macro())
-					continue;
-				out += _current_token_raw_data;
+				expanded.data.clear();
+				expanded.tokens.clear();
+				expanded.data.reserve(arguments->tokens[argument_last].offset - arguments->tokens[argument_first].offset);
+				expanded.tokens.reserve(argument_last - argument_first);
+
+				push(arguments, argument_first, argument_last + 1);
+
+				uint32_t last_input = 0;
+				size_t last_offset = 0;
+				while (true)
+				{
+					// Consume all tokens here, so spaces are added to the output too
+					consume();
+					if (_token == tokenid::unknown && _token.length == 0)
+						break;
+					if (_token == tokenid::identifier && evaluate_identifier_as_macro())
+						continue;
+
+					const input_level &input = _input_stack[_current_input_index];
+					expanded.append(_token, _current_token_raw_data, input.serial == last_input && _token.offset == last_offset);
+					last_input = input.serial;
+					last_offset = _token.offset + _token.length;
+				}
+
+				// Arguments spanning multiple lines can expand differently each time (because of '__LINE__'), so do not reuse those
+				expanded_valid = std::find_if(arguments->tokens.begin() + argument_first, arguments->tokens.begin() + argument_last,
+					[](const token_list::entry &argument_tok) { return argument_tok == tokenid::end_of_line; }) == arguments->tokens.begin() + argument_last;
 			}
-			assert(_current_token_raw_data[0] == macro_replacement_argument);
+
+			if (expanded.tokens.empty())
+				break;
+
+			// Only the first token may need to be concatenated with the preceding one, all others are copied as they are
+			append(expanded.tokens[0], std::string_view(expanded.data).substr(expanded.tokens[0].offset, expanded.tokens[0].length), false);
+			if (expanded.tokens.size() > 1)
+				out.append(expanded, 1, expanded.tokens.size(), expanded.tokens[0].offset + expanded.tokens[0].length == expanded.tokens[1].offset);
 			break;
 		}
+		}
 	}
 }
 void reshadefx::preprocessor::create_macro_replacement_list(macro &macro)
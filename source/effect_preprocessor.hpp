@@ -5,7 +5,9 @@
 
 #pragma once
 
+#include "effect_hash.hpp"
 #include "effect_token.hpp"
+#include <deque>
 #include <memory> // std::unique_ptr
 #include <filesystem>
 #include <unordered_set>
@@ -25,6 +27,13 @@ namespace reshadefx
 			std::vector<std::string> parameters;
 			bool is_variadic = false;
 			bool is_function_like = false;
+			std::vector<token> replacement_tokens; // The replacement list split into tokens, which is done when the macro is first expanded (their offsets point into 'replacement_list')
+		};
+
+		struct include_cache_statistics
+		{
+			size_t hits;
+			size_t misses;
 		};
 
 		// Define constructor explicitly because lexer class is not included here
@@ -52,9 +61,26 @@ namespace reshadefx
 		/// <returns></returns>
 		bool add_macro_definition(const std::string &name, std::string value = "1")
 		{
-			return add_macro_definition(name, macro { std::move(value), {} });
+			return add_macro_definition(name, macro { std::move(value), {}, false, false, {} });
 		}
 
+		/// <summary>
+		/// Add an identifier whose value is only known at runtime. It is passed through to the output unchanged, so that the parser can resolve it later,
+		/// but evaluates to the specified value in #if and #elif expressions, since those have to be decided while preprocessing.
+		/// </summary>
+		/// <param name="name">The name of the identifier.</param>
+		/// <param name="value">The current value of the identifier.</param>
+		void add_runtime_constant(const std::string &name, int value);
+
+		/// <summary>
+		/// Precompile the specified header file. The preprocessor state after the header was first included is saved as a snapshot to the specified directory,
+		/// and restored from there on later includes with the same macro definitions (also by other preprocessor instances), instead of preprocessing the header again.
+		/// Only the preprocessor state is part of the snapshot. The output of the header is still parsed and passed to the code generator on every compilation.
+		/// </summary>
+		/// <param name="name">The file name of the header (e.g. "ReShade.fxh").</param>
+		/// <param name="snapshot_directory">The path to the directory to store snapshots in.</param>
+		void add_precompiled_header(const std::string &name, const std::filesystem::path &snapshot_directory);
+
 		/// <summary>
 		/// Open the specified file, parse its contents and append them to the output.
 		/// </summary>
@@ -79,6 +105,18 @@ namespace reshadefx
 		std::string &output() { return _output; }
 		const std::string &output() const { return _output; }
 
+		/// <summary>
+		/// Enable or disable collecting the pre-processed output as a list of tokens in addition to the output string.
+		/// Those tokens can be passed to the parser directly, which avoids lexing the output string again.
+		/// </summary>
+		void set_token_output(bool enable) { _token_output = enable; }
+		/// <summary>
+		/// Get the current pre-processed output as a list of tokens (only available if enabled via <see cref="set_token_output"/>).
+		/// The literals of these tokens point into memory owned by this preprocessor instance, so it has to outlive any use of them.
+		/// </summary>
+		std::vector<token> &output_tokens() { return _output_tokens; }
+		const std::vector<token> &output_tokens() const { return _output_tokens; }
+
 		/// <summary>
 		/// Get a list of all included files.
 		/// </summary>
@@ -89,6 +127,29 @@ namespace reshadefx
 		/// </summary>
 		/// <returns></returns>
 		std::vector<std::pair<std::string, std::string>> used_macro_definitions() const;
+		/// <summary>
+		/// Get whether any runtime constant was evaluated in a #if or #elif expression, in which case the output is only valid for the value it had.
+		/// </summary>
+		bool runtime_constants_evaluated() const;
+
+		/// <summary>
+		/// Remove all files from the include cache that is shared between all preprocessor instances, so that they are read from disk again the next time they are included.
+		/// This also removes all precompiled header snapshots that were kept in memory.
+		/// </summary>
+		static void clear_include_cache();
+		/// <summary>
+		/// Get the number of included files that were found in the shared include cache (hits) or had to be read from disk (misses) since it was last cleared.
+		/// </summary>
+		static include_cache_statistics include_cache_stats();
+
+		/// <summary>
+		/// Get the number of #include directives that were skipped without reading the file again, because the file has an include guard whose macro was still defined.
+		/// </summary>
+		size_t skipped_includes() const { return _skipped_includes; }
+		/// <summary>
+		/// Get the number of #include directives of precompiled headers that were restored from a snapshot.
+		/// </summary>
+		size_t restored_snapshots() const { return _restored_snapshots; }
 
 	private:
 		struct if_level
@@ -97,19 +158,78 @@ namespace reshadefx
 			bool skipping;
 			token pp_token;
 			size_t input_index;
+			bool is_include_guard = false;
+		};
+		struct pending_snapshot
+		{
+			size_t input_index;
+			std::filesystem::path path;
+			size_t output_offset;
+			size_t errors_offset;
+			size_t skipped_includes;
+			std::unordered_map<std::string, std::shared_ptr<const std::string>> file_cache;
+			std::unordered_map<std::string, std::string> include_guards;
+			std::unordered_set<std::string> used_macros;
+		};
+		struct token_list
+		{
+			// Only what cannot be restored from the text is stored per token, since expansions copy their tokens around a lot (locations are assigned when a token is read again)
+			struct entry
+			{
+				tokenid id;
+				uint32_t offset, length;
+				union
+				{
+					int literal_as_int;
+					unsigned int literal_as_uint;
+					float literal_as_float;
+					double literal_as_double;
+				};
+
+				inline operator tokenid() const { return id; }
+			};
+
+			std::string data; // The text of all tokens, which their offsets point into (with a gap between tokens that did not follow each other in their input)
+			std::vector<entry> tokens;
+
+			void append(const token &tok, std::string_view raw, bool adjacent);
+			void append(const entry &tok, std::string_view raw, bool adjacent);
+			void append(const token_list &list, size_t first, size_t last, bool adjacent);
+			void pop_back();
+		};
+		struct hidden_macro
+		{
+			const std::string *name; // Points to the key of the macro in the definition map
+			const hidden_macro *next;
 		};
 		struct input_level
 		{
 			std::string name;
+			uint32_t source = 0;
+			uint32_t serial = 0;
 			std::unique_ptr<class lexer> lexer;
+			std::shared_ptr<const std::string> file_data; // Keeps the input string alive while the lexer is referencing it
+			std::shared_ptr<const token_list> tokens; // Tokens that are read instead of running a lexer (e.g. for macro expansions)
+			size_t token_index = 0;
+			size_t token_end = 0;
+			location token_location; // Location the next token is assigned, as if the text of the tokens was lexed again
+			std::string_view include_guard;
 			token next_token;
-			std::unordered_set<std::string> hidden_macros;
+			const hidden_macro *hidden_macros = nullptr;
+
+			std::string_view input_string() const;
 		};
 
 		void error(const location &location, const std::string &message);
 		void warning(const location &location, const std::string &message);
 
 		void push(std::string input, const std::string &name = std::string());
+		void push(std::shared_ptr<const std::string> input, const std::string &name);
+		void push(std::shared_ptr<const token_list> tokens, size_t first, size_t last);
+		void push(input_level &&level, const location &start_location);
+		location push_location(const std::string &name) const;
+
+		void lex_token_list(input_level &input);
 
 		bool peek(tokenid token) const;
 		bool consume();
@@ -134,12 +254,22 @@ namespace reshadefx
 		bool evaluate_expression();
 		bool evaluate_identifier_as_macro();
 
-		void expand_macro(const std::string &name, const macro &macro, const std::vector<std::string> &arguments, std::string &out);
+		std::unordered_map<std::string, macro>::iterator find_macro(std::string_view name);
+
+		hash128 snapshot_key(const std::string &file_path) const;
+		bool restore_snapshot(const std::filesystem::path &path);
+		void save_snapshot();
+
+		void add_output_token(size_t column);
+		void finish_output_line(const std::string &line, unsigned int line_number);
+		std::string_view store_output_literal(std::string_view literal);
+
+		void expand_macro(const std::string &name, const macro &macro, const std::shared_ptr<const token_list> &arguments, const std::vector<size_t> &argument_offsets, token_list &out);
 		void create_macro_replacement_list(macro &macro);
 
 		bool _success = true;
 		std::string _output, _errors;
-		std::string _current_token_raw_data;
+		std::string_view _current_token_raw_data;
 		reshadefx::token _token;
 		std::vector<if_level> _if_stack;
 		std::vector<input_level> _input_stack;
@@ -149,7 +279,27 @@ namespace reshadefx
 		location _output_location;
 		std::unordered_set<std::string> _used_macros;
 		std::unordered_map<std::string, macro> _macros;
+		std::unordered_map<std::string, int> _runtime_constants;
+		std::string _macro_lookup_key;
+		uint32_t _input_serial = 0;
+		std::deque<hidden_macro> _hidden_macros; // Hidden macros are stored as linked lists shared between input levels, so that they do not have to be copied on every push
 		std::vector<std::filesystem::path> _include_paths;
-		std::unordered_map<std::string, std::string> _file_cache;
+		std::unordered_map<std::string, std::shared_ptr<const std::string>> _file_cache;
+		std::unordered_map<std::string, std::string> _include_guards;
+		size_t _skipped_includes = 0;
+		std::unordered_map<std::string, std::filesystem::path> _precompiled_headers;
+		std::unique_ptr<pending_snapshot> _pending_snapshot;
+		size_t _restored_snapshots = 0;
+
+		bool _token_output = false;
+		bool _output_line_relex = false;
+		unsigned int _output_token_line = 0; // Line number the parser would see for the last line written to the output string
+		tokenid _output_last_id = tokenid::unknown;
+		uint32_t _output_last_input = 0;
+		size_t _output_last_offset = 0;
+		size_t _output_line_first_token = 0;
+		std::vector<token> _output_tokens;
+		std::deque<std::string> _output_literals;
+		std::vector<std::shared_ptr<const std::string>> _output_files;
 	};
 }
@@ -7,6 +7,8 @@
 #include <cassert>
 #include <malloc.h> // alloca
 #include <algorithm> // std::upper_bound, std::sort
+#include <iterator> // std::size
+#include <string_view>
 
 #pragma region Import intrinsic functions
 
@@ -85,6 +87,72 @@ static const intrinsic s_intrinsics[] = {
 #include "effect_symbol_table_intrinsics.inl"
 };
 
+// Import intrinsic function names again, this time into a table that is available at compile time
+#define DEFINE_INTRINSIC(name, i, ret_type, ...) #name,
+static constexpr std::string_view s_intrinsic_names[] = {
+#include "effect_symbol_table_intrinsics.inl"
+};
+
+static_assert(std::size(s_intrinsic_names) == std::size(s_intrinsics));
+
+// Hash table from intrinsic name to the range of its overloads in 's_intrinsics', so that resolving a call does not have to compare against every single overload
+struct intrinsic_index
+{
+	struct entry
+	{
+		std::string_view name;
+		unsigned short first = 0;
+		unsigned short count = 0;
+	};
+
+	static constexpr size_t table_size = 256; // Power of two that is large enough to keep the table sparse for all intrinsic names
+
+	static constexpr size_t hash(std::string_view name)
+	{
+		size_t value = 2166136261u; // FNV-1a
+		for (const char c : name)
+			value = ((value ^ static_cast<unsigned char>(c)) * 16777619u) & 0xFFFFFFFF;
+		return value;
+	}
+
+	constexpr intrinsic_index() : table()
+	{
+		// All overloads of an intrinsic are defined next to each other, so each name maps to a single consecutive range
+		for (size_t i = 0; i < std::size(s_intrinsic_names);)
+		{
+			size_t count = 1;
+			while (i + count < std::size(s_intrinsic_names) && s_intrinsic_names[i + count] == s_intrinsic_names[i])
+				++count;
+
+			size_t slot = hash(s_intrinsic_names[i]) & (table_size - 1);
+			while (table[slot].count != 0)
+			{
+				if (table[slot].name == s_intrinsic_names[i])
+					throw "overloads of an intrinsic have to be defined next to each other";
+				slot = (slot + 1) & (table_size - 1);
+			}
+
+			table[slot].name = s_intrinsic_names[i];
+			table[slot].first = static_cast<unsigned short>(i);
+			table[slot].count = static_cast<unsigned short>(count);
+
+			i += count;
+		}
+	}
+
+	const entry *find(std::string_view name) const
+	{
+		for (size_t slot = hash(name) & (table_size - 1); table[slot].count != 0; slot = (slot + 1) & (table_size - 1))
+			if (table[slot].name == name)
+				return &table[slot];
+		return nullptr;
+	}
+
+	entry table[table_size];
+};
+
+static constexpr intrinsic_index s_intrinsic_index;
+
 #undef void
 #undef bool
 #undef bool2
@@ -173,9 +241,10 @@ void reshadefx::symbol_table::leave_scope()
 {
 	assert(_current_scope.level > 0);
 
-	for (auto &symbol : _symbol_stack)
+	// Only the symbol lists that had local symbols inserted in this scope (or any scope nested in it) can have symbols that go out of scope now
+	for (; !_local_symbols.empty() && _local_symbols.back().second >= _current_scope.level; _local_symbols.pop_back())
 	{
-		std::vector<scoped_symbol> &scope_list = symbol.second;
+		std::vector<scoped_symbol> &scope_list = *_local_symbols.back().first;
 
 		for (auto scope_it = scope_list.begin(); scope_it != scope_list.end();)
 		{
@@ -242,7 +311,13 @@ bool reshadefx::symbol_table::insert_symbol(const std::string &name, const symbo
 	else
 	{
 		// This is a local symbol so it's sufficient to update the symbol stack with just the current scope
-		insert_sorted(_symbol_stack[name], scoped_symbol { symbol, _current_scope });
+		std::vector<scoped_symbol> &scope_list = _symbol_stack[name];
+		insert_sorted(scope_list, scoped_symbol { symbol, _current_scope });
+
+		// Remember where the symbol was inserted, so it can be removed again without searching all symbols when the scope is left
+		// This works because references to elements in an unordered map stay valid when it grows
+		if (_current_scope.level > _current_scope.namespace_level)
+			_local_symbols.emplace_back(&scope_list, _current_scope.level);
 	}
 
 	return true;
@@ -397,9 +472,13 @@ bool reshadefx::symbol_table::resolve_function_call(const std::string &name, con
 	// Try matching against intrinsic functions if no matching user-defined function was found up to this point
 	if (num_overloads == 0)
 	{
-		for (const intrinsic &intrinsic : s_intrinsics)
+		const intrinsic_index::entry *const overloads = s_intrinsic_index.find(name);
+
+		for (size_t i = 0; overloads != nullptr && i < overloads->count; ++i)
 		{
-			if (intrinsic.function.name != name || intrinsic.function.parameter_list.size() != arguments.size())
+			const intrinsic &intrinsic = s_intrinsics[overloads->first + i];
+
+			if (intrinsic.function.parameter_list.size() != arguments.size())
 				continue;
 
 			// A new possibly-matching intrinsic function was found, compare it against the current result
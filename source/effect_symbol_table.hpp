@@ -78,6 +78,10 @@ namespace reshadefx
 		/// </summary>
 		/// <returns></returns>
 		const scope &current_scope() const { return _current_scope; }
+		/// <summary>
+		/// Replace the current scope with the specified one (e.g. to resolve symbols as they were seen at an earlier point) and return the previous one.
+		/// </summary>
+		scope exchange_scope(scope new_scope) { std::swap(new_scope, _current_scope); return new_scope; }
 
 		/// <summary>
 		/// Insert an new symbol in the symbol table. Returns <c>false</c> if a symbol by that name and type already exists.
@@ -99,5 +103,6 @@ namespace reshadefx
 		scope _current_scope;
 		std::unordered_map<std::string, // Lookup table from name to matching symbols
 			std::vector<scoped_symbol>> _symbol_stack;
+		std::vector<std::pair<std::vector<scoped_symbol> *, unsigned int>> _local_symbols; // Symbol lists with local symbols in them, together with the scope level they were inserted at
 	};
 }
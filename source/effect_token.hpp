@@ -6,6 +6,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace reshadefx
@@ -15,11 +16,24 @@ namespace reshadefx
 	/// </summary>
 	struct location
 	{
-		location() : line(1), column(1) {}
-		explicit location(unsigned int line, unsigned int column = 1) : line(line), column(column) {}
-		explicit location(std::string source, unsigned int line, unsigned int column = 1) : source(std::move(source)), line(line), column(column) {}
+		location() : source(0), line(1), column(1) {}
+		explicit location(unsigned int line, unsigned int column = 1) : source(0), line(line), column(column) {}
+		explicit location(std::string_view source_name, unsigned int line, unsigned int column = 1) : source(source_id(source_name)), line(line), column(column) {}
 
-		std::string source;
+		/// <summary>
+		/// Get the identifier for the specified source file name, adding it to the global list of known source files if it is not in there yet.
+		/// This is safe to call from multiple threads at once.
+		/// </summary>
+		/// <param name="name">The source file name to look up.</param>
+		/// <returns>The identifier to store in <see cref="location::source"/>, or zero if the name is empty.</returns>
+		static uint32_t source_id(std::string_view name);
+		/// <summary>
+		/// Get the name of the source file this location points into.
+		/// </summary>
+		/// <returns>A reference to the source file name, which stays valid for the lifetime of the process.</returns>
+		const std::string &source_name() const;
+
+		uint32_t source; // Index into the global list of source file names (zero means there is no source file associated with this location)
 		unsigned int line, column;
 	};
 
@@ -237,7 +251,8 @@ namespace reshadefx
 			float literal_as_float;
 			double literal_as_double;
 		};
-		std::string literal_as_string;
+		// Points into the input string of the lexer that produced this token (or into storage owned by that lexer for string literals with escape sequences, or by the preprocessor for tokens it outputs)
+		std::string_view literal_as_string;
 
 		inline operator tokenid() const { return id; }
 
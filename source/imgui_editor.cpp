@@ -1673,8 +1673,9 @@ void reshade::gui::code_editor::colorize()
 		for (size_t k = 0; k < _lines[l].size(); ++k)
 			input_string.push_back(_lines[l][k].c);
 
+	// The lexer can work directly on this string, since it outlives all tokens below
 	reshadefx::lexer lexer(
-		input_string,
+		std::string_view(input_string),
 		false /* ignore_comments */,
 		true  /* ignore_whitespace */,
 		false /* ignore_pp_directives */,
@@ -5,15 +5,31 @@
 
 #include "input.hpp"
 #include "dll_log.hpp"
-#include "hook_manager.hpp"
 #include <algorithm>
 #include <unordered_map>
-#include <Windows.h>
 
+#ifdef _WIN32
+	#include "hook_manager.hpp"
+	#include <Windows.h>
+#else
+	// Windows virtual key codes, which are used for the key state on all platforms, so that shortcuts in configuration files stay the same
+	// There is no input capture on other platforms, so all keys remain released there
+	#define VK_LBUTTON 0x01
+	#define VK_XBUTTON2 0x06
+	#define VK_SHIFT 0x10
+	#define VK_CONTROL 0x11
+	#define VK_MENU 0x12
+	#define ARRAYSIZE(arr) std::size(arr)
+#endif
+
+#ifdef _WIN32
 extern HMODULE g_module_handle;
+#endif
 static std::mutex s_windows_mutex;
+static std::unordered_map<reshade::input::window_handle, std::weak_ptr<reshade::input>> s_windows;
+#ifdef _WIN32
 static std::unordered_map<HWND, unsigned int> s_raw_input_windows;
-static std::unordered_map<HWND, std::weak_ptr<reshade::input>> s_windows;
+#endif
 
 reshade::input::input(window_handle window)
 	: _window(window)
@@ -21,6 +37,7 @@ reshade::input::input(window_handle window)
 	assert(window != nullptr);
 }
 
+#ifdef _WIN32
 #if RESHADE_UWP
 static bool is_uwp_app()
 {
@@ -48,11 +65,12 @@ void reshade::input::register_window_with_raw_input(window_handle window, bool n
 
 	if (!insert.second) insert.first->second |= flags;
 }
+#endif
 std::shared_ptr<reshade::input> reshade::input::register_window(window_handle window)
 {
 	const std::lock_guard<std::mutex> lock(s_windows_mutex);
 
-	const auto insert = s_windows.emplace(static_cast<HWND>(window), std::weak_ptr<input>());
+	const auto insert = s_windows.emplace(window, std::weak_ptr<input>());
 
 	if (insert.second || insert.first->second.expired())
 	{
@@ -72,6 +90,7 @@ std::shared_ptr<reshade::input> reshade::input::register_window(window_handle wi
 	}
 }
 
+#ifdef _WIN32
 bool reshade::input::handle_window_message(const void *message_data)
 {
 	assert(message_data != nullptr);
@@ -262,6 +281,7 @@ bool reshade::input::handle_window_message(const void *message_data)
 
 	return (is_mouse_message && input->_block_mouse) || (is_keyboard_message && input->_block_keyboard);
 }
+#endif
 
 bool reshade::input::is_key_down(unsigned int keycode) const
 {
@@ -367,6 +387,7 @@ void reshade::input::next_frame()
 	for (auto &state : _keys)
 		state &= ~0x08;
 
+#ifdef _WIN32
 	// Reset any pressed down key states (apart from mouse buttons) that have not been updated for more than 5 seconds
 	// Do not check mouse buttons here, since 'GetAsyncKeyState' always returns the state of the physical mouse buttons, not the logical ones in case they were remapped
 	// See https://docs.microsoft.com/windows/win32/api/winuser/nf-winuser-getasynckeystate
@@ -377,12 +398,14 @@ void reshade::input::next_frame()
 			(time - _keys_time[i]) > 5000 &&
 			(GetAsyncKeyState(i) & 0x8000) == 0)
 			(_keys[i] = 0x08);
+#endif
 
 	_text_input.clear();
 	_mouse_wheel_delta = 0;
 	_last_mouse_position[0] = _mouse_position[0];
 	_last_mouse_position[1] = _mouse_position[1];
 
+#ifdef _WIN32
 	// Update caps lock state
 	_keys[VK_CAPITAL] |= GetKeyState(VK_CAPITAL) & 0x1;
 
@@ -396,6 +419,7 @@ void reshade::input::next_frame()
 		(GetAsyncKeyState(VK_SNAPSHOT) & 0x8000) != 0)
 		(_keys[VK_SNAPSHOT] = 0x88),
 		(_keys_time[VK_SNAPSHOT] = time);
+#endif
 }
 
 std::string reshade::input::key_name(unsigned int keycode)
@@ -403,6 +427,7 @@ std::string reshade::input::key_name(unsigned int keycode)
 	if (keycode >= 256)
 		return std::string();
 
+#ifdef _WIN32
 	static const char *keyboard_keys_german[256] = {
 		"", "Left Mouse", "Right Mouse", "Cancel", "Middle Mouse", "X1 Mouse", "X2 Mouse", "", "Backspace", "Tab", "", "", "Clear", "Enter", "", "",
 		"Shift", "Control", "Alt", "Pause", "Caps Lock", "", "", "", "", "", "", "Escape", "", "", "", "",
@@ -421,6 +446,7 @@ std::string reshade::input::key_name(unsigned int keycode)
 		"", "", "OEM <", "", "", "", "", "", "", "", "", "", "", "", "", "",
 		"", "", "", "", "", "", "Attn", "CrSel", "ExSel", "Erase EOF", "Play", "Zoom", "", "PA1", "OEM Clear", ""
 	};
+#endif
 	static const char *keyboard_keys_international[256] = {
 		"", "Left Mouse", "Right Mouse", "Cancel", "Middle Mouse", "X1 Mouse", "X2 Mouse", "", "Backspace", "Tab", "", "", "Clear", "Enter", "", "",
 		"Shift", "Control", "Alt", "Pause", "Caps Lock", "", "", "", "", "", "", "Escape", "", "", "", "",
@@ -440,16 +466,21 @@ std::string reshade::input::key_name(unsigned int keycode)
 		"", "", "", "", "", "", "Attn", "CrSel", "ExSel", "Erase EOF", "Play", "Zoom", "", "PA1", "OEM Clear", ""
 	};
 
+#ifdef _WIN32
 	const LANGID language = LOWORD(GetKeyboardLayout(0));
 
 	return ((language & 0xFF) == LANG_GERMAN) ?
 		keyboard_keys_german[keycode] : keyboard_keys_international[keycode];
+#else
+	return keyboard_keys_international[keycode];
+#endif
 }
 std::string reshade::input::key_name(const unsigned int key[4])
 {
 	return (key[1] ? "Ctrl + " : std::string()) + (key[2] ? "Shift + " : std::string()) + (key[3] ? "Alt + " : std::string()) + key_name(key[0]);
 }
 
+#ifdef _WIN32
 static inline bool is_blocking_mouse_input()
 {
 	const auto predicate = [](auto input_window) {
@@ -653,3 +684,4 @@ HOOK_EXPORT BOOL WINAPI HookGetCursorPosition(LPPOINT lpPoint)
 	static const auto trampoline = reshade::hooks::call(HookGetCursorPosition);
 	return trampoline(lpPoint);
 }
+#endif
@@ -4,6 +4,9 @@
  */
 
 #include "input_freepie.hpp"
+
+#ifdef _WIN32
+
 #include <Windows.h>
 
 template <typename T>
@@ -66,3 +69,12 @@ bool freepie_io_read(uint32_t index, freepie_io_data *output)
 
 	return true;
 }
+
+#else
+
+bool freepie_io_read(uint32_t, freepie_io_data *)
+{
+	return false; // FreePIE is only available on Windows
+}
+
+#endif
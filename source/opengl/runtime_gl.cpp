@@ -372,7 +372,7 @@ bool reshade::opengl::runtime_gl::capture_screenshot(uint8_t *buffer) const
 	return true;
 }
 
-bool reshade::opengl::runtime_gl::init_effect(size_t index)
+bool reshade::opengl::runtime_gl::init_effect(size_t index, const compiled_effect &)
 {
 	assert(_app_state.has_state); // Make sure all binds below are reset later when application state is restored
 
@@ -417,7 +417,10 @@ bool reshade::opengl::runtime_gl::init_effect(size_t index)
 			assert(_renderer_id >= 0x14600); // Core since OpenGL 4.6 (see https://www.khronos.org/opengl/wiki/SPIR-V)
 			assert(gl3wProcs.gl.ShaderBinary != nullptr && gl3wProcs.gl.SpecializeShader != nullptr);
 
-			glShaderBinary(1, &shader_object, GL_SHADER_BINARY_FORMAT_SPIR_V, effect.module.spirv.data(), static_cast<GLsizei>(effect.module.spirv.size() * sizeof(uint32_t)));
+			// Prefer the module that only contains what this entry point references, so the driver has less to compile
+			const std::vector<uint32_t> &spirv = entry_point.spirv.empty() ? effect.module.spirv : entry_point.spirv;
+
+			glShaderBinary(1, &shader_object, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv.data(), static_cast<GLsizei>(spirv.size() * sizeof(uint32_t)));
 			glSpecializeShader(shader_object, entry_point.name.c_str(), GLuint(spec_constants.size()), spec_constants.data(), spec_data.data());
 		}
 		else
@@ -455,8 +458,11 @@ bool reshade::opengl::runtime_gl::init_effect(size_t index)
 			defines += "#line 1 0\n"; // Reset line number, so it matches what is shown when viewing the generated code
 			defines += effect.preamble;
 
-			GLsizei lengths[] = { static_cast<GLsizei>(defines.size()), static_cast<GLsizei>(effect.module.hlsl.size()) };
-			const GLchar *sources[] = { defines.c_str(), effect.module.hlsl.c_str() };
+			// Prefer the code that only contains what this entry point references, so the driver has less to compile
+			const std::string &glsl = entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl;
+
+			GLsizei lengths[] = { static_cast<GLsizei>(defines.size()), static_cast<GLsizei>(glsl.size()) };
+			const GLchar *sources[] = { defines.c_str(), glsl.c_str() };
 			glShaderSource(shader_object, 2, sources, lengths);
 			glCompileShader(shader_object);
 		}
@@ -29,7 +29,7 @@ namespace reshade::opengl
 		std::unordered_set<HDC> _hdcs;
 
 	private:
-		bool init_effect(size_t index) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
 		void unload_effect(size_t index) override;
 		void unload_effects() override;
 
@@ -8,13 +8,15 @@
 #include "dll_config.hpp"
 #include "runtime.hpp"
 #include "runtime_objects.hpp"
+#include "runtime_platform.hpp"
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include "effect_preprocessor.hpp"
 #include "input.hpp"
 #include "input_freepie.hpp"
 #include <set>
-#include <thread>
+#include <cmath>
+#include <climits>
 #include <algorithm>
 #include <stb_image.h>
 #include <stb_image_dds.h>
@@ -68,6 +70,40 @@ static std::vector<std::filesystem::path> find_files(const std::vector<std::file
 	return files;
 }
 
+static std::string file_stat(const std::filesystem::path &path)
+{
+	// Modification time and size are enough to detect changes to a file, without having to read its contents
+	std::error_code ec;
+	const auto write_time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	if (ec)
+		return std::string();
+	const auto size = std::filesystem::file_size(path, ec);
+	if (ec)
+		return std::string();
+	return std::to_string(write_time) + ' ' + std::to_string(size);
+}
+static void hash_file_stat(reshadefx::hasher &hasher, const std::filesystem::path &path)
+{
+	hasher.update(path.u8string() + '?' + file_stat(path) + ';');
+}
+static bool write_cache_file(const std::filesystem::path &path, const void *data, size_t size)
+{
+	// Cache files are written on worker threads, so write to a temporary file first and only move it into place once complete, to never have a partially written file be read
+	// Each thread uses its own temporary file, so that neither a concurrent writer nor a file left behind by one that was interrupted can block the cache entry
+	std::filesystem::path temp_path = path;
+	temp_path += '.' + std::to_string(reshade::platform::current_thread_id()) + ".tmp";
+
+	// Do not replace an existing file, since another thread may have written the same contents already and it may be read from at this point
+	if (!reshade::platform::write_file(temp_path, { std::string_view(static_cast<const char *>(data), size) }) ||
+		!reshade::platform::move_file_no_replace(temp_path, path))
+	{
+		std::error_code ec; std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	return true;
+}
+
 reshade::runtime::runtime() :
 	_start_time(std::chrono::high_resolution_clock::now()),
 	_last_present_time(std::chrono::high_resolution_clock::now()),
@@ -101,7 +137,6 @@ reshade::runtime::runtime() :
 }
 reshade::runtime::~runtime()
 {
-	assert(_worker_threads.empty());
 	assert(!_is_initialized && _techniques.empty());
 
 #if RESHADE_GUI
@@ -242,8 +277,16 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 {
 	std::string attributes;
 	attributes += "app=" + g_target_executable_path.stem().u8string() + ';';
-	attributes += "width=" + std::to_string(_width) + ';';
-	attributes += "height=" + std::to_string(_height) + ';';
+	// Effects compiled independent of the resolution only depend on it if an #if directive evaluates the buffer dimensions, which is checked when loading the cached source instead
+	if (_resolution_independent_effects)
+	{
+		attributes += "resolution_independent=1;";
+	}
+	else
+	{
+		attributes += "width=" + std::to_string(_width) + ';';
+		attributes += "height=" + std::to_string(_height) + ';';
+	}
 	attributes += "color_bit_depth=" + std::to_string(_color_bit_depth) + ';';
 	attributes += "version=" + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + ';';
 	attributes += "performance_mode=" + std::string(_performance_mode ? "1" : "0") + ';';
@@ -258,31 +301,30 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 			include_paths.emplace(std::move(include_path));
 
 	for (const std::filesystem::path &include_path : include_paths)
-	{
-		std::error_code ec;
-		attributes += include_path.u8string();
-		for (const auto &entry : std::filesystem::directory_iterator(include_path, std::filesystem::directory_options::skip_permission_denied, ec))
-		{
-			const std::filesystem::path filename = entry.path().filename();
-			if (filename == source_file.filename() || filename.extension() == L".fxh")
-			{
-				attributes += ',';
-				attributes += filename.u8string();
-				attributes += '?';
-				attributes += std::to_string(entry.last_write_time(ec).time_since_epoch().count());
-			}
-		}
-		attributes += ';';
-	}
+		attributes += include_path.u8string() + ';';
 
 	std::vector<std::string> preprocessor_definitions = _global_preprocessor_definitions;
 	preprocessor_definitions.insert(preprocessor_definitions.end(), _preset_preprocessor_definitions.begin(), _preset_preprocessor_definitions.end());
 	for (const std::string &definition : preprocessor_definitions)
 		attributes += definition + ';';
 
-	const size_t source_hash = std::hash<std::string>()(attributes);
+	// The cache key covers the attributes, the names of all files in the effect search paths (which decide what an #include resolves to) and the source file itself
+	// Included files are not part of it, since they are only known after preprocessing, instead they are listed in the cached file and validated when loading it
+	reshadefx::hasher hasher;
+	hasher.update(attributes);
+	hasher.update_value(_effect_files_hash);
+	hash_file_stat(hasher, source_file);
+	const reshadefx::hash128 cache_key = hasher.finalize();
+
+	// Work on a copy of the effect, since the render thread keeps using the effect list while this runs on a worker thread
+	effect effect = _effects[effect_index];
+
+	// Include the files from the last time this effect was preprocessed in the hash, so that changes to any of them cause it to be loaded again
+	if (source_file == effect.source_file)
+		for (const std::filesystem::path &included_file : effect.included_files)
+			hash_file_stat(hasher, included_file);
+	const reshadefx::hash128 source_hash = hasher.finalize();
 
-	effect &effect = _effects[effect_index];
 	const std::string effect_name = source_file.filename().u8string();
 	if (source_file != effect.source_file || source_hash != effect.source_hash)
 	{
@@ -291,7 +333,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		effect.source_hash = source_hash;
 	}
 
-	if (_effect_load_skipping && !_load_option_disable_skipping && !_worker_threads.empty()) // Only skip during 'load_effects'
+	if (_effect_load_skipping && !_load_option_disable_skipping && _task_pool.is_worker_thread()) // Only skip during 'load_effects'
 	{
 		if (std::vector<std::string> techniques;
 			preset.get({}, "Techniques", techniques))
@@ -302,17 +344,20 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 
 			if (effect.skipped)
 			{
-				if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
-					_reload_remaining_effects--;
+				const std::lock_guard<std::mutex> lock(_reload_mutex);
+				_reload_loaded_effects.emplace_back(effect_index, std::move(effect));
 				return false;
 			}
 		}
 	}
 
+	// The preprocessor has to outlive the parser, since the tokens it produces reference memory owned by it
+	reshadefx::preprocessor pp;
+	pp.set_token_output(true);
+
 	bool source_cached = false; std::string source;
-	if (!effect.preprocessed && (preprocess_required || (source_cached = load_effect_cache(source_file, source_hash, source)) == false))
+	if (!effect.preprocessed && (preprocess_required || (source_cached = load_effect_cache(source_file, cache_key, source, effect.included_files)) == false))
 	{
-		reshadefx::preprocessor pp;
 		pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
 		pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0");
 		pp.add_macro_definition("__VENDOR__", std::to_string(_vendor_id));
@@ -320,8 +365,19 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		pp.add_macro_definition("__RENDERER__", std::to_string(_renderer_id));
 		pp.add_macro_definition("__APPLICATION__", std::to_string( // Truncate hash to 32-bit, since lexer currently only supports 32-bit numbers anyway
 			std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF));
-		pp.add_macro_definition("BUFFER_WIDTH", std::to_string(_width));
-		pp.add_macro_definition("BUFFER_HEIGHT", std::to_string(_height));
+		if (_resolution_independent_effects)
+		{
+			// Leave the buffer dimensions to the parser, which reads them from uniform variables wherever they do not have to be constant
+			pp.add_runtime_constant("__RESHADE_BUFFER_WIDTH__", static_cast<int>(_width));
+			pp.add_runtime_constant("__RESHADE_BUFFER_HEIGHT__", static_cast<int>(_height));
+			pp.add_macro_definition("BUFFER_WIDTH", "__RESHADE_BUFFER_WIDTH__");
+			pp.add_macro_definition("BUFFER_HEIGHT", "__RESHADE_BUFFER_HEIGHT__");
+		}
+		else
+		{
+			pp.add_macro_definition("BUFFER_WIDTH", std::to_string(_width));
+			pp.add_macro_definition("BUFFER_HEIGHT", std::to_string(_height));
+		}
 		pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
 		pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
 		pp.add_macro_definition("BUFFER_COLOR_BIT_DEPTH", std::to_string(_color_bit_depth));
@@ -343,6 +399,16 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		for (const std::filesystem::path &include_path : include_paths)
 			pp.add_include_path(include_path);
 
+		// Precompile the common headers most effects include, so that they are only preprocessed once and later restored from a snapshot next to the effect cache
+		if (!_no_effect_cache)
+		{
+			std::error_code ec;
+			const std::filesystem::path snapshot_directory = g_reshade_base_path / _intermediate_cache_path / L"reshade-pch";
+			if (std::filesystem::create_directory(snapshot_directory, ec) || std::filesystem::is_directory(snapshot_directory, ec))
+				for (const char *const header : { "ReShade.fxh", "ReShadeUI.fxh" })
+					pp.add_precompiled_header(header, snapshot_directory);
+		}
+
 		// Add some conversion macros for compatibility with older versions of ReShade
 		pp.append_string(
 			"#define tex2Doffset(s, coords, offset) tex2D(s, coords, offset)\n"
@@ -363,7 +429,11 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		if (effect.preprocessed)
 		{
 			source = std::move(pp.output());
-			source_cached = save_effect_cache(source_file, source_hash, source);
+			// Keep track of included files
+			effect.included_files = pp.included_files();
+			std::sort(effect.included_files.begin(), effect.included_files.end()); // Sort file names alphabetically
+
+			source_cached = save_effect_cache(source_file, cache_key, source, effect.included_files, pp.runtime_constants_evaluated());
 
 			// Keep track of used preprocessor definitions (so they can be displayed in the overlay)
 			effect.definitions.clear();
@@ -376,45 +446,73 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 			}
 
 			std::sort(effect.definitions.begin(), effect.definitions.end());
-
-			// Keep track of included files
-			effect.included_files = pp.included_files();
-			std::sort(effect.included_files.begin(), effect.included_files.end()); // Sort file names alphabetically
 		}
 	}
 
 	if (!effect.compiled && !source.empty())
 	{
-		unsigned shader_model;
-		if (_renderer_id == 0x9000)
-			shader_model = 30; // D3D9
-		else if (_renderer_id < 0xa100)
-			shader_model = 40; // D3D10 (including feature level 9)
-		else if (_renderer_id < 0xb000)
-			shader_model = 41; // D3D10.1
-		else if (_renderer_id < 0xc000)
-			shader_model = 50; // D3D11
+		// The module only depends on the pre-processed source code and the code generation options, so it can be restored from the cache as long as none of those changed
+		reshadefx::hasher module_hasher;
+		module_hasher.update(source);
+		module_hasher.update_value(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION);
+		module_hasher.update_value(_renderer_id);
+		module_hasher.update_value(_no_debug_info);
+		module_hasher.update_value(_performance_mode);
+		// The buffer dimensions are not part of the key, since modules the parser baked them into (e.g. in texture dimensions) are marked as such when cached and checked when loading them instead
+		const reshadefx::hash128 module_key = module_hasher.finalize();
+
+		std::string module_errors;
+		if (load_effect_cache(source_file, module_key, effect.module, module_errors))
+		{
+			effect.compiled = true;
+			effect.errors += module_errors;
+		}
 		else
-			shader_model = 51; // D3D12
-
-		std::unique_ptr<reshadefx::codegen> codegen;
-		if ((_renderer_id & 0xF0000) == 0)
-			codegen.reset(reshadefx::create_codegen_hlsl(shader_model, !_no_debug_info, _performance_mode));
-		else if (_renderer_id < 0x20000)
-			codegen.reset(reshadefx::create_codegen_glsl(!_no_debug_info, _performance_mode, false, true));
-		else // Vulkan uses SPIR-V input
-			codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, true));
+		{
+			unsigned shader_model;
+			if (_renderer_id == 0x9000)
+				shader_model = 30; // D3D9
+			else if (_renderer_id < 0xa100)
+				shader_model = 40; // D3D10 (including feature level 9)
+			else if (_renderer_id < 0xb000)
+				shader_model = 41; // D3D10.1
+			else if (_renderer_id < 0xc000)
+				shader_model = 50; // D3D11
+			else
+				shader_model = 51; // D3D12
+
+			std::unique_ptr<reshadefx::codegen> codegen;
+			if ((_renderer_id & 0xF0000) == 0)
+				codegen.reset(reshadefx::create_codegen_hlsl(shader_model, !_no_debug_info, _performance_mode, true));
+			else if (_renderer_id < 0x20000)
+				codegen.reset(reshadefx::create_codegen_glsl(!_no_debug_info, _performance_mode, false, true, true));
+			else // Vulkan uses SPIR-V input
+				codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, true, true, _performance_mode));
+
+			reshadefx::parser parser;
+			if (_resolution_independent_effects)
+			{
+				parser.add_runtime_constant("__RESHADE_BUFFER_WIDTH__", static_cast<int>(_width), "bufwidth");
+				parser.add_runtime_constant("__RESHADE_BUFFER_HEIGHT__", static_cast<int>(_height), "bufheight");
+			}
 
-		reshadefx::parser parser;
+			// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
+			// Pass the tokens from the preprocessor directly to the parser if it was run, instead of lexing the pre-processed source code again
+			if (!pp.output_tokens().empty())
+				effect.compiled = parser.parse(std::move(pp.output_tokens()), codegen.get());
+			else
+				effect.compiled = parser.parse(std::move(source), codegen.get());
 
-		// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
-		effect.compiled = parser.parse(std::move(source), codegen.get());
+			// Append parser errors to the error list
+			effect.errors  += parser.errors();
 
-		// Append parser errors to the error list
-		effect.errors  += parser.errors();
+			// Write result to effect module
+			codegen->write_result(effect.module);
 
-		// Write result to effect module
-		codegen->write_result(effect.module);
+			// Cache the module before any changes are made to it below, so that the next load can skip parsing and code generation
+			if (effect.compiled)
+				save_effect_cache(source_file, module_key, effect.module, parser.errors(), parser.runtime_constants_evaluated());
+		}
 
 		if (effect.compiled)
 		{
@@ -427,9 +525,6 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 			{
 				variable.effect_index = effect_index;
 
-				// Copy initial data into uniform storage area
-				reset_uniform_value(variable);
-
 				const std::string_view special = variable.annotation_as_string("source");
 				if (special.empty()) /* Ignore if annotation is missing */;
 				else if (special == "frametime")
@@ -464,6 +559,10 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					variable.special = special_uniform::overlay_hovered;
 				else if (special == "bufready_depth")
 					variable.special = special_uniform::bufready_depth;
+				else if (special == "bufwidth")
+					variable.special = special_uniform::buffer_width;
+				else if (special == "bufheight")
+					variable.special = special_uniform::buffer_height;
 
 				effect.uniforms.push_back(std::move(variable));
 			}
@@ -523,10 +622,60 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		}
 	}
 
-	if ( effect.compiled && (effect.preprocessed || source_cached))
+	// Neither preprocessing the source file nor loading the preprocessed source from the cache worked
+	if (!effect.preprocessed && !source_cached)
+		effect.compiled = false;
+
+	// Leave adding the effect to the render thread when running on a worker thread, so that it can keep rendering the effects that were already added in the meantime
+	if (_task_pool.is_worker_thread())
+	{
+		const bool success = effect.compiled;
+
+		const std::lock_guard<std::mutex> lock(_reload_mutex);
+		_reload_loaded_effects.emplace_back(effect_index, std::move(effect));
+		return success;
+	}
+
+	return add_effect(effect_index, std::move(effect));
+}
+bool reshade::runtime::add_effect(size_t effect_index, effect &&loaded_effect)
+{
+	_effects[effect_index] = std::move(loaded_effect);
+	effect &effect = _effects[effect_index];
+
+	if (effect.skipped)
+	{
+		if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
+			_reload_remaining_effects--;
+		return false;
+	}
+
+	if (effect.compiled)
 	{
+		// Copy initial data into uniform storage area, now that the effect is part of the effect list
+		for (uniform &variable : effect.uniforms)
+			reset_uniform_value(variable);
+
 		const std::lock_guard<std::mutex> lock(_reload_mutex);
 
+		const auto make_shared_texture_writable = [this, effect_index](texture &tex) {
+			if (tex.render_target && tex.storage_access)
+				return;
+
+			tex.render_target = true;
+			tex.storage_access = true;
+
+			// The flags cannot be changed after the texture was created, so create it again and initialize the other effects using it again too, since their device objects still reference the old one
+			if (tex.impl == nullptr)
+				return;
+
+			destroy_texture(tex);
+
+			for (const size_t shared_effect_index : tex.shared)
+				if (shared_effect_index != effect_index && std::find(_reload_reinit_effects.begin(), _reload_reinit_effects.end(), shared_effect_index) == _reload_reinit_effects.end())
+					_reload_reinit_effects.push_back(shared_effect_index);
+		};
+
 		for (texture texture : effect.module.textures)
 		{
 			texture.effect_index = effect_index;
@@ -574,8 +723,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					existing_texture->shared.push_back(effect_index);
 
 				// Always make shared textures render targets, since they may be used as such in a different effect
-				existing_texture->render_target = true;
-				existing_texture->storage_access = true;
+				make_shared_texture_writable(*existing_texture);
 				continue;
 			}
 
@@ -614,8 +762,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
 						existing_texture->shared.push_back(effect_index);
 
-					existing_texture->render_target = true;
-					existing_texture->storage_access = true;
+					make_shared_texture_writable(*existing_texture);
 					continue;
 				}
 			}
@@ -642,17 +789,21 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		}
 	}
 
+	// Apply the preset to this effect right away while other effects are still loading, so that its techniques are queued for initialization and start rendering without waiting for the rest
+	if (effect.compiled && is_loading())
+		load_current_preset(effect_index);
+
 	if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
 		_reload_remaining_effects--;
 	else
 		_reload_remaining_effects = 0; // Force effect initialization in 'update_and_render_effects'
 
-	if ( effect.compiled && (effect.preprocessed || source_cached))
+	if (effect.compiled)
 	{
 		if (effect.errors.empty())
-			LOG(INFO) << "Successfully loaded " << source_file << '.';
+			LOG(INFO) << "Successfully loaded " << effect.source_file << '.';
 		else
-			LOG(WARN) << "Successfully loaded " << source_file << " with warnings:\n" << effect.errors;
+			LOG(WARN) << "Successfully loaded " << effect.source_file << " with warnings:\n" << effect.errors;
 		return true;
 	}
 	else
@@ -660,9 +811,9 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		_last_reload_successfull = false;
 
 		if (effect.errors.empty())
-			LOG(ERROR) << "Failed to load " << source_file << '!';
+			LOG(ERROR) << "Failed to load " << effect.source_file << '!';
 		else
-			LOG(ERROR) << "Failed to load " << source_file << ":\n" << effect.errors;
+			LOG(ERROR) << "Failed to load " << effect.source_file << ":\n" << effect.errors;
 		return false;
 	}
 }
@@ -673,9 +824,25 @@ void reshade::runtime::load_effects()
 	ini_file &preset = ini_file::load_cache(_current_preset_path);
 	preset.get({}, "PreprocessorDefinitions", _preset_preprocessor_definitions);
 
-	// Build a list of effect files by walking through the effect search paths
-	const std::vector<std::filesystem::path> effect_files =
-		find_files(_effect_search_paths, { L".fx" });
+	// Build a list of effect and header files by walking through the effect search paths
+	std::vector<std::filesystem::path> effect_files =
+		find_files(_effect_search_paths, { L".fx", L".fxh" });
+
+	// Hash the names of all these files once here, instead of scanning the search paths again for every effect to build its cache key
+	// Adding or removing a header can change which file an #include resolves to, so that has to invalidate the effect cache
+	std::vector<std::string> file_names;
+	file_names.reserve(effect_files.size());
+	for (const std::filesystem::path &file : effect_files)
+		file_names.push_back(file.u8string());
+	std::sort(file_names.begin(), file_names.end()); // Directory iteration order is not guaranteed to be stable
+
+	reshadefx::hasher hasher;
+	for (const std::string &file_name : file_names)
+		hasher.update(file_name + ';');
+	_effect_files_hash = hasher.finalize();
+
+	effect_files.erase(std::remove_if(effect_files.begin(), effect_files.end(),
+		[](const std::filesystem::path &file) { return file.extension() != L".fx"; }), effect_files.end());
 
 	if (effect_files.empty())
 		return; // No effect files found, so nothing more to do
@@ -685,30 +852,108 @@ void reshade::runtime::load_effects()
 	_effects.resize(offset + effect_files.size());
 	_reload_remaining_effects = effect_files.size();
 
-	// Now that we have a list of files, load them in parallel
-	// Split workload into batches instead of launching a thread for every file to avoid launch overhead and stutters due to too many threads being in flight
-	const size_t num_splits = std::min<size_t>(effect_files.size(), std::max<size_t>(std::thread::hardware_concurrency(), 2u) - 1);
+	// Effect files that techniques in the current preset reference are loaded before all others, so that those can start rendering as soon as possible
+	std::vector<std::string> technique_list;
+	preset.get({}, "Techniques", technique_list);
+	std::unordered_set<std::string> preset_effect_names;
+	for (const std::string &technique : technique_list)
+		if (const size_t at_pos = technique.find('@'); at_pos != std::string::npos)
+			preset_effect_names.insert(technique.substr(at_pos + 1));
+
+	// Now that we have a list of files, load them in parallel, with one task per file so that idle worker threads can pick up the remaining files while others are busy with an expensive one
+	// Start with the files that took the longest to load last time, so that they do not end up holding up the end of the reload
+	// Files that were not loaded before come first (largest first), since nothing better is known about their cost
+	struct load_estimate
+	{
+		bool in_preset;
+		bool known;
+		int64_t cost;
+	};
+
+	std::vector<load_estimate> estimates(effect_files.size());
+	for (size_t i = 0; i < effect_files.size(); ++i)
+	{
+		estimates[i].in_preset = preset_effect_names.find(effect_files[i].filename().u8string()) != preset_effect_names.end();
+
+		if (const auto it = _effect_load_durations.find(effect_files[i].u8string()); it != _effect_load_durations.end())
+		{
+			estimates[i].known = true;
+			estimates[i].cost = it->second.count();
+		}
+		else
+		{
+			std::error_code ec;
+			const uintmax_t file_size = std::filesystem::file_size(effect_files[i], ec);
+			estimates[i].known = false;
+			estimates[i].cost = ec ? 0 : static_cast<int64_t>(file_size);
+		}
+	}
+
+	std::vector<size_t> load_order(effect_files.size());
+	for (size_t i = 0; i < load_order.size(); ++i)
+		load_order[i] = i;
+	std::stable_sort(load_order.begin(), load_order.end(), [&estimates](size_t lhs, size_t rhs) {
+		if (estimates[lhs].in_preset != estimates[rhs].in_preset)
+			return estimates[lhs].in_preset;
+		if (estimates[lhs].known != estimates[rhs].known)
+			return !estimates[lhs].known;
+		return estimates[lhs].cost > estimates[rhs].cost; });
+
+	// Share a copy of the preset instead of a reference, so it stays valid even if 'ini_file::load_cache' is called while effects are still being loaded
+	const auto preset_copy = std::make_shared<const ini_file>(preset);
+
+	std::vector<std::function<void()>> tasks;
+	tasks.reserve(load_order.size());
+	for (const size_t i : load_order)
+	{
+		begin_effect_task(offset + i);
 
-	// Keep track of the spawned threads, so the runtime cannot be destroyed while they are still running
-	for (size_t n = 0; n < num_splits; ++n)
-		// Create copy of preset instead of reference, so it stays valid even if 'ini_file::load_cache' is called while effects are still being loaded
-		_worker_threads.emplace_back([this, effect_files, offset, num_splits, n, preset]() {
+		tasks.push_back([this, source_file = effect_files[i], effect_index = offset + i, preset_copy]() {
 			// Abort loading when initialization state changes (indicating that 'on_reset' was called in the meantime)
-			for (size_t i = 0; i < effect_files.size() && _is_initialized; ++i)
-				if (i * num_splits / effect_files.size() == n)
-					load_effect(effect_files[i], preset, offset + i);
+			if (_is_initialized)
+			{
+				const auto load_start = std::chrono::high_resolution_clock::now();
+				load_effect(source_file, *preset_copy, effect_index);
+				const auto load_duration = std::chrono::high_resolution_clock::now() - load_start;
+
+				const std::lock_guard<std::mutex> lock(_reload_mutex);
+				_effect_load_durations[source_file.u8string()] = load_duration;
+			}
+
+			end_effect_task(effect_index);
 		});
+	}
+
+	_task_pool.push(std::move(tasks));
+}
+bool reshade::runtime::compile_effect(size_t, compiled_effect &)
+{
+	return true; // Nothing to compile ahead of time by default
 }
+
 void reshade::runtime::load_textures()
 {
 	_last_texture_reload_successfull = true;
 
 	LOG(INFO) << "Loading image files for textures ...";
 
+	struct image_file
+	{
+		texture *tex;
+		std::filesystem::path source_path;
+		unsigned char *filedata = nullptr;
+		int width = 0, height = 0, channels = 0;
+		std::vector<uint8_t> resized;
+	};
+
+	std::vector<image_file> images;
+
 	for (texture &texture : _textures)
 	{
 		if (texture.impl == nullptr || !texture.semantic.empty())
 			continue; // Ignore textures that are not created yet and those that are handled in the runtime implementation
+		if (texture.loaded)
+			continue; // Ignore textures that already have their image data, since this is called again every time another effect was initialized
 
 		std::filesystem::path source_path = std::filesystem::u8path(
 			texture.annotation_as_string("source"));
@@ -724,44 +969,57 @@ void reshade::runtime::load_textures()
 			continue;
 		}
 
-		unsigned char *filedata = nullptr;
-		int width = 0, height = 0, channels = 0;
+		image_file &image = images.emplace_back();
+		image.tex = &texture;
+		image.source_path = std::move(source_path);
+	}
 
-		if (FILE *file; _wfopen_s(&file, source_path.c_str(), L"rb") == 0)
+	// Read and decode all image files in parallel, only the upload has to happen on this thread
+	_task_pool.parallel_for(images.size(), [&images](size_t i) {
+		image_file &image = images[i];
+
+		// Read texture data into memory in one go since that is faster than reading chunk by chunk
+		if (std::vector<char> file_data; reshade::platform::read_file(image.source_path, file_data))
 		{
-			// Read texture data into memory in one go since that is faster than reading chunk by chunk
-			std::vector<uint8_t> mem(static_cast<size_t>(std::filesystem::file_size(source_path)));
-			fread(mem.data(), 1, mem.size(), file);
-			fclose(file);
+			const auto mem = reinterpret_cast<const stbi_uc *>(file_data.data());
 
-			if (stbi_dds_test_memory(mem.data(), static_cast<int>(mem.size())))
-				filedata = stbi_dds_load_from_memory(mem.data(), static_cast<int>(mem.size()), &width, &height, &channels, STBI_rgb_alpha);
+			if (stbi_dds_test_memory(mem, static_cast<int>(file_data.size())))
+				image.filedata = stbi_dds_load_from_memory(mem, static_cast<int>(file_data.size()), &image.width, &image.height, &image.channels, STBI_rgb_alpha);
 			else
-				filedata = stbi_load_from_memory(mem.data(), static_cast<int>(mem.size()), &width, &height, &channels, STBI_rgb_alpha);
+				image.filedata = stbi_load_from_memory(mem, static_cast<int>(file_data.size()), &image.width, &image.height, &image.channels, STBI_rgb_alpha);
+		}
+
+		// Need to potentially resize image data to the texture dimensions
+		if (image.filedata != nullptr && (image.tex->width != uint32_t(image.width) || image.tex->height != uint32_t(image.height)))
+		{
+			image.resized.resize(image.tex->width * image.tex->height * 4);
+			stbir_resize_uint8(image.filedata, image.width, image.height, 0, image.resized.data(), image.tex->width, image.tex->height, 0, 4);
 		}
+	});
+
+	for (image_file &image : images)
+	{
+		texture &texture = *image.tex;
 
-		if (filedata == nullptr)
+		if (image.filedata == nullptr)
 		{
-			LOG(ERROR) << "Source " << source_path << " for texture '" << texture.unique_name << "' could not be loaded! Make sure it is of a compatible file format.";
+			LOG(ERROR) << "Source " << image.source_path << " for texture '" << texture.unique_name << "' could not be loaded! Make sure it is of a compatible file format.";
 			_last_texture_reload_successfull = false;
 			continue;
 		}
 
-		// Need to potentially resize image data to the texture dimensions
-		if (texture.width != uint32_t(width) || texture.height != uint32_t(height))
+		if (!image.resized.empty())
 		{
-			LOG(INFO) << "Resizing image data for texture '" << texture.unique_name << "' from " << width << "x" << height << " to " << texture.width << "x" << texture.height << " ...";
+			LOG(INFO) << "Resized image data for texture '" << texture.unique_name << "' from " << image.width << "x" << image.height << " to " << texture.width << "x" << texture.height << '.';
 
-			std::vector<uint8_t> resized(texture.width * texture.height * 4);
-			stbir_resize_uint8(filedata, width, height, 0, resized.data(), texture.width, texture.height, 0, 4);
-			upload_texture(texture, resized.data());
+			upload_texture(texture, image.resized.data());
 		}
 		else
 		{
-			upload_texture(texture, filedata);
+			upload_texture(texture, image.filedata);
 		}
 
-		stbi_image_free(filedata);
+		stbi_image_free(image.filedata);
 
 		texture.loaded = true;
 	}
@@ -777,9 +1035,18 @@ void reshade::runtime::unload_effect(size_t effect_index)
 	_preview_texture = nullptr;
 #endif
 
+	// Make sure no worker thread is still loading or compiling this effect, since its data is about to change
+	// Work on other effects can keep running, so that this does not stall the render thread until all of it finished
+	wait_for_effect_tasks(effect_index);
+
 	// Lock here to be safe in case another effect is still loading
 	const std::lock_guard<std::mutex> lock(_reload_mutex);
 
+	// Drop any pending initialization of this effect, the compile queue is filled again when its techniques are enabled after it was reloaded
+	_reload_compile_queue.erase(std::remove(_reload_compile_queue.begin(), _reload_compile_queue.end(), effect_index), _reload_compile_queue.end());
+	_reload_compiled_effects.erase(std::remove_if(_reload_compiled_effects.begin(), _reload_compiled_effects.end(),
+		[effect_index](const compiled_effect &compiled) { return compiled.effect_index == effect_index; }), _reload_compiled_effects.end());
+
 	// Destroy textures belonging to this effect
 	_textures.erase(std::remove_if(_textures.begin(), _textures.end(),
 		[this, effect_index](texture &tex) {
@@ -790,6 +1057,13 @@ void reshade::runtime::unload_effect(size_t effect_index)
 			}
 			return false;
 		}), _textures.end());
+	// Textures after the removed ones moved, so find the stereo texture again if it is still in use by another effect
+	if (_doubletex_index != std::numeric_limits<size_t>::max())
+	{
+		const auto it = std::find_if(_textures.begin(), _textures.end(),
+			[](const texture &tex) { return tex.unique_name == "V__DoubleTex"; });
+		_doubletex_index = it != _textures.end() ? it - _textures.begin() : std::numeric_limits<size_t>::max();
+	}
 	// Clean up techniques belonging to this effect
 	_techniques.erase(std::remove_if(_techniques.begin(), _techniques.end(),
 		[effect_index](const technique &tech) {
@@ -807,10 +1081,13 @@ void reshade::runtime::unload_effects()
 #endif
 
 	// Make sure no threads are still accessing effect data
-	for (std::thread &thread : _worker_threads)
-		if (thread.joinable())
-			thread.join();
-	_worker_threads.clear();
+	_task_pool.wait();
+
+	// Drop effects that finished loading or compiling, but were not added or initialized before, since they belong to the effect list that is cleared below
+	_reload_loaded_effects.clear();
+	_reload_compiled_effects.clear();
+	_reload_compile_queue.clear();
+	_reload_reinit_effects.clear();
 
 	// Destroy all textures
 	for (texture &tex : _textures)
@@ -845,111 +1122,174 @@ void reshade::runtime::reload_effects()
 #endif
 	_last_reload_successfull = true;
 
+	// Drop all cached include files, so that each one is read from disk once during this reload
+	reshadefx::preprocessor::clear_include_cache();
+
 	load_effects();
 }
 
-bool reshade::runtime::load_effect_cache(const std::filesystem::path &source_file, const size_t hash, std::string &source) const
+bool reshade::runtime::load_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, std::string &source, std::vector<std::filesystem::path> &included_files) const
 {
 	if (_no_effect_cache)
 		return false;
 
 	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
-	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(hash) + ".i");
+	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + hash.to_string() + ".i");
 
-	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-	if (file == INVALID_HANDLE_VALUE)
+	if (!platform::read_file(path, source))
 		return false;
-	DWORD size = GetFileSize(file, nullptr);
-	source.resize(size);
-	const BOOL result = ReadFile(file, source.data(), size, &size, nullptr);
-	CloseHandle(file);
-	return result != FALSE;
+
+	// Source that evaluated the buffer dimensions in an #if directive is only valid for the resolution it was preprocessed at
+	size_t offset = 0;
+	if (source.compare(0, 14, "//!resolution ") == 0)
+	{
+		const std::string resolution = "//!resolution " + std::to_string(_width) + ' ' + std::to_string(_height) + '\n';
+		if (source.compare(0, resolution.size(), resolution) != 0)
+			return false;
+
+		offset = resolution.size();
+	}
+
+	// The cached source starts with a list of all files that were included when it was preprocessed, which have to be unchanged for it to still be valid
+	std::vector<std::filesystem::path> files;
+	while (source.compare(offset, 11, "//!include ") == 0)
+	{
+		const size_t line_end = source.find('\n', offset);
+		const size_t stat_end = source.find(' ', source.find(' ', offset + 11) + 1);
+		if (line_end == std::string::npos || stat_end >= line_end)
+			return false;
+
+		std::filesystem::path included_file = std::filesystem::u8path(source.begin() + stat_end + 1, source.begin() + line_end);
+		if (source.compare(offset + 11, stat_end - offset - 11, file_stat(included_file)) != 0)
+			return false;
+
+		files.push_back(std::move(included_file));
+		offset = line_end + 1;
+	}
+
+	source.erase(0, offset);
+	included_files = std::move(files);
+	return true;
 }
-bool reshade::runtime::load_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const size_t hash, std::vector<char> &cso, std::string &dasm) const
+bool reshade::runtime::load_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const reshadefx::hash128 &hash, std::vector<char> &cso, std::string &dasm) const
 {
 	if (_no_effect_cache)
 		return false;
 
 	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
-	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + entry_point + '-' + std::to_string(_renderer_id) + '-' + std::to_string(hash) + ".cso");
+	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + entry_point + '-' + std::to_string(_renderer_id) + '-' + hash.to_string() + ".cso");
 
-	{	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-		if (file == INVALID_HANDLE_VALUE)
-			return false;
-		DWORD size = GetFileSize(file, nullptr);
-		cso.resize(size);
-		const BOOL result = ReadFile(file, cso.data(), size, &size, nullptr);
-		CloseHandle(file);
-		if (result == FALSE)
-			return false;
-	}
+	if (!platform::read_file(path, cso))
+		return false;
 
 	path.replace_extension(L".asm");
 
-	{	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-		if (file == INVALID_HANDLE_VALUE)
-			return false;
-		DWORD size = GetFileSize(file, nullptr);
-		dasm.resize(size);
-		const BOOL result = ReadFile(file, dasm.data(), size, &size, nullptr);
-		CloseHandle(file);
-		if (result == FALSE)
+	return platform::read_file(path, dasm);
+}
+bool reshade::runtime::load_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, reshadefx::module &module, std::string &errors) const
+{
+	if (_no_effect_cache)
+		return false;
+
+	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
+	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + hash.to_string() + ".module");
+
+	std::string data;
+	if (!platform::read_file(path, data))
+		return false;
+
+	// Modules the parser baked the buffer dimensions into are only valid for the resolution they were compiled at
+	std::string_view module_data = data;
+	if (module_data.compare(0, 14, "//!resolution ") == 0)
+	{
+		const std::string resolution = "//!resolution " + std::to_string(_width) + ' ' + std::to_string(_height) + '\n';
+		if (module_data.compare(0, resolution.size(), resolution) != 0)
 			return false;
+
+		module_data.remove_prefix(resolution.size());
 	}
 
+	// The serialized module is preceded by the warnings the parser reported for it, so that they are shown again when the module is restored
+	uint32_t errors_size = 0;
+	if (module_data.size() < sizeof(errors_size))
+		return false;
+	std::memcpy(&errors_size, module_data.data(), sizeof(errors_size));
+	if (errors_size > module_data.size() - sizeof(errors_size))
+		return false;
+
+	if (!reshadefx::deserialize_module(module_data.substr(sizeof(errors_size) + errors_size), module))
+		return false;
+
+	errors.assign(module_data.substr(sizeof(errors_size), errors_size));
 	return true;
 }
-bool reshade::runtime::save_effect_cache(const std::filesystem::path &source_file, const size_t hash, const std::string &source) const
+bool reshade::runtime::save_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, const std::string &source, const std::vector<std::filesystem::path> &included_files, bool resolution_dependent) const
 {
 	if (_no_effect_cache)
 		return false;
 
 	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
-	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(hash) + ".i");
+	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + hash.to_string() + ".i");
 
-	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-	if (file == INVALID_HANDLE_VALUE)
+	std::string header;
+	if (resolution_dependent)
+		header += "//!resolution " + std::to_string(_width) + ' ' + std::to_string(_height) + '\n';
+	for (const std::filesystem::path &included_file : included_files)
+		header += "//!include " + file_stat(included_file) + ' ' + included_file.u8string() + '\n';
+
+	// Overwrite any existing file, since the name does not change when one of the included files does
+	return platform::write_file(path, { header, source });
+}
+bool reshade::runtime::save_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const reshadefx::hash128 &hash, const std::vector<char> &cso, const std::string &dasm)
+{
+	if (_no_effect_cache)
 		return false;
-	DWORD size = static_cast<DWORD>(source.size());
-	const BOOL result = WriteFile(file, source.data(), size, &size, nullptr);
-	CloseHandle(file);
-	return result != FALSE;
+
+	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
+	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + entry_point + '-' + std::to_string(_renderer_id) + '-' + hash.to_string() + ".cso");
+
+	// This is called from 'compile_effect' on a worker thread, so let another worker thread write the files, so that this one can move on to the next shader
+	_task_pool.push([path = std::move(path), cso, dasm]() mutable {
+		if (!write_cache_file(path, cso.data(), cso.size()))
+			return;
+
+		path.replace_extension(L".asm");
+
+		write_cache_file(path, dasm.data(), dasm.size());
+	});
+
+	return true;
 }
-bool reshade::runtime::save_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const size_t hash, const std::vector<char> &cso, const std::string &dasm) const
+bool reshade::runtime::save_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, const reshadefx::module &module, const std::string &errors, bool resolution_dependent)
 {
 	if (_no_effect_cache)
 		return false;
 
 	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
-	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + entry_point + '-' + std::to_string(_renderer_id) + '-' + std::to_string(hash) + ".cso");
+	path /= std::filesystem::u8path("reshade-" + source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + hash.to_string() + ".module");
 
-	{	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-		if (file == INVALID_HANDLE_VALUE)
-			return false;
-		DWORD size = static_cast<DWORD>(cso.size());
-		const BOOL result = WriteFile(file, cso.data(), size, &size, nullptr);
-		CloseHandle(file);
-		if (result == FALSE)
-			return false;
-	}
+	std::string data;
+	if (resolution_dependent)
+		data += "//!resolution " + std::to_string(_width) + ' ' + std::to_string(_height) + '\n';
 
-	path.replace_extension(L".asm");
+	const uint32_t errors_size = static_cast<uint32_t>(errors.size());
+	data.append(reinterpret_cast<const char *>(&errors_size), sizeof(errors_size));
+	data += errors;
+	reshadefx::serialize_module(module, data);
 
-	{	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-		if (file == INVALID_HANDLE_VALUE)
-			return false;
-		DWORD size = static_cast<DWORD>(dasm.size());
-		const BOOL result = WriteFile(file, dasm.c_str(), size, &size, NULL);
-		CloseHandle(file);
-		if (result == FALSE)
-			return false;
-	}
+	// Let another worker thread write the file, so that this one can move on to the next effect
+	_task_pool.push([path = std::move(path), data = std::move(data)]() {
+		write_cache_file(path, data.data(), data.size());
+	});
 
 	return true;
 }
 
 void reshade::runtime::clear_effect_cache()
 {
+	// Wait for any cache files that are still being written
+	_task_pool.wait();
+
 	// Find all cached effect files and delete them
 	std::error_code ec;
 	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(g_reshade_base_path / _intermediate_cache_path, std::filesystem::directory_options::skip_permission_denied, ec))
@@ -959,11 +1299,14 @@ void reshade::runtime::clear_effect_cache()
 
 		const std::filesystem::path filename = entry.path().filename();
 		const std::filesystem::path extension = entry.path().extension();
-		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".cso" && extension != L".asm"))
+		if (filename.u8string().compare(0, 8, "reshade-") != 0 || (extension != L".i" && extension != L".module" && extension != L".cso" && extension != L".asm" && extension != L".tmp"))
 			continue;
 
-		DeleteFileW(entry.path().c_str());
+		std::filesystem::remove(entry.path(), ec);
 	}
+
+	// Delete precompiled header snapshots too
+	std::filesystem::remove_all(g_reshade_base_path / _intermediate_cache_path / L"reshade-pch", ec);
 }
 
 void reshade::runtime::update_and_render_effects()
@@ -972,13 +1315,51 @@ void reshade::runtime::update_and_render_effects()
 	if (_framecount == 0 && !_no_reload_on_init)
 		reload_effects();
 
+	// Add effects that finished loading on the worker threads since the last frame
+	if (is_loading())
+	{
+		std::vector<std::pair<size_t, effect>> loaded_effects;
+		{	const std::lock_guard<std::mutex> lock(_reload_mutex);
+			loaded_effects.swap(_reload_loaded_effects);
+		}
+
+		for (auto &[effect_index, loaded_effect] : loaded_effects)
+			add_effect(effect_index, std::move(loaded_effect));
+	}
+
+	// Add effects again that were initialized with a texture which was created anew since (see 'add_effect'), so that their device objects are recreated with it
+	while (!_reload_reinit_effects.empty())
+	{
+		const size_t effect_index = _reload_reinit_effects.back();
+		_reload_reinit_effects.pop_back();
+
+		effect reinit_effect = _effects[effect_index];
+		reinit_effect.assembly.clear();
+		// Techniques are enabled again when the effect is added, which counts them again
+		reinit_effect.rendering = 0;
+		unload_effect(effect_index);
+
+		// This is not one of the effects the current reload is waiting for, so do not count it as such in 'add_effect'
+		if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
+			_reload_remaining_effects++;
+
+		add_effect(effect_index, std::move(reinit_effect));
+	}
+
+	// Take the next effect that finished compiling its shaders on a worker thread from the completion queue
+	const auto pop_compiled_effect = [this](compiled_effect &compiled) {
+		const std::lock_guard<std::mutex> lock(_reload_mutex);
+		if (_reload_compiled_effects.empty())
+			return false;
+		compiled = std::move(_reload_compiled_effects.front());
+		_reload_compiled_effects.erase(_reload_compiled_effects.begin());
+		return true;
+	};
+
 	if (_reload_remaining_effects == 0)
 	{
-		// Clear the thread list now that they all have finished
-		for (std::thread &thread : _worker_threads)
-			if (thread.joinable())
-				thread.join(); // Threads have exited, but still need to join them prior to destruction
-		_worker_threads.clear();
+		const auto include_cache_stats = reshadefx::preprocessor::include_cache_stats();
+		LOG(INFO) << "Finished loading effects (" << include_cache_stats.misses << " include files read from disk, " << include_cache_stats.hits << " reused from cache).";
 
 		// Finished loading effects, so apply preset to figure out which ones need compiling
 		load_current_preset();
@@ -1006,17 +1387,18 @@ void reshade::runtime::update_and_render_effects()
 		}
 #endif
 	}
-	else if (_reload_remaining_effects != std::numeric_limits<size_t>::max())
-	{
-		return; // Cannot render while effects are still being loaded
-	}
-	else if (!_reload_compile_queue.empty())
+	else if (compiled_effect compiled; !_reload_compile_queue.empty() && pop_compiled_effect(compiled))
 	{
-		// Pop an effect from the queue
-		const size_t effect_index = _reload_compile_queue.back();
-		_reload_compile_queue.pop_back();
+		// Initialize only one effect per frame, so that creating device objects for many effects that finished compiling together does not stall a single frame
+		// This does not wait for all effects to finish loading either, so that the ones that did can start rendering
+		const size_t effect_index = compiled.effect_index;
+		_reload_compile_queue.erase(std::remove(_reload_compile_queue.begin(), _reload_compile_queue.end(), effect_index), _reload_compile_queue.end());
 		effect &effect = _effects[effect_index];
 
+		effect.errors += compiled.errors;
+		for (auto &[entry_point_name, assembly] : compiled.assembly)
+			effect.assembly[entry_point_name] = std::move(assembly);
+
 		// Create textures now, since they are referenced when building samplers in the 'init_effect' call below
 		for (texture &tex : _textures)
 		{
@@ -1025,6 +1407,9 @@ void reshade::runtime::update_and_render_effects()
 				tex.effect_index != effect_index && tex.shared.size() <= 1))
 				continue;
 
+			// Image data has to be uploaded again for a texture that is created anew
+			tex.loaded = false;
+
 			if (!init_texture(tex))
 			{
 				effect.errors += "Failed to create texture " + tex.unique_name;
@@ -1033,9 +1418,9 @@ void reshade::runtime::update_and_render_effects()
 			}
 		}
 
-		// Compile the effect with the back-end implementation (unless texture creation failed)
+		// Create the device objects for the effect with the back-end implementation (unless compiling its shaders or texture creation failed)
 		if (effect.compiled)
-			effect.compiled = init_effect(effect_index);
+			effect.compiled = compiled.success && init_effect(effect_index, compiled);
 
 		// De-duplicate error lines (D3DCompiler sometimes repeats the same error multiple times)
 		for (size_t line_offset = 0, next_line_offset;
@@ -1103,7 +1488,7 @@ void reshade::runtime::update_and_render_effects()
 	}
 	else if (!_textures_loaded)
 	{
-		// Now that all effects were compiled, load all textures
+		// Now that all queued effects were initialized, load the image files for their textures
 		load_textures();
 	}
 
@@ -1128,7 +1513,8 @@ void reshade::runtime::update_and_render_effects()
 
 		for (uniform &variable : effect.uniforms)
 		{
-			if (!_ignore_shortcuts && _input->is_key_pressed(variable.toggle_key_data, _force_shortcut_modifiers))
+			// Ignore shortcuts while effects are still loading, since saving the preset would drop the techniques of effects that were not added yet
+			if (!_ignore_shortcuts && !is_loading() && _input->is_key_pressed(variable.toggle_key_data, _force_shortcut_modifiers))
 			{
 				assert(variable.supports_toggle_key());
 
@@ -1187,7 +1573,7 @@ void reshade::runtime::update_and_render_effects()
 					const float max = variable.annotation_as_float("max", 0, 1.0f);
 					const float step_min = variable.annotation_as_float("step", 0);
 					const float step_max = variable.annotation_as_float("step", 1);
-					float increment = step_max == 0 ? step_min : (step_min + std::fmodf(static_cast<float>(std::rand()), step_max - step_min + 1));
+					float increment = step_max == 0 ? step_min : (step_min + std::fmod(static_cast<float>(std::rand()), step_max - step_min + 1));
 					const float smoothing = variable.annotation_as_float("smoothing");
 
 					float value[2] = { 0, 0 };
@@ -1214,7 +1600,7 @@ void reshade::runtime::update_and_render_effects()
 				case special_uniform::date:
 				{
 					const std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-					tm tm; localtime_s(&tm, &t);
+					const tm tm = platform::local_time(t);
 
 					const int value[4] = {
 						tm.tm_year + 1900,
@@ -1328,6 +1714,16 @@ void reshade::runtime::update_and_render_effects()
 					set_uniform_value(variable, _has_depth_texture);
 					break;
 				}
+				case special_uniform::buffer_width:
+				{
+					set_uniform_value(variable, static_cast<int32_t>(_width));
+					break;
+				}
+				case special_uniform::buffer_height:
+				{
+					set_uniform_value(variable, static_cast<int32_t>(_height));
+					break;
+				}
 			}
 		}
 	}
@@ -1378,8 +1774,25 @@ void reshade::runtime::enable_technique(technique &technique)
 	// Queue effect file for compilation if it was not fully loaded yet
 	if (technique.impl == nullptr && // Avoid adding the same effect multiple times to the queue if it contains multiple techniques that were enabled simultaneously
 		std::find(_reload_compile_queue.begin(), _reload_compile_queue.end(), technique.effect_index) == _reload_compile_queue.end())
+	{
 		_reload_compile_queue.push_back(technique.effect_index);
 
+		// Compile its shaders on a worker thread right away (ahead of any effects still loading, since rendering waits for this), 'update_and_render_effects' then initializes it once that finished
+		begin_effect_task(technique.effect_index);
+
+		_task_pool.push([this, effect_index = technique.effect_index]() {
+			compiled_effect compiled;
+			compiled.effect_index = effect_index;
+			compiled.success = compile_effect(effect_index, compiled);
+
+			{	const std::lock_guard<std::mutex> lock(_reload_mutex);
+				_reload_compiled_effects.push_back(std::move(compiled));
+			}
+
+			end_effect_task(effect_index);
+		}, true);
+	}
+
 	if (status_changed) // Increase rendering reference count
 		_effects[technique.effect_index].rendering++;
 }
@@ -1397,6 +1810,29 @@ void reshade::runtime::disable_technique(technique &technique)
 		_effects[technique.effect_index].rendering--;
 }
 
+void reshade::runtime::begin_effect_task(size_t effect_index)
+{
+	const std::lock_guard<std::mutex> lock(_reload_tasks_mutex);
+	_reload_tasks_in_flight[effect_index]++;
+}
+void reshade::runtime::end_effect_task(size_t effect_index)
+{
+	{	const std::lock_guard<std::mutex> lock(_reload_tasks_mutex);
+		if (--_reload_tasks_in_flight[effect_index] != 0)
+			return;
+		_reload_tasks_in_flight.erase(effect_index);
+	}
+
+	_reload_tasks_condition.notify_all();
+}
+void reshade::runtime::wait_for_effect_tasks(size_t effect_index)
+{
+	assert(!_task_pool.is_worker_thread()); // Waiting from a task would deadlock
+
+	std::unique_lock<std::mutex> lock(_reload_tasks_mutex);
+	_reload_tasks_condition.wait(lock, [this, effect_index]() { return _reload_tasks_in_flight.find(effect_index) == _reload_tasks_in_flight.end(); });
+}
+
 void reshade::runtime::subscribe_to_load_config(std::function<void(const ini_file &)> function)
 {
 	_load_config_callables.push_back(function);
@@ -1429,6 +1865,7 @@ void reshade::runtime::load_config()
 	config.get("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config.get("GENERAL", "PerformanceMode", _performance_mode);
 	config.get("GENERAL", "PreprocessorDefinitions", _global_preprocessor_definitions);
+	config.get("GENERAL", "ResolutionIndependentEffects", _resolution_independent_effects);
 	config.get("GENERAL", "SkipLoadingDisabledEffects", _effect_load_skipping);
 	config.get("GENERAL", "TextureSearchPaths", _texture_search_paths);
 	config.get("GENERAL", "IntermediateCachePath", _intermediate_cache_path);
@@ -1439,9 +1876,8 @@ void reshade::runtime::load_config()
 	// Fall back to temp directory if cache path does not exist
 	if (_intermediate_cache_path.empty() || !resolve_path(_intermediate_cache_path))
 	{
-		WCHAR temp_path[MAX_PATH] = L"";
-		GetTempPathW(MAX_PATH, temp_path);
-		_intermediate_cache_path = temp_path;
+		std::error_code ec;
+		_intermediate_cache_path = std::filesystem::temp_directory_path(ec);
 	}
 
 	// Use default if the preset file does not exist yet
@@ -1485,6 +1921,7 @@ void reshade::runtime::save_config() const
 	config.set("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config.set("GENERAL", "PerformanceMode", _performance_mode);
 	config.set("GENERAL", "PreprocessorDefinitions", _global_preprocessor_definitions);
+	config.set("GENERAL", "ResolutionIndependentEffects", _resolution_independent_effects);
 	config.set("GENERAL", "SkipLoadingDisabledEffects", _effect_load_skipping);
 	config.set("GENERAL", "TextureSearchPaths", _texture_search_paths);
 	config.set("GENERAL", "IntermediateCachePath", _intermediate_cache_path);
@@ -1511,7 +1948,7 @@ void reshade::runtime::save_config() const
 		callback(config);
 }
 
-void reshade::runtime::load_current_preset()
+void reshade::runtime::load_current_preset(size_t effect_index)
 {
 	_preset_save_success = true;
 
@@ -1526,7 +1963,7 @@ void reshade::runtime::load_current_preset()
 	preset.get({}, "PreprocessorDefinitions", preset_preprocessor_definitions);
 
 	// Recompile effects if preprocessor definitions have changed or running in performance mode (in which case all preset values are compile-time constants)
-	if (_reload_remaining_effects != 0) // ... unless this is the 'load_current_preset' call in 'update_and_render_effects'
+	if (!is_loading()) // ... unless this is called from 'update_and_render_effects' during or right after effect loading
 	{
 		if (_performance_mode || preset_preprocessor_definitions != _preset_preprocessor_definitions)
 		{
@@ -1574,8 +2011,14 @@ void reshade::runtime::load_current_preset()
 	if (_is_in_between_presets_transition && transition_ms_left <= 0)
 		_is_in_between_presets_transition = false;
 
-	for (effect &effect : _effects)
+	// Only touch the specified effect if there is one, since the others may not have been added yet
+	const auto first_effect = effect_index < _effects.size() ? _effects.begin() + effect_index : _effects.begin();
+	const auto last_effect = effect_index < _effects.size() ? first_effect + 1 : _effects.end();
+
+	for (auto effect_it = first_effect; effect_it != last_effect; ++effect_it)
 	{
+		effect &effect = *effect_it;
+
 		for (uniform &variable : effect.uniforms)
 		{
 			if (variable.special != special_uniform::none)
@@ -1627,6 +2070,9 @@ void reshade::runtime::load_current_preset()
 
 	for (technique &technique : _techniques)
 	{
+		if (effect_index < _effects.size() && technique.effect_index != effect_index)
+			continue;
+
 		const std::string unique_name =
 			technique.name + '@' + _effects[technique.effect_index].source_file.filename().u8string();
 
@@ -1755,9 +2201,10 @@ bool reshade::runtime::switch_to_next_preset(std::filesystem::path filter_path,
 			continue;
 		}
 
-		const std::wstring preset_name = preset_path.stem();
+		const std::wstring preset_name = preset_path.stem().wstring();
+		const std::wstring filter_name = filter_text.wstring();
 		// Only add those files that are matching the filter text
-		if (filter_text.empty() || std::search(preset_name.begin(), preset_name.end(), filter_text.native().begin(), filter_text.native().end(),
+		if (filter_text.empty() || std::search(preset_name.begin(), preset_name.end(), filter_name.begin(), filter_name.end(),
 			[](wchar_t c1, wchar_t c2) { return towlower(c1) == towlower(c2); }) != preset_name.end())
 			preset_paths.push_back(std::move(preset_path));
 	}
@@ -1789,15 +2236,15 @@ void reshade::runtime::save_screenshot(const std::wstring &postfix, const bool s
 {
 	char timestamp[21];
 	const std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-	tm tm; localtime_s(&tm, &t);
-	sprintf_s(timestamp, " %.4d-%.2d-%.2d %.2d-%.2d-%.2d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+	const tm tm = platform::local_time(t);
+	snprintf(timestamp, sizeof(timestamp), " %.4d-%.2d-%.2d %.2d-%.2d-%.2d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
 
-	std::wstring filename = g_target_executable_path.stem().concat(timestamp);
+	std::wstring filename = g_target_executable_path.stem().concat(timestamp).wstring();
 	if (_screenshot_naming == 1)
 		filename += L' ' + _current_preset_path.stem().wstring();
 
 	filename += postfix;
-	if (_doubletex)
+	if (doubletex())
 		filename += _screenshot_format == 0 ? L".bmp" : _screenshot_format == 1 ? L".pns" : L".jps";
 	else
 		filename += _screenshot_format == 0 ? L".bmp" : _screenshot_format == 1 ? L".png" : L".jpg";
@@ -1810,7 +2257,7 @@ void reshade::runtime::save_screenshot(const std::wstring &postfix, const bool s
 
 	// If the V__DoubleTex texture exists, we are running in stereo mode, and want to make
 	// a 2x width stereo screenshot instead.
-	auto tex_width = _doubletex ? _width * 2: _width;
+	auto tex_width = doubletex() ? _width * 2: _width;
 
 	if (std::vector<uint8_t> data(tex_width * _height * 4); capture_screenshot(data.data()))
 	{
@@ -1821,27 +2268,26 @@ void reshade::runtime::save_screenshot(const std::wstring &postfix, const bool s
 				for (uint32_t w = 0; w < tex_width; ++w)
 					data[(h * tex_width + w) * 4 + 3] = 0xFF;
 
-		if (FILE *file; _wfopen_s(&file, screenshot_path.c_str(), L"wb") == 0)
-		{
-			const auto write_callback = [](void *context, void *data, int size) {
-				fwrite(data, 1, size, static_cast<FILE *>(context));
-			};
-
-			switch (_screenshot_format)
-			{
-			case 0:
-				_screenshot_save_success = stbi_write_bmp_to_func(write_callback, file, tex_width, _height, 4, data.data()) != 0;
-				break;
-			case 1:
-				_screenshot_save_success = stbi_write_png_to_func(write_callback, file, tex_width, _height, 4, data.data(), 0) != 0;
-				break;
-			case 2:
-				_screenshot_save_success = stbi_write_jpg_to_func(write_callback, file, tex_width, _height, 4, data.data(), _screenshot_jpeg_quality) != 0;
-				break;
-			}
+		// Encode the image into memory first and then write it to the file in one go
+		std::string file_data;
+		const auto write_callback = [](void *context, void *data, int size) {
+			static_cast<std::string *>(context)->append(static_cast<const char *>(data), size);
+		};
 
-			fclose(file);
+		switch (_screenshot_format)
+		{
+		case 0:
+			_screenshot_save_success = stbi_write_bmp_to_func(write_callback, &file_data, tex_width, _height, 4, data.data()) != 0;
+			break;
+		case 1:
+			_screenshot_save_success = stbi_write_png_to_func(write_callback, &file_data, tex_width, _height, 4, data.data(), 0) != 0;
+			break;
+		case 2:
+			_screenshot_save_success = stbi_write_jpg_to_func(write_callback, &file_data, tex_width, _height, 4, data.data(), _screenshot_jpeg_quality) != 0;
+			break;
 		}
+
+		_screenshot_save_success = _screenshot_save_success && platform::write_file(screenshot_path, { file_data });
 	}
 
 	_last_screenshot_file = screenshot_path;
@@ -2091,3 +2537,22 @@ reshade::texture &reshade::runtime::look_up_texture_by_name(const std::string &u
 	assert(it != _textures.end());
 	return *it;
 }
+bool reshade::runtime::look_up_texture_info_by_name(const std::string &unique_name, reshadefx::texture_info &info)
+{
+	// Effects add their textures on worker threads while loading, so this has to be synchronized with 'add_effect'
+	const std::lock_guard<std::mutex> lock(_reload_mutex);
+
+	// Textures may not have been created yet at this point, so do not require an implementation like 'look_up_texture_by_name' does
+	const auto it = std::find_if(_textures.begin(), _textures.end(),
+		[&unique_name](const auto &item) { return item.unique_name == unique_name; });
+	if (it == _textures.end())
+		return false;
+
+	info = *it;
+	return true;
+}
+
+const reshade::texture *reshade::runtime::doubletex() const
+{
+	return _doubletex_index < _textures.size() ? &_textures[_doubletex_index] : nullptr;
+}
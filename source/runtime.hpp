@@ -9,8 +9,12 @@
 #include <memory>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <filesystem>
+#include <unordered_map>
+#include "task_pool.hpp"
+#include "effect_hash.hpp"
 
 #if RESHADE_GUI
 #include "imgui_editor.hpp"
@@ -21,10 +25,17 @@ struct ImGuiContext;
 
 extern volatile long g_network_traffic;
 
+namespace reshadefx
+{
+	struct module; // Forward declarations to avoid excessive #include
+	struct texture_info;
+}
+
 namespace reshade
 {
 	class ini_file; // Forward declarations to avoid excessive #include
 	struct effect;
+	struct compiled_effect;
 	struct uniform;
 	struct texture;
 	struct technique;
@@ -161,14 +172,30 @@ namespace reshade
 		/// <param name="effect_index">The ID of the effect.</param>
 		bool load_effect(const std::filesystem::path &source_file, const reshade::ini_file &preset, size_t effect_index, bool preprocess_required = false);
 		/// <summary>
+		/// Store a loaded effect in the effect list and add its textures and techniques, so that it can be rendered.
+		/// Effects loaded on a worker thread are queued and added in 'update_and_render_effects' instead, since this modifies state the render thread uses.
+		/// </summary>
+		/// <param name="effect_index">The ID of the effect.</param>
+		/// <param name="loaded_effect">The effect data filled in by 'load_effect'.</param>
+		bool add_effect(size_t effect_index, effect &&loaded_effect);
+		/// <summary>
 		/// Load all effects found in the effect search paths.
 		/// </summary>
 		void load_effects();
 		/// <summary>
+		/// Compile the shaders of the effect to the format the back-end creates them from (e.g. DX byte code).
+		/// This runs on a worker thread, so it may only read the effect and only create device objects that the graphics API allows creating from any thread (e.g. pipeline states), which it then passes on in 'compiled.impl'. Back-ends that can only compile shaders on the render thread do so in 'init_effect' instead.
+		/// </summary>
+		/// <param name="effect_index">The ID of the effect.</param>
+		/// <param name="compiled">The compiled shaders, along with any warnings and errors.</param>
+		virtual bool compile_effect(size_t effect_index, compiled_effect &compiled);
+		/// <summary>
 		/// Initialize resources for the effect and load the effect module.
+		/// This runs on the render thread once 'compile_effect' finished, so should avoid any expensive work that can be done there instead.
 		/// </summary>
 		/// <param name="effect_index">The ID of the effect.</param>
-		virtual bool init_effect(size_t effect_index) = 0;
+		/// <param name="compiled">The result of the 'compile_effect' call for this effect.</param>
+		virtual bool init_effect(size_t effect_index, const compiled_effect &compiled) = 0;
 		/// <summary>
 		/// Unload the specified effect.
 		/// </summary>
@@ -192,13 +219,16 @@ namespace reshade
 		/// <summary>
 		/// Load compiled effect data from the disk cache.
 		/// </summary>
-		bool load_effect_cache(const std::filesystem::path &source_file, const size_t hash, std::string &source) const;
-		bool load_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const size_t hash, std::vector<char> &cso, std::string &dasm) const;
+		bool load_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, std::string &source, std::vector<std::filesystem::path> &included_files) const;
+		bool load_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const reshadefx::hash128 &hash, std::vector<char> &cso, std::string &dasm) const;
+		bool load_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, reshadefx::module &module, std::string &errors) const;
 		/// <summary>
 		/// Save compiled effect data to the disk cache.
+		/// Compiled shaders and modules are written on a worker thread, so these return as soon as the write was queued.
 		/// </summary>
-		bool save_effect_cache(const std::filesystem::path &source_file, const size_t hash, const std::string &source) const;
-		bool save_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const size_t hash, const std::vector<char> &cso, const std::string &dasm) const;
+		bool save_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, const std::string &source, const std::vector<std::filesystem::path> &included_files, bool resolution_dependent) const;
+		bool save_effect_cache(const std::filesystem::path &source_file, const std::string &entry_point, const reshadefx::hash128 &hash, const std::vector<char> &cso, const std::string &dasm);
+		bool save_effect_cache(const std::filesystem::path &source_file, const reshadefx::hash128 &hash, const reshadefx::module &module, const std::string &errors, bool resolution_dependent);
 		/// <summary>
 		/// Remove all compiled effect data from disk.
 		/// </summary>
@@ -231,6 +261,22 @@ namespace reshade
 		/// </summary>
 		/// <param name="unique_name">The name of the texture to find.</param>
 		texture &look_up_texture_by_name(const std::string &unique_name);
+		/// <summary>
+		/// Copies the description of the texture corresponding to the passed <paramref name="unique_name"/>, which unlike <see cref="look_up_texture_by_name"/> is safe to do on a worker thread (e.g. in 'compile_effect').
+		/// </summary>
+		/// <param name="unique_name">The name of the texture to find.</param>
+		/// <param name="info">The description of the texture.</param>
+		bool look_up_texture_info_by_name(const std::string &unique_name, reshadefx::texture_info &info);
+
+		/// <summary>
+		/// Checks whether runtime is currently loading effects.
+		/// </summary>
+		bool is_loading() const { return _reload_remaining_effects != std::numeric_limits<size_t>::max(); }
+
+		/// <summary>
+		/// Returns the stereo "V__DoubleTex" texture if it was created, or <c>nullptr</c> otherwise.
+		/// </summary>
+		const texture *doubletex() const;
 
 		bool _is_initialized = false;
 		bool _performance_mode = false;
@@ -252,7 +298,8 @@ namespace reshade
 		std::vector<texture> _textures;
 		std::vector<technique> _techniques;
 
-		texture *_doubletex = nullptr;
+		// Keep an index instead of a pointer to the stereo texture, since more textures may be added while effects are still loading after it was created
+		size_t _doubletex_index = std::numeric_limits<size_t>::max();
 
 	private:
 		/// <summary>
@@ -263,9 +310,14 @@ namespace reshade
 		static bool check_for_update(unsigned long latest_version[3]);
 
 		/// <summary>
-		/// Checks whether runtime is currently loading effects.
+		/// Track a task that loads or compiles the specified effect on a worker thread, so that <see cref="unload_effect"/> can wait for it.
 		/// </summary>
-		bool is_loading() const { return _reload_remaining_effects != std::numeric_limits<size_t>::max(); }
+		void begin_effect_task(size_t effect_index);
+		void end_effect_task(size_t effect_index);
+		/// <summary>
+		/// Block until all tasks loading or compiling the specified effect have finished, without waiting for any other work on the worker threads.
+		/// </summary>
+		void wait_for_effect_tasks(size_t effect_index);
 
 		/// <summary>
 		/// Enable a technique so it is rendered.
@@ -286,7 +338,8 @@ namespace reshade
 		/// <summary>
 		/// Load the selected preset and apply it.
 		/// </summary>
-		void load_current_preset();
+		/// <param name="effect_index">The ID of the effect to apply the preset to, or an invalid ID to apply it to all effects.</param>
+		void load_current_preset(size_t effect_index = std::numeric_limits<size_t>::max());
 		/// <summary>
 		/// Save the current value configuration to the currently selected preset.
 		/// </summary>
@@ -327,6 +380,7 @@ namespace reshade
 		bool _no_effect_cache = false;
 		bool _no_reload_on_init = false;
 		bool _effect_load_skipping = false;
+		bool _resolution_independent_effects = false;
 		bool _load_option_disable_skipping = false;
 		std::atomic<int> _last_reload_successfull = true;
 		bool _last_texture_reload_successfull = true;
@@ -334,12 +388,19 @@ namespace reshade
 		unsigned int _reload_key_data[4];
 		unsigned int _performance_mode_key_data[4];
 		std::vector<size_t> _reload_compile_queue;
+		std::vector<size_t> _reload_reinit_effects; // Effects that have to be added again, because a texture they use was created anew (see 'add_effect')
+		std::vector<std::pair<size_t, effect>> _reload_loaded_effects; // Effects that finished loading on a worker thread, but were not added yet (protected by '_reload_mutex')
+		std::vector<compiled_effect> _reload_compiled_effects; // Effects from the compile queue that finished compiling on a worker thread, but were not initialized yet (protected by '_reload_mutex')
 		std::atomic<size_t> _reload_remaining_effects = 0;
 		std::mutex _reload_mutex;
-		std::vector<std::thread> _worker_threads;
+		std::unordered_map<size_t, unsigned int> _reload_tasks_in_flight; // Number of tasks on the worker threads that load or compile each effect (protected by '_reload_tasks_mutex')
+		std::mutex _reload_tasks_mutex; // Separate from '_reload_mutex', since tasks are queued while that is held (see 'add_effect')
+		std::condition_variable _reload_tasks_condition;
+		std::unordered_map<std::string, std::chrono::high_resolution_clock::duration> _effect_load_durations; // Time it took to load each effect file the last time, used to start the most expensive ones first
 		std::vector<std::string> _global_preprocessor_definitions;
 		std::vector<std::string> _preset_preprocessor_definitions;
 		std::vector<std::filesystem::path> _effect_search_paths;
+		reshadefx::hash128 _effect_files_hash; // Hash of the names of all effect and header files found in the effect search paths during the last reload
 		std::vector<std::filesystem::path> _texture_search_paths;
 		std::filesystem::path _intermediate_cache_path;
 		std::chrono::high_resolution_clock::time_point _last_reload_time;
@@ -454,5 +515,9 @@ namespace reshade
 		std::vector<editor_instance> _editors;
 		uint32_t _editor_palette[gui::code_editor::color_palette_max];
 #endif
+
+		// === Worker Threads ===
+		// Declared last, so that it is destroyed first and any tasks still queued can finish while the state they access is alive
+		task_pool _task_pool;
 	};
 }
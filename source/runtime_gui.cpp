@@ -1348,6 +1348,14 @@ void reshade::runtime::draw_gui_settings()
 			reload_effects();
 		}
 
+		if (ImGui::Checkbox("Compile effects independent of resolution", &_resolution_independent_effects))
+		{
+			modified = true;
+			reload_effects();
+		}
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("Reads BUFFER_WIDTH and BUFFER_HEIGHT (and constants initialized from them) from uniform variables wherever they do not have to be constant.\nPreprocessor conditions, texture and array sizes, case labels and initial values of non-constant variables still use the current resolution.\nThis lets effects reuse their compiled shaders from the effect cache after the window is resized.");
+
 		if (ImGui::Button("Clear effect cache", ImVec2(ImGui::CalcItemWidth(), 0)))
 			clear_effect_cache();
 	}
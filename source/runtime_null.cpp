@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "dll_log.hpp"
+#include "runtime_null.hpp"
+#include "runtime_objects.hpp"
+
+namespace reshade::null
+{
+	struct tex_data
+	{
+		std::vector<uint8_t> pixels;
+	};
+
+	struct pass_data
+	{
+		uint32_t num_render_targets = 0;
+	};
+
+	struct effect_data
+	{
+		std::vector<uint8_t> cb;
+	};
+
+	struct technique_data
+	{
+		std::vector<pass_data> passes;
+	};
+}
+
+reshade::null::runtime_null::runtime_null()
+{
+	// Pretend to be a D3D11 device, so that effects are compiled to the same HLSL code as with that back-end
+	_renderer_id = 0xb000;
+}
+reshade::null::runtime_null::~runtime_null()
+{
+	on_reset();
+}
+
+bool reshade::null::runtime_null::on_init(void *window, unsigned int width, unsigned int height)
+{
+	_width = _window_width = width;
+	_height = _window_height = height;
+
+	_backbuffer.assign(static_cast<size_t>(_width) * _height * 4, 0);
+
+	return runtime::on_init(window);
+}
+void reshade::null::runtime_null::on_reset()
+{
+	runtime::on_reset();
+
+	_backbuffer.clear();
+	_recorded_passes.clear();
+}
+
+void reshade::null::runtime_null::on_present()
+{
+	if (!_is_initialized)
+		return;
+
+	_recorded_passes.clear();
+
+	const auto time_present_started = std::chrono::high_resolution_clock::now();
+
+	// Measure the time from the frame that started loading effects until the frame they were all added, while rendering continued in between
+	// Effects are loaded during the first frame or may have been reloaded since the last one, and loading can finish within that same frame already when all of them are in the cache
+	if (!_was_loading && (is_loading() || _framecount == 0))
+		_last_load_start_time = time_present_started,
+		_was_loading = true;
+
+	update_and_render_effects();
+
+	if (is_loading() && !_was_loading)
+		_last_load_start_time = time_present_started;
+	else if (!is_loading() && _was_loading && !_effects.empty())
+		_stats.load_effects.append(std::chrono::high_resolution_clock::now() - _last_load_start_time);
+	_was_loading = is_loading();
+
+	runtime::on_present();
+
+	_stats.present.append(std::chrono::high_resolution_clock::now() - time_present_started);
+}
+
+bool reshade::null::runtime_null::capture_screenshot(uint8_t *buffer) const
+{
+	std::memcpy(buffer, _backbuffer.data(), _backbuffer.size());
+
+	return true;
+}
+
+bool reshade::null::runtime_null::compile_effect(size_t index, compiled_effect &compiled)
+{
+	const auto time_compile_started = std::chrono::high_resolution_clock::now();
+
+	const effect &effect = _effects[index];
+
+	// There is no shader compiler to invoke, so use the generated code of each entry point as its "byte code"
+	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
+	{
+		const std::string &hlsl = entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl;
+
+		std::vector<char> &cso = compiled.entry_points[entry_point.name];
+		cso.assign(effect.preamble.begin(), effect.preamble.end());
+		cso.insert(cso.end(), hlsl.begin(), hlsl.end());
+	}
+
+	// This runs on the worker threads, so other compilations may be updating the statistics at the same time
+	const std::lock_guard<std::mutex> lock(_compile_stats_mutex);
+	_stats.compile_effect.append(std::chrono::high_resolution_clock::now() - time_compile_started);
+
+	return true;
+}
+bool reshade::null::runtime_null::init_effect(size_t index, const compiled_effect &compiled)
+{
+	const auto time_init_started = std::chrono::high_resolution_clock::now();
+
+	effect &effect = _effects[index];
+
+	if (index >= _effect_data.size())
+		_effect_data.resize(index + 1);
+	_effect_data[index].cb.resize(effect.uniform_data_storage.size());
+
+	for (technique &technique : _techniques)
+	{
+		if (technique.impl != nullptr || technique.effect_index != index)
+			continue;
+
+		auto impl = new technique_data();
+		technique.impl = impl;
+
+		impl->passes.resize(technique.passes.size());
+		for (size_t pass_index = 0; pass_index < technique.passes.size(); ++pass_index)
+		{
+			pass_data &pass_data = impl->passes[pass_index];
+			reshadefx::pass_info &pass_info = technique.passes[pass_index];
+
+			for (const std::string *entry_point_name : { &pass_info.vs_entry_point, &pass_info.ps_entry_point, &pass_info.cs_entry_point })
+			{
+				if (!entry_point_name->empty() && compiled.entry_points.find(*entry_point_name) == compiled.entry_points.end())
+				{
+					LOG(ERROR) << "Failed to find entry point '" << *entry_point_name << "' for pass " << pass_index << " in technique '" << technique.name << "'!";
+					return false;
+				}
+			}
+
+			// Render targets that are not specified write to the back buffer
+			pass_data.num_render_targets = 1;
+			while (pass_data.num_render_targets < 8 && !pass_info.render_target_names[pass_data.num_render_targets].empty())
+				pass_data.num_render_targets++;
+
+			// Passes writing to the back buffer cover all of it, same as in the other back-ends
+			if (pass_info.cs_entry_point.empty() && pass_info.render_target_names[0].empty())
+			{
+				pass_info.viewport_width = _width;
+				pass_info.viewport_height = _height;
+			}
+		}
+	}
+
+	_stats.init_effect.append(std::chrono::high_resolution_clock::now() - time_init_started);
+
+	return true;
+}
+void reshade::null::runtime_null::unload_effect(size_t index)
+{
+	for (technique &tech : _techniques)
+	{
+		if (tech.effect_index != index)
+			continue;
+
+		delete static_cast<technique_data *>(tech.impl);
+		tech.impl = nullptr;
+	}
+
+	runtime::unload_effect(index);
+
+	if (index < _effect_data.size())
+		_effect_data[index].cb.clear();
+}
+void reshade::null::runtime_null::unload_effects()
+{
+	for (technique &tech : _techniques)
+	{
+		delete static_cast<technique_data *>(tech.impl);
+		tech.impl = nullptr;
+	}
+
+	runtime::unload_effects();
+
+	_effect_data.clear();
+}
+
+bool reshade::null::runtime_null::init_texture(texture &texture)
+{
+	auto impl = new tex_data();
+	texture.impl = impl;
+
+	// Special textures reference the back buffer and depth buffer, which do not need any memory of their own
+	if (!texture.semantic.empty())
+		return true;
+
+	const auto time_init_started = std::chrono::high_resolution_clock::now();
+
+	size_t bpp;
+	switch (texture.format)
+	{
+	default:
+		bpp = 4;
+		break;
+	case reshadefx::texture_format::r8:
+		bpp = 1;
+		break;
+	case reshadefx::texture_format::r16f:
+	case reshadefx::texture_format::rg8:
+		bpp = 2;
+		break;
+	case reshadefx::texture_format::rg32f:
+	case reshadefx::texture_format::rgba16:
+	case reshadefx::texture_format::rgba16f:
+		bpp = 8;
+		break;
+	case reshadefx::texture_format::rgba32f:
+		bpp = 16;
+		break;
+	}
+
+	size_t size = 0;
+	for (uint32_t level = 0, width = texture.width, height = texture.height; level < texture.levels; ++level, width = std::max(width / 2, 1u), height = std::max(height / 2, 1u))
+		size += static_cast<size_t>(width) * height * bpp;
+
+	// Clear texture to zero, same as the other back-ends do
+	impl->pixels.assign(size, 0);
+	_stats.texture_memory += size;
+
+	_stats.init_texture.append(std::chrono::high_resolution_clock::now() - time_init_started);
+
+	return true;
+}
+void reshade::null::runtime_null::upload_texture(const texture &texture, const uint8_t *pixels)
+{
+	auto impl = static_cast<tex_data *>(texture.impl);
+	assert(impl != nullptr && texture.semantic.empty() && pixels != nullptr);
+
+	const auto time_upload_started = std::chrono::high_resolution_clock::now();
+
+	const size_t num_pixels = static_cast<size_t>(texture.width) * texture.height;
+
+	switch (texture.format)
+	{
+	case reshadefx::texture_format::r8:
+		for (size_t i = 0; i < num_pixels; ++i)
+			impl->pixels[i] = pixels[i * 4];
+		break;
+	case reshadefx::texture_format::rg8:
+		for (size_t i = 0; i < num_pixels; ++i)
+			impl->pixels[i * 2 + 0] = pixels[i * 4 + 0],
+			impl->pixels[i * 2 + 1] = pixels[i * 4 + 1];
+		break;
+	case reshadefx::texture_format::rgba8:
+		std::memcpy(impl->pixels.data(), pixels, num_pixels * 4);
+		break;
+	default:
+		LOG(ERROR) << "Texture upload is not supported for format " << static_cast<unsigned int>(texture.format) << " of texture '" << texture.unique_name << "'!";
+		return;
+	}
+
+	// Mipmaps are not generated, since nothing ever samples them
+
+	_stats.upload_texture.append(std::chrono::high_resolution_clock::now() - time_upload_started);
+}
+void reshade::null::runtime_null::destroy_texture(texture &texture)
+{
+	if (const auto impl = static_cast<tex_data *>(texture.impl); impl != nullptr)
+		_stats.texture_memory -= impl->pixels.size();
+
+	delete static_cast<tex_data *>(texture.impl);
+	texture.impl = nullptr;
+}
+
+void reshade::null::runtime_null::render_technique(technique &technique)
+{
+	const auto impl = static_cast<technique_data *>(technique.impl);
+	effect_data &effect_data = _effect_data[technique.effect_index];
+
+	const auto time_render_started = std::chrono::high_resolution_clock::now();
+
+	// Update shader constants, which is the only data the other back-ends copy every time a technique is rendered
+	std::memcpy(effect_data.cb.data(), _effects[technique.effect_index].uniform_data_storage.data(), effect_data.cb.size());
+
+	const uint64_t timestamp_beg = _gpu_timestamp;
+
+	for (size_t pass_index = 0; pass_index < technique.passes.size(); ++pass_index)
+	{
+		const pass_data &pass_data = impl->passes[pass_index];
+		const reshadefx::pass_info &pass_info = technique.passes[pass_index];
+
+		recorded_pass &pass = _recorded_passes.emplace_back();
+		pass.technique_name = technique.name;
+		pass.pass_index = pass_index;
+		pass.dispatch = !pass_info.cs_entry_point.empty();
+		pass.num_vertices = pass_info.num_vertices;
+		pass.viewport_width = pass_info.viewport_width;
+		pass.viewport_height = pass_info.viewport_height;
+
+		// Simulate the time the GPU would take, assuming a fill rate of 10 gigapixels per second (compute passes are counted with one pixel per thread group)
+		uint64_t num_pixels = static_cast<uint64_t>(pass_info.viewport_width) * pass_info.viewport_height;
+		if (pass.dispatch)
+			num_pixels *= pass_info.viewport_dispatch_z;
+		else
+			num_pixels *= pass_data.num_render_targets;
+		pass.gpu_duration = num_pixels / 10;
+
+		_gpu_timestamp += pass.gpu_duration;
+	}
+
+	// There is no latency in reading these timestamps back, unlike with real queries
+	technique.average_gpu_duration.append(_gpu_timestamp - timestamp_beg);
+
+	_stats.num_passes += technique.passes.size();
+	_stats.render_technique.append(std::chrono::high_resolution_clock::now() - time_render_started);
+}
+
+#if RESHADE_GUI
+void reshade::null::runtime_null::render_imgui_draw_data(ImDrawData *)
+{
+	// Nothing to draw, but the UI was still built this frame, so its cost is part of the measured present duration
+}
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include "runtime.hpp"
+
+namespace reshade::null
+{
+	/// <summary>
+	/// Runtime implementation without a graphics device, which keeps all textures in system memory and only records the passes it would render.
+	/// This makes it possible to profile effect loading, preset switching and the technique loop independent of any graphics API.
+	/// </summary>
+	class runtime_null : public runtime
+	{
+	public:
+		struct stage_statistics
+		{
+			void append(std::chrono::high_resolution_clock::duration duration)
+			{
+				count++;
+				total += duration;
+				if (duration > max)
+					max = duration;
+			}
+
+			size_t count = 0;
+			std::chrono::high_resolution_clock::duration total = {};
+			std::chrono::high_resolution_clock::duration max = {};
+		};
+
+		struct statistics
+		{
+			stage_statistics load_effects;
+			stage_statistics compile_effect;
+			stage_statistics init_effect;
+			stage_statistics init_texture;
+			stage_statistics upload_texture;
+			stage_statistics render_technique;
+			stage_statistics present;
+			size_t num_passes = 0;
+			size_t texture_memory = 0;
+		};
+
+		struct recorded_pass
+		{
+			std::string_view technique_name;
+			size_t pass_index;
+			bool dispatch;
+			uint32_t num_vertices;
+			uint32_t viewport_width;
+			uint32_t viewport_height;
+			uint64_t gpu_duration; // Simulated time in nanoseconds, based on the number of pixels written
+		};
+
+		runtime_null();
+		~runtime_null();
+
+		bool on_init(void *window, unsigned int width, unsigned int height);
+		void on_reset();
+		void on_present();
+
+		bool capture_screenshot(uint8_t *buffer) const override;
+
+		/// <summary>
+		/// Return the time spent in each stage since the runtime was created.
+		/// </summary>
+		const statistics &stats() const { return _stats; }
+		/// <summary>
+		/// Return the passes that were rendered in the last frame, in submission order.
+		/// </summary>
+		const std::vector<recorded_pass> &recorded_passes() const { return _recorded_passes; }
+
+	private:
+		bool compile_effect(size_t index, compiled_effect &compiled) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
+		void unload_effect(size_t index) override;
+		void unload_effects() override;
+
+		bool init_texture(texture &texture) override;
+		void upload_texture(const texture &texture, const uint8_t *pixels) override;
+		void destroy_texture(texture &texture) override;
+
+		void render_technique(technique &technique) override;
+
+#if RESHADE_GUI
+		void render_imgui_draw_data(ImDrawData *draw_data) override;
+#endif
+
+		statistics _stats;
+		std::mutex _compile_stats_mutex;
+		std::vector<uint8_t> _backbuffer;
+		std::vector<struct effect_data> _effect_data;
+		std::vector<recorded_pass> _recorded_passes;
+		uint64_t _gpu_timestamp = 0;
+		bool _was_loading = false;
+		std::chrono::high_resolution_clock::time_point _last_load_start_time;
+	};
+}
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "effect_hash.hpp"
 #include "effect_module.hpp"
 
 namespace reshade
@@ -28,6 +29,8 @@ namespace reshade
 		overlay_active,
 		overlay_hovered,
 		bufready_depth,
+		buffer_width,
+		buffer_height,
 	};
 
 	template <typename T, size_t SAMPLES>
@@ -184,7 +187,7 @@ namespace reshade
 		std::string errors;
 		std::string preamble;
 		reshadefx::module module;
-		size_t source_hash = 0;
+		reshadefx::hash128 source_hash;
 		std::filesystem::path source_file;
 		std::vector<std::filesystem::path> included_files;
 		std::vector<std::pair<std::string, std::string>> definitions;
@@ -192,4 +195,14 @@ namespace reshade
 		std::vector<uniform> uniforms;
 		std::vector<unsigned char> uniform_data_storage;
 	};
+
+	struct compiled_effect final
+	{
+		size_t effect_index = std::numeric_limits<size_t>::max();
+		bool success = false;
+		std::string errors;
+		std::unordered_map<std::string, std::string> assembly;
+		std::unordered_map<std::string, std::vector<char>> entry_points; // Compiled code of each entry point in the format the back-end creates its shaders from (e.g. DX byte code)
+		std::shared_ptr<void> impl; // Device objects the back-end created ahead of time (e.g. pipeline states), which 'init_effect' takes over (the rest is released along with this)
+	};
 }
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "runtime_platform.hpp"
+
+#ifdef _WIN32
+	#include <Windows.h>
+#else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+#endif
+
+template <typename T>
+static bool read_file_impl(const std::filesystem::path &path, T &data)
+{
+#ifdef _WIN32
+	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD size = GetFileSize(file, nullptr);
+	data.resize(size);
+	const BOOL result = ReadFile(file, data.data(), size, &size, nullptr);
+	CloseHandle(file);
+	return result != FALSE;
+#else
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat st = {};
+	if (fstat(file, &st) != 0)
+	{
+		close(file);
+		return false;
+	}
+	data.resize(static_cast<size_t>(st.st_size));
+	size_t offset = 0;
+	while (offset < data.size())
+	{
+		const ssize_t result = read(file, data.data() + offset, data.size() - offset);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			break;
+		offset += static_cast<size_t>(result);
+	}
+	close(file);
+	return offset == data.size();
+#endif
+}
+
+bool reshade::platform::read_file(const std::filesystem::path &path, std::string &data)
+{
+	return read_file_impl(path, data);
+}
+bool reshade::platform::read_file(const std::filesystem::path &path, std::vector<char> &data)
+{
+	return read_file_impl(path, data);
+}
+
+bool reshade::platform::write_file(const std::filesystem::path &path, std::initializer_list<std::string_view> data)
+{
+#ifdef _WIN32
+	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	BOOL result = TRUE;
+	for (const std::string_view &chunk : data)
+	{
+		DWORD size = static_cast<DWORD>(chunk.size());
+		result = result && WriteFile(file, chunk.data(), size, &size, nullptr);
+	}
+	CloseHandle(file);
+	return result != FALSE;
+#else
+	const int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		return false;
+	bool result = true;
+	for (const std::string_view &chunk : data)
+	{
+		for (size_t offset = 0; result && offset < chunk.size();)
+		{
+			const ssize_t written = write(file, chunk.data() + offset, chunk.size() - offset);
+			if (written < 0 && errno == EINTR)
+				continue;
+			result = written > 0;
+			offset += result ? static_cast<size_t>(written) : 0;
+		}
+	}
+	close(file);
+	return result;
+#endif
+}
+
+bool reshade::platform::move_file_no_replace(const std::filesystem::path &old_path, const std::filesystem::path &new_path)
+{
+#ifdef _WIN32
+	return MoveFileExW(old_path.c_str(), new_path.c_str(), 0) != FALSE;
+#else
+	// 'rename' always replaces the destination, whereas 'link' fails if it exists already
+	if (link(old_path.c_str(), new_path.c_str()) != 0)
+		return false;
+	unlink(old_path.c_str());
+	return true;
+#endif
+}
+
+unsigned long reshade::platform::current_thread_id()
+{
+#ifdef _WIN32
+	return GetCurrentThreadId();
+#else
+	return static_cast<unsigned long>(gettid());
+#endif
+}
+
+std::tm reshade::platform::local_time(std::time_t time)
+{
+	std::tm tm = {};
+#ifdef _WIN32
+	localtime_s(&tm, &time);
+#else
+	localtime_r(&time, &tm);
+#endif
+	return tm;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <ctime>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+
+namespace reshade::platform
+{
+	/// <summary>
+	/// Reads the entire contents of a file into memory.
+	/// </summary>
+	/// <param name="path">The path to the file to read.</param>
+	/// <param name="data">The buffer that receives the file contents.</param>
+	/// <returns><c>true</c> if the file was read successfully, <c>false</c> otherwise.</returns>
+	bool read_file(const std::filesystem::path &path, std::string &data);
+	bool read_file(const std::filesystem::path &path, std::vector<char> &data);
+
+	/// <summary>
+	/// Writes the specified data to a file, replacing any existing file with the same name.
+	/// </summary>
+	/// <param name="path">The path to the file to write.</param>
+	/// <param name="data">The chunks of data to write one after another.</param>
+	/// <returns><c>true</c> if all data was written successfully, <c>false</c> otherwise.</returns>
+	bool write_file(const std::filesystem::path &path, std::initializer_list<std::string_view> data);
+
+	/// <summary>
+	/// Moves a file to a new location, but only if there is no file at that location already.
+	/// </summary>
+	/// <param name="old_path">The path to the file to move.</param>
+	/// <param name="new_path">The path to move the file to.</param>
+	/// <returns><c>true</c> if the file was moved, <c>false</c> if it failed or the new location was already taken.</returns>
+	bool move_file_no_replace(const std::filesystem::path &old_path, const std::filesystem::path &new_path);
+
+	/// <summary>
+	/// Gets the identifier of the calling thread.
+	/// </summary>
+	unsigned long current_thread_id();
+
+	/// <summary>
+	/// Converts a point in time to the calendar time in the local time zone.
+	/// </summary>
+	std::tm local_time(std::time_t time);
+}
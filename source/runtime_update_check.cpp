@@ -5,6 +5,10 @@
 
 #include "version.h"
 #include "runtime.hpp"
+#include <cstring>
+
+#ifdef _WIN32
+
 #include <Windows.h>
 #include <WinInet.h>
 
@@ -63,3 +67,14 @@ bool reshade::runtime::check_for_update(unsigned long latest_version[3])
 
 	return false;
 }
+
+#else
+
+bool reshade::runtime::check_for_update(unsigned long latest_version[3])
+{
+	std::memset(latest_version, 0, 3 * sizeof(unsigned long));
+
+	return false; // Updates are only published for Windows
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "task_pool.hpp"
+#include <cassert>
+#include <algorithm>
+
+static thread_local const reshade::task_pool *s_current_pool = nullptr;
+
+reshade::task_pool::task_pool(size_t num_threads)
+{
+	if (num_threads == 0)
+		num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 2u) - 1;
+
+	// Set up all queues before starting any worker, since they access each others queues
+	_queues.reset(new worker_queue[num_threads]);
+	_num_queues = num_threads;
+
+	_threads.reserve(num_threads);
+	for (size_t i = 0; i < num_threads; ++i)
+		_threads.emplace_back(&task_pool::worker_main, this, i);
+}
+reshade::task_pool::~task_pool()
+{
+	// Finish all queued tasks before shutting down, since they may reference state that the owner expects to be updated
+	wait();
+
+	{	const std::lock_guard<std::mutex> lock(_wake_mutex);
+		_exit = true;
+	}
+
+	_wake_condition.notify_all();
+
+	for (std::thread &thread : _threads)
+		thread.join();
+}
+
+void reshade::task_pool::push(std::function<void()> task, bool urgent)
+{
+	_num_pending++;
+
+	{	worker_queue &queue = urgent ? _urgent_queue : _queues[_next_queue++ % _num_queues];
+
+		const std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+		_num_queued++;
+	}
+
+	notify_workers();
+}
+void reshade::task_pool::push(std::vector<std::function<void()>> tasks)
+{
+	if (tasks.empty())
+		return;
+
+	_num_pending += tasks.size();
+
+	// Deal out tasks in turn, so that every worker starts with the most expensive one of its share
+	const size_t first_queue = _next_queue.fetch_add(tasks.size());
+	for (size_t i = 0; i < _num_queues && i < tasks.size(); ++i)
+	{
+		worker_queue &queue = _queues[(first_queue + i) % _num_queues];
+
+		const std::lock_guard<std::mutex> lock(queue.mutex);
+		for (size_t k = i; k < tasks.size(); k += _num_queues)
+		{
+			queue.tasks.push_back(std::move(tasks[k]));
+			_num_queued++;
+		}
+	}
+
+	notify_workers();
+}
+void reshade::task_pool::notify_workers()
+{
+	// Workers check for queued tasks with '_wake_mutex' held, so acquiring it here ensures that none of them is between that check and starting to wait, which would miss the notification
+	{	const std::lock_guard<std::mutex> lock(_wake_mutex);
+	}
+
+	_wake_condition.notify_all();
+}
+
+void reshade::task_pool::wait()
+{
+	assert(!is_worker_thread()); // Waiting from a task would deadlock
+
+	std::unique_lock<std::mutex> lock(_wake_mutex);
+	_idle_condition.wait(lock, [this]() { return _num_pending == 0; });
+}
+
+void reshade::task_pool::parallel_for(size_t count, const std::function<void(size_t)> &func)
+{
+	// Shared with the helper tasks, which may only start after all indices were already handled (when the workers are busy with other tasks)
+	struct shared_state
+	{
+		std::atomic<size_t> next_index = 0;
+		std::atomic<size_t> num_completed = 0;
+		std::mutex mutex;
+		std::condition_variable completed_condition;
+		const std::function<void(size_t)> *func = nullptr;
+	};
+
+	const auto state = std::make_shared<shared_state>();
+	state->func = &func;
+
+	const auto process_indices = [count](shared_state &s) {
+		for (size_t index; (index = s.next_index++) < count;)
+		{
+			(*s.func)(index);
+
+			if (++s.num_completed == count)
+			{
+				const std::lock_guard<std::mutex> lock(s.mutex);
+				s.completed_condition.notify_all();
+			}
+		}
+	};
+
+	std::vector<std::function<void()>> tasks;
+	for (size_t i = 1; i < count && i <= _num_queues; ++i)
+		tasks.push_back([state, process_indices]() { process_indices(*state); });
+	push(std::move(tasks));
+
+	// The calling thread helps out, so this still makes progress while all workers are busy
+	process_indices(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->completed_condition.wait(lock, [&state, count]() { return state->num_completed == count; });
+}
+
+bool reshade::task_pool::is_worker_thread() const
+{
+	return s_current_pool == this;
+}
+
+bool reshade::task_pool::pop(size_t worker_index, std::function<void()> &task)
+{
+	// Take urgent tasks first, since the thread that queued them is waiting for them
+	{	const std::lock_guard<std::mutex> lock(_urgent_queue.mutex);
+		if (!_urgent_queue.tasks.empty())
+		{
+			task = std::move(_urgent_queue.tasks.front());
+			_urgent_queue.tasks.pop_front();
+			_num_queued--;
+			return true;
+		}
+	}
+
+	// Then take from the own queue and only then steal from the others
+	for (size_t i = 0; i < _num_queues; ++i)
+	{
+		worker_queue &queue = _queues[(worker_index + i) % _num_queues];
+
+		const std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		_num_queued--;
+		return true;
+	}
+
+	return false;
+}
+
+void reshade::task_pool::worker_main(size_t worker_index)
+{
+	s_current_pool = this;
+
+	std::function<void()> task;
+	while (true)
+	{
+		if (pop(worker_index, task))
+		{
+			task();
+			task = nullptr; // Release any captured state before signaling completion
+
+			if (--_num_pending == 0)
+			{
+				const std::lock_guard<std::mutex> lock(_wake_mutex);
+				_idle_condition.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_wake_mutex);
+		_wake_condition.wait(lock, [this]() { return _exit || _num_queued != 0; });
+		if (_exit)
+			break;
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace reshade
+{
+	/// <summary>
+	/// A fixed set of worker threads that execute queued tasks.
+	/// Every worker has its own queue and takes tasks from the queues of the others once it runs out, so that a few expensive tasks do not leave the remaining workers idle.
+	/// </summary>
+	class task_pool
+	{
+	public:
+		/// <summary>
+		/// Start the worker threads.
+		/// </summary>
+		/// <param name="num_threads">The number of worker threads, or zero to use one less than the number of hardware threads (so that the thread using the pool is not starved).</param>
+		explicit task_pool(size_t num_threads = 0);
+		task_pool(const task_pool &) = delete;
+		~task_pool();
+
+		task_pool &operator=(const task_pool &) = delete;
+
+		/// <summary>
+		/// Queue a task for execution on one of the worker threads.
+		/// </summary>
+		/// <param name="task">The function to call.</param>
+		/// <param name="urgent">Set to <c>true</c> to put the task into a queue shared by all workers, which they take tasks from before any others (e.g. because the render thread is waiting for it). Workers finish the task they are currently executing first.</param>
+		void push(std::function<void()> task, bool urgent = false);
+		/// <summary>
+		/// Queue a batch of tasks for execution on the worker threads.
+		/// The tasks are dealt out to the workers in turn and each worker executes them in the order given, so the most expensive ones should come first.
+		/// </summary>
+		/// <param name="tasks">The functions to call.</param>
+		void push(std::vector<std::function<void()>> tasks);
+
+		/// <summary>
+		/// Block until all queued tasks have finished executing.
+		/// </summary>
+		void wait();
+
+		/// <summary>
+		/// Call a function once for every index in the specified range, spread across the worker threads and the calling thread, and block until all calls have finished.
+		/// </summary>
+		/// <param name="count">The number of indices.</param>
+		/// <param name="func">The function to call with each index.</param>
+		void parallel_for(size_t count, const std::function<void(size_t)> &func);
+
+		/// <summary>
+		/// Return whether the calling thread is one of the worker threads of this pool.
+		/// </summary>
+		bool is_worker_thread() const;
+
+	private:
+		struct worker_queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		bool pop(size_t worker_index, std::function<void()> &task);
+		void notify_workers();
+		void worker_main(size_t worker_index);
+
+		std::vector<std::thread> _threads;
+		std::unique_ptr<worker_queue[]> _queues;
+		size_t _num_queues = 0;
+		worker_queue _urgent_queue;
+		std::atomic<size_t> _next_queue = 0;
+		// Number of tasks that are waiting in the queues, changed with the lock of the queue held, so that it is increased before a worker can take the task out again
+		std::atomic<size_t> _num_queued = 0;
+		// Number of tasks that were pushed, but have not finished executing yet
+		std::atomic<size_t> _num_pending = 0;
+		std::mutex _wake_mutex;
+		std::condition_variable _wake_condition;
+		std::condition_variable _idle_condition;
+		bool _exit = false;
+	};
+}
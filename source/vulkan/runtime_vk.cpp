@@ -11,6 +11,7 @@
 #include "format_utils.hpp"
 #include <imgui.h>
 #include <imgui_internal.h>
+#include <utility> // std::exchange
 
 #define check_result(call) \
 	if ((call) != VK_SUCCESS) \
@@ -61,6 +62,79 @@ namespace reshade::vulkan
 		std::vector<pass_data> passes;
 	};
 
+	struct compiled_pass_data
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkRenderPass render_pass = VK_NULL_HANDLE; // Not set for passes that render to the back buffer, which use the default render pass
+		bool stencil_attachment = false;
+	};
+
+	struct compiled_effect_data
+	{
+		compiled_effect_data(const VkLayerDispatchTable &vk, VkDevice device) : vk(vk), device(device) {}
+		~compiled_effect_data()
+		{
+			// Destroy everything 'init_effect' did not take over (because it failed or the effect was unloaded before)
+			for (const auto &[name, passes] : techniques)
+			{
+				for (const compiled_pass_data &pass_data : passes)
+				{
+					vk.DestroyRenderPass(device, pass_data.render_pass, nullptr);
+					vk.DestroyPipeline(device, pass_data.pipeline, nullptr);
+				}
+			}
+
+			vk.DestroyPipelineLayout(device, pipeline_layout, nullptr);
+			vk.DestroyDescriptorSetLayout(device, sampler_layout, nullptr);
+			vk.DestroyDescriptorSetLayout(device, storage_layout, nullptr);
+
+			// The shader modules are no longer needed once the pipelines were created
+			for (const VkShaderModule module : shader_modules)
+				vk.DestroyShaderModule(device, module, nullptr);
+		}
+
+		const VkLayerDispatchTable &vk;
+		const VkDevice device;
+		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout sampler_layout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout storage_layout = VK_NULL_HANDLE;
+		std::vector<VkShaderModule> shader_modules;
+		std::unordered_map<std::string, std::vector<compiled_pass_data>> techniques; // Pipeline of each pass, by technique name
+	};
+
+	static VkFormat convert_format(reshadefx::texture_format format, bool srgb = false)
+	{
+		switch (format)
+		{
+		case reshadefx::texture_format::r8:
+			return VK_FORMAT_R8_UNORM;
+		case reshadefx::texture_format::r16f:
+			return VK_FORMAT_R16_SFLOAT;
+		case reshadefx::texture_format::r32f:
+			return VK_FORMAT_R32_SFLOAT;
+		case reshadefx::texture_format::rg8:
+			return VK_FORMAT_R8G8_UNORM;
+		case reshadefx::texture_format::rg16:
+			return VK_FORMAT_R16G16_UNORM;
+		case reshadefx::texture_format::rg16f:
+			return VK_FORMAT_R16G16_SFLOAT;
+		case reshadefx::texture_format::rg32f:
+			return VK_FORMAT_R32G32_SFLOAT;
+		case reshadefx::texture_format::rgba8:
+			return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		case reshadefx::texture_format::rgba16:
+			return VK_FORMAT_R16G16B16A16_UNORM;
+		case reshadefx::texture_format::rgba16f:
+			return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case reshadefx::texture_format::rgba32f:
+			return VK_FORMAT_R32G32B32A32_SFLOAT;
+		case reshadefx::texture_format::rgb10a2:
+			return VK_FORMAT_A2R10G10B10_UNORM_PACK32;
+		default:
+			return VK_FORMAT_UNDEFINED;
+		}
+	}
+
 	const uint32_t MAX_IMAGE_DESCRIPTOR_SETS = 128; // TODO: Check if these limits are enough
 	const uint32_t MAX_EFFECT_DESCRIPTOR_SETS = 50 * 2 * 4; // 50 resources, 4 passes
 
@@ -753,134 +827,107 @@ bool reshade::vulkan::runtime_vk::capture_screenshot(uint8_t *buffer) const
 	return mapped_data != nullptr;
 }
 
-bool reshade::vulkan::runtime_vk::init_effect(size_t index)
+bool reshade::vulkan::runtime_vk::compile_effect(size_t index, compiled_effect &compiled)
 {
-	effect &effect = _effects[index];
+	const effect &effect = _effects[index];
+
+	// Vulkan allows creating device objects from any thread, so create the pipelines here already, which is where the driver compiles the SPIR-V code to GPU code
+	const auto impl = std::make_shared<compiled_effect_data>(vk, _device);
+	compiled.impl = impl;
 
 	// Load shader modules
-	struct shader_modules
-	{
-		bool loaded = false;
-		runtime_vk *const runtime;
-		std::vector<VkShaderModule> list;
-		std::unordered_map<std::string, VkShaderModule> entry_points;
+	std::unordered_map<std::string, VkShaderModule> entry_points;
 
-		shader_modules(runtime_vk *runtime, const reshadefx::module &effect_module) : runtime(runtime)
+	// There are various issues with SPIR-V modules that have multiple entry points on all major GPU vendors.
+	// On AMD for instance creating a graphics pipeline just fails with a generic VK_ERROR_OUT_OF_HOST_MEMORY. On NVIDIA artifacts occur on some driver versions.
+	// To work around these problems, create a separate shader module for every entry point and rewrite the SPIR-V module for each to removes all but a single entry point (and associated functions/variables).
+	for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
+	{
+		// The code generator already writes a module per entry point when eliminating dead code, so only need to rewrite when that is not available
+		std::vector<uint32_t> spirv = entry_point.spirv;
+		if (spirv.empty())
 		{
-			VkResult res = VK_SUCCESS;
+			uint32_t current_function = 0, current_function_offset = 0;
+			spirv = effect.module.spirv;
+			std::vector<uint32_t> functions_to_remove, variables_to_remove;
 
-			// There are various issues with SPIR-V modules that have multiple entry points on all major GPU vendors.
-			// On AMD for instance creating a graphics pipeline just fails with a generic VK_ERROR_OUT_OF_HOST_MEMORY. On NVIDIA artifacts occur on some driver versions.
-			// To work around these problems, create a separate shader module for every entry point and rewrite the SPIR-V module for each to removes all but a single entry point (and associated functions/variables).
-			for (size_t i = 0; i < effect_module.entry_points.size() && res == VK_SUCCESS; ++i)
+			for (uint32_t inst = 5 /* Skip SPIR-V header information */; inst < spirv.size();)
 			{
-				const reshadefx::entry_point &entry_point = effect_module.entry_points[i];
+				const uint32_t op = spirv[inst] & 0xFFFF;
+				const uint32_t len = (spirv[inst] >> 16) & 0xFFFF;
+				assert(len != 0);
 
-				uint32_t current_function = 0, current_function_offset = 0;
-				std::vector<uint32_t> spirv = effect_module.spirv;
-				std::vector<uint32_t> functions_to_remove, variables_to_remove;
-
-				for (uint32_t inst = 5 /* Skip SPIR-V header information */; inst < spirv.size();)
+				switch (op)
 				{
-					const uint32_t op = spirv[inst] & 0xFFFF;
-					const uint32_t len = (spirv[inst] >> 16) & 0xFFFF;
-					assert(len != 0);
+				case 15: // OpEntryPoint
+					// Look for any non-matching entry points
+					if (entry_point.name != reinterpret_cast<const char *>(&spirv[inst + 3]))
+					{
+						functions_to_remove.push_back(spirv[inst + 2]);
 
-					switch (op)
+						// Get interface variables
+						for (size_t k = inst + 3 + ((strlen(reinterpret_cast<const char *>(&spirv[inst + 3])) + 4) / 4); k < inst + len; ++k)
+							variables_to_remove.push_back(spirv[k]);
+
+						// Remove this entry point from the module
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 16: // OpExecutionMode
+					if (std::find(functions_to_remove.begin(), functions_to_remove.end(), spirv[inst + 1]) != functions_to_remove.end())
 					{
-					case 15: // OpEntryPoint
-						// Look for any non-matching entry points
-						if (entry_point.name != reinterpret_cast<const char *>(&spirv[inst + 3]))
-						{
-							functions_to_remove.push_back(spirv[inst + 2]);
-
-							// Get interface variables
-							for (size_t k = inst + 3 + ((strlen(reinterpret_cast<const char *>(&spirv[inst + 3])) + 4) / 4); k < inst + len; ++k)
-								variables_to_remove.push_back(spirv[k]);
-
-							// Remove this entry point from the module
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 16: // OpExecutionMode
-						if (std::find(functions_to_remove.begin(), functions_to_remove.end(), spirv[inst + 1]) != functions_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 59: // OpVariable
-						// Remove all declarations of the interface variables for non-matching entry points
-						if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 2]) != variables_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 71: // OpDecorate
-						// Remove all decorations targeting any of the interface variables for non-matching entry points
-						if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 1]) != variables_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 54: // OpFunction
-						current_function = spirv[inst + 2];
-						current_function_offset = inst;
-						break;
-					case 56: // OpFunctionEnd
-						// Remove all function definitions for non-matching entry points
-						if (std::find(functions_to_remove.begin(), functions_to_remove.end(), current_function) != functions_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + current_function_offset, spirv.begin() + inst + len);
-							inst = current_function_offset;
-							continue;
-						}
-						break;
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
 					}
-
-					inst += len;
+					break;
+				case 59: // OpVariable
+					// Remove all declarations of the interface variables for non-matching entry points
+					if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 2]) != variables_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 71: // OpDecorate
+					// Remove all decorations targeting any of the interface variables for non-matching entry points
+					if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 1]) != variables_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 54: // OpFunction
+					current_function = spirv[inst + 2];
+					current_function_offset = inst;
+					break;
+				case 56: // OpFunctionEnd
+					// Remove all function definitions for non-matching entry points
+					if (std::find(functions_to_remove.begin(), functions_to_remove.end(), current_function) != functions_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + current_function_offset, spirv.begin() + inst + len);
+						inst = current_function_offset;
+						continue;
+					}
+					break;
 				}
 
-				VkShaderModuleCreateInfo create_info { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-				create_info.codeSize = spirv.size() * sizeof(uint32_t);
-				create_info.pCode = spirv.data();
-
-				res = runtime->vk.CreateShaderModule(runtime->_device, &create_info, nullptr, &list.emplace_back());
-
-				entry_points[entry_point.name] = list.back();
+				inst += len;
 			}
+		}
 
-			if (res != VK_SUCCESS)
-			{
-				LOG(ERROR) << "Failed to create shader module! Vulkan error code is " << res << '.';
-				return;
-			}
+		VkShaderModuleCreateInfo create_info { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+		create_info.codeSize = spirv.size() * sizeof(uint32_t);
+		create_info.pCode = spirv.data();
 
-			loaded = true;
-		}
-		~shader_modules()
+		const VkResult res = vk.CreateShaderModule(_device, &create_info, nullptr, &impl->shader_modules.emplace_back());
+		if (res != VK_SUCCESS)
 		{
-			for (const VkShaderModule module : list)
-				runtime->vk.DestroyShaderModule(runtime->_device, module, nullptr);
+			LOG(ERROR) << "Failed to create shader module! Vulkan error code is " << res << '.';
+			return false;
 		}
-	}
-	shader_modules(this, effect.module);
-	if (!shader_modules.loaded)
-		return false;
-
-	if (_effect_data.size() <= index)
-		_effect_data.resize(index + 1);
-	effect_data &effect_data = _effect_data[index];
-
-	// Create query pool for time measurements
-	{   VkQueryPoolCreateInfo create_info { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
-		create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
-		create_info.queryCount = static_cast<uint32_t>(effect.module.techniques.size() * 2 * NUM_COMMAND_FRAMES);
 
-		check_result(vk.CreateQueryPool(_device, &create_info, nullptr, &effect_data.query_pool)) false;
+		entry_points[entry_point.name] = impl->shader_modules.back();
 	}
 
 	// Initialize pipeline layout
@@ -893,7 +940,7 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 		create_info.bindingCount = uint32_t(bindings.size());
 		create_info.pBindings = bindings.data();
 
-		check_result(vk.CreateDescriptorSetLayout(_device, &create_info, nullptr, &effect_data.sampler_layout)) false;
+		check_result(vk.CreateDescriptorSetLayout(_device, &create_info, nullptr, &impl->sampler_layout)) false;
 	}
 
 	if (effect.module.num_storage_bindings != 0)
@@ -907,186 +954,16 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 		create_info.bindingCount = uint32_t(bindings.size());
 		create_info.pBindings = bindings.data();
 
-		check_result(vk.CreateDescriptorSetLayout(_device, &create_info, nullptr, &effect_data.storage_layout)) false;
+		check_result(vk.CreateDescriptorSetLayout(_device, &create_info, nullptr, &impl->storage_layout)) false;
 	}
 
-	const VkDescriptorSetLayout set_layouts[3] = { _effect_descriptor_layout, effect_data.sampler_layout, effect_data.storage_layout };
+	const VkDescriptorSetLayout set_layouts[3] = { _effect_descriptor_layout, impl->sampler_layout, impl->storage_layout };
 
 	{   VkPipelineLayoutCreateInfo create_info { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
 		create_info.setLayoutCount = effect.module.num_storage_bindings == 0 ? 2 : 3; // [0] = Global UBO, [1] = Samplers, [2] = Storage Images
 		create_info.pSetLayouts = set_layouts;
 
-		check_result(vk.CreatePipelineLayout(_device, &create_info, nullptr, &effect_data.pipeline_layout)) false;
-	}
-
-	// Create global uniform buffer object
-	if (!effect.uniform_data_storage.empty())
-	{
-		effect_data.ubo = create_buffer(
-			effect.uniform_data_storage.size(),
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
-			0, 0, &effect_data.ubo_mem);
-		if (effect_data.ubo == VK_NULL_HANDLE)
-			return false;
-	}
-
-	// Initialize image and sampler bindings
-	assert(effect.module.num_texture_bindings == 0); // Use combined image samplers
-	std::vector<VkDescriptorImageInfo> sampler_bindings(effect.module.num_sampler_bindings);
-	std::vector<VkDescriptorImageInfo> storage_bindings(effect.module.num_storage_bindings);
-
-	for (const reshadefx::sampler_info &info : effect.module.samplers)
-	{
-		const texture &texture = look_up_texture_by_name(info.texture_name);
-
-		VkDescriptorImageInfo &image_binding = sampler_bindings[info.binding];
-		image_binding.imageView = static_cast<tex_data *>(texture.impl)->view[info.srgb];
-		image_binding.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		if (texture.semantic == "COLOR")
-		{
-			image_binding.imageView = _backbuffer_image_view[info.srgb];
-		}
-		if (texture.semantic == "DEPTH")
-		{
-			// Set to a default view to avoid crash because of this being null
-			image_binding.imageView = _empty_depth_image_view;
-#if RESHADE_DEPTH
-			if (_depth_image_view != VK_NULL_HANDLE)
-				image_binding.imageView = _depth_image_view;
-			// Keep track of the depth buffer texture descriptor to simplify updating it
-			effect_data.depth_image_bindings.emplace(info.binding, std::vector<VkDescriptorSet>());
-#endif
-		}
-
-		// Unset bindings are not allowed, so fail initialization for the entire effect in that case
-		if (image_binding.imageView == VK_NULL_HANDLE)
-			return false;
-
-		VkSamplerCreateInfo create_info { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
-		create_info.addressModeU = static_cast<VkSamplerAddressMode>(static_cast<uint32_t>(info.address_u) - 1);
-		create_info.addressModeV = static_cast<VkSamplerAddressMode>(static_cast<uint32_t>(info.address_v) - 1);
-		create_info.addressModeW = static_cast<VkSamplerAddressMode>(static_cast<uint32_t>(info.address_w) - 1);
-		create_info.mipLodBias = info.lod_bias;
-		create_info.anisotropyEnable = VK_FALSE;
-		create_info.maxAnisotropy = 1.0f;
-		create_info.compareEnable = VK_FALSE;
-		create_info.compareOp = VK_COMPARE_OP_ALWAYS;
-		create_info.minLod = info.min_lod;
-		create_info.maxLod = info.max_lod;
-
-		switch (info.filter)
-		{
-		case reshadefx::texture_filter::min_mag_mip_point:
-			create_info.magFilter = VK_FILTER_NEAREST;
-			create_info.minFilter = VK_FILTER_NEAREST;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-			break;
-		case reshadefx::texture_filter::min_mag_point_mip_linear:
-			create_info.magFilter = VK_FILTER_NEAREST;
-			create_info.minFilter = VK_FILTER_NEAREST;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			break;
-		case reshadefx::texture_filter::min_point_mag_linear_mip_point:
-			create_info.magFilter = VK_FILTER_LINEAR;
-			create_info.minFilter = VK_FILTER_NEAREST;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-			break;
-		case reshadefx::texture_filter::min_point_mag_mip_linear:
-			create_info.magFilter = VK_FILTER_LINEAR;
-			create_info.minFilter = VK_FILTER_NEAREST;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			break;
-		case reshadefx::texture_filter::min_linear_mag_mip_point:
-			create_info.magFilter = VK_FILTER_NEAREST;
-			create_info.minFilter = VK_FILTER_LINEAR;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-			break;
-		case reshadefx::texture_filter::min_linear_mag_point_mip_linear:
-			create_info.magFilter = VK_FILTER_NEAREST;
-			create_info.minFilter = VK_FILTER_LINEAR;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			break;
-		case reshadefx::texture_filter::min_mag_linear_mip_point:
-			create_info.magFilter = VK_FILTER_LINEAR;
-			create_info.minFilter = VK_FILTER_LINEAR;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-			break;
-		case reshadefx::texture_filter::min_mag_mip_linear:
-			create_info.magFilter = VK_FILTER_LINEAR;
-			create_info.minFilter = VK_FILTER_LINEAR;
-			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			break;
-		}
-
-		// Generate hash for sampler description
-		size_t desc_hash = 2166136261;
-		for (size_t i = 0; i < sizeof(create_info); ++i)
-			desc_hash = (desc_hash * 16777619) ^ reinterpret_cast<const uint8_t *>(&create_info)[i];
-
-		std::unordered_map<size_t, VkSampler>::iterator it = _effect_sampler_states.find(desc_hash);
-		if (it == _effect_sampler_states.end())
-		{
-			VkSampler sampler = VK_NULL_HANDLE;
-			check_result(vk.CreateSampler(_device, &create_info, nullptr, &sampler)) false;
-			it = _effect_sampler_states.emplace(desc_hash, sampler).first;
-		}
-
-		image_binding.sampler = it->second;
-	}
-
-	for (const reshadefx::storage_info &info : effect.module.storages)
-	{
-		const texture &texture = look_up_texture_by_name(info.texture_name);
-
-		VkDescriptorImageInfo &image_binding = storage_bindings[info.binding];
-		image_binding.imageView = static_cast<tex_data *>(texture.impl)->view[0];
-		image_binding.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-		// Unset bindings are not allowed, so fail initialization for the entire effect in that case
-		if (image_binding.imageView == VK_NULL_HANDLE)
-			return false;
-	}
-
-	uint32_t num_passes = 0;
-	for (const reshadefx::technique_info &info : effect.module.techniques)
-		num_passes += static_cast<uint32_t>(info.passes.size());
-
-	std::vector<VkDescriptorSet> sets(1 + 2 * num_passes);
-	std::vector<VkWriteDescriptorSet> writes;
-	writes.reserve(sets.size());
-
-	{   VkDescriptorSetAllocateInfo alloc_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-		alloc_info.descriptorPool = _effect_descriptor_pool;
-		alloc_info.descriptorSetCount = 1 + (effect.module.num_storage_bindings == 0 ? 1 : 2) * num_passes;
-
-		std::vector<VkDescriptorSetLayout> alloc_set_layouts(sets.size());
-		alloc_set_layouts[0] = _effect_descriptor_layout;
-		for (size_t i = 0; i < num_passes; ++i)
-		{
-			alloc_set_layouts[1 + i] = effect_data.sampler_layout;
-			alloc_set_layouts[1 + num_passes + i] = effect_data.storage_layout;
-		}
-		alloc_info.pSetLayouts = alloc_set_layouts.data();
-
-		if (vk.AllocateDescriptorSets(_device, &alloc_info, sets.data()) != VK_SUCCESS)
-		{
-			LOG(ERROR) << "Too many effects loaded. Only " << (MAX_EFFECT_DESCRIPTOR_SETS / 2) << " effects can be active simultaneously in Vulkan.";
-			return false;
-		}
-	}
-
-	effect_data.ubo_set = sets[0];
-	const VkDescriptorBufferInfo ubo_info = { effect_data.ubo, 0, VK_WHOLE_SIZE };
-	if (effect_data.ubo != VK_NULL_HANDLE)
-	{
-		VkWriteDescriptorSet &write = writes.emplace_back();
-		write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
-		write.dstSet = effect_data.ubo_set;
-		write.dstBinding = 0;
-		write.descriptorCount = 1;
-		write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		write.pBufferInfo = &ubo_info;
+		check_result(vk.CreatePipelineLayout(_device, &create_info, nullptr, &impl->pipeline_layout)) false;
 	}
 
 	std::vector<uint8_t> spec_data;
@@ -1105,41 +982,30 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 		spec_data.size(), spec_data.data()
 	};
 
-	uint32_t technique_index = 0;
-	uint32_t total_pass_index = 0;
-	for (technique &technique : _techniques)
+	for (const reshadefx::technique_info &technique_info : effect.module.techniques)
 	{
-		if (technique.impl != nullptr || technique.effect_index != index)
-			continue;
-
-		auto impl = new technique_data();
-		technique.impl = impl;
-
-		// Offset index so that a query exists for each command frame and two subsequent ones are used for before/after stamps
-		impl->query_base_index = technique_index++ * 2 * NUM_COMMAND_FRAMES;
+		std::vector<compiled_pass_data> &passes = impl->techniques[technique_info.name];
+		passes.resize(technique_info.passes.size());
 
-		impl->passes.resize(technique.passes.size());
-		for (size_t pass_index = 0; pass_index < technique.passes.size(); ++pass_index, ++total_pass_index)
+		for (size_t pass_index = 0; pass_index < technique_info.passes.size(); ++pass_index)
 		{
-			pass_data &pass_data = impl->passes[pass_index];
-			const reshadefx::pass_info &pass_info = technique.passes[pass_index];
+			compiled_pass_data &pass_data = passes[pass_index];
+			const reshadefx::pass_info &pass_info = technique_info.passes[pass_index];
 
 			if (!pass_info.cs_entry_point.empty())
 			{
-				impl->has_compute_passes = true;
-
 				VkComputePipelineCreateInfo create_info { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
 				create_info.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
 				create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-				create_info.stage.module = shader_modules.entry_points.at(pass_info.cs_entry_point);;
+				create_info.stage.module = entry_points.at(pass_info.cs_entry_point);
 				create_info.stage.pName = pass_info.cs_entry_point.c_str();
 				create_info.stage.pSpecializationInfo = &spec_info;
-				create_info.layout = effect_data.pipeline_layout;
+				create_info.layout = impl->pipeline_layout;
 
 				const VkResult res = vk.CreateComputePipelines(_device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pass_data.pipeline);
 				if (res != VK_SUCCESS)
 				{
-					LOG(ERROR) << "Failed to create compute pipeline for pass " << pass_index << " in technique '" << technique.name << "'! Vulkan error code is " << res << '.';
+					LOG(ERROR) << "Failed to create compute pipeline for pass " << pass_index << " in technique '" << technique_info.name << "'! Vulkan error code is " << res << '.';
 					return false;
 				}
 			}
@@ -1212,10 +1078,7 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 					0.0f, 1.0f
 				};
 
-				pass_data.begin_info.renderArea = scissor_rect;
-
 				uint32_t num_color_attachments = 0;
-				VkImageView attachment_views[9] = {};
 				VkAttachmentReference attachment_refs[9] = {};
 				VkAttachmentDescription attachment_descs[9] = {};
 				VkPipelineColorBlendAttachmentState attachment_blends[8];
@@ -1230,12 +1093,14 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 
 				for (uint32_t k = 0; k < 8 && !pass_info.render_target_names[k].empty(); ++k, ++num_color_attachments)
 				{
-					tex_data *const tex_impl = static_cast<tex_data *>(
-						look_up_texture_by_name(pass_info.render_target_names[k]).impl);
-
-					pass_data.modified_resources.push_back(tex_impl);
+					// The render target textures may not have been created yet, so take their format from the description
+					reshadefx::texture_info texture_info;
+					if (!look_up_texture_info_by_name(pass_info.render_target_names[k], texture_info))
+					{
+						LOG(ERROR) << "Failed to find render target '" << pass_info.render_target_names[k] << "' for pass " << pass_index << " in technique '" << technique_info.name << "'!";
+						return false;
+					}
 
-					attachment_views[k] = tex_impl->view[2 + pass_info.srgb_write_enable];
 					attachment_blends[k] = attachment_blends[0];
 
 					VkAttachmentReference &attachment_ref = attachment_refs[k];
@@ -1243,7 +1108,7 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 					attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 					VkAttachmentDescription &attachment_desc = attachment_descs[k];
-					attachment_desc.format = tex_impl->formats[pass_info.srgb_write_enable];
+					attachment_desc.format = convert_format(texture_info.format, pass_info.srgb_write_enable);
 					attachment_desc.samples = VK_SAMPLE_COUNT_1_BIT;
 					attachment_desc.loadOp = pass_info.clear_render_targets ? VK_ATTACHMENT_LOAD_OP_CLEAR : pass_info.blend_enable ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 					attachment_desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -1253,17 +1118,10 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 					attachment_desc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				}
 
-				if (pass_info.clear_render_targets)
-				{
-					pass_data.begin_info.clearValueCount = num_color_attachments;
-					pass_data.begin_info.pClearValues = pass_data.clear_values; // These are initialized to zero already
-				}
-
+				VkRenderPass render_pass = _default_render_pass[pass_info.srgb_write_enable];
 				if (pass_info.render_target_names[0].empty())
 				{
 					num_color_attachments = 1;
-					pass_data.begin_info.renderPass = _default_render_pass[pass_info.srgb_write_enable];
-					pass_data.begin_info.framebuffer = VK_NULL_HANDLE; // Select the correct swap chain frame buffer during rendering
 				}
 				else
 				{
@@ -1274,10 +1132,9 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 						scissor_rect.extent.height == _height)
 					{
 						num_stencil_attachments = 1;
+						pass_data.stencil_attachment = true;
 						const uint32_t stencil_idx = num_color_attachments;
 
-						attachment_views[stencil_idx] = _effect_stencil_view;
-
 						VkAttachmentReference &attachment_ref = attachment_refs[stencil_idx];
 						attachment_ref.attachment = stencil_idx;
 						attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -1316,30 +1173,21 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 						create_info.dependencyCount = 1;
 						create_info.pDependencies = &subdep;
 
-						check_result(vk.CreateRenderPass(_device, &create_info, nullptr, &pass_data.begin_info.renderPass)) false;
+						check_result(vk.CreateRenderPass(_device, &create_info, nullptr, &pass_data.render_pass)) false;
 					}
 
-					{   VkFramebufferCreateInfo create_info { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-						create_info.renderPass = pass_data.begin_info.renderPass;
-						create_info.attachmentCount = num_color_attachments + num_stencil_attachments;
-						create_info.pAttachments = attachment_views;
-						create_info.width = scissor_rect.extent.width;
-						create_info.height = scissor_rect.extent.height;
-						create_info.layers = 1;
-
-						check_result(vk.CreateFramebuffer(_device, &create_info, nullptr, &pass_data.begin_info.framebuffer)) false;
-					}
+					render_pass = pass_data.render_pass;
 				}
 
 				VkPipelineShaderStageCreateInfo stages[2];
 				stages[0] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
 				stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-				stages[0].module = shader_modules.entry_points.at(pass_info.vs_entry_point);
+				stages[0].module = entry_points.at(pass_info.vs_entry_point);
 				stages[0].pName = pass_info.vs_entry_point.c_str();
 				stages[0].pSpecializationInfo = &spec_info;
 				stages[1] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
 				stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-				stages[1].module = shader_modules.entry_points.at(pass_info.ps_entry_point);
+				stages[1].module = entry_points.at(pass_info.ps_entry_point);
 				stages[1].pName = pass_info.ps_entry_point.c_str();
 				stages[1].pSpecializationInfo = &spec_info;
 
@@ -1412,16 +1260,303 @@ bool reshade::vulkan::runtime_vk::init_effect(size_t index)
 				create_info.pMultisampleState = &ms_info;
 				create_info.pDepthStencilState = &depth_info;
 				create_info.pColorBlendState = &blend_info;
-				create_info.layout = effect_data.pipeline_layout;
-				create_info.renderPass = pass_data.begin_info.renderPass;
+				create_info.layout = impl->pipeline_layout;
+				create_info.renderPass = render_pass;
 
 				const VkResult res = vk.CreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pass_data.pipeline);
 				if (res != VK_SUCCESS)
 				{
-					LOG(ERROR) << "Failed to create graphics pipeline for pass " << pass_index << " in technique '" << technique.name << "'! Vulkan error code is " << res << '.';
+					LOG(ERROR) << "Failed to create graphics pipeline for pass " << pass_index << " in technique '" << technique_info.name << "'! Vulkan error code is " << res << '.';
 					return false;
 				}
 			}
+		}
+	}
+
+	return true;
+}
+bool reshade::vulkan::runtime_vk::init_effect(size_t index, const compiled_effect &compiled)
+{
+	effect &effect = _effects[index];
+
+	// The shader modules, layouts, render passes and pipelines were already created in 'compile_effect', so take them over from there
+	const auto compiled_data = static_cast<compiled_effect_data *>(compiled.impl.get());
+	if (compiled_data == nullptr)
+		return false;
+
+	if (_effect_data.size() <= index)
+		_effect_data.resize(index + 1);
+	effect_data &effect_data = _effect_data[index];
+
+	effect_data.pipeline_layout = std::exchange(compiled_data->pipeline_layout, VK_NULL_HANDLE);
+	effect_data.sampler_layout = std::exchange(compiled_data->sampler_layout, VK_NULL_HANDLE);
+	effect_data.storage_layout = std::exchange(compiled_data->storage_layout, VK_NULL_HANDLE);
+
+	// Create query pool for time measurements
+	{   VkQueryPoolCreateInfo create_info { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+		create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		create_info.queryCount = static_cast<uint32_t>(effect.module.techniques.size() * 2 * NUM_COMMAND_FRAMES);
+
+		check_result(vk.CreateQueryPool(_device, &create_info, nullptr, &effect_data.query_pool)) false;
+	}
+
+	// Create global uniform buffer object
+	if (!effect.uniform_data_storage.empty())
+	{
+		effect_data.ubo = create_buffer(
+			effect.uniform_data_storage.size(),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+			0, 0, &effect_data.ubo_mem);
+		if (effect_data.ubo == VK_NULL_HANDLE)
+			return false;
+	}
+
+	// Initialize image and sampler bindings
+	assert(effect.module.num_texture_bindings == 0); // Use combined image samplers
+	std::vector<VkDescriptorImageInfo> sampler_bindings(effect.module.num_sampler_bindings);
+	std::vector<VkDescriptorImageInfo> storage_bindings(effect.module.num_storage_bindings);
+
+	for (const reshadefx::sampler_info &info : effect.module.samplers)
+	{
+		const texture &texture = look_up_texture_by_name(info.texture_name);
+
+		VkDescriptorImageInfo &image_binding = sampler_bindings[info.binding];
+		image_binding.imageView = static_cast<tex_data *>(texture.impl)->view[info.srgb];
+		image_binding.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		if (texture.semantic == "COLOR")
+		{
+			image_binding.imageView = _backbuffer_image_view[info.srgb];
+		}
+		if (texture.semantic == "DEPTH")
+		{
+			// Set to a default view to avoid crash because of this being null
+			image_binding.imageView = _empty_depth_image_view;
+#if RESHADE_DEPTH
+			if (_depth_image_view != VK_NULL_HANDLE)
+				image_binding.imageView = _depth_image_view;
+			// Keep track of the depth buffer texture descriptor to simplify updating it
+			effect_data.depth_image_bindings.emplace(info.binding, std::vector<VkDescriptorSet>());
+#endif
+		}
+
+		// Unset bindings are not allowed, so fail initialization for the entire effect in that case
+		if (image_binding.imageView == VK_NULL_HANDLE)
+			return false;
+
+		VkSamplerCreateInfo create_info { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+		create_info.addressModeU = static_cast<VkSamplerAddressMode>(static_cast<uint32_t>(info.address_u) - 1);
+		create_info.addressModeV = static_cast<VkSamplerAddressMode>(static_cast<uint32_t>(info.address_v) - 1);
+		create_info.addressModeW = static_cast<VkSamplerAddressMode>(static_cast<uint32_t>(info.address_w) - 1);
+		create_info.mipLodBias = info.lod_bias;
+		create_info.anisotropyEnable = VK_FALSE;
+		create_info.maxAnisotropy = 1.0f;
+		create_info.compareEnable = VK_FALSE;
+		create_info.compareOp = VK_COMPARE_OP_ALWAYS;
+		create_info.minLod = info.min_lod;
+		create_info.maxLod = info.max_lod;
+
+		switch (info.filter)
+		{
+		case reshadefx::texture_filter::min_mag_mip_point:
+			create_info.magFilter = VK_FILTER_NEAREST;
+			create_info.minFilter = VK_FILTER_NEAREST;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			break;
+		case reshadefx::texture_filter::min_mag_point_mip_linear:
+			create_info.magFilter = VK_FILTER_NEAREST;
+			create_info.minFilter = VK_FILTER_NEAREST;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			break;
+		case reshadefx::texture_filter::min_point_mag_linear_mip_point:
+			create_info.magFilter = VK_FILTER_LINEAR;
+			create_info.minFilter = VK_FILTER_NEAREST;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			break;
+		case reshadefx::texture_filter::min_point_mag_mip_linear:
+			create_info.magFilter = VK_FILTER_LINEAR;
+			create_info.minFilter = VK_FILTER_NEAREST;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			break;
+		case reshadefx::texture_filter::min_linear_mag_mip_point:
+			create_info.magFilter = VK_FILTER_NEAREST;
+			create_info.minFilter = VK_FILTER_LINEAR;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			break;
+		case reshadefx::texture_filter::min_linear_mag_point_mip_linear:
+			create_info.magFilter = VK_FILTER_NEAREST;
+			create_info.minFilter = VK_FILTER_LINEAR;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			break;
+		case reshadefx::texture_filter::min_mag_linear_mip_point:
+			create_info.magFilter = VK_FILTER_LINEAR;
+			create_info.minFilter = VK_FILTER_LINEAR;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			break;
+		case reshadefx::texture_filter::min_mag_mip_linear:
+			create_info.magFilter = VK_FILTER_LINEAR;
+			create_info.minFilter = VK_FILTER_LINEAR;
+			create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			break;
+		}
+
+		// Generate hash for sampler description
+		size_t desc_hash = 2166136261;
+		for (size_t i = 0; i < sizeof(create_info); ++i)
+			desc_hash = (desc_hash * 16777619) ^ reinterpret_cast<const uint8_t *>(&create_info)[i];
+
+		std::unordered_map<size_t, VkSampler>::iterator it = _effect_sampler_states.find(desc_hash);
+		if (it == _effect_sampler_states.end())
+		{
+			VkSampler sampler = VK_NULL_HANDLE;
+			check_result(vk.CreateSampler(_device, &create_info, nullptr, &sampler)) false;
+			it = _effect_sampler_states.emplace(desc_hash, sampler).first;
+		}
+
+		image_binding.sampler = it->second;
+	}
+
+	for (const reshadefx::storage_info &info : effect.module.storages)
+	{
+		const texture &texture = look_up_texture_by_name(info.texture_name);
+
+		VkDescriptorImageInfo &image_binding = storage_bindings[info.binding];
+		image_binding.imageView = static_cast<tex_data *>(texture.impl)->view[0];
+		image_binding.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		// Unset bindings are not allowed, so fail initialization for the entire effect in that case
+		if (image_binding.imageView == VK_NULL_HANDLE)
+			return false;
+	}
+
+	uint32_t num_passes = 0;
+	for (const reshadefx::technique_info &info : effect.module.techniques)
+		num_passes += static_cast<uint32_t>(info.passes.size());
+
+	std::vector<VkDescriptorSet> sets(1 + 2 * num_passes);
+	std::vector<VkWriteDescriptorSet> writes;
+	writes.reserve(sets.size());
+
+	{   VkDescriptorSetAllocateInfo alloc_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		alloc_info.descriptorPool = _effect_descriptor_pool;
+		alloc_info.descriptorSetCount = 1 + (effect.module.num_storage_bindings == 0 ? 1 : 2) * num_passes;
+
+		std::vector<VkDescriptorSetLayout> alloc_set_layouts(sets.size());
+		alloc_set_layouts[0] = _effect_descriptor_layout;
+		for (size_t i = 0; i < num_passes; ++i)
+		{
+			alloc_set_layouts[1 + i] = effect_data.sampler_layout;
+			alloc_set_layouts[1 + num_passes + i] = effect_data.storage_layout;
+		}
+		alloc_info.pSetLayouts = alloc_set_layouts.data();
+
+		if (vk.AllocateDescriptorSets(_device, &alloc_info, sets.data()) != VK_SUCCESS)
+		{
+			LOG(ERROR) << "Too many effects loaded. Only " << (MAX_EFFECT_DESCRIPTOR_SETS / 2) << " effects can be active simultaneously in Vulkan.";
+			return false;
+		}
+	}
+
+	effect_data.ubo_set = sets[0];
+	const VkDescriptorBufferInfo ubo_info = { effect_data.ubo, 0, VK_WHOLE_SIZE };
+	if (effect_data.ubo != VK_NULL_HANDLE)
+	{
+		VkWriteDescriptorSet &write = writes.emplace_back();
+		write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		write.dstSet = effect_data.ubo_set;
+		write.dstBinding = 0;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		write.pBufferInfo = &ubo_info;
+	}
+
+	uint32_t technique_index = 0;
+	uint32_t total_pass_index = 0;
+	for (technique &technique : _techniques)
+	{
+		if (technique.impl != nullptr || technique.effect_index != index)
+			continue;
+
+		auto impl = new technique_data();
+		technique.impl = impl;
+
+		// Offset index so that a query exists for each command frame and two subsequent ones are used for before/after stamps
+		impl->query_base_index = technique_index++ * 2 * NUM_COMMAND_FRAMES;
+
+		const auto compiled_passes = compiled_data->techniques.find(technique.name);
+		if (compiled_passes == compiled_data->techniques.end() || compiled_passes->second.size() != technique.passes.size())
+		{
+			LOG(ERROR) << "Failed to find pipelines for technique '" << technique.name << "'!";
+			return false;
+		}
+
+		impl->passes.resize(technique.passes.size());
+		for (size_t pass_index = 0; pass_index < technique.passes.size(); ++pass_index, ++total_pass_index)
+		{
+			pass_data &pass_data = impl->passes[pass_index];
+			const reshadefx::pass_info &pass_info = technique.passes[pass_index];
+
+			compiled_pass_data &compiled_pass = compiled_passes->second[pass_index];
+			pass_data.pipeline = std::exchange(compiled_pass.pipeline, VK_NULL_HANDLE);
+
+			if (!pass_info.cs_entry_point.empty())
+			{
+				impl->has_compute_passes = true;
+			}
+			else
+			{
+				const VkRect2D scissor_rect = {
+					{ 0, 0 },
+					{ pass_info.viewport_width ? pass_info.viewport_width : _width,
+					  pass_info.viewport_height ? pass_info.viewport_height : _height }
+				};
+
+				pass_data.begin_info.renderArea = scissor_rect;
+
+				uint32_t num_color_attachments = 0;
+				VkImageView attachment_views[9] = {};
+
+				for (uint32_t k = 0; k < 8 && !pass_info.render_target_names[k].empty(); ++k, ++num_color_attachments)
+				{
+					tex_data *const tex_impl = static_cast<tex_data *>(
+						look_up_texture_by_name(pass_info.render_target_names[k]).impl);
+
+					pass_data.modified_resources.push_back(tex_impl);
+
+					attachment_views[k] = tex_impl->view[2 + pass_info.srgb_write_enable];
+				}
+
+				if (pass_info.clear_render_targets)
+				{
+					pass_data.begin_info.clearValueCount = num_color_attachments;
+					pass_data.begin_info.pClearValues = pass_data.clear_values; // These are initialized to zero already
+				}
+
+				if (pass_info.render_target_names[0].empty())
+				{
+					pass_data.begin_info.renderPass = _default_render_pass[pass_info.srgb_write_enable];
+					pass_data.begin_info.framebuffer = VK_NULL_HANDLE; // Select the correct swap chain frame buffer during rendering
+				}
+				else
+				{
+					pass_data.begin_info.renderPass = std::exchange(compiled_pass.render_pass, VK_NULL_HANDLE);
+
+					uint32_t num_attachments = num_color_attachments;
+					if (compiled_pass.stencil_attachment)
+						attachment_views[num_attachments++] = _effect_stencil_view;
+
+					{   VkFramebufferCreateInfo create_info { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+						create_info.renderPass = pass_data.begin_info.renderPass;
+						create_info.attachmentCount = num_attachments;
+						create_info.pAttachments = attachment_views;
+						create_info.width = scissor_rect.extent.width;
+						create_info.height = scissor_rect.extent.height;
+						create_info.layers = 1;
+
+						check_result(vk.CreateFramebuffer(_device, &create_info, nullptr, &pass_data.begin_info.framebuffer)) false;
+					}
+				}
+			}
 
 			pass_data.set[0] = sets[1 + total_pass_index];
 			for (const reshadefx::sampler_info &info : pass_info.samplers)
@@ -1578,46 +1713,9 @@ bool reshade::vulkan::runtime_vk::init_texture(texture &texture)
 	impl->height = texture.height;
 	impl->levels = texture.levels;
 
-	switch (texture.format)
-	{
-	case reshadefx::texture_format::r8:
-		impl->formats[0] = VK_FORMAT_R8_UNORM;
-		break;
-	case reshadefx::texture_format::r16f:
-		impl->formats[0] = VK_FORMAT_R16_SFLOAT;
-		break;
-	case reshadefx::texture_format::r32f:
-		impl->formats[0] = VK_FORMAT_R32_SFLOAT;
-		break;
-	case reshadefx::texture_format::rg8:
-		impl->formats[0] = VK_FORMAT_R8G8_UNORM;
-		break;
-	case reshadefx::texture_format::rg16:
-		impl->formats[0] = VK_FORMAT_R16G16_UNORM;
-		break;
-	case reshadefx::texture_format::rg16f:
-		impl->formats[0] = VK_FORMAT_R16G16_SFLOAT;
-		break;
-	case reshadefx::texture_format::rg32f:
-		impl->formats[0] = VK_FORMAT_R32G32_SFLOAT;
-		break;
-	case reshadefx::texture_format::rgba8:
-		impl->formats[0] = VK_FORMAT_R8G8B8A8_UNORM;
-		impl->formats[1] = VK_FORMAT_R8G8B8A8_SRGB;
-		break;
-	case reshadefx::texture_format::rgba16:
-		impl->formats[0] = VK_FORMAT_R16G16B16A16_UNORM;
-		break;
-	case reshadefx::texture_format::rgba16f:
-		impl->formats[0] = VK_FORMAT_R16G16B16A16_SFLOAT;
-		break;
-	case reshadefx::texture_format::rgba32f:
-		impl->formats[0] = VK_FORMAT_R32G32B32A32_SFLOAT;
-		break;
-	case reshadefx::texture_format::rgb10a2:
-		impl->formats[0] = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
-		break;
-	}
+	// Only RGBA8 textures have a separate sRGB format, all others use the same one for both
+	impl->formats[0] = convert_format(texture.format);
+	impl->formats[1] = convert_format(texture.format, true);
 
 	// Need TRANSFER_DST for texture data upload
 	VkImageUsageFlags usage_flags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
@@ -1630,10 +1728,8 @@ bool reshade::vulkan::runtime_vk::init_texture(texture &texture)
 
 	VkImageCreateFlags image_flags = 0;
 	// Add mutable format flag required to create a SRGB view of the image
-	if (impl->formats[1] != VK_FORMAT_UNDEFINED)
+	if (impl->formats[1] != impl->formats[0])
 		image_flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
-	else
-		impl->formats[1] = impl->formats[0];
 
 	impl->image = create_image(
 		texture.width, texture.height, texture.levels, impl->formats[0],
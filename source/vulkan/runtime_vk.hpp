@@ -34,7 +34,8 @@ namespace reshade::vulkan
 		const VkLayerDispatchTable vk;
 
 	private:
-		bool init_effect(size_t index) override;
+		bool compile_effect(size_t index, compiled_effect &compiled) override;
+		bool init_effect(size_t index, const compiled_effect &compiled) override;
 		void unload_effect(size_t index) override;
 		void unload_effects() override;
 
@@ -0,0 +1,874 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Benchmarks for the individual stages of the effect compiler, which run over a shader corpus (e.g. setup/Config/reshade-shaders or a checkout of the reshade-shaders repository).
+// Build it together with the effect compiler, e.g.:
+//   g++ -std=c++17 -O2 -Isource -Ideps/spirv/include/spirv/unified1 tools/effect_bench.cpp source/effect_*.cpp source/dll_config.cpp source/runtime_platform.cpp -o effect_bench
+// And run one of the benchmarks on shader files or directories (which are searched recursively and added as include paths, any ".ini" files in them are used as presets):
+//   ./effect_bench lexer setup/Config/reshade-shaders
+
+#include "effect_lexer.hpp"
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include "effect_module.hpp"
+#include "effect_preprocessor.hpp"
+#include "dll_config.hpp"
+#include <new>
+#include <tuple>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::filesystem::path g_reshade_dll_path; // Normally set when the DLL is loaded and only needed for the global configuration file in 'ini_file', which is not used here
+
+struct source_file
+{
+	std::filesystem::path path;
+	std::string data;
+};
+
+static size_t s_rounds = 10;
+static std::vector<source_file> s_effects; // All ".fx" files in the corpus
+static std::vector<source_file> s_headers; // All ".fxh" files in the corpus
+static std::vector<std::filesystem::path> s_presets; // All ".ini" files in the corpus
+static std::vector<std::filesystem::path> s_include_paths;
+
+// Count the heap allocations of the whole process and the bytes they hold, so that benchmarks can report how many each stage makes and how much memory it needs at most
+// Every allocation is preceded by a header with its size, which keeps the alignment 'malloc' guarantees
+static std::atomic<size_t> s_num_allocations = 0;
+static std::atomic<size_t> s_allocated_bytes = 0;
+static std::atomic<size_t> s_peak_allocated_bytes = 0;
+static constexpr size_t s_allocation_header_size = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+	s_num_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *const ptr = std::malloc(s_allocation_header_size + size))
+	{
+		*static_cast<size_t *>(ptr) = size;
+
+		const size_t allocated_bytes = s_allocated_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t peak_allocated_bytes = s_peak_allocated_bytes.load(std::memory_order_relaxed);
+		while (allocated_bytes > peak_allocated_bytes && !s_peak_allocated_bytes.compare_exchange_weak(peak_allocated_bytes, allocated_bytes, std::memory_order_relaxed))
+			continue;
+
+		return static_cast<char *>(ptr) + s_allocation_header_size;
+	}
+	throw std::bad_alloc();
+}
+// GCC warns about freeing memory from 'operator new' wherever it inlines these into code that allocated through it, which is what they are replacing
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *ptr) noexcept
+{
+	if (ptr == nullptr)
+		return;
+
+	ptr = static_cast<char *>(ptr) - s_allocation_header_size;
+	s_allocated_bytes.fetch_sub(*static_cast<size_t *>(ptr), std::memory_order_relaxed);
+	std::free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static std::string read_file(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream data;
+	data << file.rdbuf();
+	return data.str();
+}
+
+static void add_corpus(const std::filesystem::path &path)
+{
+	std::error_code ec;
+	if (std::filesystem::is_directory(path, ec))
+	{
+		s_include_paths.push_back(path);
+		for (const std::filesystem::directory_entry &entry : std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied, ec))
+			if (entry.is_directory(ec))
+				s_include_paths.push_back(entry.path());
+			else if (entry.path().extension() == ".fx")
+				s_effects.push_back({ entry.path(), read_file(entry.path()) });
+			else if (entry.path().extension() == ".fxh")
+				s_headers.push_back({ entry.path(), read_file(entry.path()) });
+			else if (entry.path().extension() == ".ini")
+				s_presets.push_back(entry.path());
+	}
+	else
+	{
+		s_include_paths.push_back(path.parent_path());
+		(path.extension() == ".fxh" ? s_headers : s_effects).push_back({ path, read_file(path) });
+	}
+}
+
+// Set up the preprocessor the same way the runtime does, so that the corpus compiles the same as it would in a game
+static void init_preprocessor(reshadefx::preprocessor &pp)
+{
+	pp.add_macro_definition("__RESHADE__", "40900");
+	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+	pp.add_macro_definition("__VENDOR__", "0");
+	pp.add_macro_definition("__DEVICE__", "0");
+	pp.add_macro_definition("__RENDERER__", "45056");
+	pp.add_macro_definition("__APPLICATION__", "0");
+	pp.add_macro_definition("BUFFER_WIDTH", "1920");
+	pp.add_macro_definition("BUFFER_HEIGHT", "1080");
+	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+	pp.add_macro_definition("BUFFER_COLOR_BIT_DEPTH", "8");
+
+	for (const std::filesystem::path &include_path : s_include_paths)
+		pp.add_include_path(include_path);
+}
+
+static std::string preprocess(const source_file &file)
+{
+	reshadefx::preprocessor pp;
+	init_preprocessor(pp);
+	if (!pp.append_file(file.path))
+		fprintf(stderr, "warning: failed to preprocess '%s':\n%s", file.path.u8string().c_str(), pp.errors().c_str());
+	return std::move(pp.output());
+}
+static std::vector<std::string> preprocess_all()
+{
+	std::vector<std::string> preprocessed;
+	for (const source_file &file : s_effects)
+		preprocessed.push_back(preprocess(file));
+	return preprocessed;
+}
+
+// A named group of preprocessed effects that a benchmark runs over
+struct effect_set
+{
+	std::string name;
+	std::vector<std::string> sources;
+	std::vector<std::filesystem::path> paths; // Files in the corpus the sources were preprocessed from, which is empty for generated code
+};
+
+// Return the largest effect of the corpus on its own, since that is where costs per token add up the most, and all effects together
+static std::vector<effect_set> corpus_effect_sets()
+{
+	std::vector<effect_set> sets(2);
+	sets[1].name = "all effects";
+	for (const source_file &file : s_effects)
+	{
+		sets[1].sources.push_back(preprocess(file));
+		sets[1].paths.push_back(file.path);
+	}
+
+	if (const auto largest = std::max_element(sets[1].sources.begin(), sets[1].sources.end(),
+			[](const std::string &lhs, const std::string &rhs) { return lhs.size() < rhs.size(); }); largest != sets[1].sources.end())
+	{
+		const size_t index = largest - sets[1].sources.begin();
+		sets[0].name = sets[1].paths[index].filename().u8string();
+		sets[0].sources.push_back(sets[1].sources[index]);
+		sets[0].paths.push_back(sets[1].paths[index]);
+	}
+	else
+	{
+		sets.erase(sets.begin());
+	}
+
+	return sets;
+}
+
+// Parse the preprocessed source and generate code for it with the specified code generator, without writing it into a module
+static bool parse(const std::string &source, reshadefx::codegen *codegen)
+{
+	reshadefx::parser parser;
+	if (parser.parse(source, codegen))
+		return true;
+
+	fprintf(stderr, "warning: failed to parse:\n%s", parser.errors().c_str());
+	return false;
+}
+
+// Append a vertex and pixel shader and a technique that uses them to generated code, so that it compiles like an effect does
+// The pixel shader returns the specified expression, which can use 'position' and 'uv', so that the generated functions are called from an entry point
+static void append_technique(std::string &generated, const std::string &result)
+{
+	generated +=
+		"void VS(uint id : SV_VertexID, out float4 position : SV_Position, out float2 uv : TEXCOORD) { uv = float2(id, id); position = float4(uv, 0, 1); }\n"
+		"float4 PS(float4 position : SV_Position, float2 uv : TEXCOORD) : SV_Target { return " + result + "; }\n"
+		"technique T { pass { VertexShader = VS; PixelShader = PS; } }\n";
+}
+
+static size_t total_size(const std::vector<std::string> &sources)
+{
+	return std::accumulate(sources.begin(), sources.end(), size_t(0),
+		[](size_t size, const std::string &source) { return size + source.size(); });
+}
+
+struct measurement
+{
+	double duration = 0.0; // Fastest round in seconds, which is least affected by other activity on the machine
+	size_t allocations = 0; // Heap allocations of a single round
+	size_t peak_memory = 0; // Most heap memory in bytes a single round held at once, on top of what was allocated before it started
+};
+
+// Run the function once to count its heap allocations and peak heap memory, then the configured number of rounds to find the fastest one
+// The preparation function is called before every round without counting its time or allocations
+template <typename P, typename F>
+static measurement measure(P &&prepare, F &&function)
+{
+	measurement result;
+
+	prepare();
+	const size_t num_allocations_before = s_num_allocations;
+	const size_t allocated_bytes_before = s_allocated_bytes;
+	s_peak_allocated_bytes = allocated_bytes_before;
+	function();
+	result.allocations = s_num_allocations - num_allocations_before;
+	result.peak_memory = s_peak_allocated_bytes - allocated_bytes_before;
+
+	result.duration = std::numeric_limits<double>::max();
+	for (size_t round = 0; round < s_rounds; ++round)
+	{
+		prepare();
+
+		const auto time_started = std::chrono::high_resolution_clock::now();
+		function();
+		const auto duration = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - time_started).count();
+		if (duration < result.duration)
+			result.duration = duration;
+	}
+
+	return result;
+}
+template <typename F>
+static measurement measure(F &&function)
+{
+	return measure([]() {}, std::forward<F>(function));
+}
+
+// Print one line per measurement, so that the output of all benchmarks has the same columns, followed by anything the benchmark adds (e.g. sizes and throughput)
+static void print_result(const std::string &name, const measurement &result, const char *details_format = "", ...)
+{
+	char details[256];
+	va_list args;
+	va_start(args, details_format);
+	vsnprintf(details, sizeof(details), details_format, args);
+	va_end(args);
+
+	printf("%-36s %10.3f ms %10zu allocations %9.3f MB peak   %s\n", name.c_str(),
+		result.duration * 1000.0, result.allocations, result.peak_memory / (1024.0 * 1024.0), details);
+}
+
+// Drop the file from the page cache of the operating system, so that it has to be read from disk again the next time
+// This is only supported on POSIX systems and only works for files that have no pending writes
+static bool evict_from_page_cache(const std::filesystem::path &path)
+{
+#ifndef _WIN32
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	const bool success = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return success;
+#else
+	return static_cast<void>(path), false;
+#endif
+}
+
+// Walk over whitespace, comments and identifiers one character at a time, the way the scalar code of the lexer does, as a baseline to compare the vectorized lexer against
+// This does less work than the lexer, since it creates no tokens and steps over every other character on its own, so its throughput is an upper bound for a scalar lexer
+static size_t scan_scalar(std::string_view input)
+{
+	const auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r'; };
+	const auto is_identifier = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; };
+
+	size_t num_tokens = 0;
+	for (const char *cur = input.data(), *const end = cur + input.size(); cur < end; ++num_tokens)
+	{
+		if (is_space(*cur))
+		{
+			do cur++; while (cur < end && is_space(*cur));
+		}
+		else if (is_identifier(*cur))
+		{
+			do cur++; while (cur < end && is_identifier(*cur));
+		}
+		else if (cur + 1 < end && cur[0] == '/' && cur[1] == '/')
+		{
+			while (cur < end && *cur != '\n')
+				cur++;
+		}
+		else if (cur + 1 < end && cur[0] == '/' && cur[1] == '*')
+		{
+			for (cur += 2; cur + 1 < end && (cur[0] != '*' || cur[1] != '/');)
+				cur++;
+			cur = std::min(cur + 2, end);
+		}
+		else
+		{
+			cur++;
+		}
+	}
+	return num_tokens;
+}
+
+static void bench_lexer()
+{
+	std::vector<std::string> sources;
+	for (const source_file &file : s_effects)
+		sources.push_back(file.data);
+	for (const source_file &file : s_headers)
+		sources.push_back(file.data);
+	std::vector<std::string> preprocessed = preprocess_all();
+
+	for (const auto &[name, inputs, as_preprocessor] : {
+			std::make_tuple("source files", &sources, true),
+			std::make_tuple("preprocessed effects", &preprocessed, false) })
+	{
+		size_t num_bytes = 0;
+		for (const std::string &input : *inputs)
+			num_bytes += input.size();
+
+		// The preprocessor keeps whitespace and directives and leaves keywords to the parser, which lexes the preprocessed text with the default settings
+		size_t num_tokens = 0;
+		const measurement lexer_result = measure([&, inputs = inputs, as_preprocessor = as_preprocessor]() {
+			num_tokens = 0;
+			for (const std::string &input : *inputs)
+			{
+				reshadefx::lexer lexer = as_preprocessor ?
+					reshadefx::lexer(std::string_view(input), true, false, false, false, true, false) :
+					reshadefx::lexer(std::string_view(input));
+				while (lexer.lex().id != reshadefx::tokenid::end_of_file)
+					num_tokens++;
+			}
+		});
+		print_result(std::string(name) + " (lexer)", lexer_result, "%8zu tokens in %8zu bytes, %7.2f MB/s", num_tokens, num_bytes, num_bytes / lexer_result.duration / 1e6);
+
+		size_t num_scanned = 0;
+		const measurement scalar_result = measure([&, inputs = inputs]() {
+			num_scanned = 0;
+			for (const std::string &input : *inputs)
+				num_scanned += scan_scalar(input);
+		});
+		print_result(std::string(name) + " (scalar scan)", scalar_result, "%8zu tokens in %8zu bytes, %7.2f MB/s", num_scanned, num_bytes, num_bytes / scalar_result.duration / 1e6);
+	}
+}
+
+static void bench_tokens()
+{
+	for (const effect_set &set : corpus_effect_sets())
+	{
+		// Lex the preprocessed text into a token list, the way the parser does
+		size_t num_tokens = 0;
+		const measurement lex_result = measure([&]() {
+			num_tokens = 0;
+			for (const std::string &source : set.sources)
+			{
+				std::vector<reshadefx::token> tokens;
+				reshadefx::lexer lexer { std::string_view(source) };
+				do
+					tokens.push_back(lexer.lex());
+				while (tokens.back().id != reshadefx::tokenid::end_of_file);
+				num_tokens += tokens.size();
+			}
+		});
+		print_result(set.name + " (lex)", lex_result, "%8zu tokens, %5.2f allocations per token", num_tokens, static_cast<double>(lex_result.allocations) / num_tokens);
+
+		// Preprocess the effects again, which lexes all included files too
+		size_t output_size = 0;
+		const measurement preprocess_result = measure([&]() {
+			output_size = 0;
+			for (const std::filesystem::path &path : set.paths)
+				output_size += preprocess({ path, std::string() }).size();
+		});
+		print_result(set.name + " (preprocess)", preprocess_result, "%8zu bytes output", output_size);
+	}
+}
+
+static void bench_keywords()
+{
+	// Collect every identifier, keyword and preprocessor directive in the corpus, so that lexing them is dominated by the lookup
+	std::string identifiers, directives;
+	size_t num_identifiers = 0, num_directives = 0;
+	std::vector<std::string> inputs = preprocess_all();
+	for (const source_file &file : s_effects)
+		inputs.push_back(file.data);
+	for (const source_file &file : s_headers)
+		inputs.push_back(file.data);
+	for (const std::string &input : inputs)
+	{
+		reshadefx::lexer lexer(std::string_view(input), true, true, false, true, true);
+		for (reshadefx::token tok; (tok = lexer.lex()).id != reshadefx::tokenid::end_of_file;)
+		{
+			if (tok.id == reshadefx::tokenid::identifier)
+				identifiers += tok.literal_as_string, identifiers += ' ', num_identifiers++;
+			else if (tok.id >= reshadefx::tokenid::hash_def && tok.id < reshadefx::tokenid::hash_unknown)
+				directives += '#', directives += tok.literal_as_string, directives += '\n', num_directives++;
+		}
+	}
+
+	// The lexer used to look names up in a 'std::unordered_map' with string keys, which is the baseline here
+	// It is filled with the names that the lexer reports as keywords or directives, so that it does not have to repeat the lists of the lexer
+	using name_map = std::unordered_map<std::string, reshadefx::tokenid>;
+	name_map keyword_map, pp_directive_map;
+	for (const auto &[input, map, ignore_pp_directives] : {
+			std::make_tuple(&identifiers, &keyword_map, true),
+			std::make_tuple(&directives, &pp_directive_map, false) })
+	{
+		reshadefx::lexer lexer(std::string_view(*input), true, true, ignore_pp_directives);
+		for (reshadefx::token tok; (tok = lexer.lex()).id != reshadefx::tokenid::end_of_file;)
+			if (tok.id != reshadefx::tokenid::identifier)
+				map->emplace(tok.literal_as_string, tok.id);
+	}
+
+	// Lexing the identifiers without any lookup shows how much of the time the lookup takes
+	// For the map the directives are lexed as a hash sign followed by an identifier, which is then looked up
+	const struct {
+		const char *name;
+		const std::string *input;
+		size_t count;
+		bool ignore_pp_directives, ignore_keywords;
+		const name_map *map;
+	} cases[] = {
+		{ "identifiers (no lookup)", &identifiers, num_identifiers, true, true, nullptr },
+		{ "identifiers (keyword table)", &identifiers, num_identifiers, true, false, nullptr },
+		{ "identifiers (keyword map)", &identifiers, num_identifiers, true, true, &keyword_map },
+		{ "directives (directive table)", &directives, num_directives, false, true, nullptr },
+		{ "directives (directive map)", &directives, num_directives, true, true, &pp_directive_map },
+	};
+
+	for (const auto &[name, input, count, ignore_pp_directives, ignore_keywords, map] : cases)
+	{
+		size_t num_found = 0;
+		const measurement result = measure([&, input = input, ignore_pp_directives = ignore_pp_directives, ignore_keywords = ignore_keywords, map = map]() {
+			num_found = 0;
+			reshadefx::lexer lexer(std::string_view(*input), true, true, ignore_pp_directives, false, ignore_keywords);
+			for (reshadefx::token tok; (tok = lexer.lex()).id != reshadefx::tokenid::end_of_file;)
+				if (map != nullptr && tok.id == reshadefx::tokenid::identifier)
+					num_found += map->find(std::string(tok.literal_as_string)) != map->end();
+		});
+		print_result(name, result, "%8zu names, %7.2f ns per name", count, result.duration / count * 1e9);
+	}
+}
+
+static void bench_macros()
+{
+	// Generate input where every line expands into a deep tree of nested function-like macro calls, with macro calls in the arguments on every level
+	std::string generated =
+		"#define ADD(a, b) ((a) + (b))\n"
+		"#define MUL(a, b) ((a) * (b))\n"
+		"#define LERP(a, b, t) ADD(a, MUL(ADD(b, -(a)), t))\n"
+		"#define NEST1(x) LERP(x, ADD(x, 1.0), 0.5)\n"
+		"#define NEST2(x) NEST1(NEST1(x))\n"
+		"#define NEST3(x) NEST2(MUL(NEST2(x), 2.0))\n";
+	for (size_t i = 0; i < 200; ++i)
+		generated += "float f" + std::to_string(i) + " = NEST3(v" + std::to_string(i) + ");\n";
+
+	// The macro-heavy headers are preprocessed on their own too, which mostly defines macros, and the effects show how much of their time macros take
+	std::vector<std::pair<std::string, std::vector<std::string>>> inputs;
+	inputs.emplace_back("generated", std::vector<std::string>(1, generated));
+	for (const source_file &file : s_headers)
+		if (file.path.filename() == "Macros.fxh" || file.path.filename() == "ReShadeUI.fxh")
+			inputs.emplace_back(file.path.filename().u8string(), std::vector<std::string>(1, "#include \"" + file.path.filename().u8string() + "\"\n"));
+	inputs.emplace_back("all effects", std::vector<std::string>());
+	for (const source_file &file : s_effects)
+		inputs.back().second.push_back(file.data);
+
+	for (const auto &[name, sources] : inputs)
+	{
+		size_t output_size = 0;
+		const measurement result = measure([&, &sources = sources]() {
+			output_size = 0;
+			for (const std::string &source : sources)
+			{
+				reshadefx::preprocessor pp;
+				init_preprocessor(pp);
+				pp.append_string(source);
+				output_size += pp.output().size();
+			}
+		});
+		print_result(name, result, "%8zu bytes output", output_size);
+	}
+}
+
+static void bench_files()
+{
+	// Generate a large preset next to the corpus presets, with as many techniques and effect settings as a preset for a big shader collection has
+	std::error_code ec;
+	const std::filesystem::path generated_preset_path = std::filesystem::temp_directory_path(ec) / "effect_bench_preset.ini";
+	{	std::ofstream file(generated_preset_path);
+		file << "Techniques=";
+		for (size_t i = 0; i < 500; ++i)
+			file << (i != 0 ? "," : "") << "Technique" << i << "@Effect" << i << ".fx";
+		file << "\n\n";
+		for (size_t i = 0; i < 500; ++i)
+		{
+			file << "[Effect" << i << ".fx]\n";
+			for (size_t k = 0; k < 30; ++k)
+				file << "Setting" << k << '=' << i * 0.001 << ',' << k * 0.5 << ",1.000000\n";
+			file << '\n';
+		}
+	}
+
+	std::vector<std::filesystem::path> shader_files, preset_files = s_presets;
+	for (const source_file &file : s_effects)
+		shader_files.push_back(file.path);
+	for (const source_file &file : s_headers)
+		shader_files.push_back(file.path);
+	preset_files.push_back(generated_preset_path);
+
+	const auto evict_all = [&]() {
+		bool success = true;
+		for (const std::vector<std::filesystem::path> *files : { &shader_files, &preset_files })
+			for (const std::filesystem::path &path : *files)
+				success &= evict_from_page_cache(path);
+		return success;
+	};
+	const bool cold_supported = evict_all();
+
+	// Sum up what was read, so that the compiler cannot skip reading it
+	size_t checksum = 0;
+	using read_function = std::function<size_t(const std::filesystem::path &)>;
+
+	for (const auto &[name, files, function] : {
+			// Read each file through a stream into a string and look at all of its contents
+			std::make_tuple("read through stream", &shader_files, read_function([](const std::filesystem::path &path) {
+				const std::string data = read_file(path);
+				return static_cast<size_t>(std::count(data.begin(), data.end(), '\n')); })),
+			// Preprocess every effect with an empty include cache, so that all included files are read again
+			std::make_tuple("preprocess", &shader_files, read_function([](const std::filesystem::path &path) {
+				if (path.extension() != ".fx")
+					return size_t(0);
+				reshadefx::preprocessor::clear_include_cache();
+				return preprocess({ path, std::string() }).size(); })),
+			std::make_tuple("load presets", &preset_files, read_function([](const std::filesystem::path &path) {
+				std::vector<std::string> techniques;
+				reshade::ini_file(path).get({}, "Techniques", techniques);
+				return techniques.size(); })) })
+	{
+		const auto run = [&, files = files, &function = function]() {
+			for (const std::filesystem::path &path : *files)
+				checksum += function(path);
+		};
+
+		if (cold_supported)
+			print_result(std::string(name) + " (cold)", measure(evict_all, run), "%8zu files", files->size());
+		print_result(std::string(name) + " (warm)", measure(run), "%8zu files", files->size());
+	}
+
+	if (!cold_supported)
+		printf("Files could not be evicted from the page cache on this system, so no cold reads were measured\n");
+
+	std::filesystem::remove(generated_preset_path, ec);
+}
+
+static void bench_scopes()
+{
+	// Generate an effect with many global symbols and functions full of deeply nested blocks, so that leaving scopes happens often while a lot of symbols are declared
+	std::string generated;
+	for (size_t i = 0; i < 1000; ++i)
+		generated += "uniform float g" + std::to_string(i) + ";\n";
+	for (size_t i = 0; i < 200; ++i)
+	{
+		generated += "float f" + std::to_string(i) + "(float x)\n{\n\tfloat r = x;\n";
+		for (size_t depth = 0; depth < 30; ++depth)
+			generated += std::string(depth + 1, '\t') + "if (r > g" + std::to_string((i + depth) % 1000) + ") { float v" + std::to_string(depth) + " = r * 0.5; r = v" + std::to_string(depth) + ";\n";
+		for (size_t depth = 30; depth > 0; --depth)
+			generated += std::string(depth, '\t') + "}\n";
+		generated += "\treturn r;\n}\n";
+	}
+	append_technique(generated, "f199(position.x)");
+
+	std::vector<effect_set> sets = corpus_effect_sets();
+	sets.insert(sets.begin(), { "generated", std::vector<std::string>(1, generated), {} });
+
+	for (const effect_set &set : sets)
+	{
+		// Code is generated along the way, but not written into a module, so that most of the time is spent in the parser and symbol table
+		const measurement result = measure([&]() {
+			for (const std::string &source : set.sources)
+			{
+				const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_hlsl(50, false, false));
+				parse(source, codegen.get());
+			}
+		});
+		print_result(set.name, result, "%8zu bytes", total_size(set.sources));
+	}
+}
+
+static void bench_intrinsics()
+{
+	// Generate an effect that calls intrinsic functions with many overloads in every statement, with arguments that are not constant so that the calls cannot be folded
+	static const char *const statements[] = {
+		"c = lerp(c, tex2D(s, uv + r), saturate(dot(c.rgb, float3(0.3, 0.6, 0.1))));",
+		"r = saturate(r * abs(sin(c.rg)) + max(c.ba, min(uv, r)));",
+		"c.rgb = normalize(cross(c.rgb, float3(r, c.a))) * pow(abs(c.rgb), 2.2);",
+		"c = clamp(c + tex2Dlod(s, float4(uv, 0, 0)) * exp2(-length(r)), 0.0, 1.0);",
+		"r = frac(floor(uv * 8.0) / 8.0 + step(0.5, c.rg) * smoothstep(0.0, 1.0, r));",
+		"c.a = rsqrt(max(distance(c.rgb, r.xyx), 0.001)) * any(c > 0.5) + all(r < 0.5);",
+	};
+
+	std::string generated = "texture t { Width = 256; Height = 256; };\nsampler s { Texture = t; };\n";
+	for (size_t i = 0; i < 100; ++i)
+	{
+		generated += "float4 f" + std::to_string(i) + "(float4 c, float2 uv)\n{\n\tfloat2 r = uv;\n";
+		for (size_t k = 0; k < 60; ++k)
+			generated += '\t' + std::string(statements[(i + k) % std::size(statements)]) + '\n';
+		generated += "\treturn c;\n}\n";
+	}
+	append_technique(generated, "f99(position, uv)");
+
+	const measurement result = measure([&]() {
+		const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_hlsl(50, false, false));
+		parse(generated, codegen.get());
+	});
+	print_result("generated", result, "%8zu bytes", generated.size());
+}
+
+static void bench_module_cache()
+{
+	// Compare a cold start, which compiles every effect into a module, with a warm start, which restores the module from the cache
+	// Both preprocess the effects first, since the runtime needs the preprocessed source to compute the cache key
+	struct cached_effect
+	{
+		const source_file *file;
+		std::string data;
+	};
+
+	for (const auto &[name, create_codegen] : {
+			std::make_pair("hlsl", std::function<reshadefx::codegen *()>([]() { return reshadefx::create_codegen_hlsl(50, false, false, true); })),
+			std::make_pair("spirv", std::function<reshadefx::codegen *()>([]() { return reshadefx::create_codegen_spirv(true, false, false, false, true, true); })) })
+	{
+		std::vector<cached_effect> cache;
+		size_t cache_size = 0;
+		for (const source_file &file : s_effects)
+		{
+			const std::unique_ptr<reshadefx::codegen> codegen(create_codegen());
+			if (!parse(preprocess(file), codegen.get()))
+				continue; // Effects that fail to compile are never cached
+
+			reshadefx::module module;
+			codegen->write_result(module);
+
+			std::string data;
+			reshadefx::serialize_module(module, data);
+			cache_size += data.size();
+			cache.push_back({ &file, std::move(data) });
+		}
+
+		const measurement preprocess_result = measure([&]() {
+			for (const cached_effect &effect : cache)
+				preprocess(*effect.file);
+		});
+		const measurement compile_result = measure([&, &create_codegen = create_codegen]() {
+			for (const cached_effect &effect : cache)
+			{
+				const std::unique_ptr<reshadefx::codegen> codegen(create_codegen());
+				parse(preprocess(*effect.file), codegen.get());
+
+				reshadefx::module module;
+				codegen->write_result(module);
+			}
+		});
+		const measurement deserialize_result = measure([&]() {
+			for (const cached_effect &effect : cache)
+			{
+				reshadefx::module module;
+				if (!reshadefx::deserialize_module(effect.data, module))
+					fprintf(stderr, "warning: failed to restore module of '%s'\n", effect.file->path.u8string().c_str());
+			}
+		});
+
+		measurement warm_start_result;
+		warm_start_result.duration = preprocess_result.duration + deserialize_result.duration;
+		warm_start_result.allocations = preprocess_result.allocations + deserialize_result.allocations;
+		warm_start_result.peak_memory = std::max(preprocess_result.peak_memory, deserialize_result.peak_memory);
+
+		print_result(std::string(name) + " (preprocess)", preprocess_result, "%8zu effects", cache.size());
+		print_result(std::string(name) + " (preprocess + compile)", compile_result, "%8zu effects", cache.size());
+		print_result(std::string(name) + " (deserialize)", deserialize_result, "%8zu bytes of cached modules", cache_size);
+		print_result(std::string(name) + " (warm start)", warm_start_result, "%8.1fx faster than compiling", compile_result.duration / warm_start_result.duration);
+	}
+}
+
+// Generate an effect with thousands of distinct constants, hundreds of array types and many function signatures, which all have to be looked up whenever they are used again
+// The matrix and array uniforms with initializers become specialization constants when those are enabled, which splits them into one constant per element
+static std::string generate_constants_effect()
+{
+	std::string generated;
+	for (size_t i = 0; i < 100; ++i)
+		generated += "uniform float4x4 m" + std::to_string(i) + " = float4x4(" + std::to_string(i) + ".0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10.0, 11.0, 12.0, 13.0, 14.0, " + std::to_string(i) + ".5);\n";
+	for (size_t i = 0; i < 400; ++i)
+	{
+		static const char *const float_types[] = { "float", "float2", "float3", "float4" };
+		static const char *const int_types[] = { "int", "int2", "int3", "int4" };
+
+		const std::string index = std::to_string(i), size = std::to_string(i + 1);
+		generated += std::string(float_types[i % 4]) + " f" + index + '(' + float_types[i % 4] + " x, " + int_types[i / 4 % 4] + " y)\n{\n\tfloat a[" + size + "];\n";
+		for (size_t k = 0; k < 20; ++k)
+			generated += "\ta[" + std::to_string(k % (i + 1)) + "] = x.x * " + std::to_string(i * 20 + k) + ".25 + y.x;\n";
+		generated += "\treturn x * a[0] + m" + std::to_string(i % 100) + "[0][0];\n}\n";
+	}
+	append_technique(generated, "f399(position, int4(position)) + f0(position.x, 0)");
+
+	return generated;
+}
+
+static void bench_spirv_lookups()
+{
+	const std::string generated = generate_constants_effect();
+
+	for (const bool spec_constants : { false, true })
+	{
+		const measurement result = measure([&]() {
+			const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_spirv(true, false, spec_constants));
+			parse(generated, codegen.get());
+
+			reshadefx::module module;
+			codegen->write_result(module);
+		});
+		print_result(spec_constants ? "generated (spec constants)" : "generated", result, "%8zu bytes", generated.size());
+	}
+}
+
+static void bench_spirv()
+{
+	// Report the largest effect and all effects next to the generated effect with many constants, which produces the most instructions
+	std::vector<effect_set> sets = corpus_effect_sets();
+	sets.push_back({ "generated", std::vector<std::string>(1, generate_constants_effect()), {} });
+
+	for (const effect_set &set : sets)
+	{
+		// Count code generation while parsing separately from assembling the final module in 'write_result', since both copy instructions around
+		std::vector<std::unique_ptr<reshadefx::codegen>> codegens(set.sources.size());
+		const measurement parse_result = measure([&]() {
+			for (size_t i = 0; i < set.sources.size(); ++i)
+			{
+				codegens[i].reset(reshadefx::create_codegen_spirv(true, false, false));
+				parse(set.sources[i], codegens[i].get());
+			}
+		});
+		const measurement write_result_result = measure([&]() {
+			for (const std::unique_ptr<reshadefx::codegen> &codegen : codegens)
+			{
+				reshadefx::module module;
+				codegen->write_result(module);
+			}
+		});
+
+		print_result(set.name + " (parse)", parse_result, "%8zu bytes", total_size(set.sources));
+		print_result(set.name + " (write_result)", write_result_result);
+	}
+}
+
+static void bench_hlsl()
+{
+	// Generate an effect with deeply nested control flow, since every level of it splices and indents the code of the blocks inside it
+	std::string generated;
+	for (size_t i = 0; i < 50; ++i)
+	{
+		generated += "float f" + std::to_string(i) + "(float x)\n{\n\tfloat r = x;\n";
+		for (size_t depth = 0; depth < 40; ++depth)
+		{
+			const std::string indentation(depth + 1, '\t'), level = std::to_string(depth);
+			switch (depth % 3)
+			{
+			case 0:
+				generated += indentation + "if (r > " + level + ".5) { r = sin(r) * " + level + ".25;\n";
+				break;
+			case 1:
+				generated += indentation + "for (int i" + level + " = 0; i" + level + " < 4; ++i" + level + ") { r += cos(r * i" + level + ");\n";
+				break;
+			case 2:
+				generated += indentation + "[branch] if (r < " + level + ".0) { r = r * r; } else { r = sqrt(abs(r));\n";
+				break;
+			}
+		}
+		for (size_t depth = 40; depth > 0; --depth)
+			generated += std::string(depth, '\t') + "}\n";
+		generated += "\treturn r;\n}\n";
+	}
+	append_technique(generated, "f0(position.x) + f49(position.y)");
+
+	// Report the largest effect and all effects next to the generated effect with nested control flow and the one with many definitions
+	std::vector<effect_set> sets = corpus_effect_sets();
+	sets.push_back({ "nested control flow", std::vector<std::string>(1, std::move(generated)), {} });
+	sets.push_back({ "many definitions", std::vector<std::string>(1, generate_constants_effect()), {} });
+
+	for (const effect_set &set : sets)
+	{
+		// Keep the module of every effect alive until the end, the way the runtime does with all effects it loads
+		const measurement result = measure([&]() {
+			std::vector<reshadefx::module> modules(set.sources.size());
+			for (size_t i = 0; i < set.sources.size(); ++i)
+			{
+				const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_hlsl(50, false, false));
+				parse(set.sources[i], codegen.get());
+				codegen->write_result(modules[i]);
+			}
+		});
+		print_result(set.name, result, "%8zu bytes", total_size(set.sources));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const std::pair<const char *, void(*)()> benchmarks[] = {
+		{ "lexer", bench_lexer }, // Lexer throughput on the source files and the preprocessed effects, compared to a scalar scan over the same text
+		{ "tokens", bench_tokens }, // Time and heap allocations to lex and to preprocess the largest effect and all effects
+		{ "keywords", bench_keywords }, // Keyword and preprocessor directive lookup on all identifiers and directives in the corpus, compared to a 'std::unordered_map'
+		{ "macros", bench_macros }, // Preprocessing of generated nested macro calls, of the macro-heavy headers and of all effects
+		{ "files", bench_files }, // Reading shader files and presets with and without them being in the page cache of the operating system
+		{ "scopes", bench_scopes }, // Parsing generated code with many symbols and deeply nested blocks, the largest effect and all effects
+		{ "intrinsics", bench_intrinsics }, // Parsing generated code that calls intrinsic functions in every statement
+		{ "spirv_lookups", bench_spirv_lookups }, // Generating SPIR-V for generated code with many distinct constants, array types and function signatures
+		{ "spirv", bench_spirv }, // Time and heap allocations to generate SPIR-V for the largest effect, all effects and generated code with many constants, and to write it into a module
+		{ "hlsl", bench_hlsl }, // Time, heap allocations and peak heap memory to generate HLSL for the largest effect, all effects and generated code with nested control flow and many definitions
+		{ "module_cache", bench_module_cache }, // Compiling all effects into modules compared to restoring them from their serialized form, like a cold and a warm start of the runtime
+	};
+
+	const auto benchmark = argc > 1 ? std::find_if(std::begin(benchmarks), std::end(benchmarks),
+		[name = argv[1]](const auto &entry) { return std::strcmp(entry.first, name) == 0; }) : std::end(benchmarks);
+	if (benchmark == std::end(benchmarks))
+	{
+		fprintf(stderr, "usage: %s <benchmark> [-rounds <count>] <files or directories>...\n\nBenchmarks:\n", argv[0]);
+		for (const auto &entry : benchmarks)
+			fprintf(stderr, "  %s\n", entry.first);
+		return 1;
+	}
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-rounds") == 0 && i + 1 < argc)
+			s_rounds = std::strtoul(argv[++i], nullptr, 10);
+		else
+			add_corpus(std::filesystem::u8path(argv[i]));
+	}
+
+	if (s_effects.empty() && s_headers.empty())
+		return fprintf(stderr, "error: no shader files found\n"), 1;
+
+	printf("%zu effects and %zu headers, best of %zu rounds:\n", s_effects.size(), s_headers.size(), s_rounds);
+	benchmark->second();
+
+	return 0;
+}
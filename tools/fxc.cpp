@@ -6,11 +6,16 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include "effect_preprocessor.hpp"
+#include "effect_hash.hpp"
 #include "version.h"
+#include <spirv.hpp>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 
 static void print_usage(const char *path)
 {
@@ -23,7 +28,11 @@ Options:
   -D <id>=<text>            Define a preprocessor macro.
   -I <path>                 Add directory to include search path.
   -P <path>                 Pre-process to file. If <path> is "-", then result is written to standard output instead.
+  --pch <name>              Precompile the header file with the given name (e.g. "ReShade.fxh"). A snapshot of the preprocessor state after it was included is saved and reused on later runs.
+  --pch-dir <path>          Directory to store precompiled header snapshots in. Defaults to the current directory.
 
+  -E <name>                 Only output the code the given entry point (e.g. "PS_Main" or "Namespace::PS_Main", for any shader type and code generator) references (implies --eliminate-dead-code).
+                            With --glsl or --hlsl, fails if a function the entry point does not reference was left in its code.
   -Fo <file>                Output SPIR-V binary to the given file.
   -Fe <file>                Output warnings and errors to the given file.
 
@@ -33,26 +42,348 @@ Options:
 
   --width                   Value of the 'BUFFER_WIDTH' preprocessor macro.
   --height                  Value of the 'BUFFER_HEIGHT' preprocessor macro.
+  --resolution-independent  Read 'BUFFER_WIDTH' and 'BUFFER_HEIGHT' from uniform variables wherever they do not have to be constant.
   --invert-y                Insert code to invert the Y component of the output position in vertex shaders (only applies to SPIR-V).
   --spec-constants          Convert uniform variables to specialization constants.
+  --eliminate-dead-code     Remove functions, global variables and resource declarations from the code that are not referenced by any technique (the module still lists all resources).
+  --optimize                Run optimization passes over the generated SPIR-V code.
+  --stats                   Print size and instruction count of the generated SPIR-V code.
+  --cfg                     Print the blocks, branches, merge and phi instructions and remaining function local variables of the generated SPIR-V code.
+  --validate                Validate the generated SPIR-V code with "spirv-val" (skipped if it is not found in the search path).
+  --check-serialization     Verify that the compiled module reads back unchanged from the binary representation it is cached in.
 
   -Zi                       Enable debug information.
+
+  --test <path>             Compile every "*.fx" file in the given directory with the arguments listed in its first line (e.g. "// fxc: --hlsl -E PS_Main"),
+                            and compare everything printed with the "*.expected" file next to it (e.g. "tools/fxc_tests").
 	)", path);
 }
 
-int main(int argc, char *argv[])
+// Compare every field of the module that is serialized, so that a field the writer and reader both skip is caught too (which comparing serialized bytes alone cannot do)
+template <typename T>
+static bool fields_equal(const T &lhs, const T &rhs);
+template <typename T>
+static bool fields_equal(const std::vector<T> &lhs, const std::vector<T> &rhs);
+static bool fields_equal(const reshadefx::type &lhs, const reshadefx::type &rhs);
+static bool fields_equal(const reshadefx::constant &lhs, const reshadefx::constant &rhs);
+static bool fields_equal(const reshadefx::annotation &lhs, const reshadefx::annotation &rhs);
+static bool fields_equal(const reshadefx::entry_point &lhs, const reshadefx::entry_point &rhs);
+static bool fields_equal(const reshadefx::texture_info &lhs, const reshadefx::texture_info &rhs);
+static bool fields_equal(const reshadefx::sampler_info &lhs, const reshadefx::sampler_info &rhs);
+static bool fields_equal(const reshadefx::storage_info &lhs, const reshadefx::storage_info &rhs);
+static bool fields_equal(const reshadefx::uniform_info &lhs, const reshadefx::uniform_info &rhs);
+static bool fields_equal(const reshadefx::pass_info &lhs, const reshadefx::pass_info &rhs);
+static bool fields_equal(const reshadefx::technique_info &lhs, const reshadefx::technique_info &rhs);
+
+template <typename T>
+static bool fields_equal(const T &lhs, const T &rhs)
+{
+	return lhs == rhs;
+}
+template <typename T>
+static bool fields_equal(const std::vector<T> &lhs, const std::vector<T> &rhs)
+{
+	return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(),
+		[](const T &lhs_element, const T &rhs_element) { return fields_equal(lhs_element, rhs_element); });
+}
+static bool fields_equal(const reshadefx::type &lhs, const reshadefx::type &rhs)
+{
+	return lhs == rhs && lhs.qualifiers == rhs.qualifiers; // The equality operator of types ignores qualifiers
+}
+static bool fields_equal(const reshadefx::constant &lhs, const reshadefx::constant &rhs)
+{
+	return std::memcmp(lhs.as_uint, rhs.as_uint, sizeof(lhs.as_uint)) == 0 && lhs.string_data == rhs.string_data && fields_equal(lhs.array_data, rhs.array_data);
+}
+static bool fields_equal(const reshadefx::annotation &lhs, const reshadefx::annotation &rhs)
+{
+	return fields_equal(lhs.type, rhs.type) && lhs.name == rhs.name && fields_equal(lhs.value, rhs.value);
+}
+static bool fields_equal(const reshadefx::entry_point &lhs, const reshadefx::entry_point &rhs)
+{
+	return lhs.name == rhs.name && lhs.type == rhs.type && lhs.hlsl == rhs.hlsl && lhs.spirv == rhs.spirv;
+}
+static bool fields_equal(const reshadefx::texture_info &lhs, const reshadefx::texture_info &rhs)
+{
+	return lhs.id == rhs.id && lhs.binding == rhs.binding && lhs.semantic == rhs.semantic && lhs.unique_name == rhs.unique_name && fields_equal(lhs.annotations, rhs.annotations) &&
+		lhs.width == rhs.width && lhs.height == rhs.height && lhs.levels == rhs.levels && lhs.format == rhs.format && lhs.render_target == rhs.render_target && lhs.storage_access == rhs.storage_access;
+}
+static bool fields_equal(const reshadefx::sampler_info &lhs, const reshadefx::sampler_info &rhs)
+{
+	return lhs.id == rhs.id && lhs.binding == rhs.binding && lhs.texture_binding == rhs.texture_binding && lhs.unique_name == rhs.unique_name && lhs.texture_name == rhs.texture_name && fields_equal(lhs.annotations, rhs.annotations) &&
+		lhs.filter == rhs.filter && lhs.address_u == rhs.address_u && lhs.address_v == rhs.address_v && lhs.address_w == rhs.address_w &&
+		lhs.min_lod == rhs.min_lod && lhs.max_lod == rhs.max_lod && lhs.lod_bias == rhs.lod_bias && lhs.srgb == rhs.srgb;
+}
+static bool fields_equal(const reshadefx::storage_info &lhs, const reshadefx::storage_info &rhs)
+{
+	return lhs.id == rhs.id && lhs.binding == rhs.binding && lhs.unique_name == rhs.unique_name && lhs.texture_name == rhs.texture_name;
+}
+static bool fields_equal(const reshadefx::uniform_info &lhs, const reshadefx::uniform_info &rhs)
+{
+	return lhs.name == rhs.name && fields_equal(lhs.type, rhs.type) && lhs.size == rhs.size && lhs.offset == rhs.offset && fields_equal(lhs.annotations, rhs.annotations) &&
+		lhs.has_initializer_value == rhs.has_initializer_value && fields_equal(lhs.initializer_value, rhs.initializer_value);
+}
+static bool fields_equal(const reshadefx::pass_info &lhs, const reshadefx::pass_info &rhs)
+{
+	return lhs.name == rhs.name && std::equal(std::begin(lhs.render_target_names), std::end(lhs.render_target_names), std::begin(rhs.render_target_names)) &&
+		lhs.vs_entry_point == rhs.vs_entry_point && lhs.ps_entry_point == rhs.ps_entry_point && lhs.cs_entry_point == rhs.cs_entry_point &&
+		lhs.clear_render_targets == rhs.clear_render_targets && lhs.srgb_write_enable == rhs.srgb_write_enable && lhs.blend_enable == rhs.blend_enable && lhs.stencil_enable == rhs.stencil_enable &&
+		lhs.color_write_mask == rhs.color_write_mask && lhs.stencil_read_mask == rhs.stencil_read_mask && lhs.stencil_write_mask == rhs.stencil_write_mask &&
+		lhs.blend_op == rhs.blend_op && lhs.blend_op_alpha == rhs.blend_op_alpha &&
+		lhs.src_blend == rhs.src_blend && lhs.dest_blend == rhs.dest_blend && lhs.src_blend_alpha == rhs.src_blend_alpha && lhs.dest_blend_alpha == rhs.dest_blend_alpha &&
+		lhs.stencil_comparison_func == rhs.stencil_comparison_func && lhs.stencil_reference_value == rhs.stencil_reference_value &&
+		lhs.stencil_op_pass == rhs.stencil_op_pass && lhs.stencil_op_fail == rhs.stencil_op_fail && lhs.stencil_op_depth_fail == rhs.stencil_op_depth_fail &&
+		lhs.num_vertices == rhs.num_vertices && lhs.topology == rhs.topology &&
+		lhs.viewport_width == rhs.viewport_width && lhs.viewport_height == rhs.viewport_height && lhs.viewport_dispatch_z == rhs.viewport_dispatch_z &&
+		fields_equal(lhs.samplers, rhs.samplers) && fields_equal(lhs.storages, rhs.storages);
+}
+static bool fields_equal(const reshadefx::technique_info &lhs, const reshadefx::technique_info &rhs)
+{
+	return lhs.name == rhs.name && fields_equal(lhs.passes, rhs.passes) && fields_equal(lhs.annotations, rhs.annotations);
+}
+
+static bool check_module_serialization(const reshadefx::module &module)
+{
+	// Serializing a module again after reading it back has to reproduce the same data, otherwise writer and reader disagree on the format
+	std::string data, data_round_trip;
+	reshadefx::module module_round_trip;
+	reshadefx::serialize_module(module, data);
+	if (!reshadefx::deserialize_module(data, module_round_trip))
+		return std::cout << "error: Serialized module could not be read back" << std::endl, false;
+	reshadefx::serialize_module(module_round_trip, data_round_trip);
+	if (data != data_round_trip)
+		return std::cout << "error: Serialized module changed after reading it back (" << data.size() << " vs. " << data_round_trip.size() << " bytes)" << std::endl, false;
+
+	const std::pair<const char *, bool> fields[] = {
+		{ "hlsl", module.hlsl == module_round_trip.hlsl },
+		{ "spirv", module.spirv == module_round_trip.spirv },
+		{ "entry_points", fields_equal(module.entry_points, module_round_trip.entry_points) },
+		{ "textures", fields_equal(module.textures, module_round_trip.textures) },
+		{ "samplers", fields_equal(module.samplers, module_round_trip.samplers) },
+		{ "storages", fields_equal(module.storages, module_round_trip.storages) },
+		{ "uniforms", fields_equal(module.uniforms, module_round_trip.uniforms) },
+		{ "spec_constants", fields_equal(module.spec_constants, module_round_trip.spec_constants) },
+		{ "techniques", fields_equal(module.techniques, module_round_trip.techniques) },
+		{ "total_uniform_size", module.total_uniform_size == module_round_trip.total_uniform_size },
+		{ "num_texture_bindings", module.num_texture_bindings == module_round_trip.num_texture_bindings },
+		{ "num_sampler_bindings", module.num_sampler_bindings == module_round_trip.num_sampler_bindings },
+		{ "num_storage_bindings", module.num_storage_bindings == module_round_trip.num_storage_bindings },
+	};
+	for (const auto &[field_name, equal] : fields)
+		if (!equal)
+			return std::cout << "error: Module field '" << field_name << "' is different after reading it back from its serialized form" << std::endl, false;
+
+	// The serialized form of a module with one default element of every kind identifies the format, so it may only change together with the magic at the start
+	// Add an entry for the new magic to this list when it is increased after a format change
+	static const std::pair<std::string_view, std::string_view> known_formats[] = {
+		{ "RFXMOD01", "13c487e72548e58609f3fa688b78a65f" },
+	};
+
+	reshadefx::module reference;
+	reference.entry_points.emplace_back();
+	reference.textures.emplace_back().annotations.emplace_back().value.array_data.emplace_back();
+	reference.samplers.emplace_back();
+	reference.storages.emplace_back();
+	reference.uniforms.emplace_back();
+	reference.spec_constants.emplace_back();
+	reshadefx::technique_info &technique = reference.techniques.emplace_back();
+	reshadefx::pass_info &pass = technique.passes.emplace_back();
+	pass.samplers.emplace_back();
+	pass.storages.emplace_back();
+
+	std::string reference_data;
+	reshadefx::serialize_module(reference, reference_data);
+
+	const std::string_view magic = std::string_view(reference_data).substr(0, 8);
+	const std::string fingerprint = reshadefx::hash(reference_data).to_string();
+
+	const auto known_format = std::find_if(std::begin(known_formats), std::end(known_formats),
+		[magic](const auto &format) { return format.first == magic; });
+	if (known_format == std::end(known_formats) || known_format->second != fingerprint)
+		return std::cout << "error: Serialized module format " << fingerprint << " does not match the one known for magic '" << magic << "', increase 's_module_magic' and add it to the list of known formats" << std::endl, false;
+
+	return true;
+}
+
+static std::string collapse_underscores(std::string name)
+{
+	for (size_t pos = 0; (pos = name.find("__", pos)) != std::string::npos;)
+		name.erase(pos, 1);
+	return name;
+}
+
+static bool contains_identifier(std::string_view code, std::string_view name)
+{
+	const auto is_identifier_char = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; };
+
+	for (size_t pos = 0; (pos = code.find(name, pos)) != std::string_view::npos; pos += name.size())
+		if ((pos == 0 || !is_identifier_char(code[pos - 1])) && (pos + name.size() == code.size() || !is_identifier_char(code[pos + name.size()])))
+			return true;
+	return false;
+}
+
+static bool check_eliminated_functions(const reshadefx::codegen &backend, const reshadefx::entry_point &entry_point)
+{
+	// Every function the entry point does not reference has to be missing from its code, otherwise dead code elimination kept it
+	// Compare without duplicated underscores, since some code generators remove them from names (e.g. GLSL)
+	const std::string code = collapse_underscores(entry_point.hlsl);
+	for (const std::unique_ptr<reshadefx::function_info> &function : backend.functions())
+		if (!function->unique_name.empty() && !backend.is_referenced_by_entry_point(entry_point.name, function->definition) && contains_identifier(code, collapse_underscores(function->unique_name)))
+			return std::cout << "error: Function '" << function->name << "' is not referenced by entry point '" << entry_point.name << "', but was not eliminated from its code" << std::endl, false;
+	return true;
+}
+
+static bool is_entry_point_for_function(const reshadefx::entry_point &entry_point, const std::string &function_name)
+{
+	// Some code generators remove duplicated underscores from names (e.g. GLSL), so compare without them
+	const std::string entry_point_name = collapse_underscores(entry_point.name);
+	if (entry_point_name == function_name)
+		return true;
+
+	// Code generators prefix the function name with 'E' when they generate a new function for the entry point (e.g. in shader model 3 or for compute shaders)
+	std::string_view name = entry_point_name;
+	if (name.size() <= function_name.size() || name[0] != 'E' || name.compare(1, function_name.size(), function_name) != 0)
+		return false;
+	name.remove_prefix(1 + function_name.size());
+
+	// Compute shader entry points are suffixed with their thread group size (e.g. "_8_8_1")
+	if (entry_point.type == reshadefx::shader_type::cs)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (name.size() < 2 || name[0] != '_' || name[1] < '0' || name[1] > '9')
+				return false;
+			name.remove_prefix(std::min(name.find_first_not_of("0123456789", 1), name.size()));
+		}
+	}
+
+	return name.empty();
+}
+
+static void print_control_flow(const std::vector<uint32_t> &spirv)
+{
+	// Only the instructions that make up the control flow and the remaining function local variables are printed, everything else is left out
+	// Number IDs in the order they are first printed, so that the output does not change when unrelated code allocates more of them
+	std::unordered_map<uint32_t, size_t> ids;
+	const auto id = [&ids](uint32_t id) {
+		return '%' + std::to_string(ids.emplace(id, ids.size()).first->second);
+	};
+
+	for (size_t offset = 5, word_count; offset < spirv.size(); offset += word_count)
+	{
+		const uint32_t *const op = spirv.data() + offset;
+		word_count = std::max<size_t>(op[0] >> spv::WordCountShift, 1);
+		if (offset + word_count > spirv.size())
+			break;
+
+		switch (op[0] & spv::OpCodeMask)
+		{
+		case spv::OpFunction:
+			std::cout << "function " << id(op[2]) << std::endl;
+			break;
+		case spv::OpFunctionEnd:
+			std::cout << "function_end" << std::endl;
+			break;
+		case spv::OpLabel:
+			std::cout << "  " << id(op[1]) << ':' << std::endl;
+			break;
+		case spv::OpVariable:
+			if (op[3] == spv::StorageClassFunction)
+				std::cout << "    " << id(op[2]) << " = variable" << std::endl;
+			break;
+		case spv::OpPhi:
+			std::cout << "    " << id(op[2]) << " = phi";
+			for (size_t i = 3; i + 1 < word_count; i += 2)
+				std::cout << (i != 3 ? ", " : " ") << id(op[i]) << " from " << id(op[i + 1]);
+			std::cout << std::endl;
+			break;
+		case spv::OpLoopMerge:
+			std::cout << "    loop_merge " << id(op[1]) << " continue " << id(op[2]) << std::endl;
+			break;
+		case spv::OpSelectionMerge:
+			std::cout << "    selection_merge " << id(op[1]) << std::endl;
+			break;
+		case spv::OpBranch:
+			std::cout << "    branch " << id(op[1]) << std::endl;
+			break;
+		case spv::OpBranchConditional:
+			std::cout << "    branch_conditional " << id(op[1]) << ' ' << id(op[2]) << ' ' << id(op[3]) << std::endl;
+			break;
+		case spv::OpSwitch:
+			std::cout << "    switch " << id(op[1]) << " default " << id(op[2]);
+			for (size_t i = 3; i + 1 < word_count; i += 2)
+				std::cout << ", " << op[i] << ' ' << id(op[i + 1]);
+			std::cout << std::endl;
+			break;
+		case spv::OpKill:
+			std::cout << "    kill" << std::endl;
+			break;
+		case spv::OpReturn:
+			std::cout << "    return" << std::endl;
+			break;
+		case spv::OpReturnValue:
+			std::cout << "    return " << id(op[1]) << std::endl;
+			break;
+		case spv::OpUnreachable:
+			std::cout << "    unreachable" << std::endl;
+			break;
+		}
+	}
+}
+
+static bool is_spirv_val_available()
+{
+	static const bool available = std::system(
+#ifdef _WIN32
+		"spirv-val --version > NUL 2>&1"
+#else
+		"spirv-val --version > /dev/null 2>&1"
+#endif
+		) == 0;
+	return available;
+}
+static bool validate_spirv(const std::vector<uint32_t> &spirv)
+{
+	// Validation is skipped when the tool cannot be found, so that tests still run on machines without the SPIR-V tools installed
+	if (!is_spirv_val_available())
+		return true;
+
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "fxc_validate.spv";
+	std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(spirv.data()), spirv.size() * sizeof(uint32_t));
+
+	const std::string command = "spirv-val \"" + path.u8string() + '\"';
+	const bool valid = std::system(command.c_str()) == 0;
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+
+	if (!valid)
+		std::cout << "error: spirv-val rejected the generated SPIR-V code" << std::endl;
+	return valid;
+}
+
+static int compile(int argc, char *argv[])
 {
 	const char *filename = nullptr;
 	const char *preprocess = nullptr;
 	const char *errorfile = nullptr;
 	const char *objectfile = nullptr;
+	const char *entry_point_name = nullptr;
 	const char *buffer_width = "800";
 	const char *buffer_height = "600";
+	const char *pch_directory = ".";
+	std::vector<const char *> pch_headers;
 	bool print_glsl = false;
 	bool print_hlsl = false;
 	bool debug_info = false;
 	bool invert_y_axis = false;
 	bool spec_constants = false;
+	bool eliminate_dead_code = false;
+	bool optimize = false;
+	bool print_stats = false;
+	bool print_cfg = false;
+	bool validate = false;
+	bool resolution_independent = false;
+	bool check_serialization = false;
 	unsigned int shader_model = 50;
 
 	reshadefx::parser parser;
@@ -101,6 +432,20 @@ int main(int argc, char *argv[])
 				invert_y_axis = true;
 			else if (0 == std::strcmp(arg, "--spec-constants"))
 				spec_constants = true;
+			else if (0 == std::strcmp(arg, "--eliminate-dead-code"))
+				eliminate_dead_code = true;
+			else if (0 == std::strcmp(arg, "--optimize"))
+				optimize = true;
+			else if (0 == std::strcmp(arg, "--stats"))
+				print_stats = true;
+			else if (0 == std::strcmp(arg, "--cfg"))
+				print_cfg = true;
+			else if (0 == std::strcmp(arg, "--validate"))
+				validate = true;
+			else if (0 == std::strcmp(arg, "--resolution-independent"))
+				resolution_independent = true;
+			else if (0 == std::strcmp(arg, "--check-serialization"))
+				check_serialization = true;
 
 			if (i + 1 >= argc)
 				continue;
@@ -110,12 +455,18 @@ int main(int argc, char *argv[])
 				errorfile = argv[++i];
 			else if (0 == std::strcmp(arg, "-Fo"))
 				objectfile = argv[++i];
+			else if (0 == std::strcmp(arg, "-E"))
+				entry_point_name = argv[++i], eliminate_dead_code = true;
 			else if (0 == std::strcmp(arg, "--shader-model"))
 				shader_model = std::strtol(argv[++i], nullptr, 10);
 			else if (0 == std::strcmp(arg, "--width"))
 				buffer_width = argv[++i];
 			else if (0 == std::strcmp(arg, "--height"))
 				buffer_height = argv[++i];
+			else if (0 == std::strcmp(arg, "--pch"))
+				pch_headers.push_back(argv[++i]);
+			else if (0 == std::strcmp(arg, "--pch-dir"))
+				pch_directory = argv[++i];
 		}
 		else
 		{
@@ -135,11 +486,30 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	pp.add_macro_definition("BUFFER_WIDTH", buffer_width);
-	pp.add_macro_definition("BUFFER_HEIGHT", buffer_height);
+	if (resolution_independent)
+	{
+		const int width = std::atoi(buffer_width), height = std::atoi(buffer_height);
+		pp.add_runtime_constant("__RESHADE_BUFFER_WIDTH__", width);
+		pp.add_runtime_constant("__RESHADE_BUFFER_HEIGHT__", height);
+		pp.add_macro_definition("BUFFER_WIDTH", "__RESHADE_BUFFER_WIDTH__");
+		pp.add_macro_definition("BUFFER_HEIGHT", "__RESHADE_BUFFER_HEIGHT__");
+		parser.add_runtime_constant("__RESHADE_BUFFER_WIDTH__", width, "bufwidth");
+		parser.add_runtime_constant("__RESHADE_BUFFER_HEIGHT__", height, "bufheight");
+	}
+	else
+	{
+		pp.add_macro_definition("BUFFER_WIDTH", buffer_width);
+		pp.add_macro_definition("BUFFER_HEIGHT", buffer_height);
+	}
 	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
 	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
 
+	for (const char *header : pch_headers)
+		pp.add_precompiled_header(header, std::filesystem::u8path(pch_directory));
+
+	// Pass tokens directly from the preprocessor to the parser, unless only the preprocessed text is requested
+	pp.set_token_output(preprocess == nullptr);
+
 	if (!pp.append_file(filename))
 	{
 		if (errorfile == nullptr)
@@ -151,6 +521,10 @@ int main(int argc, char *argv[])
 
 	if (preprocess != nullptr)
 	{
+		const auto include_cache_stats = reshadefx::preprocessor::include_cache_stats();
+		fprintf(stderr, "%zu include files read from disk, %zu reused from cache, %zu skipped because of include guards, %zu restored from precompiled headers\n",
+			include_cache_stats.misses, include_cache_stats.hits, pp.skipped_includes(), pp.restored_snapshots());
+
 		if (std::strcmp(preprocess, "-") == 0)
 			std::cout << pp.output() << std::endl;
 		else
@@ -160,13 +534,13 @@ int main(int argc, char *argv[])
 
 	std::unique_ptr<reshadefx::codegen> backend;
 	if (print_glsl)
-		backend.reset(reshadefx::create_codegen_glsl(debug_info, spec_constants));
+		backend.reset(reshadefx::create_codegen_glsl(debug_info, spec_constants, false, false, eliminate_dead_code));
 	else if (print_hlsl)
-		backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, spec_constants));
+		backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, spec_constants, eliminate_dead_code));
 	else
-		backend.reset(reshadefx::create_codegen_spirv(true, debug_info, spec_constants, invert_y_axis));
+		backend.reset(reshadefx::create_codegen_spirv(true, debug_info, spec_constants, false, invert_y_axis, eliminate_dead_code, optimize));
 
-	if (!parser.parse(pp.output(), backend.get()))
+	if (!parser.parse(std::move(pp.output_tokens()), backend.get()))
 	{
 		if (errorfile == nullptr)
 			std::cout << pp.errors() << parser.errors() << std::endl;
@@ -175,9 +549,75 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	// The runtime has to preprocess or compile effects again when the resolution changes if either baked the buffer dimensions in
+	if (resolution_independent)
+		std::cerr << "Buffer dimensions evaluated by the preprocessor: " << (pp.runtime_constants_evaluated() ? "yes" : "no") << ", baked into the module: " << (parser.runtime_constants_evaluated() ? "yes" : "no") << std::endl;
+
 	reshadefx::module module;
 	backend->write_result(module);
 
+	if (check_serialization && !check_module_serialization(module))
+		return 1;
+
+	if (entry_point_name != nullptr)
+	{
+		// Look for an entry point with exactly that name first, then for the entry points generated for a function with that (optionally namespace qualified) name
+		std::vector<reshadefx::entry_point *> matches;
+		for (reshadefx::entry_point &ep : module.entry_points)
+			if (ep.name == entry_point_name)
+				matches.push_back(&ep);
+
+		if (matches.empty())
+		{
+			// Build the unique name of the function the same way the parser does
+			std::string function_name = entry_point_name;
+			if (function_name.compare(0, 2, "::") != 0)
+				function_name.insert(0, "::");
+			function_name.insert(0, 1, 'F');
+			std::replace(function_name.begin(), function_name.end(), ':', '_');
+			function_name = collapse_underscores(std::move(function_name));
+
+			for (reshadefx::entry_point &ep : module.entry_points)
+				if (is_entry_point_for_function(ep, function_name))
+					matches.push_back(&ep);
+		}
+
+		if (matches.size() != 1)
+		{
+			std::cout << "error: Entry point '" << entry_point_name << (matches.empty() ? "' not found" : "' is ambiguous") << ", use one of:";
+			for (const reshadefx::entry_point &ep : module.entry_points)
+				if (matches.empty() || std::find(matches.begin(), matches.end(), &ep) != matches.end())
+					std::cout << ' ' << ep.name;
+			std::cout << std::endl;
+			return 1;
+		}
+
+		reshadefx::entry_point *const entry_point = matches.front();
+
+		if ((print_glsl || print_hlsl) && !check_eliminated_functions(*backend, *entry_point))
+			return 1;
+
+		// Replace the whole module code with the code of only that entry point
+		module.hlsl = std::move(entry_point->hlsl);
+		module.spirv = std::move(entry_point->spirv);
+	}
+
+	if (print_stats && !module.spirv.empty())
+	{
+		// Walk the instruction stream after the header, the high 16 bits of the first word of every instruction are its word count
+		size_t num_instructions = 0;
+		for (size_t offset = 5; offset < module.spirv.size(); offset += module.spirv[offset] >> 16)
+			num_instructions++;
+
+		std::cerr << module.spirv.size() * sizeof(uint32_t) << " bytes (" << module.spirv.size() << " words), " << num_instructions << " instructions" << std::endl;
+	}
+
+	if (validate && !module.spirv.empty() && !validate_spirv(module.spirv))
+		return 1;
+
+	if (print_cfg && !module.spirv.empty())
+		print_control_flow(module.spirv);
+
 	if (print_glsl || print_hlsl)
 	{
 		std::cout << module.hlsl << std::endl;
@@ -190,3 +630,96 @@ int main(int argc, char *argv[])
 
 	return 0;
 }
+
+static bool run_test(const char *path, const std::filesystem::path &test_path)
+{
+	// The first line of a test lists the arguments to compile it with, e.g. "// fxc: --hlsl -E PS_Main"
+	std::ifstream test_file(test_path);
+	std::string arguments_line;
+	if (!std::getline(test_file, arguments_line) || arguments_line.compare(0, 8, "// fxc: ") != 0)
+		return std::cout << "error: " << test_path.u8string() << " does not start with a '// fxc: <arguments>' line" << std::endl, false;
+	if (arguments_line.back() == '\r')
+		arguments_line.pop_back();
+
+	std::vector<std::string> arguments = { path };
+	for (size_t begin = 8, end; begin < arguments_line.size(); begin = end + 1)
+	{
+		end = std::min(arguments_line.find(' ', begin), arguments_line.size());
+		if (end != begin)
+			arguments.push_back(arguments_line.substr(begin, end - begin));
+	}
+	arguments.push_back(test_path.u8string());
+
+	std::vector<char *> argv;
+	for (std::string &argument : arguments)
+		argv.push_back(argument.data());
+
+	// Compile with everything written to the standard output and error streams going into a string instead
+	std::stringstream output;
+	std::streambuf *const cout_buffer = std::cout.rdbuf(output.rdbuf());
+	std::streambuf *const cerr_buffer = std::cerr.rdbuf(output.rdbuf());
+	const int result = compile(static_cast<int>(argv.size()), argv.data());
+	std::cout.rdbuf(cout_buffer);
+	std::cerr.rdbuf(cerr_buffer);
+
+	if (result != 0)
+		output << "exit code " << result << std::endl;
+
+	// Compare with the expected output line by line, so that differences in line endings do not matter
+	std::filesystem::path expected_path = test_path;
+	expected_path.replace_extension(".expected");
+	std::ifstream expected_file(expected_path);
+	if (!expected_file)
+		return std::cout << "error: " << expected_path.u8string() << " not found" << std::endl, false;
+
+	std::string expected_line, actual_line;
+	for (size_t line = 1; true; ++line)
+	{
+		const bool has_expected_line = !!std::getline(expected_file, expected_line);
+		const bool has_actual_line = !!std::getline(output, actual_line);
+		if (!has_expected_line && !has_actual_line)
+			return true;
+
+		if (!expected_line.empty() && expected_line.back() == '\r')
+			expected_line.pop_back();
+
+		if (has_expected_line != has_actual_line || expected_line != actual_line)
+		{
+			std::cout << "error: " << test_path.u8string() << '(' << line << "): output differs from " << expected_path.filename().u8string() << ":\n"
+				<< "  expected: " << (has_expected_line ? expected_line : "<end of file>") << "\n"
+				<< "  actual:   " << (has_actual_line ? actual_line : "<end of file>") << std::endl;
+			return false;
+		}
+	}
+}
+
+static int run_tests(const char *path, const std::filesystem::path &test_directory)
+{
+	std::vector<std::filesystem::path> test_paths;
+	std::error_code ec;
+	for (const auto &entry : std::filesystem::directory_iterator(test_directory, ec))
+		if (entry.path().extension() == ".fx")
+			test_paths.push_back(entry.path());
+	std::sort(test_paths.begin(), test_paths.end());
+
+	if (test_paths.empty())
+		return std::cout << "error: No tests found in " << test_directory.u8string() << std::endl, 1;
+
+	size_t num_failed = 0;
+	for (const std::filesystem::path &test_path : test_paths)
+		if (!run_test(path, test_path))
+			num_failed++;
+
+	std::cout << test_paths.size() - num_failed << " of " << test_paths.size() << " tests passed" << std::endl;
+	if (!is_spirv_val_available())
+		std::cout << "note: spirv-val was not found, so tests with --validate did not validate their SPIR-V code" << std::endl;
+	return num_failed != 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc == 3 && 0 == std::strcmp(argv[1], "--test"))
+		return run_tests(argv[0], std::filesystem::u8path(argv[2]));
+
+	return compile(argc, argv);
+}
@@ -0,0 +1,4 @@
+// fxc: --optimize --validate --cfg -E PS_ControlFlow
+// Local variables are promoted to phi instructions at the merge blocks of branches and in loop headers, and blocks without branches in between are merged, compared to "control_flow_disabled.fx", which compiles the same effect without optimization.
+
+#include "control_flow.fxh"
@@ -0,0 +1,4 @@
+// fxc: --validate --cfg -E PS_ControlFlow
+// The control flow of the SPIR-V code without optimization, to compare "control_flow.fx" against.
+
+#include "control_flow.fxh"
@@ -0,0 +1,61 @@
+// fxc: --hlsl --shader-model 30 -E VS_PostProcess
+// Shader model 3 generates a new function for every entry point, which -E has to find from the name of the original function.
+
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+
+texture HorizontalTex { Width = 800; Height = 600; Format = RGBA8; };
+sampler Horizontal { Texture = HorizontalTex; };
+
+float Weight(int offset)
+{
+	return 1.0 / (1 + abs(offset));
+}
+float4 Sample(sampler s, float2 texcoord, float2 offset)
+{
+	return tex2D(s, texcoord + offset);
+}
+float4 Unused(float2 texcoord)
+{
+	return tex2D(Horizontal, texcoord) * 2.0;
+}
+
+void VS_PostProcess(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+namespace Blur
+{
+	float4 PS_Horizontal(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+	{
+		float4 color = 0.0;
+		for (int i = -2; i <= 2; i++)
+			color += Sample(BackBuffer, texcoord, float2(i / 800.0, 0.0)) * Weight(i);
+		return color;
+	}
+	float4 PS_Vertical(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+	{
+		float4 color = 0.0;
+		for (int i = -2; i <= 2; i++)
+			color += Sample(Horizontal, texcoord, float2(0.0, i / 600.0)) * Weight(i);
+		return color;
+	}
+}
+
+technique Blur
+{
+	pass
+	{
+		VertexShader = VS_PostProcess;
+		PixelShader = Blur::PS_Horizontal;
+		RenderTarget = HorizontalTex;
+	}
+	pass
+	{
+		VertexShader = VS_PostProcess;
+		PixelShader = Blur::PS_Vertical;
+	}
+}
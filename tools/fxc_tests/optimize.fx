@@ -0,0 +1,4 @@
+// fxc: --optimize --validate --stats
+// Optimizing the SPIR-V code has to reduce its size compared to "optimize_disabled.fx", which compiles the same effect without.
+
+#include "optimize.fxh"
@@ -0,0 +1,4 @@
+// fxc: --validate --stats
+// The size of the SPIR-V code without optimization, to compare "optimize.fx" against.
+
+#include "optimize.fxh"
@@ -0,0 +1,54 @@
+// fxc: --hlsl --resolution-independent --width 1920 --height 1080
+// Where a constant is required, the current resolution is baked in. Code inside functions reads it from the 'bufwidth' and 'bufheight' uniform variables instead.
+
+#if BUFFER_WIDTH > 1280
+	#define TAPS 3
+#else
+	#define TAPS 1
+#endif
+
+static const int HalfWidth = BUFFER_WIDTH / 2;
+static const float2 PixelSize = float2(BUFFER_RCP_WIDTH, BUFFER_RCP_HEIGHT);
+static const float Offsets[BUFFER_WIDTH / 960] = { 0.0, 1.5 };
+
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+
+texture HalfTex { Width = HalfWidth; Height = BUFFER_HEIGHT / 2; Format = RGBA8; };
+sampler Half { Texture = HalfTex; };
+
+void VS_PostProcess(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+float4 PS_Downsample(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	float4 color = 0.0;
+	for (int i = 0; i < TAPS; i++)
+		color += tex2D(BackBuffer, texcoord + float2(i * PixelSize.x, Offsets[1] * PixelSize.y));
+	return color / TAPS;
+}
+float4 PS_Upsample(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	float weights[BUFFER_HEIGHT / 540] = { 0.75, 0.25 };
+	const float aspect = float(BUFFER_WIDTH) / BUFFER_HEIGHT;
+	return tex2D(Half, texcoord) * weights[0] + tex2D(Half, texcoord + float2(0.0, aspect / HalfWidth)) * weights[1];
+}
+
+technique Rescale
+{
+	pass
+	{
+		VertexShader = VS_PostProcess;
+		PixelShader = PS_Downsample;
+		RenderTarget = HalfTex;
+	}
+	pass
+	{
+		VertexShader = VS_PostProcess;
+		PixelShader = PS_Upsample;
+	}
+}
@@ -0,0 +1,29 @@
+// fxc: --hlsl --resolution-independent --width 1920 --height 1080
+// The buffer dimensions are only read in code here (also through a global constant), so neither the preprocessed source nor the module depends on them and both can be reused after a resolution change.
+
+static const float2 PixelSize = float2(BUFFER_RCP_WIDTH, BUFFER_RCP_HEIGHT);
+
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+
+void VS_PostProcess(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+float4 PS_Blur(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	const float aspect = float(BUFFER_WIDTH) / BUFFER_HEIGHT;
+	return (tex2D(BackBuffer, texcoord - PixelSize) + tex2D(BackBuffer, texcoord + PixelSize * aspect)) * 0.5;
+}
+
+technique Blur
+{
+	pass
+	{
+		VertexShader = VS_PostProcess;
+		PixelShader = PS_Blur;
+	}
+}
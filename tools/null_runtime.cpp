@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Standalone driver for the null runtime, which loads the effects from a shader directory with the techniques of a preset enabled and presents a fixed number of frames.
+// This is the same as running the test application with "-null", but does not depend on anything Windows specific, so can be used to profile on other platforms too.
+// Build it together with the runtime core and the effect compiler (after generating "res/version.h" with "tools/verbuild.ps1" and checking out the submodules), e.g.:
+//   g++ -std=c++17 -O2 -pthread -DRESHADE_GUI=0 -Isource -Ires -Ideps/stb -Ideps/stb_image_dds -Ideps/spirv/include/spirv/unified1 tools/null_runtime.cpp source/runtime.cpp source/runtime_null.cpp source/runtime_platform.cpp source/runtime_update_check.cpp source/input.cpp source/input_freepie.cpp source/dll_config.cpp source/dll_log.cpp source/task_pool.cpp source/effect_*.cpp -x c deps/stb_impl.c -o null_runtime
+// And run it on a shader directory (with "Shaders" and "Textures" subdirectories) and a preset listing the techniques to enable:
+//   ./null_runtime setup/Config/reshade-shaders ReShadePreset.ini -frames 1000
+// With "-reload <interval>" one effect after another is reloaded every that many frames, while the previous ones may still be compiling on the worker threads.
+// With "-reload-all <count>" all effects are loaded again that many times as soon as the previous load finished, to benchmark 'load_effect' over the whole shader directory, e.g.:
+//   ./null_runtime reshade-shaders ReShadePreset.ini -frames 0 -reload-all 20 -nocache
+
+#include "dll_log.hpp"
+#include "dll_config.hpp"
+#include "runtime_null.hpp"
+#include "runtime_objects.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+std::filesystem::path g_reshade_dll_path;
+std::filesystem::path g_reshade_base_path;
+std::filesystem::path g_target_executable_path;
+volatile long g_network_traffic = 0; // Normally counted by the network hooks, which are not part of this build
+
+// Makes reloading accessible, which is otherwise only triggered by the GUI or a shortcut
+class null_runtime : public reshade::null::runtime_null
+{
+public:
+	using runtime::reload_effect;
+	using runtime::reload_effects;
+	using runtime::is_loading;
+
+	size_t num_effects() const { return _effects.size(); }
+};
+
+static void print_stage(const char *name, const reshade::null::runtime_null::stage_statistics &stage)
+{
+	using namespace std::chrono;
+	printf("  %-16s %8zu calls, %10.3f ms in total, %8lld us on average, %8lld us at most\n", name, stage.count,
+		duration_cast<microseconds>(stage.total).count() / 1000.0,
+		static_cast<long long>(stage.count != 0 ? duration_cast<microseconds>(stage.total).count() / stage.count : 0),
+		static_cast<long long>(duration_cast<microseconds>(stage.max).count()));
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <shader directory> <preset> [-frames <count>] [-size <width> <height>] [-nocache] [-cache <directory>] [-reload <interval>] [-reload-all <count>]\n", argv[0]);
+		return 1;
+	}
+
+	unsigned long num_frames = 1000;
+	unsigned int width = 1920, height = 1080;
+	unsigned long reload_interval = 0;
+	unsigned long reload_all_count = 0;
+	bool no_effect_cache = false;
+
+	std::error_code ec;
+	std::filesystem::path shader_path = std::filesystem::absolute(argv[1], ec);
+	std::filesystem::path preset_path = std::filesystem::absolute(argv[2], ec);
+	std::filesystem::path cache_path = std::filesystem::temp_directory_path(ec) / "reshade-null-runtime";
+
+	for (int i = 3; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			num_frames = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc)
+			width = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10)),
+			height = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "-nocache") == 0)
+			no_effect_cache = true;
+		else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc)
+			cache_path = std::filesystem::absolute(argv[++i], ec);
+		else if (strcmp(argv[i], "-reload") == 0 && i + 1 < argc)
+			reload_interval = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-reload-all") == 0 && i + 1 < argc)
+			reload_all_count = strtoul(argv[++i], nullptr, 10);
+		else
+			return fprintf(stderr, "error: unknown argument '%s'\n", argv[i]), 1;
+	}
+
+	// The configuration and log file are kept next to the effect cache, so that nothing is written to the shader directory
+	std::filesystem::create_directories(cache_path, ec);
+	if (ec)
+		return fprintf(stderr, "error: could not create directory '%s'\n", cache_path.u8string().c_str()), 1;
+
+	g_reshade_dll_path = cache_path / "ReShade.dll";
+	g_reshade_base_path = cache_path;
+	g_target_executable_path = std::filesystem::absolute(argv[0], ec);
+
+	reshade::log::open_log_file(cache_path / "ReShade.log");
+
+	{	reshade::ini_file &config = reshade::ini_file::load_cache(cache_path / "ReShade.ini");
+		config.set("GENERAL", "EffectSearchPaths", std::vector<std::filesystem::path> { shader_path, shader_path / "Shaders" });
+		config.set("GENERAL", "TextureSearchPaths", std::vector<std::filesystem::path> { shader_path, shader_path / "Textures" });
+		config.set("GENERAL", "IntermediateCachePath", cache_path);
+		config.set("GENERAL", "PresetPath", preset_path);
+		config.set("GENERAL", "NoEffectCache", no_effect_cache);
+		config.set("GENERAL", "NoReloadOnInit", false);
+		config.set("GENERAL", "SkipLoadingDisabledEffects", false);
+		reshade::ini_file::flush_cache();
+	}
+
+	// There is no window, but the input manager still needs a unique handle to associate the runtime with
+	static int window = 0;
+
+	const auto time_init_started = std::chrono::high_resolution_clock::now();
+	null_runtime runtime;
+	if (!runtime.on_init(&window, width, height))
+		return fprintf(stderr, "error: failed to initialize the null runtime\n"), 1;
+	const auto init_duration = std::chrono::high_resolution_clock::now() - time_init_started;
+
+	size_t num_reloads = 0, num_full_reloads = 0;
+	// Keep presenting past the requested number of frames until all full reloads finished, since each one is only measured once the last effect was added
+	for (unsigned long frame = 0; frame < num_frames || num_full_reloads < reload_all_count || (reload_all_count != 0 && runtime.is_loading()); ++frame)
+	{
+		runtime.on_present();
+
+		if (frame == 0 || runtime.is_loading())
+			continue;
+
+		if (num_full_reloads < reload_all_count)
+			runtime.reload_effects(), num_full_reloads++;
+		else if (reload_interval != 0 && frame % reload_interval == 0 && runtime.num_effects() != 0)
+			runtime.reload_effect(num_reloads++ % runtime.num_effects());
+	}
+
+	const reshade::null::runtime_null::statistics &stats = runtime.stats();
+	printf("Presented %zu frames at %ux%u with the null runtime, which took %lld ms to initialize:\n", stats.present.count, width, height,
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(init_duration).count()));
+	print_stage("present", stats.present);
+	print_stage("load_effects", stats.load_effects);
+	print_stage("compile_effect", stats.compile_effect);
+	print_stage("init_effect", stats.init_effect);
+	print_stage("init_texture", stats.init_texture);
+	print_stage("upload_texture", stats.upload_texture);
+	print_stage("render_technique", stats.render_technique);
+	if (num_reloads != 0)
+		printf("  %zu effects reloaded\n", num_reloads);
+	if (num_full_reloads != 0)
+		printf("  %zu effects loaded %zu times (the first load is included in 'load_effects')\n", runtime.num_effects(), num_full_reloads + 1);
+	printf("  %zu passes rendered, %zu of them in the last frame, %zu KiB of texture memory in use\n", stats.num_passes, runtime.recorded_passes().size(), stats.texture_memory / 1024);
+	printf("See '%s' for any errors and warnings\n", (cache_path / "ReShade.log").u8string().c_str());
+
+	runtime.on_reset();
+
+	return 0;
+}
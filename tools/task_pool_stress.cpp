@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Stress test and benchmark for the task pool used to load effects, which does not depend on anything Windows specific.
+// Build it together with the pool, optionally with a sanitizer enabled, e.g.:
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread -Isource tools/task_pool_stress.cpp source/task_pool.cpp -o task_pool_stress
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread -Isource tools/task_pool_stress.cpp source/task_pool.cpp -o task_pool_stress
+
+#include "task_pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+static std::atomic<bool> s_failed = false; // Set from worker threads too
+
+static void check(bool condition, const char *message, size_t num_threads)
+{
+	if (condition)
+		return;
+
+	fprintf(stderr, "error: %s (with %zu worker threads)\n", message, num_threads);
+	s_failed = true;
+}
+
+// Burn a varying amount of time, so that workers finish their tasks out of order and have to steal from each other
+static void spin(size_t amount)
+{
+	volatile size_t value = 0;
+	for (size_t i = 0; i < (amount % 7) * 200; ++i)
+		value = value + i;
+}
+
+static void run_round(size_t num_threads)
+{
+	const size_t num_tasks = 2000;
+	const auto counters = std::make_unique<std::atomic<unsigned int>[]>(num_tasks);
+	for (size_t i = 0; i < num_tasks; ++i)
+		counters[i] = 0;
+
+	{	reshade::task_pool pool(num_threads);
+
+		// Batches, single tasks and urgent tasks each have to run exactly once
+		std::vector<std::function<void()>> tasks;
+		for (size_t i = 0; i < num_tasks / 2; ++i)
+			tasks.push_back([&counters, i]() { spin(i); counters[i]++; });
+		pool.push(std::move(tasks));
+		for (size_t i = num_tasks / 2; i < num_tasks; ++i)
+			pool.push([&counters, i]() { spin(i); counters[i]++; }, i % 3 == 0);
+
+		pool.wait();
+
+		for (size_t i = 0; i < num_tasks; ++i)
+			check(counters[i] == 1, "task did not run exactly once", num_threads);
+
+		// Tasks queued from within other tasks are covered by the same wait
+		std::atomic<size_t> num_nested = 0;
+		for (size_t i = 0; i < 100; ++i)
+		{
+			pool.push([&pool, &num_nested, i, num_threads]() {
+				check(pool.is_worker_thread(), "task did not run on a worker thread", num_threads);
+				for (size_t k = 0; k < 10; ++k)
+					pool.push([&num_nested, i, k]() { spin(i + k); num_nested++; }, k == 0);
+			});
+		}
+
+		pool.wait();
+
+		check(num_nested == 1000, "nested task did not run exactly once", num_threads);
+		check(!pool.is_worker_thread(), "calling thread considered a worker thread", num_threads);
+
+		// Parallel loops from the calling thread and from workers, while other tasks keep the pool busy
+		std::vector<size_t> values(5000);
+		for (size_t i = 0; i < 20; ++i)
+			pool.push([i]() { spin(i); });
+		pool.parallel_for(values.size(), [&values](size_t index) { spin(index); values[index] = index * 2; });
+
+		for (size_t i = 0; i < values.size(); ++i)
+			check(values[i] == i * 2, "parallel loop skipped an index", num_threads);
+
+		std::atomic<size_t> nested_sum = 0;
+		for (size_t i = 0; i < 10; ++i)
+			pool.push([&pool, &nested_sum]() { pool.parallel_for(100, [&nested_sum](size_t index) { nested_sum += index; }); });
+
+		pool.parallel_for(0, [&num_threads](size_t) { check(false, "parallel loop over an empty range called the function", num_threads); });
+		pool.parallel_for(1, [&values](size_t index) { values[index] = 1; });
+
+		pool.wait();
+
+		check(values[0] == 1, "parallel loop over a single index did not run", num_threads);
+		check(nested_sum == 10 * 4950, "nested parallel loop skipped an index", num_threads);
+
+		// Several threads queuing tasks at the same time
+		std::atomic<size_t> num_produced = 0;
+		std::vector<std::thread> producers;
+		for (size_t i = 0; i < 4; ++i)
+			producers.emplace_back([&pool, &num_produced]() {
+				for (size_t k = 0; k < 250; ++k)
+					pool.push([&num_produced]() { num_produced++; }, k % 5 == 0);
+			});
+		for (std::thread &producer : producers)
+			producer.join();
+
+		pool.wait();
+
+		check(num_produced == 1000, "task queued from another thread did not run exactly once", num_threads);
+
+		// The destructor has to finish all tasks that are still queued
+		for (size_t i = 0; i < num_tasks; ++i)
+			pool.push([&counters, i]() { spin(i); counters[i]++; });
+	}
+
+	for (size_t i = 0; i < num_tasks; ++i)
+		check(counters[i] == 2, "task queued before destruction did not run", num_threads);
+}
+
+int main(int argc, char *argv[])
+{
+	const size_t num_rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50;
+
+	for (size_t num_threads = 1; num_threads <= 8 && !s_failed; ++num_threads)
+	{
+		const auto time_started = std::chrono::high_resolution_clock::now();
+
+		for (size_t round = 0; round < num_rounds && !s_failed; ++round)
+			run_round(num_threads);
+
+		const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - time_started);
+		printf("%zu worker threads: %zu rounds in %.3f ms\n", num_threads, num_rounds, duration.count() / 1000.0);
+	}
+
+	return s_failed ? 1 : 0;
+}